@@ -110,6 +110,15 @@ namespace octomap {
   public:
     /// Default constructor, sets resolution of leafs
     ColorOcTree(double resolution);
+
+    /// Deep copy constructor
+    ColorOcTree(const ColorOcTree& rhs) : OccupancyOcTreeBase<ColorOcTreeNode>(rhs) {}
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Move constructor, takes over the tree of rhs in O(1)
+    ColorOcTree(ColorOcTree&& rhs) : OccupancyOcTreeBase<ColorOcTreeNode>(std::move(rhs)) {}
+    ColorOcTree& operator=(ColorOcTree&& rhs) { swap(rhs); return *this; }
+#endif
       
     /// virtual constructor: creates a new object of same type
     /// (Covariant return type requires an up-to-date compiler)
@@ -172,6 +181,12 @@ namespace octomap {
   protected:
     void updateInnerOccupancyRecurs(ColorOcTreeNode* node, unsigned int depth);
 
+    /// updates occupancy and color of the inner node from its children
+    virtual void updateInnerNode(ColorOcTreeNode* node) {
+      node->updateOccupancyChildren();
+      node->updateColorChildren();
+    }
+
     /**
      * Static member object which ensures that this OcTree's prototype
      * ends up in the classIDMapping only once. You need this as a 
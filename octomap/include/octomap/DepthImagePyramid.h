@@ -0,0 +1,100 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_DEPTH_IMAGE_PYRAMID_H
+#define OCTOMAP_DEPTH_IMAGE_PYRAMID_H
+
+#include <cstddef>
+#include <vector>
+
+namespace octomap {
+
+  /**
+   * Pinhole model of a depth camera in pixels: a point (x, y, z) in the camera frame
+   * (z along the optical axis, x to the right, y down) is seen at the pixel
+   * (fx * x / z + cx, fy * y / z + cy), pixel centers have integer coordinates.
+   */
+  struct CameraIntrinsics {
+    CameraIntrinsics() : fx(0.0), fy(0.0), cx(0.0), cy(0.0) {}
+    CameraIntrinsics(double _fx, double _fy, double _cx, double _cy) : fx(_fx), fy(_fy), cx(_cx), cy(_cy) {}
+    double fx, fy;
+    double cx, cy;
+  };
+
+  /**
+   * Minimum and maximum depth of a depth image for blocks of 2^k x 2^k pixels on
+   * level k, used by OccupancyOcTreeBase::insertDepthImage() to bound the depth within
+   * the projection of a node with at most four lookups.
+   * Invalid pixels (not positive or not finite) have depth 0.
+   */
+  class DepthImagePyramid {
+  public:
+    DepthImagePyramid() : width(0), height(0) {}
+
+    /**
+     * Builds all levels from the image.
+     *
+     * @param depth depth per pixel in meters, row after row
+     * @param row_pitch bytes from the start of one row to the next (a multiple of
+     *   sizeof(float)), 0: width * sizeof(float)
+     * @param maxrange larger depths are limited to maxrange (-1: unlimited)
+     */
+    void build(const float* depth, unsigned int width, unsigned int height, size_t row_pitch, double maxrange);
+
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+
+    /// @return depth of pixel (u, v) (level 0)
+    float getDepth(unsigned int u, unsigned int v) const { return depths[0][v * width + u]; }
+
+    /**
+     * Bounds the depth of the pixels [u0, u1] x [v0, v1] (clipped to the image) from the
+     * smallest level where they cover at most 2 x 2 blocks. The bounds may include
+     * pixels around the rectangle, so min_depth can be too low and max_depth too high.
+     * @return false if the rectangle is outside of the image
+     */
+    bool getDepthRange(int u0, int v0, int u1, int v1, float& min_depth, float& max_depth) const;
+
+  protected:
+    unsigned int width;
+    unsigned int height;
+    std::vector<unsigned int> level_widths;
+    std::vector<unsigned int> level_heights;
+    /// per level, level 0 holds the (limited) depth of each pixel and serves as minimum and maximum
+    std::vector<std::vector<float> > depths;
+    std::vector<std::vector<float> > max_depths;
+  };
+
+} // namespace
+
+#endif
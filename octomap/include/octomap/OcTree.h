@@ -59,6 +59,15 @@ namespace octomap {
      */
     OcTree(std::string _filename);
 
+    /// Deep copy constructor
+    OcTree(const OcTree& rhs) : OccupancyOcTreeBase<OcTreeNode>(rhs) {}
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Move constructor, takes over the tree of rhs in O(1)
+    OcTree(OcTree&& rhs) : OccupancyOcTreeBase<OcTreeNode>(std::move(rhs)) {}
+    OcTree& operator=(OcTree&& rhs) { swap(rhs); return *this; }
+#endif
+
     virtual ~OcTree(){};
 
     /// virtual constructor: creates a new object of same type
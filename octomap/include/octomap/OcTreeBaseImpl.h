@@ -40,9 +40,13 @@
 #include <iterator>
 #include <stack>
 #include <bitset>
+#include <map>
+#include <fstream>
 
 #include "octomap_types.h"
 #include "OcTreeKey.h"
+#include "OcTreeMemoryPool.h"
+#include "OcTreeRayPacket.h"
 #include "ScanGraph.h"
 
 
@@ -55,9 +59,11 @@ namespace octomap {
   /**
    * OcTree base class, to be used with with any kind of OcTreeDataNode.
    *
-   * This tree implementation currently has a maximum depth of 16
-   * nodes. For this reason, coordinates values have to be, e.g.,
+   * This tree implementation has a depth of 16 levels by default.
+   * For this reason, coordinates values have to be, e.g.,
    * below +/- 327.68 meters (2^15) at a maximum resolution of 0.01m.
+   * Deeper trees (up to 21 levels) are enabled at compile time with the
+   * CMake options OCTOMAP_KEY_32BIT and OCTOMAP_TREE_DEPTH, see OcTreeKey.h.
    *
    * This limitation enables the use of an efficient key generation
    * method which uses the binary representation of the data point
@@ -78,6 +84,10 @@ namespace octomap {
     /// Make the templated NODE type available from the outside
     typedef NODE NodeType;
 
+    /// tree and node type of the iterators in OcTreeIterator.hxx
+    typedef OcTreeBaseImpl<NODE,INTERFACE> IteratorTreeType;
+    typedef NODE IteratorNodeType;
+
     // the actual iterator implementation is included here
     // as a member from this file
     #include <octomap/OcTreeIterator.hxx>
@@ -97,6 +107,24 @@ namespace octomap {
      */
     void swapContent(OcTreeBaseImpl<NODE,INTERFACE>& rhs);
 
+    /**
+     * Swap the complete contents of two octrees of the same tree depth in O(1),
+     * i.e., the tree structure, the resolution and the memory and thread settings.
+     * Derived trees extend this with their own parameters.
+     */
+    void swap(OcTreeBaseImpl<NODE,INTERFACE>& other);
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Move constructor, takes over the tree of rhs in O(1) and leaves rhs empty
+    OcTreeBaseImpl(OcTreeBaseImpl<NODE,INTERFACE>&& rhs);
+
+    /// Move assignment in O(1), exchanges the contents with rhs (see swap())
+    OcTreeBaseImpl<NODE,INTERFACE>& operator=(OcTreeBaseImpl<NODE,INTERFACE>&& rhs) {
+      swap(rhs);
+      return *this;
+    }
+#endif
+
     /// Comparison between two octrees, all meta data, all
     /// nodes, and the structure must be identical
     bool operator== (const OcTreeBaseImpl<NODE,INTERFACE>& rhs) const;
@@ -126,8 +154,11 @@ namespace octomap {
     /// Creates (allocates) the i-th child of the node. @return ptr to newly create NODE
     NODE* createNodeChild(NODE* node, unsigned int childIdx);
     
-    /// Deletes the i-th child of the node
+    /// Deletes the i-th child of the node, which must not have children
     void deleteNodeChild(NODE* node, unsigned int childIdx);
+
+    /// Deletes the i-th child of the node including all its descendants
+    void deleteNodeChildSubtree(NODE* node, unsigned int childIdx);
     
     /// @return ptr to child number childIdx of node
     NODE* getNodeChild(NODE* node, unsigned int childIdx) const;
@@ -220,9 +251,122 @@ namespace octomap {
      */
     bool deleteNode(const OcTreeKey& key, unsigned int depth = 0);
 
-    /// Deletes the complete tree structure
+    /**
+     * Deletes all nodes outside of the box between min_key and max_key (keys at the
+     * lowest level, inclusive). Subtrees completely outside are deleted as a whole,
+     * only nodes intersecting the boundary of the box are visited (and expanded if
+     * pruned), so the cost does not depend on the number of deleted voxels.
+     */
+    void deleteOutsideBBX(const OcTreeKey& min_key, const OcTreeKey& max_key);
+
+    /// Deletes all nodes outside of the box between min and max, see deleteOutsideBBX(const OcTreeKey&, const OcTreeKey&)
+    void deleteOutsideBBX(const point3d& min, const point3d& max);
+
+    /**
+     * Translates the contents of the tree by an offset in keys at the lowest level,
+     * i.e. by the metric offset (dx, dy, dz) * resolution. Nodes moved outside of the
+     * key range are deleted. Whole subtrees are re-linked at the smallest depth whose
+     * node size divides all offsets, pruned nodes above that depth are expanded.
+     * The cost thus depends on the number of these subtrees, e.g. offsets in multiples
+     * of getNodeSize(depth) / resolution move the subtrees at depth.
+     */
+    void shiftKeys(int dx, int dy, int dz);
+
+    /// Deletes the complete tree structure. With the memory pool enabled, the
+    /// memory of all nodes is kept for reuse, see releaseMemoryPool().
     void clear();
 
+    // -- memory management  -----------------
+
+    /**
+     * Enable or disable the per-tree memory pool (enabled by default). With the pool,
+     * nodes and child arrays are allocated in larger chunks and recycled through free
+     * lists instead of individual heap allocations. This can only be changed while
+     * the tree is empty. Builds with OCTOMAP_INDEXED_CHILDREN always use the pool.
+     * @return true if the setting was changed (or already as requested)
+     */
+    bool setMemoryPoolEnabled(bool enable);
+    bool isMemoryPoolEnabled() const { return use_memory_pool; }
+
+    /// Returns all memory cached by the memory pool to the system.
+    /// This only has an effect on an empty tree, e.g. after clear().
+    void releaseMemoryPool();
+
+    // -- paging of cold subtrees  -----------------
+
+    /**
+     * Enables paging to bound the memory used by the nodes when mapping large areas.
+     * The subtrees at paging_depth record their last access by pageIn(), deleteNode()
+     * and the updates of OccupancyOcTreeBase. When the nodes in memory exceed
+     * memory_budget bytes (see memoryUsageResident()), enforceMemoryBudget() writes the
+     * least recently used subtrees to the file filename in the format of writeData()
+     * and frees them. The root of such a subtree stays in the tree as a leaf with its
+     * value, i.e. the maximum occupancy of the subtree.
+     *
+     * Only non-const operations read subtrees back: the updates, deleteNode() and
+     * pageIn() the subtrees they access, expand(), toMaxLikelihood() and shiftKeys()
+     * all of them. Const accessors never change the tree. search(), castRay() and
+     * the iterators see a paged-out subtree as the leaf at paging_depth, call pageIn()
+     * or pageInAll() first to query below it. Writing, copying and comparing read the
+     * paged-out subtrees from the file without changing the tree.
+     * size(), getNumInnerNodes() and getNumLeafNodes() include the paged-out nodes,
+     * calcNumNodes(), getNumNodesAtDepth() and the memory statistics only count the
+     * nodes in memory.
+     *
+     * Thread safety: as without paging, const accessors may be called concurrently
+     * with each other, but not together with a non-const operation. Node pointers
+     * and iterators are only valid until the next non-const operation, which may
+     * page out their subtree. Not available together with snapshots. Whole-tree
+     * operations which change nodes do not run in parallel (see setNumThreads()).
+     * @return false if paging_depth is not in [1, tree_depth-1] or the file cannot be opened
+     */
+    bool enablePaging(const std::string& filename, size_t memory_budget, unsigned int paging_depth);
+
+    /// Reads back all paged-out subtrees and removes the paging file
+    void disablePaging();
+    bool isPagingEnabled() const { return paging_depth != 0; }
+    unsigned int getPagingDepth() const { return paging_depth; }
+
+    /**
+     * Pages out the least recently used subtrees until the nodes in memory use at most
+     * 7/8 of the budget, so that not every update needs to page. Called by the updates
+     * of OccupancyOcTreeBase, the subtree accessed last is never paged out.
+     * @return number of subtrees paged out
+     */
+    size_t enforceMemoryBudget();
+
+    /// @return number of subtrees currently paged out, see enablePaging()
+    size_t getNumPagedSubtrees() const { return paged_subtrees.size(); }
+
+    /**
+     * Reads back the paged-out subtree at paging_depth which contains key, if any,
+     * and records an access to it (see enablePaging()), so that const accessors
+     * like search() reach the nodes below it. Changes the tree.
+     * @return true if the subtree was read back
+     */
+    bool pageIn(const OcTreeKey& key);
+
+    /// Reads back all paged-out subtrees, see enablePaging()
+    void pageInAll();
+
+    // -- parallel traversals  -----------------
+
+    /**
+     * Number of threads for whole-tree operations (prune(), expand(), toMaxLikelihood(),
+     * updateInnerOccupancy(), calcNumNodes(), getNumLeafNodes(), and the metric
+     * bounds), which then process the eight subtrees of the root in parallel with
+     * identical results. Only has an effect when compiled with OpenMP (OCTOMAP_OMP).
+     * Default: 1 (serial)
+     */
+    void setNumThreads(unsigned int num) { num_threads = (num > 0) ? num : 1; }
+    unsigned int getNumThreads() const { return num_threads; }
+
+    /// Limits the instruction set of computeRaysKeys() for this tree (e.g. for benchmarks).
+    /// Default: RAY_SIMD_AVX2, i.e. the best one of detectRaySIMD()
+    void setRaySIMD(RaySIMD simd) { ray_simd = simd; }
+    /// @return instruction set used by computeRaysKeys(), at most detectRaySIMD()
+    RaySIMD getRaySIMD() const { return std::min(ray_simd, detectRaySIMD()); }
+
     /**
      * Lossless compression of the octree: A node will replace all of its eight
      * children if they have identical values. You usually don't have to call
@@ -238,14 +382,38 @@ namespace octomap {
     // -- statistics  ----------------------
 
     /// \return The number of nodes in the tree
-    virtual inline size_t size() const { return tree_size; }
+    /// \return number of nodes in the tree, including paged-out ones (see enablePaging())
+    virtual inline size_t size() const { return tree_size + num_paged_nodes; }
 
-    /// \return Memory usage of the complete octree in bytes (may vary between architectures)
+    /// \return Memory usage of the complete octree in bytes (may vary between architectures).
+    /// With the memory pool enabled, this is the memory actually held by the pool.
     virtual size_t memoryUsage() const;
 
     /// \return Memory usage of a single octree node
     virtual inline size_t memoryUsageNode() const {return sizeof(NODE); };
 
+    /// \return Memory used by the arrays of child pointers (part of memoryUsage()),
+    /// including arrays of replaced nodes which snapshots still refer to.
+    /// With OCTOMAP_INDEXED_CHILDREN, these are the unused slots of the blocks of children.
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    size_t memoryUsageChildArrays() const { return memoryUsageResident() - tree_size * sizeof(NODE); }
+#else
+    size_t memoryUsageChildArrays() const { return num_child_arrays * sizeof(AbstractOcTreeNode*[8]); }
+#endif
+
+    /// \return Memory used by the nodes and child arrays of the tree, i.e. memoryUsage()
+    /// without the slack of the allocator. Compared against the budget of enablePaging().
+    size_t memoryUsageResident() const;
+
+    /// \return Memory held by the allocator but not by the nodes and child arrays
+    /// of the tree: free slots of the memory pool and nodes retained for snapshots.
+    /// Always 0 without the memory pool.
+    size_t memoryUsageSlack() const;
+
+    /// \return Maximum of memoryUsage() since construction or resetMemoryUsagePeak()
+    size_t memoryUsagePeak() const;
+    void resetMemoryUsagePeak() { memory_usage_peak = 0; }
+
     /// \return Memory usage of a full grid of the same size as the OcTree in bytes (for comparison)
     /// \note this can be larger than the adressable memory - size_t may not be enough to hold it!
     unsigned long long memoryFullGrid() const;
@@ -271,6 +439,15 @@ namespace octomap {
     /// Traverses the tree to calculate the total number of leaf nodes
     size_t getNumLeafNodes() const;
 
+    /// \return number of inner nodes, i.e., nodes with an array of child pointers.
+    /// Maintained incrementally, the number of leafs is size() - getNumInnerNodes().
+    size_t getNumInnerNodes() const { return num_child_arrays - num_retired_child_arrays + num_paged_inner_nodes; }
+
+    /// \return number of nodes at the given depth (0: root). Maintained incrementally
+    /// for nodes which store their depth (OcTreeNode and derived), otherwise
+    /// this traverses the tree.
+    size_t getNumNodesAtDepth(unsigned int depth) const;
+
 
     // -- access tree nodes  ------------------
 
@@ -292,6 +469,34 @@ namespace octomap {
     */
     bool computeRayKeys(const point3d& origin, const point3d& end, KeyRay& ray) const;
 
+   /**
+    * Traces a ray from origin to end (excluding) like computeRayKeys(), with an exact DDA in
+    * key space: origin and end are converted once (by coordToKey() plus a sub-voxel offset
+    * in fixed point), then only integer arithmetic is used. The ray contains every node
+    * between both keys exactly once (face-connected, no skipped or duplicated nodes) and the
+    * result does not depend on the compiler. It may differ from computeRayKeys() where a ray
+    * passes close to the edge or corner of a node.
+    *
+    * @param origin start coordinate of ray
+    * @param end end coordinate of ray
+    * @param ray KeyRay structure that holds the keys of all nodes traversed by the ray, excluding "end"
+    * @return Success of operation. Returning false usually means that one of the coordinates is out of the OcTree's range
+    */
+    bool computeRayKeysExact(const point3d& origin, const point3d& end, KeyRay& ray) const;
+
+   /**
+    * Traces the rays from origin to each of the end points like computeRayKeys(), several
+    * rays at once with SIMD instructions where the CPU supports them (see traverseRayPacket()).
+    * The keys are identical to the ones of computeRayKeys(). Each KeyRay is grown to the number
+    * of nodes its ray can cross (see KeyRay::reserveMax()), so KeyRay(0) can be passed.
+    *
+    * @param origin start coordinate of all rays
+    * @param ends array of num_rays end coordinates
+    * @param rays array of num_rays KeyRays, rays[i] receives the keys of the ray to ends[i]
+    * @param valid array of num_rays results, valid[i] is the return value of computeRayKeys() for ends[i]
+    */
+    void computeRaysKeys(const point3d& origin, const point3d* ends, size_t num_rays, KeyRay* rays, bool* valid) const;
+
 
    /**
     * Traces a ray from origin to end (excluding), returning the
@@ -355,7 +560,7 @@ namespace octomap {
 
     /// Converts from a single coordinate into a discrete key
     inline key_type coordToKey(double coordinate) const{
-      return ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+      return computeKey(coordinate, resolution_factor, tree_max_val);
     }
 
     /// Converts from a single coordinate into a discrete key at a given depth
@@ -460,7 +665,7 @@ namespace octomap {
      * Converts a single coordinate into a discrete addressing key, with boundary checking.
      *
      * @param coordinate 3d coordinate of a point
-     * @param key discrete 16 bit adressing key, result
+     * @param key discrete adressing key, result
      * @return true if coordinate is within the octree bounds (valid), false otherwise
      */
     bool coordToKeyChecked(double coordinate, key_type& key) const;
@@ -470,7 +675,7 @@ namespace octomap {
      *
      * @param coordinate 3d coordinate of a point
      * @param depth level of the key from the top
-     * @param key discrete 16 bit adressing key, result
+     * @param key discrete adressing key, result
      * @return true if coordinate is within the octree bounds (valid), false otherwise
      */
     bool coordToKeyChecked(double coordinate, unsigned depth, key_type& key) const;
@@ -482,7 +687,7 @@ namespace octomap {
     /// converts from a discrete key at the lowest tree level into a coordinate
     /// corresponding to the key's center
     inline double keyToCoord(key_type key) const{
-      return (double( (int) key - (int) this->tree_max_val ) +0.5) * this->resolution;
+      return computeKeyCoord(key, this->tree_max_val, this->resolution);
     }
 
     /// converts from an addressing key at the lowest tree level into a coordinate
@@ -505,16 +710,52 @@ namespace octomap {
     /// initialize non-trivial members, helper for constructors
     void init();
 
-    /// recalculates min and max in x, y, z. Does nothing when tree size didn't change.
+    /// recursive helper of the copy constructor, copies all children of "from" into "to"
+    void copyNodesRecurs(const NODE* from, NODE* to);
+
+    /// Constructs child childIdx of node in its storage (without touching tree_size)
+    NODE* allocNodeChild(NODE* node, unsigned int childIdx);
+
+    /// Updates min and max in x, y, z. Only the subtrees of the root whose bounds
+    /// are not maintained incrementally (see growBounds(), shrinkBounds()) are traversed.
     void calcMinMax();
 
+    /// Computes the metric bounds (min_val, max_val) from the bounds of the subtrees
+    /// of the root (min_keys, max_keys), after recomputing those of the subtrees in dirty
+    void calcMinMaxChildren(unsigned char dirty, OcTreeKey* min_keys, OcTreeKey* max_keys,
+                            double* min_val, double* max_val) const;
+
+    /// recursive helper of calcMinMax() for the leafs below node (at key and depth),
+    /// as keys at the lowest tree level
+    void calcMinMaxRecurs(const NODE* node, const OcTreeKey& key, unsigned int depth,
+                          OcTreeKey& min_key, OcTreeKey& max_key) const;
+
+    // -- incremental bounds: structural changes (createNodeChild(), deleteNodeChild())
+    // invalidate the bounds, operations which know where they changed the tree restore them
+
+    /// @return true if the bounds are maintained incrementally, to be checked
+    /// before a structural change (an empty root is replaced by smaller leafs)
+    inline bool boundsTracked() const { return !size_changed && root != NULL && nodeHasChildren(root); }
+
+    /// Restores the bounds after nodes were created on the path to key only,
+    /// ending in the leaf that contains key
+    void growBounds(const OcTreeKey& key);
+
+    /// Restores the bounds after nodes were deleted on the path to key,
+    /// the bounds of its subtree of the root are recomputed on demand
+    void shrinkBounds(const OcTreeKey& key);
+
+    /// @return true if the eight subtrees of the root are to be processed in parallel
+    /// (see setNumThreads()), with modify: by an operation which changes nodes
+    bool useParallelTraversal(bool modify) const;
+
     void calcNumNodesRecurs(NODE* node, size_t& num_nodes) const;
     
     /// recursive call of readData()
     std::istream& readNodesRecurs(NODE*, std::istream &s);
     
-    /// recursive call of writeData()
-    std::ostream& writeNodesRecurs(const NODE*, std::ostream &s) const;
+    /// recursive call of writeData(), reads paged-out subtrees from paging_reader if given
+    std::ostream& writeNodesRecurs(const NODE*, std::ostream &s, std::istream* paging_reader = NULL) const;
     
     /// Recursively delete a node and all children. Deallocates memory
     /// but does NOT set the node ptr to NULL nor updates tree size.
@@ -523,6 +764,27 @@ namespace octomap {
     /// recursive call of deleteNode()
     bool deleteNodeRecurs(NODE* node, unsigned int depth, unsigned int max_depth, const OcTreeKey& key);
 
+    /// recursive call of deleteOutsideBBX() for a node intersecting the boundary of the box,
+    /// base_key: lowest key of the node's volume
+    void deleteOutsideBBXRecurs(NODE* node, unsigned int depth, const OcTreeKey& base_key,
+                                const OcTreeKey& min_key, const OcTreeKey& max_key);
+
+    /// recursive helper of shiftKeys(), collects the nodes at max_depth (and their lowest keys)
+    void collectSubtreesRecurs(NODE* node, unsigned int depth, const OcTreeKey& base_key, unsigned int max_depth,
+                               std::vector<std::pair<OcTreeKey, NODE*> >& subtrees);
+
+    /// updates the inner nodes above max_depth from their children (after shiftKeys())
+    void updateInnerNodesRecurs(NODE* node, unsigned int depth, unsigned int max_depth);
+
+    /// removes all descendants of node from tree_size and the per-depth statistics
+    /// @return number of child arrays of node and its descendants
+    size_t discountChildrenRecurs(const NODE* node);
+
+    /// Deletes node and its subtree (deleteNodeRecurs()) after discountChildrenRecurs().
+    /// Of the num_arrays child arrays in the subtree, those retained for snapshots
+    /// are counted as retired.
+    void deleteDiscountedSubtree(NODE* node, size_t num_arrays);
+
     /// recursive call of prune()
     void pruneRecurs(NODE* node, unsigned int depth, unsigned int max_depth, unsigned int& num_pruned);
 
@@ -531,25 +793,204 @@ namespace octomap {
     
     size_t getNumLeafNodesRecurs(const NODE* parent) const;
 
+    // -- copy-on-write support, see OccupancyOcTreeBase::snapshot()
+
+    /// @return child childIdx of node, which is replaced by a private copy first
+    /// if it is shared. Needs to be used on all paths that modify nodes.
+    inline NODE* getNodeChildForWrite(NODE* node, unsigned int childIdx) {
+      if (copy_on_write)
+        return unshareNodeChild(node, childIdx);
+      return getNodeChild(node, childIdx);
+    }
+
+    /// search() for a node which is going to be modified (see getNodeChildForWrite())
+    NODE* searchForWrite(const OcTreeKey& key, unsigned int depth = 0);
+
+    /// Called by getNodeChildForWrite() if copy_on_write is set.
+    /// @return child childIdx of node after making sure that it may be modified
+    virtual NODE* unshareNodeChild(NODE* node, unsigned int childIdx) { return getNodeChild(node, childIdx); }
+
+    /// Called before node and its subtree are deleted if copy_on_write is set.
+    /// @return true if the subtree is still in use elsewhere and was taken over,
+    /// i.e. must not be freed
+    virtual bool retainSubtree(NODE* /*node*/) { return false; }
+
+    /// @return new node with the data and the child pointers (not the children) of node
+    NODE* copyNodeShallow(const NODE* node);
+
+    /// Replaces child childIdx of node by child, the previous child is neither freed nor counted
+    void replaceNodeChild(NODE* node, unsigned int childIdx, NODE* child) {
+#ifdef OCTOMAP_INDEXED_CHILDREN
+      // a slot can't refer to another node, snapshot() refuses indexed children
+      assert(child == getNodeChild(node, childIdx));
+#else
+      node->children[childIdx] = static_cast<AbstractOcTreeNode*>(child);
+#endif
+    }
+
+    /// Marks child childIdx of node as deleted after it was freed
+    void clearNodeChild(NODE* node, unsigned int childIdx) {
+#ifdef OCTOMAP_INDEXED_CHILDREN
+      node->child_mask &= (unsigned char) ~(1 << childIdx);
+#else
+      node->children[childIdx] = NULL;
+#endif
+    }
+
+    // -- paging, see enablePaging()
+
+    /// location of a paged-out subtree in the paging file
+    struct PagedSubtree {
+      std::streamoff offset; ///< of the subtree, written by writeNodesRecurs()
+      size_t num_nodes;      ///< number of nodes below the root of the subtree
+      size_t num_inner_nodes;///< number of inner nodes of the subtree, including its root
+      OcTreeKey key;         ///< index key of the subtree
+      OcTreeKey min_key;     ///< bounds of its leafs, see calcMinMaxRecurs()
+      OcTreeKey max_key;
+    };
+
+    /// subtree in memory which may be paged out, ordered by last access
+    struct PagingCandidate {
+      unsigned long last_access;
+      NODE* node;
+      OcTreeKey key; ///< center key of node
+      bool operator<(const PagingCandidate& other) const { return last_access < other.last_access; }
+    };
+
+    /// @return true if node is the root of a paged-out subtree (a leaf in memory)
+    inline bool isPagedOut(const NODE* node) const {
+      return !paged_subtrees.empty() && !hasChildArray(node)
+          && (!NODE::storesDepth() || node->getStoredDepth() == paging_depth)
+          && paged_subtrees.count(node) > 0;
+    }
+
+    /// reads back the subtree of node if it is paged out
+    inline void pageInIfPaged(NODE* node) {
+      if (isPagedOut(node))
+        pageInSubtree(node);
+    }
+
+    /// Records an access to the subtree at paging_depth which contains key,
+    /// and reads it back if it is paged out. Requires paging to be enabled.
+    /// @return true if the subtree was read back
+    bool touchSubtree(const OcTreeKey& key);
+
+    /// reads back the children of the paged-out node from the paging file
+    void pageInSubtree(NODE* node);
+
+    // const accessors read the paging file with a stream of their own, paging_file
+    // and the tree stay untouched
+
+    /// opens the paging file for reading in reader. @return false on error
+    bool openPagingReader(std::ifstream& reader) const;
+
+    /// Reads the paged-out subtree of node (including node) into new nodes
+    /// which are not part of the tree, free them with deletePagedSubtree()
+    NODE* readPagedSubtree(const NODE* node, std::istream& reader) const;
+
+    /// recursive helper of readPagedSubtree()
+    static void readPagedNodesRecurs(NODE* node, std::istream& s);
+
+    /// frees a subtree of readPagedSubtree()
+    static void deletePagedSubtree(NODE* node);
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    /// recursive helper of deletePagedSubtree(), destroys the nodes
+    static void destroyPagedNodesRecurs(NODE* node);
+#endif
+
+    /// recursive helper of operator==, compares the subtrees of node and other_node
+    /// and reads paged-out subtrees with the readers
+    bool nodesEqualRecurs(const NODE* node, std::istream& reader, const OcTreeBaseImpl<NODE,INTERFACE>& other,
+                          const NODE* other_node, std::istream& other_reader) const;
+
+    /// writes the children of node (at paging_depth, with center key) to the paging file
+    /// and frees them. @return false if the file could not be written
+    bool pageOutSubtree(NODE* node, const OcTreeKey& key);
+
+    /// Called before the subtree of node is paged out, derived trees
+    /// bring the nodes which are not stored into a consistent state there
+    virtual void beforePageOut(NODE* /*node*/) {}
+
+    /// Updates the data of the inner node from its children after deleteOutsideBBX()
+    /// or shiftKeys() changed them. Derived trees update all data they keep in inner nodes.
+    virtual void updateInnerNode(NODE* /*node*/) {}
+
+    /// recursive helper of enforceMemoryBudget(), collects the subtrees in memory at paging_depth
+    void collectPagingCandidatesRecurs(NODE* node, unsigned int depth, const OcTreeKey& key,
+                                       std::vector<PagingCandidate>& candidates) const;
+
+    /// (re-)opens the paging file empty, after the last subtree was read back
+    bool resetPagingFile();
+
+    /// @return number of child arrays of node (0 or 1), to maintain num_retired_child_arrays
+    size_t countChildArrays(const NODE* node) const { return hasChildArray(node) ? 1 : 0; }
+
+    /// @return true if the children of node are allocated (some may not exist)
+    static bool hasChildArray(const NODE* node) { return node->children != 0; }
+
   private:
     /// Assignment operator is private: don't (re-)assign octrees
     /// (const-parameters can't be changed) -  use the copy constructor instead.
     OcTreeBaseImpl<NODE,INTERFACE>& operator=(const OcTreeBaseImpl<NODE,INTERFACE>&);
 
   protected:  
+    /// Allocates a new (childless) NODE, from the memory pool if enabled
+    NODE* allocNode();
+    /// Destroys a NODE allocated by allocNode(). Its children need to be freed already.
+    void freeNode(NODE* node);
+
     void allocNodeChildren(NODE* node);
+    /// Frees the child array of a node (the children themselves need to be deleted already)
+    void freeNodeChildren(NODE* node);
+
+    /**
+     * Initialization phase of the DDA in computeRayKeys() and computeRaysKeys(), resets the ray
+     * and adds the key of origin. current_key, step, tMax, tDelta and length start the
+     * incremental phase unless done is set (origin and end in the same node).
+     * @return false if origin or end are out of bounds
+     */
+    bool initRayKeys(const point3d& origin, const point3d& end, KeyRay& ray,
+                     OcTreeKey& current_key, OcTreeKey& key_end,
+                     int step[3], double tMax[3], double tDelta[3],
+                     float& length, bool& done) const;
+
+    /**
+     * Position of coord in key space as used by computeRayKeysExact(): the key in the
+     * upper bits, a sub-voxel offset in the lower getKeyPositionBits() bits.
+     * @return false if coord is out of bounds
+     */
+    bool coordToKeyPositionChecked(const point3d& coord, OcTreeKey& key, uint64_t pos[3]) const;
+    /// fractional bits of coordToKeyPositionChecked(), positions stay below 2^31
+    unsigned int getKeyPositionBits() const { return 30 - tree_depth; }
+
+    /// memory usage can only decrease by freeing memory, the peak is recorded right before
+    inline void recordMemoryUsagePeak() {
+      size_t usage = OcTreeBaseImpl<NODE,INTERFACE>::memoryUsage();
+      if (usage > memory_usage_peak)
+        memory_usage_peak = usage;
+    }
 
     NODE* root; ///< Pointer to the root NODE, NULL for empty tree
 
     // constants of the tree
-    const unsigned int tree_depth; ///< Maximum tree depth is fixed to 16 currently
+    const unsigned int tree_depth; ///< Maximum tree depth, OCTOMAP_TREE_DEPTH (16 by default)
     const unsigned int tree_max_val;
     double resolution;  ///< in meters
     double resolution_factor; ///< = 1. / resolution
   
     size_t tree_size; ///< number of nodes in tree
+    /// number of nodes per depth (if NODE::storesDepth()), depth 0 is given by root
+    std::vector<size_t> num_nodes_depth;
+    size_t num_child_arrays; ///< number of allocated arrays of child pointers
+    /// number of child arrays of nodes no longer in the tree, retained for snapshots
+    size_t num_retired_child_arrays;
+    size_t memory_usage_peak; ///< see recordMemoryUsagePeak()
     /// flag to denote whether the octree extent changed (for lazy min/max eval)
     bool size_changed;
+    /// bounds of the leafs in each subtree of the root, as keys at the lowest tree level
+    OcTreeKey bounds_min_key[8];
+    OcTreeKey bounds_max_key[8];
+    unsigned char bounds_dirty; ///< subtrees of the root whose bounds need to be recomputed
 
     point3d tree_center;  // coordinate offset of tree
 
@@ -561,6 +1002,35 @@ namespace octomap {
     /// data structure for ray casting, array for multithreading
     std::vector<KeyRay> keyrays;
 
+    bool use_memory_pool;
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    OcTreeBlockPool block_pool;     ///< storage of all NODEs, in blocks of siblings
+#else
+    OcTreeMemoryPool node_pool;     ///< storage of all NODEs (if use_memory_pool)
+    OcTreeMemoryPool children_pool; ///< storage of child pointer arrays (if use_memory_pool)
+#endif
+
+    /// nodes may be shared with snapshots, enables the copy-on-write hooks
+    bool copy_on_write;
+
+    /// number of threads for whole-tree operations
+    unsigned int num_threads;
+    /// limit of the instruction set for ray traversal, see setRaySIMD()
+    RaySIMD ray_simd;
+
+    unsigned int paging_depth;   ///< depth of the paged subtrees, 0: paging disabled
+    size_t paging_budget;        ///< in bytes, see memoryUsageResident()
+    std::string paging_filename;
+    std::fstream* paging_file;
+    unsigned long paging_clock;  ///< number of accesses to subtrees so far
+    /// last access (paging_clock) of the subtrees in memory, by their index key
+    KeyFlatMap<unsigned long> subtree_access;
+    /// roots of the paged-out subtrees
+    std::map<const NODE*, PagedSubtree> paged_subtrees;
+    /// sums of PagedSubtree::num_nodes and num_inner_nodes of all paged-out subtrees
+    size_t num_paged_nodes;
+    size_t num_paged_inner_nodes;
+
     const leaf_iterator leaf_iterator_end;
     const leaf_bbx_iterator leaf_iterator_bbx_end;
     const tree_iterator tree_iterator_end;
@@ -33,7 +33,11 @@
 
 #undef max
 #undef min
+#include <algorithm>
 #include <limits>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
 
 #ifdef _OPENMP
   #include <omp.h>
@@ -44,8 +48,14 @@ namespace octomap {
 
   template <class NODE,class I>
   OcTreeBaseImpl<NODE,I>::OcTreeBaseImpl(double in_resolution) :
-    I(), root(NULL), tree_depth(16), tree_max_val(32768),
-    resolution(in_resolution), tree_size(0)
+    I(), root(NULL), tree_depth(OCTOMAP_TREE_DEPTH), tree_max_val(1 << (OCTOMAP_TREE_DEPTH-1)),
+    resolution(in_resolution), tree_size(0), use_memory_pool(true),
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    block_pool(sizeof(NODE)),
+#else
+    node_pool(sizeof(NODE)), children_pool(sizeof(AbstractOcTreeNode*[8])),
+#endif
+    copy_on_write(false), num_threads(1), ray_simd(RAY_SIMD_AVX2)
   {
 
     init();
@@ -56,7 +66,13 @@ namespace octomap {
   template <class NODE,class I>
   OcTreeBaseImpl<NODE,I>::OcTreeBaseImpl(double in_resolution, unsigned int in_tree_depth, unsigned int in_tree_max_val) :
     I(), root(NULL), tree_depth(in_tree_depth), tree_max_val(in_tree_max_val),
-    resolution(in_resolution), tree_size(0)
+    resolution(in_resolution), tree_size(0), use_memory_pool(true),
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    block_pool(sizeof(NODE)),
+#else
+    node_pool(sizeof(NODE)), children_pool(sizeof(AbstractOcTreeNode*[8])),
+#endif
+    copy_on_write(false), num_threads(1), ray_simd(RAY_SIMD_AVX2)
   {
     init();
 
@@ -67,31 +83,101 @@ namespace octomap {
   template <class NODE,class I>
   OcTreeBaseImpl<NODE,I>::~OcTreeBaseImpl(){
     clear();
+    disablePaging();
   }
 
 
   template <class NODE,class I>
   OcTreeBaseImpl<NODE,I>::OcTreeBaseImpl(const OcTreeBaseImpl<NODE,I>& rhs) :
     root(NULL), tree_depth(rhs.tree_depth), tree_max_val(rhs.tree_max_val),
-    resolution(rhs.resolution), tree_size(rhs.tree_size)
+    resolution(rhs.resolution), tree_size(rhs.tree_size), use_memory_pool(rhs.use_memory_pool),
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    block_pool(sizeof(NODE)),
+#else
+    node_pool(sizeof(NODE)), children_pool(sizeof(AbstractOcTreeNode*[8])),
+#endif
+    copy_on_write(false), num_threads(rhs.num_threads), ray_simd(rhs.ray_simd)
   {
     init();
+    tree_size = rhs.tree_size;
 
     // copy nodes recursively:
-    if (rhs.root)
-      root = new NODE(*(rhs.root));
+    if (rhs.root){
+      root = allocNode();
+      root->copyData(*(rhs.root));
+      copyNodesRecurs(rhs.root, root);
+      num_nodes_depth = rhs.num_nodes_depth;
+    }
+
+    // the copy holds all nodes in memory: read the paged-out subtrees of rhs
+    // from its file (rhs stays unchanged)
+    std::ifstream paging_reader;
+    if (!rhs.paged_subtrees.empty() && rhs.openPagingReader(paging_reader)) {
+      for (typename std::map<const NODE*, PagedSubtree>::const_iterator it = rhs.paged_subtrees.begin();
+           it != rhs.paged_subtrees.end(); ++it) {
+        NODE* node = search(it->second.key, rhs.paging_depth);
+        assert(node != NULL && !hasChildArray(node));
+        paging_reader.seekg(it->second.offset);
+        readNodesRecurs(node, paging_reader);
+      }
+      if (!paging_reader.good())
+        OCTOMAP_ERROR_STR("Could not read subtrees from paging file " << rhs.paging_filename);
+    }
+  }
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+  template <class NODE,class I>
+  OcTreeBaseImpl<NODE,I>::OcTreeBaseImpl(OcTreeBaseImpl<NODE,I>&& rhs) :
+    I(), root(NULL), tree_depth(rhs.tree_depth), tree_max_val(rhs.tree_max_val),
+    resolution(rhs.resolution), tree_size(0), use_memory_pool(true),
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    block_pool(sizeof(NODE)),
+#else
+    node_pool(sizeof(NODE)), children_pool(sizeof(AbstractOcTreeNode*[8])),
+#endif
+    copy_on_write(false), num_threads(1), ray_simd(RAY_SIMD_AVX2)
+  {
+    init();
+    swap(rhs);
+  }
+#endif
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::copyNodesRecurs(const NODE* from, NODE* to){
+    if (!hasChildArray(from))
+      return;
 
+    allocNodeChildren(to);
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(from, i)){
+        const NODE* from_child = getNodeChild(from, i);
+        NODE* to_child = allocNodeChild(to, i);
+        to_child->copyData(*from_child);
+        copyNodesRecurs(from_child, to_child);
+      }
+    }
   }
 
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::init(){
 
     this->setResolution(this->resolution);
+    num_nodes_depth.assign(tree_depth+1, 0);
+    num_child_arrays = 0;
+    num_retired_child_arrays = 0;
+    memory_usage_peak = 0;
     for (unsigned i = 0; i< 3; i++){
       max_value[i] = -(std::numeric_limits<double>::max( ));
       min_value[i] = std::numeric_limits<double>::max( );
     }
     size_changed = true;
+    bounds_dirty = 0xFF;
+    paging_depth = 0;
+    paging_budget = 0;
+    paging_file = NULL;
+    paging_clock = 0;
+    num_paged_nodes = 0;
+    num_paged_inner_nodes = 0;
 
     // create as many KeyRays as there are OMP_THREADS defined,
     // one buffer for each thread
@@ -119,15 +205,82 @@ namespace octomap {
     size_t this_size = this->tree_size;
     this->tree_size = other.tree_size;
     other.tree_size = this_size;
+
+    recordMemoryUsagePeak();
+    other.recordMemoryUsagePeak();
+    num_nodes_depth.swap(other.num_nodes_depth);
+    std::swap(num_child_arrays, other.num_child_arrays);
+    std::swap(num_retired_child_arrays, other.num_retired_child_arrays);
+    std::swap(memory_usage_peak, other.memory_usage_peak);
+
+    std::swap(size_changed, other.size_changed);
+    std::swap(bounds_dirty, other.bounds_dirty);
+    for (unsigned int i=0; i<8; i++) {
+      std::swap(bounds_min_key[i], other.bounds_min_key[i]);
+      std::swap(bounds_max_key[i], other.bounds_max_key[i]);
+    }
+    for (unsigned int j=0; j<3; j++) {
+      std::swap(min_value[j], other.min_value[j]);
+      std::swap(max_value[j], other.max_value[j]);
+    }
+
+    // the nodes live in the pools, so these move along with them
+    std::swap(use_memory_pool, other.use_memory_pool);
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    block_pool.swap(other.block_pool);
+#else
+    node_pool.swap(other.node_pool);
+    children_pool.swap(other.children_pool);
+#endif
+    std::swap(copy_on_write, other.copy_on_write);
+
+    // paged-out subtrees belong to the nodes
+    std::swap(paging_depth, other.paging_depth);
+    std::swap(paging_budget, other.paging_budget);
+    paging_filename.swap(other.paging_filename);
+    std::swap(paging_file, other.paging_file);
+    std::swap(paging_clock, other.paging_clock);
+    subtree_access.swap(other.subtree_access);
+    paged_subtrees.swap(other.paged_subtrees);
+    std::swap(num_paged_nodes, other.num_paged_nodes);
+    std::swap(num_paged_inner_nodes, other.num_paged_inner_nodes);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::swap(OcTreeBaseImpl<NODE,I>& other){
+    if (tree_depth != other.tree_depth || tree_max_val != other.tree_max_val){
+      OCTOMAP_ERROR("Cannot swap octrees of different tree depth\n");
+      return;
+    }
+
+    swapContent(other);
+    std::swap(num_threads, other.num_threads);
+    std::swap(ray_simd, other.ray_simd);
+
+    // also updates the lookup tables and invalidates the cached extents
+    double this_resolution = resolution;
+    setResolution(other.resolution);
+    other.setResolution(this_resolution);
   }
 
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::operator== (const OcTreeBaseImpl<NODE,I>& other) const{
     if (tree_depth != other.tree_depth || tree_max_val != other.tree_max_val
-        || resolution != other.resolution || tree_size != other.tree_size){
+        || resolution != other.resolution || size() != other.size()){
       return false;
     }
 
+    // paged-out subtrees are compared node by node after reading them from the files
+    if (!paged_subtrees.empty() || !other.paged_subtrees.empty()) {
+      if (root == NULL || other.root == NULL)
+        return root == other.root;
+      std::ifstream reader, other_reader;
+      if ((!paged_subtrees.empty() && !openPagingReader(reader))
+          || (!other.paged_subtrees.empty() && !other.openPagingReader(other_reader)))
+        return false;
+      return nodesEqualRecurs(root, reader, other, other.root, other_reader);
+    }
+
     // traverse all nodes, check if structure the same
     typename OcTreeBaseImpl<NODE,I>::tree_iterator it = this->begin_tree();
     typename OcTreeBaseImpl<NODE,I>::tree_iterator end = this->end_tree();
@@ -172,14 +325,15 @@ namespace octomap {
   template <class NODE,class I>
   NODE* OcTreeBaseImpl<NODE,I>::createNodeChild(NODE* node, unsigned int childIdx){
     assert(childIdx < 8);
-    if (node->children == NULL) {
+    if (!hasChildArray(node)) {
       allocNodeChildren(node);
     }
-    assert (node->children[childIdx] == NULL);
-    NODE* newNode = new NODE();
-    node->children[childIdx] = static_cast<AbstractOcTreeNode*>(newNode);
+    assert (!nodeChildExists(node, childIdx));
+    NODE* newNode = allocNodeChild(node, childIdx);
 
     tree_size++;
+    if (NODE::storesDepth())
+      num_nodes_depth[newNode->getStoredDepth()]++;
     size_changed = true;
 
     return newNode;
@@ -187,10 +341,33 @@ namespace octomap {
 
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::deleteNodeChild(NODE* node, unsigned int childIdx){
-    assert((childIdx < 8) && (node->children != NULL));
-    assert(node->children[childIdx] != NULL);
-    delete static_cast<NODE*>(node->children[childIdx]); // TODO delete check if empty
-    node->children[childIdx] = NULL;
+    assert((childIdx < 8) && nodeChildExists(node, childIdx));
+    NODE* child = getNodeChild(node, childIdx);
+    assert(!hasChildArray(child));
+    if (NODE::storesDepth())
+      num_nodes_depth[child->getStoredDepth()]--;
+    deleteNodeRecurs(child);
+    clearNodeChild(node, childIdx);
+
+    tree_size--;
+    size_changed = true;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deleteNodeChildSubtree(NODE* node, unsigned int childIdx){
+    assert((childIdx < 8) && nodeChildExists(node, childIdx));
+    NODE* child = getNodeChild(node, childIdx);
+    if (!hasChildArray(child)) {
+      deleteNodeChild(node, childIdx);
+      return;
+    }
+
+    recordMemoryUsagePeak(); // before the subtree is discounted
+    size_t num_arrays = discountChildrenRecurs(child);
+    if (NODE::storesDepth())
+      num_nodes_depth[child->getStoredDepth()]--;
+    deleteDiscountedSubtree(child, num_arrays);
+    clearNodeChild(node, childIdx);
 
     tree_size--;
     size_changed = true;
@@ -198,16 +375,42 @@ namespace octomap {
 
   template <class NODE,class I>
   NODE* OcTreeBaseImpl<NODE,I>::getNodeChild(NODE* node, unsigned int childIdx) const{
-    assert((childIdx < 8) && (node->children != NULL));
-    assert(node->children[childIdx] != NULL);
+    assert((childIdx < 8) && nodeChildExists(node, childIdx));
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    return static_cast<NODE*>(OcTreeBlockPool::getSlot(node, node->children, childIdx));
+#else
     return static_cast<NODE*>(node->children[childIdx]);
+#endif
   }
 
   template <class NODE,class I>
   const NODE* OcTreeBaseImpl<NODE,I>::getNodeChild(const NODE* node, unsigned int childIdx) const{
-    assert((childIdx < 8) && (node->children != NULL));
-    assert(node->children[childIdx] != NULL);
+    assert((childIdx < 8) && nodeChildExists(node, childIdx));
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    return static_cast<const NODE*>(OcTreeBlockPool::getSlot(node, node->children, childIdx));
+#else
     return static_cast<const NODE*>(node->children[childIdx]);
+#endif
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::copyNodeShallow(const NODE* node){
+    NODE* copy = allocNode();
+    copy->copyData(*node);
+    copy->setStoredDepth(node->getStoredDepth());
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // the block of the children can't be shared with copy-on-write,
+    // snapshots are not supported with indexed children
+    copy->children = node->children;
+    copy->child_mask = node->child_mask;
+#else
+    if (node->children != NULL){
+      allocNodeChildren(copy);
+      for (unsigned int i=0; i<8; i++)
+        copy->children[i] = node->children[i];
+    }
+#endif
+    return copy;
   }
 
   template <class NODE,class I>
@@ -217,14 +420,16 @@ namespace octomap {
     if (!nodeChildExists(node, 0))
       return false;
 
+    // paged-out subtrees look like leafs
     const NODE* firstChild = getNodeChild(node, 0);
-    if (nodeHasChildren(firstChild))
+    if (nodeHasChildren(firstChild) || isPagedOut(firstChild))
       return false;
 
     for (unsigned int i = 1; i<8; i++) {
       // comparison via getChild so that casts of derived classes ensure
       // that the right == operator gets called
-      if (!nodeChildExists(node, i) || nodeHasChildren(getNodeChild(node, i)) || !(*(getNodeChild(node, i)) == *(firstChild)))
+      if (!nodeChildExists(node, i) || nodeHasChildren(getNodeChild(node, i)) || !(*(getNodeChild(node, i)) == *(firstChild))
+          || isPagedOut(getNodeChild(node, i)))
         return false;
     }
 
@@ -234,14 +439,21 @@ namespace octomap {
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::nodeChildExists(const NODE* node, unsigned int childIdx) const{
     assert(childIdx < 8);
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    return ((node->child_mask >> childIdx) & 1) != 0;
+#else
     if ((node->children != NULL) && (node->children[childIdx] != NULL))
       return true;
     else
       return false;
+#endif
   }
 
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::nodeHasChildren(const NODE* node) const {
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    return node->child_mask != 0;
+#else
     if (node->children == NULL)
       return false;
 
@@ -250,6 +462,7 @@ namespace octomap {
         return true;
     }
     return false;
+#endif
   }
 
 
@@ -276,19 +489,449 @@ namespace octomap {
     for (unsigned int i=0;i<8;i++) {
       deleteNodeChild(node, i);
     }
-    delete[] node->children;
-    node->children = NULL;
+    freeNodeChildren(node);
 
     return true;
   }
 
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::allocNode(){
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // a node without parent (the root) takes the first slot of a block of its own
+    return new (block_pool.getSlot(block_pool.allocate(), 0)) NODE();
+#else
+    if (use_memory_pool)
+      return new (node_pool.allocate()) NODE();
+    else
+      return new NODE();
+#endif
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::allocNodeChild(NODE* node, unsigned int childIdx){
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    NODE* child = new (block_pool.getSlot(node->children, childIdx)) NODE();
+    node->child_mask |= (unsigned char) (1 << childIdx);
+#else
+    NODE* child = allocNode();
+    node->children[childIdx] = static_cast<AbstractOcTreeNode*>(child);
+#endif
+    if (NODE::storesDepth())
+      child->setStoredDepth(node->getStoredDepth() + 1);
+    return child;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::freeNode(NODE* node){
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // children live in the block of their parent, only the root has a block of its own
+    node->~NODE();
+    if (node == root)
+      block_pool.deallocate(OcTreeBlockPool::getBlock(node));
+#else
+    if (use_memory_pool){
+      node->~NODE();
+      node_pool.deallocate(node);
+    } else {
+      recordMemoryUsagePeak();
+      delete node;
+    }
+#endif
+  }
+
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::allocNodeChildren(NODE* node){
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    node->children = block_pool.allocate();
+    node->child_mask = 0;
+#else
     // TODO NODE*
+    if (use_memory_pool)
+      node->children = static_cast<AbstractOcTreeNode**>(children_pool.allocate());
+    else
+      node->children = new AbstractOcTreeNode*[8];
+
+    for (unsigned int i=0; i<8; i++) {
+      node->children[i] = NULL;
+    }
+#endif
+    num_child_arrays++;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::freeNodeChildren(NODE* node){
+    if (!hasChildArray(node))
+      return;
+
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    block_pool.deallocate(node->children);
+    node->children = 0;
+    node->child_mask = 0;
+#else
+    if (use_memory_pool)
+      children_pool.deallocate(node->children);
+    else {
+      recordMemoryUsagePeak();
+      delete[] node->children;
+    }
+
+    node->children = NULL;
+#endif
+    num_child_arrays--;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::setMemoryPoolEnabled(bool enable){
+    if (enable == use_memory_pool)
+      return true;
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    OCTOMAP_ERROR("Indexed children always live in the memory pool\n");
+    return false;
+#endif
+
+    if (root != NULL){
+      OCTOMAP_ERROR("Memory pool can only be enabled or disabled on an empty tree\n");
+      return false;
+    }
+
+    use_memory_pool = enable;
+    releaseMemoryPool();
+    return true;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::releaseMemoryPool(){
+    if (root != NULL)
+      return;
+
+    recordMemoryUsagePeak();
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    block_pool.release();
+#else
+    node_pool.release();
+    children_pool.release();
+#endif
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::enablePaging(const std::string& filename, size_t memory_budget, unsigned int depth){
+    if (depth == 0 || depth >= tree_depth) {
+      OCTOMAP_ERROR("Paging depth %u needs to be between 1 and %u\n", depth, tree_depth-1);
+      return false;
+    }
+    if (copy_on_write) {
+      OCTOMAP_ERROR("Paging is not supported together with snapshots\n");
+      return false;
+    }
+
+    disablePaging();
+    paging_filename = filename;
+    if (!resetPagingFile())
+      return false;
+
+    paging_depth = depth;
+    paging_budget = memory_budget;
+    return true;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::disablePaging(){
+    if (paging_depth == 0)
+      return;
+
+    pageInAll();
+    paging_depth = 0;
+    subtree_access.clear();
+    delete paging_file;
+    paging_file = NULL;
+    std::remove(paging_filename.c_str());
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::resetPagingFile(){
+    delete paging_file;
+    paging_file = new std::fstream(paging_filename.c_str(),
+                                   std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!paging_file->is_open()) {
+      OCTOMAP_ERROR_STR("Could not open paging file " << paging_filename);
+      delete paging_file;
+      paging_file = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::enforceMemoryBudget(){
+    if (paging_depth == 0 || paging_file == NULL || root == NULL || memoryUsageResident() <= paging_budget)
+      return 0;
+
+    std::vector<PagingCandidate> candidates;
+    collectPagingCandidatesRecurs(root, 0, OcTreeKey(tree_max_val, tree_max_val, tree_max_val), candidates);
+    std::sort(candidates.begin(), candidates.end());
+
+    size_t target = paging_budget - paging_budget / 8;
+    size_t num_paged = 0;
+    for (size_t i = 0; i < candidates.size() && memoryUsageResident() > target; ++i) {
+      // the subtree accessed last is in use, e.g. by the result of updateNode()
+      if (candidates[i].last_access == paging_clock && paging_clock != 0)
+        break;
+      if (!pageOutSubtree(candidates[i].node, candidates[i].key))
+        break;
+      num_paged++;
+    }
+
+    // forget the subtrees paged out or deleted in the meantime
+    KeyFlatMap<unsigned long> access;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (hasChildArray(candidates[i].node) && candidates[i].last_access != 0)
+        access[computeIndexKey(tree_depth - paging_depth, candidates[i].key)] = candidates[i].last_access;
+    }
+    subtree_access.swap(access);
+    return num_paged;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::collectPagingCandidatesRecurs(NODE* node, unsigned int depth, const OcTreeKey& key,
+                                                             std::vector<PagingCandidate>& candidates) const {
+    if (!hasChildArray(node))
+      return;
+
+    if (depth == paging_depth) {
+      PagingCandidate candidate;
+      typename KeyFlatMap<unsigned long>::const_iterator it = subtree_access.find(computeIndexKey(tree_depth - paging_depth, key));
+      candidate.last_access = (it != subtree_access.end()) ? it->second : 0;
+      candidate.node = node;
+      candidate.key = key;
+      candidates.push_back(candidate);
+      return;
+    }
+
+    key_type center_offset_key = tree_max_val >> (depth+1);
+    OcTreeKey child_key;
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i)) {
+        computeChildKey(i, center_offset_key, key, child_key);
+        collectPagingCandidatesRecurs(getNodeChild(node, i), depth+1, child_key, candidates);
+      }
+    }
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::touchSubtree(const OcTreeKey& key) {
+    if (root == NULL)
+      return false;
+
+    // the subtree only exists if there is no leaf above it
+    NODE* node = root;
+    for (unsigned int depth = 0; depth < paging_depth; ++depth) {
+      unsigned int pos = computeChildIdx(key, tree_depth-1-depth);
+      if (!nodeChildExists(node, pos))
+        return false;
+      node = getNodeChild(node, pos);
+    }
+
+    subtree_access[computeIndexKey(tree_depth - paging_depth, key)] = ++paging_clock;
+    if (!isPagedOut(node))
+      return false;
+    pageInSubtree(node);
+    return true;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::pageIn(const OcTreeKey& key) {
+    if (paging_depth == 0)
+      return false;
+    return touchSubtree(key);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::pageInSubtree(NODE* node) {
+    typename std::map<const NODE*, PagedSubtree>::iterator it = paged_subtrees.find(node);
+    if (it == paged_subtrees.end())
+      return;
+
+    PagedSubtree paged = it->second;
+    paged_subtrees.erase(it);
+    num_paged_nodes -= paged.num_nodes;
+    num_paged_inner_nodes -= paged.num_inner_nodes;
+
+    // the subtree covers the space of its leaf, the bounds stay valid
+    bool bounds_changed = size_changed;
+    paging_file->clear();
+    paging_file->seekg(paged.offset);
+    readNodesRecurs(node, *paging_file);
+    size_changed = bounds_changed;
+    if (!paging_file->good()) {
+      OCTOMAP_ERROR_STR("Could not read subtree from paging file " << paging_filename);
+      paging_file->clear();
+    }
+
+    subtree_access[paged.key] = ++paging_clock;
+    if (paged_subtrees.empty())
+      resetPagingFile();
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::pageInAll() {
+    while (!paged_subtrees.empty())
+      pageInSubtree(const_cast<NODE*>(paged_subtrees.begin()->first));
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::openPagingReader(std::ifstream& reader) const {
+    reader.open(paging_filename.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!reader.is_open()) {
+      OCTOMAP_ERROR_STR("Could not open paging file " << paging_filename << " for reading");
+      return false;
+    }
+    return true;
+  }
+
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::readPagedSubtree(const NODE* node, std::istream& reader) const {
+    typename std::map<const NODE*, PagedSubtree>::const_iterator it = paged_subtrees.find(node);
+    assert(it != paged_subtrees.end());
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // the nodes need a pool of their own, see deletePagedSubtree()
+    OcTreeBlockPool* pool = new OcTreeBlockPool(sizeof(NODE));
+    NODE* copy = new (pool->getSlot(pool->allocate(), 0)) NODE();
+#else
+    NODE* copy = new NODE();
+#endif
+    reader.clear();
+    reader.seekg(it->second.offset);
+    readPagedNodesRecurs(copy, reader);
+    if (!reader.good())
+      OCTOMAP_ERROR_STR("Could not read subtree from paging file " << paging_filename);
+    return copy;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::readPagedNodesRecurs(NODE* node, std::istream& s) {
+    node->readData(s);
+
+    char children_char;
+    s.read((char*)&children_char, sizeof(char));
+    std::bitset<8> children ((unsigned long long) children_char);
+    if (children.none() || !s.good())
+      return;
+
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    OcTreeBlockPool* pool = OcTreeBlockPool::getPool(node);
+    node->children = pool->allocate();
+    for (unsigned int i=0; i<8; i++) {
+      if (children[i] == 1) {
+        NODE* child = new (pool->getSlot(node->children, i)) NODE();
+        node->child_mask |= (unsigned char) (1 << i);
+        readPagedNodesRecurs(child, s);
+      }
+    }
+#else
     node->children = new AbstractOcTreeNode*[8];
     for (unsigned int i=0; i<8; i++) {
       node->children[i] = NULL;
+      if (children[i] == 1) {
+        NODE* child = new NODE();
+        node->children[i] = child;
+        readPagedNodesRecurs(child, s);
+      }
     }
+#endif
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deletePagedSubtree(NODE* node) {
+    if (node == NULL)
+      return;
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    OcTreeBlockPool* pool = OcTreeBlockPool::getPool(node);
+    destroyPagedNodesRecurs(node);
+    delete pool;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::destroyPagedNodesRecurs(NODE* node) {
+    for (unsigned int i=0; i<8; i++) {
+      if ((node->child_mask >> i) & 1)
+        destroyPagedNodesRecurs(static_cast<NODE*>(OcTreeBlockPool::getSlot(node, node->children, i)));
+    }
+    // the blocks go away with the pool
+    node->children = 0;
+    node->child_mask = 0;
+    node->~NODE();
+#else
+    if (node->children != NULL) {
+      for (unsigned int i=0; i<8; i++)
+        deletePagedSubtree(static_cast<NODE*>(node->children[i]));
+      delete[] node->children;
+      node->children = NULL;
+    }
+    delete node;
+#endif
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::nodesEqualRecurs(const NODE* node, std::istream& reader, const OcTreeBaseImpl<NODE,I>& other,
+                                                const NODE* other_node, std::istream& other_reader) const {
+    NODE* paged = isPagedOut(node) ? readPagedSubtree(node, reader) : NULL;
+    NODE* other_paged = other.isPagedOut(other_node) ? other.readPagedSubtree(other_node, other_reader) : NULL;
+    if (paged != NULL)
+      node = paged;
+    if (other_paged != NULL)
+      other_node = other_paged;
+
+    bool equal = (*node == *other_node);
+    for (unsigned int i=0; i<8 && equal; i++) {
+      bool exists = nodeChildExists(node, i);
+      if (exists != nodeChildExists(other_node, i))
+        equal = false;
+      else if (exists)
+        equal = nodesEqualRecurs(getNodeChild(node, i), reader, other, getNodeChild(other_node, i), other_reader);
+    }
+
+    deletePagedSubtree(paged);
+    deletePagedSubtree(other_paged);
+    return equal;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::pageOutSubtree(NODE* node, const OcTreeKey& key){
+    assert(hasChildArray(node));
+    beforePageOut(node);
+
+    PagedSubtree paged;
+    paged.key = computeIndexKey(tree_depth - paging_depth, key);
+    paged.min_key = OcTreeKey(std::numeric_limits<key_type>::max(), std::numeric_limits<key_type>::max(),
+                              std::numeric_limits<key_type>::max());
+    paged.max_key = OcTreeKey(0, 0, 0);
+    calcMinMaxRecurs(node, key, paging_depth, paged.min_key, paged.max_key);
+
+    paging_file->clear();
+    paging_file->seekp(0, std::ios_base::end);
+    paged.offset = paging_file->tellp();
+    writeNodesRecurs(node, *paging_file);
+    paging_file->flush(); // for the readers of the const accessors
+    if (!paging_file->good()) {
+      OCTOMAP_ERROR_STR("Could not write subtree to paging file " << paging_filename);
+      paging_file->clear();
+      return false;
+    }
+
+    // free the children, the node remains as a leaf
+    recordMemoryUsagePeak();
+    size_t num_nodes = tree_size;
+    paged.num_inner_nodes = discountChildrenRecurs(node);
+    paged.num_nodes = num_nodes - tree_size;
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i))
+        deleteNodeRecurs(getNodeChild(node, i));
+    }
+    freeNodeChildren(node);
+    paged_subtrees[node] = paged;
+    num_paged_nodes += paged.num_nodes;
+    num_paged_inner_nodes += paged.num_inner_nodes;
+    return true;
   }
 
 
@@ -308,32 +951,17 @@ namespace octomap {
 
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::coordToKeyChecked(double coordinate, key_type& keyval) const {
-
-    // scale to resolution and shift center for tree_max_val
-    int scaled_coord =  ((int) floor(resolution_factor * coordinate)) + tree_max_val;
-
-    // keyval within range of tree?
-    if (( scaled_coord >= 0) && (((unsigned int) scaled_coord) < (2*tree_max_val))) {
-      keyval = scaled_coord;
-      return true;
-    }
-    return false;
+    return computeKeyChecked(coordinate, resolution_factor, tree_max_val, keyval);
   }
 
 
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::coordToKeyChecked(double coordinate, unsigned depth, key_type& keyval) const {
+    if (!computeKeyChecked(coordinate, resolution_factor, tree_max_val, keyval))
+      return false;
 
-    // scale to resolution and shift center for tree_max_val
-    int scaled_coord =  ((int) floor(resolution_factor * coordinate)) + tree_max_val;
-
-    // keyval within range of tree?
-    if (( scaled_coord >= 0) && (((unsigned int) scaled_coord) < (2*tree_max_val))) {
-      keyval = scaled_coord;
-      keyval = adjustKeyAtDepth(keyval, depth);
-      return true;
-    }
-    return false;
+    keyval = adjustKeyAtDepth(keyval, depth);
+    return true;
   }
 
   template <class NODE,class I>
@@ -382,26 +1010,12 @@ namespace octomap {
 
   template <class NODE,class I>
   key_type OcTreeBaseImpl<NODE,I>::adjustKeyAtDepth(key_type key, unsigned int depth) const{
-    unsigned int diff = tree_depth - depth;
-
-    if(diff == 0)
-      return key;
-    else
-      return (((key-tree_max_val) >> diff) << diff) + (1 << (diff-1)) + tree_max_val;
+    return computeKeyAtDepth(key, depth, tree_depth, tree_max_val);
   }
 
   template <class NODE,class I>
   double OcTreeBaseImpl<NODE,I>::keyToCoord(key_type key, unsigned depth) const{
-    assert(depth <= tree_depth);
-
-    // root is centered on 0 = 0.0
-    if (depth == 0) {
-      return 0.0;
-    } else if (depth == tree_depth) {
-      return keyToCoord(key);
-    } else {
-      return (floor( (double(key)-double(this->tree_max_val)) /double(1 << (tree_depth - depth)) )  + 0.5 ) * this->getNodeSize(depth);
-    }
+    return computeKeyCoord(key, depth, tree_depth, tree_max_val, resolution);
   }
 
   template <class NODE,class I>
@@ -439,8 +1053,6 @@ namespace octomap {
     if (depth == 0)
       depth = tree_depth;
 
-
-
     // generate appropriate key_at_depth for queried depth
     OcTreeKey key_at_depth = key;
     if (depth != tree_depth)
@@ -471,6 +1083,43 @@ namespace octomap {
   }
 
 
+  template <class NODE,class I>
+  NODE* OcTreeBaseImpl<NODE,I>::searchForWrite(const OcTreeKey& key, unsigned int depth) {
+    // the node is going to be modified, not its paged-out subtree
+    if (paging_depth != 0 && (depth == 0 || depth > paging_depth))
+      touchSubtree(key);
+    if (!copy_on_write)
+      return search(key, depth);
+
+    assert(depth <= tree_depth);
+    if (root == NULL)
+      return NULL;
+
+    if (depth == 0)
+      depth = tree_depth;
+
+    OcTreeKey key_at_depth = key;
+    if (depth != tree_depth)
+      key_at_depth = adjustKeyAtDepth(key, depth);
+
+    NODE* curNode (root);
+    int diff = tree_depth - depth;
+
+    // same as search(), but unshares all nodes on the way down
+    for (int i=(tree_depth-1); i>=diff; --i) {
+      unsigned int pos = computeChildIdx(key_at_depth, i);
+      if (nodeChildExists(curNode, pos)) {
+        curNode = getNodeChildForWrite(curNode, pos);
+      } else {
+        if (!nodeHasChildren(curNode))
+          return curNode;
+        else
+          return NULL;
+      }
+    }
+    return curNode;
+  }
+
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::deleteNode(const point3d& value, unsigned int depth) {
     OcTreeKey key;
@@ -494,18 +1143,127 @@ namespace octomap {
     else {
       return this->deleteNode(key, depth);
     }
-  }
+  }
+
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::deleteNode(const OcTreeKey& key, unsigned int depth) {
+    if (root == NULL)
+      return true;
+
+    if (depth == 0)
+      depth = tree_depth;
+
+    if (paging_depth != 0 && depth > paging_depth)
+      touchSubtree(key);
+
+    bool bounds_tracked = boundsTracked();
+    bool deleted = deleteNodeRecurs(root, 0, depth, key);
+    if (bounds_tracked)
+      shrinkBounds(key);
+    return deleted;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deleteOutsideBBX(const point3d& min, const point3d& max) {
+    // clamp the box to the key range
+    OcTreeKey min_key, max_key;
+    for (unsigned int j=0; j<3; j++) {
+      double min_scaled = floor(resolution_factor * min(j)) + double(tree_max_val);
+      double max_scaled = floor(resolution_factor * max(j)) + double(tree_max_val);
+      if (min_scaled > max_scaled || max_scaled < 0.0 || min_scaled > double(2*tree_max_val - 1)) {
+        clear(); // empty box
+        return;
+      }
+      min_key[j] = (key_type) std::max(min_scaled, 0.0);
+      max_key[j] = (key_type) std::min(max_scaled, double(2*tree_max_val - 1));
+    }
+    deleteOutsideBBX(min_key, max_key);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deleteOutsideBBX(const OcTreeKey& min_key, const OcTreeKey& max_key) {
+    if (root == NULL)
+      return;
+
+    bool inside = true;
+    for (unsigned int j=0; j<3; j++) {
+      if (min_key[j] > max_key[j]) {
+        clear(); // empty box
+        return;
+      }
+      if (min_key[j] > 0 || max_key[j] < 2*tree_max_val - 1)
+        inside = false;
+    }
+    if (inside)
+      return;
+
+    deleteOutsideBBXRecurs(root, 0, OcTreeKey(0, 0, 0), min_key, max_key);
+    if (!nodeHasChildren(root))
+      clear();
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::shiftKeys(int dx, int dy, int dz) {
+    if (root == NULL || (dx == 0 && dy == 0 && dz == 0))
+      return;
+    pageInAll();
+
+    // subtrees at depth move as a whole if the offsets are multiples of their size in keys
+    const int offset[3] = {dx, dy, dz};
+    unsigned int depth = 1;
+    for (; depth < tree_depth; ++depth) {
+      int size = 1 << (tree_depth - depth);
+      if (dx % size == 0 && dy % size == 0 && dz % size == 0)
+        break;
+    }
 
+    std::vector<std::pair<OcTreeKey, NODE*> > subtrees;
+    collectSubtreesRecurs(root, 0, OcTreeKey(0, 0, 0), depth, subtrees);
 
-  template <class NODE,class I>
-  bool OcTreeBaseImpl<NODE,I>::deleteNode(const OcTreeKey& key, unsigned int depth) {
-    if (root == NULL)
-      return true;
+    // build the new tree above depth, then take over the children of the subtrees
+    NODE* new_root = allocNode();
+    tree_size++;
+    for (size_t i = 0; i < subtrees.size(); ++i) {
+      OcTreeKey key;
+      bool in_range = true;
+      for (unsigned int j=0; j<3; j++) {
+        int k = int(subtrees[i].first[j]) + offset[j];
+        in_range = in_range && (k >= 0) && (k < int(2*tree_max_val));
+        key[j] = (key_type) k;
+      }
+      if (!in_range)
+        continue; // deleted with the old tree
 
-    if (depth == 0)
-      depth = tree_depth;
+      NODE* node = new_root;
+      for (unsigned int d = 0; d+1 < depth; ++d) {
+        unsigned int pos = computeChildIdx(key, tree_depth-1-d);
+        node = nodeChildExists(node, pos) ? getNodeChild(node, pos) : createNodeChild(node, pos);
+      }
+      NODE* moved = createNodeChild(node, computeChildIdx(key, tree_depth-depth));
+      NODE* subtree = subtrees[i].second;
+      moved->copyData(*subtree);
+      moved->children = subtree->children;
+      subtree->children = 0;
+#ifdef OCTOMAP_INDEXED_CHILDREN
+      moved->child_mask = subtree->child_mask;
+      subtree->child_mask = 0;
+#endif
+    }
+
+    // delete what is left of the old tree while it is still the root
+    // (freeNode() treats the root differently with indexed children)
+    recordMemoryUsagePeak();
+    size_t num_arrays = discountChildrenRecurs(root);
+    tree_size--;
+    deleteDiscountedSubtree(root, num_arrays);
+    root = new_root;
 
-    return deleteNodeRecurs(root, 0, depth, key);
+    if (!nodeHasChildren(root))
+      clear();
+    else
+      updateInnerNodesRecurs(root, 0, depth);
+    size_changed = true;
   }
 
   template <class NODE,class I>
@@ -514,6 +1272,10 @@ namespace octomap {
       deleteNodeRecurs(root);
       this->tree_size = 0;
       this->root = NULL;
+      num_nodes_depth.assign(tree_depth+1, 0);
+      subtree_access.clear();
+      // whatever is left belongs to nodes retained for snapshots
+      num_retired_child_arrays = num_child_arrays;
       // max extent of tree changed:
       this->size_changed = true;
     }
@@ -524,31 +1286,79 @@ namespace octomap {
     if (root == NULL)
       return;
 
+    // pruning doesn't change the space covered by leafs
+    bool bounds_tracked = boundsTracked();
+    bool parallel = useParallelTraversal(true);
     for (unsigned int depth=tree_depth-1; depth > 0; --depth) {
       unsigned int num_pruned = 0;
-      pruneRecurs(this->root, 0, depth, num_pruned);
+      if (parallel) {
+        // still level by level, each level split into the subtrees of the root
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) reduction(+:num_pruned)
+#endif
+        for (int i=0; i<8; i++) {
+          if (nodeChildExists(root, i))
+            pruneRecurs(getNodeChild(root, i), 1, depth, num_pruned);
+        }
+      } else {
+        pruneRecurs(this->root, 0, depth, num_pruned);
+      }
       if (num_pruned == 0)
         break;
     }
+    if (bounds_tracked)
+      size_changed = false;
   }
 
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::expand() {
-    if (root)
+    if (root == NULL)
+      return;
+    pageInAll();
+
+    // neither does expanding
+    bool bounds_tracked = boundsTracked();
+    if (useParallelTraversal(true)) {
+      if (!nodeHasChildren(root))
+        expandNode(root);
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+      for (int i=0; i<8; i++) {
+        if (nodeChildExists(root, i))
+          expandRecurs(getNodeChild(root, i), 1, tree_depth);
+      }
+    } else {
       expandRecurs(root,0, tree_depth);
+    }
+    if (bounds_tracked)
+      size_changed = false;
   }
 
   template <class NODE,class I>
-  bool OcTreeBaseImpl<NODE,I>::computeRayKeys(const point3d& origin,
-                                          const point3d& end,
-                                          KeyRay& ray) const {
+  bool OcTreeBaseImpl<NODE,I>::useParallelTraversal(bool modify) const {
+#ifdef _OPENMP
+    // copy-on-write allocates and retires nodes on every write, paging reads subtrees
+    // back and pages them out, neither is thread-safe
+    return num_threads > 1 && root != NULL && tree_depth > 1 && !(modify && (copy_on_write || paging_depth != 0));
+#else
+    (void) modify;
+    return false;
+#endif
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::initRayKeys(const point3d& origin, const point3d& end, KeyRay& ray,
+                                           OcTreeKey& current_key, OcTreeKey& key_end,
+                                           int step[3], double tMax[3], double tDelta[3],
+                                           float& length, bool& done) const {
 
     // see "A Faster Voxel Traversal Algorithm for Ray Tracing" by Amanatides & Woo
     // basically: DDA in 3D
 
     ray.reset();
 
-    OcTreeKey key_origin, key_end;
+    OcTreeKey key_origin;
     if ( !OcTreeBaseImpl<NODE,I>::coordToKeyChecked(origin, key_origin) ||
          !OcTreeBaseImpl<NODE,I>::coordToKeyChecked(end, key_end) ) {
       OCTOMAP_WARNING_STR("coordinates ( "
@@ -557,7 +1367,8 @@ namespace octomap {
     }
 
 
-    if (key_origin == key_end)
+    done = (key_origin == key_end);
+    if (done)
       return true; // same tree cell, we're done.
 
     ray.addKey(key_origin);
@@ -565,14 +1376,10 @@ namespace octomap {
     // Initialization phase -------------------------------------------------------
 
     point3d direction = (end - origin);
-    float length = (float) direction.norm();
+    length = (float) direction.norm();
     direction /= length; // normalize vector
 
-    int    step[3];
-    double tMax[3];
-    double tDelta[3];
-
-    OcTreeKey current_key = key_origin;
+    current_key = key_origin;
 
     for(unsigned int i=0; i < 3; ++i) {
       // compute step direction
@@ -594,10 +1401,24 @@ namespace octomap {
         tDelta[i] = std::numeric_limits<double>::max( );
       }
     }
+    return true;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::computeRayKeys(const point3d& origin,
+                                          const point3d& end,
+                                          KeyRay& ray) const {
+    OcTreeKey current_key, key_end;
+    int    step[3];
+    double tMax[3];
+    double tDelta[3];
+    float length;
+    bool done;
+    if (!initRayKeys(origin, end, ray, current_key, key_end, step, tMax, tDelta, length, done))
+      return false;
 
     // Incremental phase  ---------------------------------------------------------
 
-    bool done = false;
     while (!done) {
 
       unsigned int dim;
@@ -647,6 +1468,143 @@ namespace octomap {
     return true;
   }
 
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::computeRayKeysExact(const point3d& origin,
+                                                   const point3d& end,
+                                                   KeyRay& ray) const {
+    ray.reset();
+
+    // positions in key space with frac_bits fractional bits
+    const unsigned int frac_bits = getKeyPositionBits();
+    const uint64_t one = (uint64_t) 1 << frac_bits;
+    OcTreeKey key_origin, key_end;
+    uint64_t pos_origin[3], pos_end[3];
+    if ( !coordToKeyPositionChecked(origin, key_origin, pos_origin) ||
+         !coordToKeyPositionChecked(end, key_end, pos_end) ) {
+      OCTOMAP_WARNING_STR("coordinates ( "
+                << origin << " -> " << end << ") out of bounds in computeRayKeysExact");
+      return false;
+    }
+
+    if (key_origin == key_end)
+      return true; // same tree cell, we're done.
+
+    ray.addKey(key_origin);
+
+    // The remaining distance to the next node border along dimension i is dist[i] / delta[i]
+    // of the ray, both below 2^31 so that the products comparing them fit into 64 bit.
+    uint64_t dist[3];
+    uint64_t delta[3];
+    int step[3];
+    unsigned int remaining[3]; // node borders still to cross
+    unsigned int num_steps = 0;
+    for (unsigned int i = 0; i < 3; ++i) {
+      uint64_t frac_origin = pos_origin[i] & (one - 1);
+      if (pos_end[i] > pos_origin[i]) {
+        step[i] = 1;
+        delta[i] = pos_end[i] - pos_origin[i];
+        dist[i] = one - frac_origin;
+        remaining[i] = key_end[i] - key_origin[i];
+      } else if (pos_end[i] < pos_origin[i]) {
+        step[i] = -1;
+        delta[i] = pos_origin[i] - pos_end[i];
+        dist[i] = frac_origin;
+        remaining[i] = key_origin[i] - key_end[i];
+      } else {
+        step[i] = 0;
+        delta[i] = 0;
+        dist[i] = 0;
+        remaining[i] = 0;
+      }
+      num_steps += remaining[i];
+    }
+
+    OcTreeKey current_key = key_origin;
+    while (true) {
+      // next border crossed: minimum of dist[i] / delta[i]
+      unsigned int dim = 3;
+      for (unsigned int i = 0; i < 3; ++i) {
+        if (remaining[i] > 0 && (dim == 3 || dist[i] * delta[dim] < dist[dim] * delta[i]))
+          dim = i;
+      }
+      assert(dim < 3);
+
+      current_key[dim] += step[dim];
+      dist[dim] += one;
+      --remaining[dim];
+
+      if (--num_steps == 0)
+        break;
+      ray.addKey(current_key);
+      assert ( ray.size() < ray.sizeMax() - 1);
+    }
+    assert(current_key == key_end);
+
+    return true;
+  }
+
+  template <class NODE,class I>
+  bool OcTreeBaseImpl<NODE,I>::coordToKeyPositionChecked(const point3d& coord, OcTreeKey& key, uint64_t pos[3]) const {
+    if (!coordToKeyChecked(coord, key))
+      return false;
+
+    const unsigned int frac_bits = getKeyPositionBits();
+    for (unsigned int i = 0; i < 3; ++i) {
+      // sub-voxel offset, floor() as in coordToKey()
+      double v = resolution_factor * (double) coord(i);
+      uint64_t frac = (uint64_t) ((v - floor(v)) * (double) ((uint64_t) 1 << frac_bits));
+      pos[i] = ((uint64_t) key[i] << frac_bits) + frac;
+    }
+    return true;
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::computeRaysKeys(const point3d& origin, const point3d* ends, size_t num_rays,
+                                               KeyRay* rays, bool* valid) const {
+    // same initialization as computeRayKeys(), the incremental phase for a packet of rays at once
+    RayPacket packet;
+    OcTreeKey key_origin;
+    bool origin_valid = coordToKeyChecked(origin, key_origin);
+    for (size_t i = 0; i < num_rays; ++i) {
+      OcTreeKey current_key, key_end;
+      // room for the origin and one key per node boundary crossed, with a margin for the
+      // rounding of the DDA (a ray which still does not fit is marked invalid)
+      if (origin_valid && coordToKeyChecked(ends[i], key_end)) {
+        size_t crossings = 0;
+        for (unsigned int d = 0; d < 3; ++d)
+          crossings += std::abs((int) key_end[d] - (int) key_origin[d]);
+        rays[i].reserveMax(crossings + 8);
+      }
+
+      int step[3];
+      double tMax[3];
+      double tDelta[3];
+      float length;
+      bool done;
+      valid[i] = initRayKeys(origin, ends[i], rays[i], current_key, key_end, step, tMax, tDelta, length, done);
+      if (!valid[i] || done)
+        continue;
+
+      unsigned int r = packet.num_rays++;
+      packet.rays[r] = &rays[i];
+      packet.valid[r] = &valid[i];
+      for (unsigned int d = 0; d < 3; ++d) {
+        packet.key[d][r] = current_key[d];
+        packet.key_end[d][r] = key_end[d];
+        packet.step[d][r] = step[d];
+        packet.t_max[d][r] = tMax[d];
+        packet.t_delta[d][r] = tDelta[d];
+      }
+      packet.length[r] = length;
+
+      if (packet.num_rays == RayPacket::MAX_RAYS) {
+        traverseRayPacket(packet, ray_simd);
+        packet.num_rays = 0;
+      }
+    }
+    traverseRayPacket(packet, ray_simd);
+  }
+
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::computeRay(const point3d& origin, const point3d& end,
                                     std::vector<point3d>& _ray) {
@@ -663,19 +1621,54 @@ namespace octomap {
     assert(node);
     // TODO: maintain tree size?
 
-    if (node->children != NULL) {
+    if (copy_on_write && retainSubtree(node))
+      return;
+
+    if (isPagedOut(node)) {
+      typename std::map<const NODE*, PagedSubtree>::iterator it = paged_subtrees.find(node);
+      num_paged_nodes -= it->second.num_nodes;
+      num_paged_inner_nodes -= it->second.num_inner_nodes;
+      paged_subtrees.erase(it);
+      if (paged_subtrees.empty())
+        resetPagingFile();
+    }
+
+    if (hasChildArray(node)) {
       for (unsigned int i=0; i<8; i++) {
-        if (node->children[i] != NULL){
-          this->deleteNodeRecurs(static_cast<NODE*>(node->children[i]));
+        if (nodeChildExists(node, i)){
+          this->deleteNodeRecurs(getNodeChild(node, i));
         }
       }
-      delete[] node->children;
-      node->children = NULL;
+      freeNodeChildren(node);
     } // else: node has no children
 
-    delete node;
+    freeNode(node);
+  }
+
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::discountChildrenRecurs(const NODE* node){
+    size_t num_arrays = 1;
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i)){
+        const NODE* child = getNodeChild(node, i);
+        if (hasChildArray(child))
+          num_arrays += discountChildrenRecurs(child);
+        if (NODE::storesDepth())
+          num_nodes_depth[child->getStoredDepth()]--;
+        tree_size--;
+      }
+    }
+    return num_arrays;
   }
 
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deleteDiscountedSubtree(NODE* node, size_t num_arrays){
+    // the arrays which were not freed are still referenced by snapshots
+    size_t num_allocated = num_child_arrays;
+    deleteNodeRecurs(node);
+    num_retired_child_arrays += num_arrays - (num_allocated - num_child_arrays);
+  }
 
   template <class NODE,class I>
   bool OcTreeBaseImpl<NODE,I>::deleteNodeRecurs(NODE* node, unsigned int depth, unsigned int max_depth, const OcTreeKey& key){
@@ -699,14 +1692,15 @@ namespace octomap {
     }
 
     // follow down further, fix inner nodes on way back up
-    bool deleteChild = deleteNodeRecurs(getNodeChild(node, pos), depth+1, max_depth, key);
+    bool deleteChild = deleteNodeRecurs(getNodeChildForWrite(node, pos), depth+1, max_depth, key);
     if (deleteChild){
       // TODO: lazy eval?
-      // TODO delete check depth, what happens to inner nodes with children?
-      this->deleteNodeChild(node, pos);
+      this->deleteNodeChildSubtree(node, pos);
 
-      if (!nodeHasChildren(node))
+      if (!nodeHasChildren(node)) {
+        freeNodeChildren(node);
         return true;
+      }
       else{
         node->updateOccupancyChildren(); // TODO: occupancy?
       }
@@ -715,6 +1709,80 @@ namespace octomap {
     return false;
   }
 
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::deleteOutsideBBXRecurs(NODE* node, unsigned int depth, const OcTreeKey& base_key,
+                                                      const OcTreeKey& min_key, const OcTreeKey& max_key) {
+    // nodes on the boundary are larger than a voxel: expand pruned ones
+    pageInIfPaged(node);
+    if (!nodeHasChildren(node))
+      expandNode(node);
+
+    const unsigned int child_size = 1u << (tree_depth - depth - 1);
+    for (unsigned int i=0; i<8; i++) {
+      if (!nodeChildExists(node, i))
+        continue;
+
+      OcTreeKey child_key;
+      bool outside = false;
+      bool inside = true;
+      for (unsigned int j=0; j<3; j++) {
+        unsigned int min_j = base_key[j] + ((i & (1 << j)) ? child_size : 0);
+        unsigned int max_j = min_j + child_size - 1;
+        child_key[j] = (key_type) min_j;
+        if (max_j < min_key[j] || min_j > max_key[j])
+          outside = true;
+        else if (min_j < min_key[j] || max_j > max_key[j])
+          inside = false;
+      }
+
+      if (outside) {
+        deleteNodeChildSubtree(node, i);
+      } else if (!inside) {
+        NODE* child = getNodeChildForWrite(node, i);
+        deleteOutsideBBXRecurs(child, depth+1, child_key, min_key, max_key);
+        if (!nodeHasChildren(child))
+          deleteNodeChildSubtree(node, i);
+      }
+    }
+
+    if (nodeHasChildren(node))
+      updateInnerNode(node);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::collectSubtreesRecurs(NODE* node, unsigned int depth, const OcTreeKey& base_key, unsigned int max_depth,
+                                                     std::vector<std::pair<OcTreeKey, NODE*> >& subtrees) {
+    if (depth == max_depth) {
+      subtrees.push_back(std::make_pair(base_key, node));
+      return;
+    }
+
+    if (!nodeHasChildren(node))
+      expandNode(node);
+
+    const unsigned int child_size = 1u << (tree_depth - depth - 1);
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i)) {
+        OcTreeKey child_key;
+        for (unsigned int j=0; j<3; j++)
+          child_key[j] = (key_type) (base_key[j] + ((i & (1 << j)) ? child_size : 0));
+        // the children of the subtrees are taken over, the nodes need to be private
+        collectSubtreesRecurs(getNodeChildForWrite(node, i), depth+1, child_key, max_depth, subtrees);
+      }
+    }
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::updateInnerNodesRecurs(NODE* node, unsigned int depth, unsigned int max_depth) {
+    if (depth >= max_depth)
+      return;
+    for (unsigned int i=0; i<8; i++) {
+      if (nodeChildExists(node, i))
+        updateInnerNodesRecurs(getNodeChild(node, i), depth+1, max_depth);
+    }
+    updateInnerNode(node);
+  }
+
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::pruneRecurs(NODE* node, unsigned int depth,
          unsigned int max_depth, unsigned int& num_pruned) {
@@ -724,14 +1792,22 @@ namespace octomap {
     if (depth < max_depth) {
       for (unsigned int i=0; i<8; i++) {
         if (nodeChildExists(node, i)) {
-          pruneRecurs(getNodeChild(node, i), depth+1, max_depth, num_pruned);
+          // skip children which won't change (so that they are not copied on write)
+          const NODE* child = getNodeChild(node, i);
+          if (depth+1 < max_depth ? nodeHasChildren(child) : isNodeCollapsible(child))
+            pruneRecurs(getNodeChildForWrite(node, i), depth+1, max_depth, num_pruned);
         }
       }
     } // end if depth
 
     else {
-      // max level reached
-      if (pruneNode(node)) {
+      // max level reached. Node memory and tree_size are shared by parallel traversals
+      bool pruned;
+#ifdef _OPENMP
+      #pragma omp critical (octomap_node_memory)
+#endif
+      pruned = pruneNode(node);
+      if (pruned) {
         num_pruned++;
       }
     }
@@ -748,12 +1824,15 @@ namespace octomap {
 
     // current node has no children => can be expanded
     if (!nodeHasChildren(node)){
+#ifdef _OPENMP
+      #pragma omp critical (octomap_node_memory)
+#endif
       expandNode(node);
     }
     // recursively expand children
     for (unsigned int i=0; i<8; i++) {
       if (nodeChildExists(node, i)) { // TODO double check (node != NULL)
-        expandRecurs(getNodeChild(node, i), depth+1, max_depth);
+        expandRecurs(getNodeChildForWrite(node, i), depth+1, max_depth);
       }
     }
   }
@@ -761,14 +1840,27 @@ namespace octomap {
 
   template <class NODE,class I>
   std::ostream& OcTreeBaseImpl<NODE,I>::writeData(std::ostream &s) const{
-    if (root)
+    if (root == NULL)
+      return s;
+
+    std::ifstream paging_reader;
+    if (!paged_subtrees.empty() && openPagingReader(paging_reader))
+      writeNodesRecurs(root, s, &paging_reader);
+    else
       writeNodesRecurs(root, s);
 
     return s;
   }
 
   template <class NODE,class I>
-  std::ostream& OcTreeBaseImpl<NODE,I>::writeNodesRecurs(const NODE* node, std::ostream &s) const{
+  std::ostream& OcTreeBaseImpl<NODE,I>::writeNodesRecurs(const NODE* node, std::ostream &s, std::istream* paging_reader) const{
+    if (paging_reader != NULL && isPagedOut(node)) {
+      NODE* paged = readPagedSubtree(node, *paging_reader);
+      writeNodesRecurs(paged, s);
+      deletePagedSubtree(paged);
+      return s;
+    }
+
     node->writeData(s);
 
     // 1 bit for each children; 0: empty, 1: allocated
@@ -790,7 +1882,7 @@ namespace octomap {
     // recursively write children
     for (unsigned int i=0; i<8; i++) {
       if (children[i] == 1) {
-        this->writeNodesRecurs(getNodeChild(node, i), s);
+        this->writeNodesRecurs(getNodeChild(node, i), s, paging_reader);
       }
     }
 
@@ -813,7 +1905,7 @@ namespace octomap {
       return s;
     }
 
-    root = new NODE();
+    root = allocNode();
     readNodesRecurs(root, s);
 
     tree_size = calcNumNodes();  // compute number of nodes
@@ -898,43 +1990,122 @@ namespace octomap {
 
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::calcMinMax() {
-    if (!size_changed)
-      return;
+    if (size_changed) {
+      bounds_dirty = 0xFF;
+      size_changed = false;
+    }
+    calcMinMaxChildren(bounds_dirty, bounds_min_key, bounds_max_key, min_value, max_value);
+    bounds_dirty = 0;
+  }
 
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::calcMinMaxChildren(unsigned char dirty, OcTreeKey* min_keys, OcTreeKey* max_keys,
+                                                  double* min_val, double* max_val) const {
     // empty tree
     if (root == NULL){
-      min_value[0] = min_value[1] = min_value[2] = 0.0;
-      max_value[0] = max_value[1] = max_value[2] = 0.0;
-      size_changed = false;
+      for (unsigned int j=0; j<3; j++)
+        min_val[j] = max_val[j] = 0.0;
       return;
     }
 
-    for (unsigned i = 0; i< 3; i++){
-      max_value[i] = -std::numeric_limits<double>::max();
-      min_value[i] = std::numeric_limits<double>::max();
+    // the root is the only leaf
+    if (!nodeHasChildren(root)){
+      for (unsigned int j=0; j<3; j++) {
+        min_val[j] = -double(tree_max_val) * resolution;
+        max_val[j] = double(tree_max_val) * resolution;
+      }
+      return;
     }
 
-    for(typename OcTreeBaseImpl<NODE,I>::leaf_iterator it = this->begin(),
-        end=this->end(); it!= end; ++it)
-    {
-      double size = it.getSize();
-      double halfSize = size/2.0;
-      double x = it.getX() - halfSize;
-      double y = it.getY() - halfSize;
-      double z = it.getZ() - halfSize;
-      if (x < min_value[0]) min_value[0] = x;
-      if (y < min_value[1]) min_value[1] = y;
-      if (z < min_value[2]) min_value[2] = z;
+    if (dirty != 0) {
+      OcTreeKey root_key (tree_max_val, tree_max_val, tree_max_val);
+      bool parallel = useParallelTraversal(false);
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) if(parallel)
+#else
+      (void) parallel;
+#endif
+      for (int i=0; i<8; i++) {
+        if (!(dirty & (1 << i)))
+          continue;
+        // empty: min > max
+        for (unsigned int j=0; j<3; j++) {
+          min_keys[i][j] = std::numeric_limits<key_type>::max();
+          max_keys[i][j] = 0;
+        }
+        if (nodeChildExists(root, i)) {
+          OcTreeKey child_key;
+          computeChildKey(i, tree_max_val >> 1, root_key, child_key);
+          calcMinMaxRecurs(getNodeChild(root, i), child_key, 1, min_keys[i], max_keys[i]);
+        }
+      }
+    }
+
+    for (unsigned int j=0; j<3; j++) {
+      key_type min_key = std::numeric_limits<key_type>::max();
+      key_type max_key = 0;
+      for (unsigned int i=0; i<8; i++) {
+        if (min_keys[i][j] > max_keys[i][j])
+          continue;
+        if (min_keys[i][j] < min_key) min_key = min_keys[i][j];
+        if (max_keys[i][j] > max_key) max_key = max_keys[i][j];
+      }
+      // lower and upper boundary of the voxels at min_key and max_key
+      min_val[j] = (double(min_key) - double(tree_max_val)) * resolution;
+      max_val[j] = (double(max_key) + 1.0 - double(tree_max_val)) * resolution;
+    }
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::calcMinMaxRecurs(const NODE* node, const OcTreeKey& key, unsigned int depth,
+                                                OcTreeKey& min_key, OcTreeKey& max_key) const {
+    if (nodeHasChildren(node)) {
+      key_type center_offset_key = tree_max_val >> (depth+1);
+      OcTreeKey child_key;
+      for (unsigned int i=0; i<8; i++) {
+        if (nodeChildExists(node, i)) {
+          computeChildKey(i, center_offset_key, key, child_key);
+          calcMinMaxRecurs(getNodeChild(node, i), child_key, depth+1, min_key, max_key);
+        }
+      }
+      return;
+    }
+
+    // paged-out subtree: its bounds were recorded
+    if (isPagedOut(node)) {
+      const PagedSubtree& paged = paged_subtrees.find(node)->second;
+      for (unsigned int j=0; j<3; j++) {
+        if (paged.min_key[j] < min_key[j]) min_key[j] = paged.min_key[j];
+        if (paged.max_key[j] > max_key[j]) max_key[j] = paged.max_key[j];
+      }
+      return;
+    }
 
-      x += size;
-      y += size;
-      z += size;
-      if (x > max_value[0]) max_value[0] = x;
-      if (y > max_value[1]) max_value[1] = y;
-      if (z > max_value[2]) max_value[2] = z;
+    // leaf: range of keys at the lowest level
+    unsigned int shift = tree_depth - depth;
+    for (unsigned int j=0; j<3; j++) {
+      key_type min_j = (key_type) ((key[j] >> shift) << shift);
+      key_type max_j = (key_type) (min_j + ((1u << shift) - 1));
+      if (min_j < min_key[j]) min_key[j] = min_j;
+      if (max_j > max_key[j]) max_key[j] = max_j;
+    }
+  }
 
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::growBounds(const OcTreeKey& key) {
+    unsigned int i = computeChildIdx(key, tree_depth-1);
+    if (!(bounds_dirty & (1 << i))) {
+      for (unsigned int j=0; j<3; j++) {
+        if (key[j] < bounds_min_key[i][j]) bounds_min_key[i][j] = key[j];
+        if (key[j] > bounds_max_key[i][j]) bounds_max_key[i][j] = key[j];
+      }
     }
+    size_changed = false;
+  }
 
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::shrinkBounds(const OcTreeKey& key) {
+    bounds_dirty |= (unsigned char) (1 << computeChildIdx(key, tree_depth-1));
     size_changed = false;
   }
 
@@ -958,58 +2129,27 @@ namespace octomap {
 
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::getMetricMin(double& mx, double& my, double& mz) const {
-    mx = my = mz = std::numeric_limits<double>::max( );
-    if (size_changed) {
-      // empty tree
-      if (root == NULL){
-        mx = my = mz = 0.0;
-        return;
-      }
-
-      for(typename OcTreeBaseImpl<NODE,I>::leaf_iterator it = this->begin(),
-              end=this->end(); it!= end; ++it) {
-        double halfSize = it.getSize()/2.0;
-        double x = it.getX() - halfSize;
-        double y = it.getY() - halfSize;
-        double z = it.getZ() - halfSize;
-        if (x < mx) mx = x;
-        if (y < my) my = y;
-        if (z < mz) mz = z;
-      }
-    } // end if size changed
-    else {
-      mx = min_value[0];
-      my = min_value[1];
-      mz = min_value[2];
-    }
+    // same as calcMinMax(), on copies of the bounds
+    OcTreeKey min_keys[8], max_keys[8];
+    std::copy(bounds_min_key, bounds_min_key + 8, min_keys);
+    std::copy(bounds_max_key, bounds_max_key + 8, max_keys);
+    double min_val[3], max_val[3];
+    calcMinMaxChildren(size_changed ? 0xFF : bounds_dirty, min_keys, max_keys, min_val, max_val);
+    mx = min_val[0];
+    my = min_val[1];
+    mz = min_val[2];
   }
 
   template <class NODE,class I>
   void OcTreeBaseImpl<NODE,I>::getMetricMax(double& mx, double& my, double& mz) const {
-    mx = my = mz = -std::numeric_limits<double>::max( );
-    if (size_changed) {
-      // empty tree
-      if (root == NULL){
-        mx = my = mz = 0.0;
-        return;
-      }
-
-      for(typename OcTreeBaseImpl<NODE,I>::leaf_iterator it = this->begin(),
-            end=this->end(); it!= end; ++it) {
-        double halfSize = it.getSize()/2.0;
-        double x = it.getX() + halfSize;
-        double y = it.getY() + halfSize;
-        double z = it.getZ() + halfSize;
-        if (x > mx) mx = x;
-        if (y > my) my = y;
-        if (z > mz) mz = z;
-      }
-    }
-    else {
-      mx = max_value[0];
-      my = max_value[1];
-      mz = max_value[2];
-    }
+    OcTreeKey min_keys[8], max_keys[8];
+    std::copy(bounds_min_key, bounds_min_key + 8, min_keys);
+    std::copy(bounds_max_key, bounds_max_key + 8, max_keys);
+    double min_val[3], max_val[3];
+    calcMinMaxChildren(size_changed ? 0xFF : bounds_dirty, min_keys, max_keys, min_val, max_val);
+    mx = max_val[0];
+    my = max_val[1];
+    mz = max_val[2];
   }
 
   template <class NODE,class I>
@@ -1017,7 +2157,19 @@ namespace octomap {
     size_t retval = 0; // root node
     if (root){
       retval++;
-      calcNumNodesRecurs(root, retval);
+      if (useParallelTraversal(false)) {
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) reduction(+:retval)
+#endif
+        for (int i=0; i<8; i++) {
+          if (nodeChildExists(root, i)) {
+            retval++;
+            calcNumNodesRecurs(getNodeChild(root, i), retval);
+          }
+        }
+      } else {
+        calcNumNodesRecurs(root, retval);
+      }
     }
     return retval;
   }
@@ -1037,9 +2189,53 @@ namespace octomap {
 
   template <class NODE,class I>
   size_t OcTreeBaseImpl<NODE,I>::memoryUsage() const{
-    size_t num_leaf_nodes = this->getNumLeafNodes();
-    size_t num_inner_nodes = tree_size - num_leaf_nodes;
-    return (sizeof(OcTreeBaseImpl<NODE,I>) + memoryUsageNode() * tree_size + num_inner_nodes * sizeof(NODE*[8]));
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    return (sizeof(OcTreeBaseImpl<NODE,I>) + block_pool.getMemoryReserved());
+#else
+    if (use_memory_pool)
+      return (sizeof(OcTreeBaseImpl<NODE,I>) + node_pool.getMemoryReserved() + children_pool.getMemoryReserved());
+
+    return (sizeof(OcTreeBaseImpl<NODE,I>) + memoryUsageNode() * tree_size + memoryUsageChildArrays());
+#endif
+  }
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::memoryUsageResident() const{
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // the nodes fill the slots of the blocks
+    return block_pool.getNumBlocksInUse() * block_pool.getBlockSize();
+#else
+    return sizeof(NODE) * tree_size + (num_child_arrays - num_retired_child_arrays) * sizeof(AbstractOcTreeNode*[8]);
+#endif
+  }
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::memoryUsageSlack() const{
+    size_t usage = OcTreeBaseImpl<NODE,I>::memoryUsage();
+    size_t used = sizeof(OcTreeBaseImpl<NODE,I>) + memoryUsageResident();
+    return (usage > used) ? usage - used : 0;
+  }
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::memoryUsagePeak() const{
+    return std::max(memory_usage_peak, OcTreeBaseImpl<NODE,I>::memoryUsage());
+  }
+
+  template <class NODE,class I>
+  size_t OcTreeBaseImpl<NODE,I>::getNumNodesAtDepth(unsigned int depth) const{
+    if (depth > tree_depth || root == NULL)
+      return 0;
+    if (depth == 0)
+      return 1;
+    if (NODE::storesDepth())
+      return num_nodes_depth[depth];
+
+    size_t num_nodes = 0;
+    for (tree_iterator it = this->begin_tree(depth), end = this->end_tree(); it != end; ++it){
+      if (it.getDepth() == depth)
+        num_nodes++;
+    }
+    return num_nodes;
   }
 
   template <class NODE,class I>
@@ -1087,7 +2283,20 @@ namespace octomap {
     if (root == NULL)
       return 0;
 
-    return getNumLeafNodesRecurs(root);
+    if (useParallelTraversal(false) && nodeHasChildren(root)) {
+      size_t num_leafs = 0;
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) reduction(+:num_leafs)
+#endif
+      for (int i=0; i<8; i++) {
+        if (nodeChildExists(root, i))
+          num_leafs += getNumLeafNodesRecurs(getNodeChild(root, i));
+      }
+      // the roots of paged-out subtrees are counted as leafs
+      return num_leafs + num_paged_nodes - num_paged_inner_nodes;
+    }
+
+    return getNumLeafNodesRecurs(root) + num_paged_nodes - num_paged_inner_nodes;
   }
 
 
@@ -36,6 +36,7 @@
 
 
 #include "octomap_types.h"
+#include "OcTreeMemoryPool.h"
 #include "assert.h"
 
 namespace octomap {
@@ -70,7 +71,8 @@ namespace octomap {
     OcTreeDataNode(T initVal);
     
     /// Copy constructor, performs a recursive deep-copy of all children 
-    /// including node data in "value"
+    /// including node data in "value". With OCTOMAP_INDEXED_CHILDREN, the children
+    /// belong to the storage of the tree and only "value" is copied.
     OcTreeDataNode(const OcTreeDataNode& rhs);
 
     /// Delete only own members. 
@@ -116,8 +118,31 @@ namespace octomap {
     /// Make the templated data type available from the outside
     typedef T DataType;
 
+    // -- depth in the tree  ----------------------------
+
+    /// Node types with spare bits store their depth in the tree, which lets the
+    /// tree maintain per-depth statistics (see OcTreeBaseImpl::getNumNodesAtDepth()).
+    /// OcTreeDataNode does not, derived nodes hide these functions to do so.
+    static bool storesDepth() { return false; }
+    unsigned int getStoredDepth() const { return 0; }
+    void setStoredDepth(unsigned int /*depth*/) {}
+
 
   protected:
+    /// @return child i, NULL if it does not exist (for nodes which compute
+    /// their data from their children)
+    AbstractOcTreeNode* getChildPtr(unsigned int i) const;
+
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    /// Index of the block of the eight children in the OcTreeBlockPool of the tree,
+    /// 0 if there is none. Child i exists if bit i of child_mask is set.
+    /// @note The tree class manages the index and the block.
+    /// The children of a node are always enforced to be the same type as the node
+    uint32_t children;
+    /// stored data (payload)
+    T value;
+    unsigned char child_mask;
+#else
     void allocChildren();
 
     /// pointer to array of children, may be NULL
@@ -126,6 +151,7 @@ namespace octomap {
     AbstractOcTreeNode** children;
     /// stored data (payload)
     T value;
+#endif
 
   };
 
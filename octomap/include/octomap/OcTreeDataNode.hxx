@@ -35,22 +35,29 @@ namespace octomap {
 
   template <typename T>
   OcTreeDataNode<T>::OcTreeDataNode()
-   : children(NULL)
+   : children(0)
   {
-
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    child_mask = 0;
+#endif
   }
 
   template <typename T>
   OcTreeDataNode<T>::OcTreeDataNode(T initVal)
-   : children(NULL), value(initVal)
+   : children(0), value(initVal)
   {
-
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    child_mask = 0;
+#endif
   }
 
   template <typename T>
   OcTreeDataNode<T>::OcTreeDataNode(const OcTreeDataNode<T>& rhs)
-   : children(NULL), value(rhs.value)
+   : children(0), value(rhs.value)
   {
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    child_mask = 0;
+#else
     if (rhs.children != NULL){
       allocChildren();
       for (unsigned i = 0; i<8; ++i){
@@ -59,6 +66,7 @@ namespace octomap {
 
       }
     }
+#endif
   }
   
   template <typename T>
@@ -66,7 +74,7 @@ namespace octomap {
   {
     // Delete only own members. OcTree maintains tree structure and must have deleted 
     // children already
-    assert(children == NULL);
+    assert(children == 0);
   }
   
   template <typename T>
@@ -87,24 +95,32 @@ namespace octomap {
   template <typename T>
   bool OcTreeDataNode<T>::childExists(unsigned int i) const {
     assert(i < 8);
-    if ((children != NULL) && (children[i] != NULL))
-      return true;
-    else
-      return false;
+    return getChildPtr(i) != NULL;
   }
   
   template <typename T>
   bool OcTreeDataNode<T>::hasChildren() const {
-    if (children == NULL)
-      return false;
     for (unsigned int i = 0; i<8; i++){
-      // fast check, we know children != NULL
-      if (children[i] != NULL)
+      if (getChildPtr(i) != NULL)
         return true;
     }
     return false;
   }
 
+  template <typename T>
+  AbstractOcTreeNode* OcTreeDataNode<T>::getChildPtr(unsigned int i) const {
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // the block of the children is found through the chunk holding this node
+    if (child_mask & (1 << i))
+      return static_cast<AbstractOcTreeNode*>(OcTreeBlockPool::getSlot(this, children, i));
+    return NULL;
+#else
+    if (children == NULL)
+      return NULL;
+    return children[i];
+#endif
+  }
+
 
   // ============================================================
   // =  File IO           =======================================
@@ -124,6 +140,7 @@ namespace octomap {
   }
 
 
+#ifndef OCTOMAP_INDEXED_CHILDREN
   // ============================================================
   // =  private methodes  =======================================
   // ============================================================
@@ -134,7 +151,7 @@ namespace octomap {
       children[i] = NULL;
     }
   }
-
+#endif
 
 } // end namespace
 
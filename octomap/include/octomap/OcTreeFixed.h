@@ -0,0 +1,161 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_OCTREE_FIXED_H
+#define OCTOMAP_OCTREE_FIXED_H
+
+#include "octomap_types.h"
+#include "octomap_utils.h"
+#include "OcTreeKey.h"
+
+namespace octomap {
+
+  /**
+   * Occupancy tree with the depth and optionally the resolution fixed at
+   * compile time, for deployments with a single configuration. TREE is any
+   * occupancy tree (OcTree, ColorOcTree, OcTreeStamped, ...), which keeps
+   * its file format and can be used through TREE& as before.
+   *
+   * Key / coordinate conversion and node sizes become compile-time constants
+   * instead of the runtime resolution, tree_max_val and sizeLookupTable, and the
+   * root-to-leaf descent of search() and updateNode() is unrolled over DEPTH.
+   * Only calls on the OcTreeFixed itself benefit from the non-virtual functions,
+   * updateNode() is overridden and therefore also used by insertRay() etc.
+   *
+   * Example: OcTreeFixed<OcTree, 16, 5, 100> for a 16 level OcTree at 5 cm.
+   *
+   * \tparam TREE occupancy tree class, derived from OccupancyOcTreeBase
+   * \tparam DEPTH tree depth, needs to equal the depth of TREE (OCTOMAP_TREE_DEPTH)
+   * \tparam RES_NUM resolution numerator in meters, 0: resolution given at runtime
+   * \tparam RES_DEN resolution denominator, the resolution is RES_NUM / RES_DEN
+   * (a ratio, since non-type template parameters need to be integral before C++20)
+   */
+  template <class TREE, unsigned int DEPTH = OCTOMAP_TREE_DEPTH, unsigned int RES_NUM = 0, unsigned int RES_DEN = 1000>
+  class OcTreeFixed : public TREE {
+  public:
+    typedef typename TREE::NodeType NodeType;
+
+    enum { TREE_DEPTH = DEPTH, TREE_MAX_VAL = 1 << (DEPTH - 1) };
+
+    /// Creates a tree with the fixed resolution RES_NUM / RES_DEN (requires RES_NUM > 0)
+    OcTreeFixed();
+    /// Creates a tree with the given resolution. If RES_NUM > 0, any other resolution
+    /// than RES_NUM / RES_DEN is an error and the fixed resolution is used instead.
+    OcTreeFixed(double resolution);
+
+    /// @return true if the resolution is fixed at compile time
+    static bool hasFixedResolution() { return RES_NUM > 0; }
+
+    /// Changing the resolution is only possible if it is not fixed, otherwise the
+    /// resolution stays unchanged (and readBinary() of a file with another one fails)
+    virtual void setResolution(double r);
+
+    inline double getResolution() const { return res(); }
+    inline unsigned int getTreeDepth () const { return DEPTH; }
+    inline double getNodeSize(unsigned depth) const {
+      assert(depth <= DEPTH);
+      return res() * double(1u << (DEPTH - depth));
+    }
+
+    // -- Key / coordinate conversion with compile-time constants, see OcTreeBaseImpl
+
+    using TREE::coordToKey;
+    using TREE::coordToKeyChecked;
+    using TREE::keyToCoord;
+
+    inline key_type coordToKey(double coordinate) const{
+      return computeKey(coordinate, resFactor(), TREE_MAX_VAL);
+    }
+    inline OcTreeKey coordToKey(const point3d& coord) const{
+      return OcTreeKey(coordToKey(coord(0)), coordToKey(coord(1)), coordToKey(coord(2)));
+    }
+    inline OcTreeKey coordToKey(double x, double y, double z) const{
+      return OcTreeKey(coordToKey(x), coordToKey(y), coordToKey(z));
+    }
+
+    inline bool coordToKeyChecked(double coordinate, key_type& key) const{
+      return computeKeyChecked(coordinate, resFactor(), TREE_MAX_VAL, key);
+    }
+    inline bool coordToKeyChecked(const point3d& coord, OcTreeKey& key) const{
+      return coordToKeyChecked(coord(0), key[0]) && coordToKeyChecked(coord(1), key[1])
+          && coordToKeyChecked(coord(2), key[2]);
+    }
+    inline bool coordToKeyChecked(double x, double y, double z, OcTreeKey& key) const{
+      return coordToKeyChecked(x, key[0]) && coordToKeyChecked(y, key[1]) && coordToKeyChecked(z, key[2]);
+    }
+
+    inline double keyToCoord(key_type key) const{
+      return computeKeyCoord(key, TREE_MAX_VAL, res());
+    }
+    inline point3d keyToCoord(const OcTreeKey& key) const{
+      return point3d(float(keyToCoord(key[0])), float(keyToCoord(key[1])), float(keyToCoord(key[2])));
+    }
+
+    // -- search and update with an unrolled descent
+
+    using TREE::search;
+    using TREE::updateNode;
+
+    /// Search node at specified depth given a key (depth=0: search full tree depth), see OcTreeBaseImpl::search()
+    NodeType* search(const OcTreeKey& key, unsigned int depth = 0) const;
+    NodeType* search(const point3d& value, unsigned int depth = 0) const;
+    NodeType* search(double x, double y, double z, unsigned int depth = 0) const;
+
+    /// Integrate occupancy measurement, see OccupancyOcTreeBase::updateNode()
+    virtual NodeType* updateNode(const OcTreeKey& key, float log_odds_update, bool lazy_eval = false);
+
+  protected:
+    /// tag type selecting the recursion step at compile time
+    template <unsigned int D> struct Depth {};
+
+    /// resolution as compile-time constant if fixed (folded by the compiler)
+    inline double res() const { return (RES_NUM > 0) ? double(RES_NUM) / double(RES_DEN) : this->resolution; }
+    /// computed like OcTreeBaseImpl::resolution_factor, so that keys are identical
+    inline double resFactor() const { return (RES_NUM > 0) ? 1. / (double(RES_NUM) / double(RES_DEN)) : this->resolution_factor; }
+
+    /// see OccupancyOcTreeBase::updateNodeRecurs(), D is the depth of node
+    template <unsigned int D>
+    NodeType* updateNodeFixedRecurs(NodeType* node, bool node_just_created, const OcTreeKey& key,
+                                    float log_odds_update, bool lazy_eval, Depth<D>);
+    /// end of recursion at the last level
+    NodeType* updateNodeFixedRecurs(NodeType* node, bool node_just_created, const OcTreeKey& key,
+                                    float log_odds_update, bool lazy_eval, Depth<DEPTH>);
+
+    void checkConfiguration() const;
+  };
+
+} // end namespace
+
+#include "octomap/OcTreeFixed.hxx"
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+namespace octomap {
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::OcTreeFixed()
+    : TREE(double(RES_NUM) / double(RES_DEN))
+  {
+    if (RES_NUM == 0)
+      OCTOMAP_ERROR("OcTreeFixed without fixed resolution needs to be constructed with a resolution\n");
+    checkConfiguration();
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::OcTreeFixed(double in_resolution)
+    : TREE((RES_NUM > 0) ? double(RES_NUM) / double(RES_DEN) : in_resolution)
+  {
+    // the base tree always uses the fixed resolution, other ones are rejected
+    if (RES_NUM > 0 && in_resolution != double(RES_NUM) / double(RES_DEN))
+      OCTOMAP_ERROR("Resolution %f differs from the fixed resolution %f of the OcTreeFixed, using the latter\n",
+                    in_resolution, double(RES_NUM) / double(RES_DEN));
+    checkConfiguration();
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  void OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::checkConfiguration() const {
+    if (this->tree_depth != DEPTH)
+      OCTOMAP_ERROR("Depth %d of the OcTreeFixed differs from the tree depth %u\n", DEPTH, this->tree_depth);
+    assert(this->tree_depth == DEPTH && this->tree_max_val == (unsigned int) TREE_MAX_VAL);
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  void OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::setResolution(double r) {
+    if (RES_NUM > 0){
+      // e.g. when reading a file: only the fixed resolution is possible,
+      // readBinary() fails if the file has another one
+      if (r != double(RES_NUM) / double(RES_DEN))
+        OCTOMAP_ERROR("Cannot change the fixed resolution %f of the OcTreeFixed to %f\n",
+                      double(RES_NUM) / double(RES_DEN), r);
+      return;
+    }
+    TREE::setResolution(r);
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  typename OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::NodeType*
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::search(const OcTreeKey& key, unsigned int depth) const {
+    // only the full depth is unrolled
+    if (depth != 0 && depth != DEPTH)
+      return TREE::search(key, depth);
+
+    NodeType* curNode (this->root);
+    if (!curNode)
+      return NULL;
+
+    // constant trip count: unrolled by the compiler
+    for (int i = DEPTH - 1; i >= 0; --i) {
+      unsigned int pos = computeChildIdx(key, i);
+      if (this->nodeChildExists(curNode, pos)) {
+        curNode = this->getNodeChild(curNode, pos);
+      } else {
+        // we expected a child but did not get it
+        // is the current node a leaf already?
+        if (!this->nodeHasChildren(curNode))
+          return curNode;
+        else
+          return NULL;
+      }
+    }
+    return curNode;
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  typename OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::NodeType*
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::search(const point3d& value, unsigned int depth) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(value, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< value <<"] is out of OcTree bounds!");
+      return NULL;
+    }
+    return this->search(key, depth);
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  typename OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::NodeType*
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::search(double x, double y, double z, unsigned int depth) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(x, y, z, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< x <<" "<< y << " " << z << "] is out of OcTree bounds!");
+      return NULL;
+    }
+    return this->search(key, depth);
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  typename OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::NodeType*
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::updateNode(const OcTreeKey& key, float log_odds_update, bool lazy_eval) {
+    // early abort (no change will happen), see OccupancyOcTreeBase::updateNode()
+    if (this->isPagingEnabled())
+      this->touchSubtree(key);
+    NodeType* leaf = this->search(key);
+    if (leaf
+        && ((log_odds_update >= 0 && leaf->getLogOdds() >= this->clamping_thres_max)
+        || ( log_odds_update <= 0 && leaf->getLogOdds() <= this->clamping_thres_min)))
+    {
+      return leaf;
+    }
+
+    bool createdRoot = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      createdRoot = true;
+    }
+
+    bool bounds_tracked = this->boundsTracked();
+    NodeType* result = updateNodeFixedRecurs(this->root, createdRoot, key, log_odds_update, lazy_eval, Depth<0>());
+    if (bounds_tracked)
+      this->growBounds(key);
+    if (this->isPagingEnabled()) {
+      this->touchSubtree(key);
+      this->enforceMemoryBudget();
+    }
+    return result;
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  template <unsigned int D>
+  typename OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::NodeType*
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::updateNodeFixedRecurs(NodeType* node, bool node_just_created, const OcTreeKey& key,
+                                                                 float log_odds_update, bool lazy_eval, Depth<D>) {
+    bool created_node = false;
+    assert(node);
+
+    unsigned int pos = computeChildIdx(key, DEPTH - 1 - D);
+    if (!this->nodeChildExists(node, pos)) {
+      // child does not exist, but maybe it's a pruned node?
+      if (!this->nodeHasChildren(node) && !node_just_created ) {
+        // current node does not have children AND it is not a new node
+        // -> expand pruned node
+        this->expandNode(node);
+      }
+      else {
+        // not a pruned node, create requested child
+        this->createNodeChild(node, pos);
+        created_node = true;
+      }
+    }
+
+    if (lazy_eval) {
+      if (this->use_dirty_tracking)
+        node->setDirty();
+      return updateNodeFixedRecurs(this->getNodeChildForWrite(node, pos), created_node, key, log_odds_update, lazy_eval, Depth<D+1>());
+    }
+    else {
+      NodeType* retval = updateNodeFixedRecurs(this->getNodeChildForWrite(node, pos), created_node, key, log_odds_update, lazy_eval, Depth<D+1>());
+      // prune node if possible, otherwise set own probability
+      if (this->pruneNode(node)){
+        // return pointer to current parent (pruned), the just updated node no longer exists
+        retval = node;
+      } else{
+        node->updateOccupancyChildren();
+      }
+      return retval;
+    }
+  }
+
+  template <class TREE, unsigned int DEPTH, unsigned int RES_NUM, unsigned int RES_DEN>
+  typename OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::NodeType*
+  OcTreeFixed<TREE,DEPTH,RES_NUM,RES_DEN>::updateNodeFixedRecurs(NodeType* node, bool node_just_created, const OcTreeKey& key,
+                                                                 float log_odds_update, bool /*lazy_eval*/, Depth<DEPTH>) {
+    // at last level, update node, end of recursion
+    if (this->use_change_detection) {
+      bool occBefore = this->isNodeOccupied(node);
+      this->updateNodeLogOdds(node, log_odds_update);
+
+      if (node_just_created){  // new node
+        this->changed_keys.insert(std::pair<OcTreeKey,bool>(key, true));
+      } else if (occBefore != this->isNodeOccupied(node)) {  // occupancy changed, track it
+        KeyBoolMap::iterator it = this->changed_keys.find(key);
+        if (it == this->changed_keys.end())
+          this->changed_keys.insert(std::pair<OcTreeKey,bool>(key, false));
+        else if (it->second == false)
+          this->changed_keys.erase(it);
+      }
+    } else {
+      this->updateNodeLogOdds(node, log_odds_update);
+    }
+    return node;
+  }
+
+} // end namespace
@@ -0,0 +1,246 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_OCTREE_FROZEN_H
+#define OCTOMAP_OCTREE_FROZEN_H
+
+#include <stack>
+#include <vector>
+#include <iterator>
+
+#include "octomap_types.h"
+#include "octomap_utils.h"
+#include "OcTreeKey.h"
+#include "OcTreeRayCast.h"
+#include "OccupancyOcTreeBase.h"
+
+namespace octomap {
+
+  class OcTreeFrozen;
+
+  /**
+   * Node of an OcTreeFrozen. Nodes are stored breadth-first in one array,
+   * all children of a node are consecutive. Instead of child pointers, a node
+   * only stores a bitmask of its existing children and the index of its first child.
+   */
+  class OcTreeFrozenNode {
+  public:
+    friend class OcTreeFrozen;
+
+    /// @return occupancy probability of node
+    inline double getOccupancy() const { return probability(log_odds); }
+    /// @return log odds representation of occupancy probability of node
+    inline float getLogOdds() const { return log_odds; }
+    inline float getValue() const { return log_odds; }
+
+    /// @return true if the node has at least one child
+    inline bool hasChildren() const { return child_mask != 0; }
+    /// @return true if the child at childIdx exists
+    inline bool childExists(unsigned int childIdx) const { return ((child_mask >> childIdx) & 1) != 0; }
+
+  protected:
+    float log_odds;
+    uint32_t first_child; ///< index of the first existing child in OcTreeFrozen::nodes
+    uint8_t child_mask;   ///< bit i is set if child i exists
+  };
+
+
+  /**
+   * Immutable, compacted copy of an occupancy octree for query-only use.
+   * It can be built from any OccupancyOcTreeBase (OcTree, ColorOcTree,
+   * OcTreeStamped, ...) and only keeps the occupancy of the nodes. The nodes are
+   * stored breadth-first in a single array with child bitmasks instead of
+   * pointers, which needs a fraction of the memory of the source tree and keeps
+   * lookups local in memory.
+   *
+   * Supports search(), castRay(), isNodeOccupied() and the tree, leaf and
+   * bounding-box leaf iterators with the same semantics as in OccupancyOcTreeBase,
+   * sharing their implementation (OcTreeKey.h, OcTreeRayCast.h, OcTreeIterator.hxx).
+   */
+  class OcTreeFrozen {
+  public:
+    typedef OcTreeFrozenNode NodeType;
+
+    /// tree and node type of the iterators in OcTreeIterator.hxx, which never modify nodes
+    typedef OcTreeFrozen IteratorTreeType;
+    typedef const OcTreeFrozenNode IteratorNodeType;
+
+    // the iterators of the mutable trees (tree, leaf and bounding-box leaf iterator)
+    #include <octomap/OcTreeIterator.hxx>
+
+    /// Creates an empty frozen tree
+    OcTreeFrozen(double resolution);
+
+    /// Creates a compacted copy of tree (all nodes, inner nodes as in tree)
+    template <class NODE>
+    OcTreeFrozen(const OccupancyOcTreeBase<NODE>& tree);
+
+    std::string getTreeType() const {return "OcTreeFrozen";}
+
+    inline double getResolution() const { return resolution; }
+    inline unsigned int getTreeDepth () const { return tree_depth; }
+    inline double getNodeSize(unsigned depth) const {assert(depth <= tree_depth); return sizeLookupTable[depth];}
+
+    /// @return number of nodes in the tree
+    inline size_t size() const { return nodes.size(); }
+    /// @return memory usage of the frozen tree in bytes
+    size_t memoryUsage() const;
+    /// @return memory usage of a single frozen node
+    inline size_t memoryUsageNode() const { return sizeof(OcTreeFrozenNode); }
+
+    /// @return threshold (probability) for occupancy
+    double getOccupancyThres() const {return probability(occ_prob_thres_log); }
+    /// @return threshold (log-odds) for occupancy
+    float getOccupancyThresLog() const {return occ_prob_thres_log; }
+
+    /// queries whether a node is occupied according to the tree's parameter for "occupancy"
+    inline bool isNodeOccupied(const OcTreeFrozenNode* node) const{
+      return (node->getLogOdds() >= this->occ_prob_thres_log);
+    }
+    /// queries whether a node is occupied according to the tree's parameter for "occupancy"
+    inline bool isNodeOccupied(const OcTreeFrozenNode& node) const{
+      return (node.getLogOdds() >= this->occ_prob_thres_log);
+    }
+
+    /// @return root node of the tree, NULL for an empty tree
+    inline const OcTreeFrozenNode* getRoot() const { return nodes.empty() ? NULL : &nodes[0]; }
+
+    /// @return true if node has a child at childIdx
+    inline bool nodeChildExists(const OcTreeFrozenNode* node, unsigned int childIdx) const{
+      return node->childExists(childIdx);
+    }
+    /// @return true if node has at least one child
+    inline bool nodeHasChildren(const OcTreeFrozenNode* node) const { return node->hasChildren(); }
+
+    /// @return child number childIdx of node, which needs to exist
+    inline const OcTreeFrozenNode* getNodeChild(const OcTreeFrozenNode* node, unsigned int childIdx) const{
+      assert(node->childExists(childIdx));
+      return &nodes[node->first_child + countBits(node->child_mask & ((1u << childIdx) - 1))];
+    }
+
+    /**
+     *  Search node at specified depth given a 3d point (depth=0: search full tree depth).
+     *  You need to check if the returned node is NULL, since it can be in unknown space.
+     *  @return pointer to node if found, NULL otherwise
+     */
+    const OcTreeFrozenNode* search(double x, double y, double z, unsigned int depth = 0) const;
+    const OcTreeFrozenNode* search(const point3d& value, unsigned int depth = 0) const;
+    const OcTreeFrozenNode* search(const OcTreeKey& key, unsigned int depth = 0) const;
+
+    /**
+     * Performs raycasting in 3d, same as OccupancyOcTreeBase::castRay().
+     * A ray is cast from 'origin' with a given direction, the first non-free
+     * cell is returned in 'end' (as center coordinate). This could also be
+     * the origin node if it is occupied or unknown.
+     *
+     * @return true if an occupied cell was hit, false if the maximum range or
+     *   octree bounds are reached, or if an unknown node was hit.
+     */
+    bool castRay(const point3d& origin, const point3d& direction, point3d& end,
+                 bool ignoreUnknownCells=false, double maxRange=-1.0) const;
+
+    // -- Key / coordinate conversion, see OcTreeBaseImpl
+
+    inline key_type coordToKey(double coordinate) const{
+      return computeKey(coordinate, resolution_factor, tree_max_val);
+    }
+    inline OcTreeKey coordToKey(const point3d& coord) const{
+      return OcTreeKey(coordToKey(coord(0)), coordToKey(coord(1)), coordToKey(coord(2)));
+    }
+    inline bool coordToKeyChecked(double coordinate, key_type& key) const{
+      return computeKeyChecked(coordinate, resolution_factor, tree_max_val, key);
+    }
+    inline bool coordToKeyChecked(const point3d& coord, OcTreeKey& key) const{
+      return coordToKeyChecked(coord(0), key[0]) && coordToKeyChecked(coord(1), key[1])
+          && coordToKeyChecked(coord(2), key[2]);
+    }
+    inline bool coordToKeyChecked(double x, double y, double z, OcTreeKey& key) const{
+      return coordToKeyChecked(x, key[0]) && coordToKeyChecked(y, key[1]) && coordToKeyChecked(z, key[2]);
+    }
+
+    inline double keyToCoord(key_type key) const{
+      return computeKeyCoord(key, tree_max_val, resolution);
+    }
+    inline double keyToCoord(key_type key, unsigned depth) const{
+      return computeKeyCoord(key, depth, tree_depth, tree_max_val, resolution);
+    }
+    inline point3d keyToCoord(const OcTreeKey& key) const{
+      return point3d(float(keyToCoord(key[0])), float(keyToCoord(key[1])), float(keyToCoord(key[2])));
+    }
+    inline point3d keyToCoord(const OcTreeKey& key, unsigned depth) const{
+      return point3d(float(keyToCoord(key[0], depth)), float(keyToCoord(key[1], depth)), float(keyToCoord(key[2], depth)));
+    }
+
+    tree_iterator begin_tree(unsigned char maxDepth=0) const {return tree_iterator(this, maxDepth);}
+    const tree_iterator end_tree() const {return tree_iterator_end;}
+
+    leaf_iterator begin_leafs(unsigned char maxDepth=0) const {return leaf_iterator(this, maxDepth);}
+    const leaf_iterator end_leafs() const {return leaf_iterator_end;}
+
+    leaf_bbx_iterator begin_leafs_bbx(const OcTreeKey& min, const OcTreeKey& max, unsigned char maxDepth=0) const {
+      return leaf_bbx_iterator(this, min, max, maxDepth);
+    }
+    leaf_bbx_iterator begin_leafs_bbx(const point3d& min, const point3d& max, unsigned char maxDepth=0) const {
+      return leaf_bbx_iterator(this, min, max, maxDepth);
+    }
+    const leaf_bbx_iterator end_leafs_bbx() const {return leaf_iterator_bbx_end;}
+
+  protected:
+    void init(double resolution, unsigned int tree_depth, float occ_prob_thres_log);
+
+    /// number of set bits in an 8 bit mask
+    static inline unsigned int countBits(unsigned int mask){
+      mask = mask - ((mask >> 1) & 0x55);
+      mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+      return (mask + (mask >> 4)) & 0x0F;
+    }
+
+    std::vector<OcTreeFrozenNode> nodes; ///< all nodes in breadth-first order, nodes[0] is the root
+
+    unsigned int tree_depth;
+    unsigned int tree_max_val;
+    double resolution;  ///< in meters
+    double resolution_factor; ///< = 1. / resolution
+    float occ_prob_thres_log;
+    std::vector<double> sizeLookupTable;
+
+    const leaf_iterator leaf_iterator_end;
+    const leaf_bbx_iterator leaf_iterator_bbx_end;
+    const tree_iterator tree_iterator_end;
+  };
+
+} // end namespace
+
+#include "octomap/OcTreeFrozen.hxx"
+
+#endif
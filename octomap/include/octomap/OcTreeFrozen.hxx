@@ -0,0 +1,75 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <limits>
+
+namespace octomap {
+
+  template <class NODE>
+  OcTreeFrozen::OcTreeFrozen(const OccupancyOcTreeBase<NODE>& tree)
+  {
+    init(tree.getResolution(), tree.getTreeDepth(), tree.getOccupancyThresLog());
+
+    const NODE* root = tree.getRoot();
+    if (root == NULL)
+      return;
+
+    if (tree.size() > size_t(std::numeric_limits<uint32_t>::max())){
+      OCTOMAP_ERROR("Tree with %zu nodes is too large to be frozen\n", tree.size());
+      return;
+    }
+
+    // breadth-first traversal: the children of a node are appended to the
+    // queue together, so they end up consecutive in the node array
+    std::vector<const NODE*> queue;
+    queue.reserve(tree.size());
+    nodes.reserve(tree.size());
+    queue.push_back(root);
+
+    for (size_t i = 0; i < queue.size(); ++i){
+      const NODE* node = queue[i];
+      OcTreeFrozenNode frozen;
+      frozen.log_odds = node->getLogOdds();
+      frozen.first_child = uint32_t(queue.size());
+      frozen.child_mask = 0;
+      for (unsigned int c = 0; c < 8; ++c){
+        if (tree.nodeChildExists(node, c)){
+          frozen.child_mask |= uint8_t(1 << c);
+          queue.push_back(tree.getNodeChild(node, c));
+        }
+      }
+      nodes.push_back(frozen);
+    }
+  }
+
+} // end namespace
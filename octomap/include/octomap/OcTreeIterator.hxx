@@ -31,15 +31,17 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifndef OCTOMAP_OCTREEITERATOR_HXX_
-#define OCTOMAP_OCTREEITERATOR_HXX_
+// No include guard: this file is included into the body of every tree class
+// with iterators (OcTreeBaseImpl and OcTreeFrozen)
 
     /**
      * Base class for OcTree iterators. So far, all iterator's are
      * const with respect to the tree. This file is included within
-     * OcTreeBaseImpl.h, you should probably not include this directly.
+     * OcTreeBaseImpl.h and OcTreeFrozen.h, you should probably not include this directly.
+     * The including class defines IteratorTreeType (itself) and IteratorNodeType
+     * (its node type, const for read-only trees).
      */
-    class iterator_base : public std::iterator<std::forward_iterator_tag, NodeType>{
+    class iterator_base : public std::iterator<std::forward_iterator_tag, IteratorNodeType>{
     public:
       struct StackElement;
       /// Default ctor, only used for the end-iterator
@@ -52,15 +54,15 @@
        * @param tree OcTreeBaseImpl on which the iterator is used on
        * @param depth Maximum depth to traverse the tree. 0 (default): unlimited
        */
-      iterator_base(OcTreeBaseImpl<NodeType,INTERFACE> const* ptree, uint8_t depth=0)
-        : tree((ptree && ptree->root) ? ptree : NULL), maxDepth(depth)
+      iterator_base(IteratorTreeType const* ptree, uint8_t depth=0)
+        : tree((ptree && ptree->getRoot()) ? ptree : NULL), maxDepth(depth)
       {
         if (ptree && maxDepth == 0)
           maxDepth = ptree->getTreeDepth();
 
-        if (tree && tree->root){ // tree is not empty
+        if (tree && tree->getRoot()){ // tree is not empty
           StackElement s;
-          s.node = tree->root;
+          s.node = tree->getRoot();
           s.depth = 0;
           s.key[0] = s.key[1] = s.key[2] = tree->tree_max_val;
           stack.push(s);
@@ -99,19 +101,19 @@
 
       /// Ptr operator will return the current node in the octree which the
       /// iterator is referring to
-      NodeType const* operator->() const { return stack.top().node;}
+      IteratorNodeType const* operator->() const { return stack.top().node;}
 
       /// Ptr operator will return the current node in the octree which the
       /// iterator is referring to
-      NodeType* operator->() { return stack.top().node;}
+      IteratorNodeType* operator->() { return stack.top().node;}
 
       /// Return the current node in the octree which the
       /// iterator is referring to
-      const NodeType& operator*() const { return *(stack.top().node);}
+      const IteratorNodeType& operator*() const { return *(stack.top().node);}
 
       /// Return the current node in the octree which the
       /// iterator is referring to
-      NodeType& operator*() { return *(stack.top().node);}
+      IteratorNodeType& operator*() { return *(stack.top().node);}
 
       /// return the center coordinate of the current node
       point3d getCoordinate() const {
@@ -148,14 +150,14 @@
 
       /// Element on the internal recursion stack of the iterator
       struct StackElement{
-        NodeType* node;
+        IteratorNodeType* node;
         OcTreeKey key;
         uint8_t depth;
       };
 
 
     protected:
-      OcTreeBaseImpl<NodeType,INTERFACE> const* tree; ///< Octree this iterator is working on
+      IteratorTreeType const* tree; ///< Octree this iterator is working on
       uint8_t maxDepth; ///< Maximum depth for depth-limited queries
 
       /// Internal recursion stack. Apparently a stack of vector works fastest here.
@@ -213,7 +215,7 @@
        * @param tree OcTreeBaseImpl on which the iterator is used on
        * @param depth Maximum depth to traverse the tree. 0 (default): unlimited
        */
-      tree_iterator(OcTreeBaseImpl<NodeType,INTERFACE> const* ptree, uint8_t depth=0) : iterator_base(ptree, depth) {};
+      tree_iterator(IteratorTreeType const* ptree, uint8_t depth=0) : iterator_base(ptree, depth) {};
 
       /// postfix increment operator of iterator (it++)
       tree_iterator operator++(int){
@@ -270,7 +272,7 @@
           * @param tree OcTreeBaseImpl on which the iterator is used on
           * @param depth Maximum depth to traverse the tree. 0 (default): unlimited
           */
-          leaf_iterator(OcTreeBaseImpl<NodeType, INTERFACE> const* ptree, uint8_t depth=0) : iterator_base(ptree, depth) {
+          leaf_iterator(IteratorTreeType const* ptree, uint8_t depth=0) : iterator_base(ptree, depth) {
             // tree could be empty (= no stack)
             if (this->stack.size() > 0){
               // skip forward to next valid leaf node:
@@ -350,7 +352,7 @@
       * @param max Maximum point3d of the axis-aligned boundingbox
       * @param depth Maximum depth to traverse the tree. 0 (default): unlimited
       */
-      leaf_bbx_iterator(OcTreeBaseImpl<NodeType,INTERFACE> const* ptree, const point3d& min, const point3d& max, uint8_t depth=0)
+      leaf_bbx_iterator(IteratorTreeType const* ptree, const point3d& min, const point3d& max, uint8_t depth=0)
         : iterator_base(ptree, depth)
       {
         if (this->stack.size() > 0){
@@ -359,6 +361,8 @@
             // coordinates invalid, set to end iterator
             this->tree = NULL;
             this->maxDepth = 0;
+            while (!this->stack.empty())
+              this->stack.pop();
           } else{  // else: keys are generated and stored
 
             // advance from root to next valid leaf in bbx:
@@ -378,7 +382,7 @@
       * @param max Maximum OcTreeKey to be included in the axis-aligned boundingbox
       * @param depth Maximum depth to traverse the tree. 0 (default): unlimited
       */
-      leaf_bbx_iterator(OcTreeBaseImpl<NodeType,INTERFACE> const* ptree, const OcTreeKey& min, const OcTreeKey& max, uint8_t depth=0)
+      leaf_bbx_iterator(IteratorTreeType const* ptree, const OcTreeKey& min, const OcTreeKey& max, uint8_t depth=0)
         : iterator_base(ptree, depth), minKey(min), maxKey(max)
       {
         // tree could be empty (= no stack)
@@ -459,5 +463,3 @@
       OcTreeKey maxKey;
     };
 
-
-#endif /* OCTREEITERATOR_HXX_ */
@@ -40,6 +40,11 @@
 #include <ciso646>
 
 #include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
 
 /* Libc++ does not implement the TR1 namespace, all c++11 related functionality
  * is instead implemented in the std namespace.
@@ -58,9 +63,34 @@
   }
 #endif
 
+/**
+ * Number of levels below the root of all octrees, set with the CMake option
+ * OCTOMAP_TREE_DEPTH. With 16 levels, a tree spans 2^16 voxels per axis
+ * (3.2 km at 5 cm resolution). Deeper trees need 32 bit keys (OCTOMAP_KEY_32BIT)
+ * and can have up to 21 levels, so that the Morton code of a key fits into 64 bits.
+ */
+#ifndef OCTOMAP_TREE_DEPTH
+  #define OCTOMAP_TREE_DEPTH 16
+#endif
+
+#ifdef OCTOMAP_KEY_32BIT
+  #if OCTOMAP_TREE_DEPTH > 21
+    #error "OCTOMAP_TREE_DEPTH must not exceed 21"
+  #endif
+#elif OCTOMAP_TREE_DEPTH > 16
+  #error "OCTOMAP_TREE_DEPTH > 16 requires OCTOMAP_KEY_32BIT"
+#endif
+
 namespace octomap {
 
+#ifdef OCTOMAP_KEY_32BIT
+  typedef uint32_t key_type;
+#else
   typedef uint16_t key_type;
+#endif
+
+  /// Morton code (Z-order) of an OcTreeKey, see computeMortonCode()
+  typedef uint64_t morton_type;
   
   /**
    * OcTreeKey is a container class for internal key addressing. The keys count the
@@ -106,34 +136,165 @@ namespace octomap {
 
     key_type k[3];
 
-    /// Provides a hash function on Keys
+    /// Provides a hash function on Keys, based on their Morton code
     struct KeyHash{
-      size_t operator()(const OcTreeKey& key) const{
-        // a simple hashing function 
-	// explicit casts to size_t to operate on the complete range
-	// constanst will be promoted according to C++ standard
-        return static_cast<size_t>(key.k[0])
-          + 1447*static_cast<size_t>(key.k[1])
-          + 345637*static_cast<size_t>(key.k[2]);
-      }
+      inline size_t operator()(const OcTreeKey& key) const;
     };
     
   };
+
+#ifdef OCTOMAP_KEY_32BIT
+  /// spreads the lower 21 bits of v so that there are two zero bits between each of them
+  inline morton_type mortonSplitBits(key_type v){
+    morton_type x = v & 0x1FFFFF;
+    x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+    x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+    x = (x | (x << 8))  & 0x100F00F00F00F00FULL;
+    x = (x | (x << 4))  & 0x10C30C30C30C30C3ULL;
+    x = (x | (x << 2))  & 0x1249249249249249ULL;
+    return x;
+  }
+
+  /// inverse of mortonSplitBits(), collects every third bit of x
+  inline key_type mortonCompactBits(morton_type x){
+    x &= 0x1249249249249249ULL;
+    x = (x | (x >> 2))  & 0x10C30C30C30C30C3ULL;
+    x = (x | (x >> 4))  & 0x100F00F00F00F00FULL;
+    x = (x | (x >> 8))  & 0x001F0000FF0000FFULL;
+    x = (x | (x >> 16)) & 0x001F00000000FFFFULL;
+    x = (x | (x >> 32)) & 0x00000000001FFFFFULL;
+    return static_cast<key_type>(x);
+  }
+#else
+  /// spreads the 16 bits of v so that there are two zero bits between each of them
+  inline morton_type mortonSplitBits(key_type v){
+    morton_type x = v;
+    x = (x | (x << 16)) & 0x0000FF0000FFULL;
+    x = (x | (x << 8))  & 0x00F00F00F00FULL;
+    x = (x | (x << 4))  & 0x0C30C30C30C3ULL;
+    x = (x | (x << 2))  & 0x249249249249ULL;
+    return x;
+  }
+
+  /// inverse of mortonSplitBits(), collects every third bit of x
+  inline key_type mortonCompactBits(morton_type x){
+    x &= 0x249249249249ULL;
+    x = (x | (x >> 2))  & 0x0C30C30C30C3ULL;
+    x = (x | (x >> 4))  & 0x00F00F00F00FULL;
+    x = (x | (x >> 8))  & 0x0000FF0000FFULL;
+    x = (x | (x >> 16)) & 0x00000000FFFFULL;
+    return static_cast<key_type>(x);
+  }
+#endif
+
+  /**
+   * Computes the Morton code (Z-order) of a key by interleaving the bits of
+   * its three components, x in the lowest bit. The three bits at position
+   * 3*level are the child index of the key at that level (see computeChildIdx()),
+   * so sorting by Morton code orders keys like a depth-first traversal of the tree.
+   */
+  inline morton_type computeMortonCode(const OcTreeKey& key){
+    return mortonSplitBits(key[0]) | (mortonSplitBits(key[1]) << 1) | (mortonSplitBits(key[2]) << 2);
+  }
+
+  /// Converts a Morton code back into the OcTreeKey, inverse of computeMortonCode()
+  inline OcTreeKey mortonCodeToKey(morton_type code){
+    return OcTreeKey(mortonCompactBits(code), mortonCompactBits(code >> 1), mortonCompactBits(code >> 2));
+  }
+
+  /**
+   * Morton code of the ancestor of a node, equivalent to computeIndexKey() on keys
+   *
+   * @param level from the bottom (= tree_depth - depth of ancestor)
+   * @param code Morton code at the lowest level
+   */
+  inline morton_type computeMortonIndexCode(unsigned int level, morton_type code){
+    if (level == 0)
+      return code;
+    else
+      return code & ~((morton_type(1) << (3*level)) - 1);
+  }
+
+  /// child index (between 0 and 7) of a Morton code at a given level, equivalent to computeChildIdx()
+  inline uint8_t computeMortonChildIdx(morton_type code, unsigned int level){
+    return static_cast<uint8_t>((code >> (3*level)) & 7);
+  }
+
+  /**
+   * Morton code of a child from the (index) code of its parent
+   *
+   * @param pos index of child node (0..7)
+   * @param parent_level level of the parent from the bottom (> 0)
+   * @param parent_code Morton index code of the parent, see computeMortonIndexCode()
+   */
+  inline morton_type computeMortonChildCode(unsigned int pos, unsigned int parent_level, morton_type parent_code){
+    assert(parent_level > 0 && pos < 8);
+    return parent_code | (morton_type(pos) << (3*(parent_level-1)));
+  }
+
+  inline size_t OcTreeKey::KeyHash::operator()(const OcTreeKey& key) const{
+    // the Morton code is unique for each key, scramble it with a multiplicative
+    // hash to distribute it evenly also in the lower bits
+    morton_type h = computeMortonCode(key) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(h ^ (h >> 32));
+  }
+
+  /// Comparison of keys in Morton order, e.g. for std::sort
+  struct KeyMortonLess{
+    bool operator()(const OcTreeKey& a, const OcTreeKey& b) const{
+      return computeMortonCode(a) < computeMortonCode(b);
+    }
+  };
   
+} // namespace
+
+#include "OcTreeKeyFlatHash.h"
+
+namespace octomap {
+
   /**
    * Data structure to efficiently compute the nodes to update from a scan
    * insertion using a hash set.
    * @note you need to use boost::unordered_set instead if your compiler does not
    * yet support tr1!
+   * @see KeyFlatSet for the open-addressing set used by the tree internally
    */
   typedef unordered_ns::unordered_set<OcTreeKey, OcTreeKey::KeyHash> KeySet;
 
   /**
    * Data structrure to efficiently track changed nodes as a combination of
    * OcTreeKeys and a bool flag (to denote newly created nodes)
-   *
+   * @note change detection keeps using this std container (its iterators are
+   * returned by changedKeysBegin()), only the scan insertion uses KeyFlatSet
    */
   typedef unordered_ns::unordered_map<OcTreeKey, bool, OcTreeKey::KeyHash> KeyBoolMap;
+  /// Depth of a node per key
+  typedef unordered_ns::unordered_map<OcTreeKey, unsigned int, OcTreeKey::KeyHash> KeyDepthMap;
+
+  /// Sorts keys in place into Morton order (spatially coherent, depth-first in the tree)
+  inline void sortMortonOrder(std::vector<OcTreeKey>::iterator begin, std::vector<OcTreeKey>::iterator end){
+    // sort the codes themselves instead of recomputing them in every comparison
+    std::vector<morton_type> codes;
+    codes.reserve(end - begin);
+    for (std::vector<OcTreeKey>::iterator it = begin; it != end; ++it)
+      codes.push_back(computeMortonCode(*it));
+
+    std::sort(codes.begin(), codes.end());
+    for (size_t i = 0; i < codes.size(); ++i, ++begin)
+      *begin = mortonCodeToKey(codes[i]);
+  }
+
+  /// Copies the contents of a KeySet into keys, sorted in Morton order
+  inline void sortMortonOrder(const KeySet& key_set, std::vector<OcTreeKey>& keys){
+    keys.assign(key_set.begin(), key_set.end());
+    sortMortonOrder(keys.begin(), keys.end());
+  }
+
+  /// Copies the contents of a KeyFlatSet into keys, sorted in Morton order
+  inline void sortMortonOrder(const KeyFlatSet& key_set, std::vector<OcTreeKey>& keys){
+    keys.assign(key_set.begin(), key_set.end());
+    sortMortonOrder(keys.begin(), keys.end());
+  }
 
 
   class KeyRay {
@@ -143,6 +304,12 @@ namespace octomap {
       ray.resize(maxSize);
       reset();
     }
+
+    /// KeyRay with room for max_size keys only, see reserveMax()
+    explicit KeyRay (size_t max_size) {
+      ray.resize(max_size);
+      reset();
+    }
     
     KeyRay(const KeyRay& other){
       ray = other.ray;
@@ -161,7 +328,16 @@ namespace octomap {
     }
 
     size_t size() const { return end_of_ray - ray.begin(); }
-    size_t sizeMax() const { return maxSize; }
+    size_t sizeMax() const { return ray.size(); }
+    /// @return room of a default-constructed KeyRay
+    static size_t sizeMaxDefault() { return maxSize; }
+
+    /// Makes room for at least max_size keys (never shrinks) and resets the ray
+    void reserveMax(size_t max_size) {
+      if (ray.size() < max_size)
+        ray.resize(max_size);
+      reset();
+    }
 
     typedef std::vector<OcTreeKey>::iterator iterator;
     typedef std::vector<OcTreeKey>::const_iterator const_iterator;
@@ -175,6 +351,9 @@ namespace octomap {
     reverse_iterator rbegin() { return (reverse_iterator) end_of_ray; }
     reverse_iterator rend() { return ray.rend(); }
 
+    /// Sorts the keys of the ray into Morton order (the ray order is lost)
+    void sortMortonOrder() { octomap::sortMortonOrder(begin(), end()); }
+
   private:
     std::vector<OcTreeKey> ray;
     std::vector<OcTreeKey>::iterator end_of_ray;
@@ -229,7 +408,7 @@ namespace octomap {
     if (level == 0)
       return key;
     else {
-      key_type mask = 65535 << level;
+      key_type mask = std::numeric_limits<key_type>::max() << level;
       OcTreeKey result = key;
       result[0] &= mask;
       result[1] &= mask;
@@ -238,6 +417,64 @@ namespace octomap {
     }
   }
 
+  /*
+   * Conversion between coordinates and keys of a tree with the given resolution and depth,
+   * shared by OcTreeBaseImpl, OcTreeFixed and OcTreeFrozen (see OcTreeBaseImpl::coordToKey()
+   * and keyToCoord()). tree_max_val is the key of the tree center, 2^(tree_depth-1).
+   */
+
+  /// key of a coordinate (not checked for the tree bounds), resolution_factor = 1 / resolution
+  inline key_type computeKey(double coordinate, double resolution_factor, unsigned int tree_max_val){
+    return ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+  }
+
+  /// key of a coordinate, @return false if the coordinate is out of the tree bounds
+  inline bool computeKeyChecked(double coordinate, double resolution_factor, unsigned int tree_max_val,
+                                key_type& key){
+    // scale to resolution and shift center for tree_max_val
+    int scaled_coord =  ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+
+    // keyval within range of tree?
+    if (( scaled_coord >= 0) && (((unsigned int) scaled_coord) < (2*tree_max_val))) {
+      key = scaled_coord;
+      return true;
+    }
+    return false;
+  }
+
+  /// key of the center of the node at depth which contains the (finest) key
+  inline key_type computeKeyAtDepth(key_type key, unsigned int depth, unsigned int tree_depth,
+                                    unsigned int tree_max_val){
+    unsigned int diff = tree_depth - depth;
+
+    if(diff == 0)
+      return key;
+    else
+      return (((key-tree_max_val) >> diff) << diff) + (1 << (diff-1)) + tree_max_val;
+  }
+
+  /// center coordinate of the finest node with the given key
+  inline double computeKeyCoord(key_type key, unsigned int tree_max_val, double resolution){
+    return (double( (int) key - (int) tree_max_val ) +0.5) * resolution;
+  }
+
+  /// center coordinate of the node at depth which contains the key
+  inline double computeKeyCoord(key_type key, unsigned int depth, unsigned int tree_depth,
+                                unsigned int tree_max_val, double resolution){
+    assert(depth <= tree_depth);
+
+    // root is centered on 0 = 0.0
+    if (depth == 0) {
+      return 0.0;
+    } else if (depth == tree_depth) {
+      return computeKeyCoord(key, tree_max_val, resolution);
+    } else {
+      // node size as in the size lookup table of the trees
+      double node_size = resolution * double(1 << (tree_depth - depth));
+      return (floor( (double(key)-double(tree_max_val)) /double(1 << (tree_depth - depth)) )  + 0.5 ) * node_size;
+    }
+  }
+
 } // namespace
 
 #endif
@@ -0,0 +1,363 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_OCTREE_KEY_FLAT_HASH_H
+#define OCTOMAP_OCTREE_KEY_FLAT_HASH_H
+
+/* This file is included from OcTreeKey.h, include that one instead. */
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace octomap {
+
+  /**
+   * Open-addressing hash table for OcTreeKeys with linear probing, the common
+   * implementation of KeyFlatSet and KeyFlatMap. All entries are stored in one
+   * array (no allocation per insert). Erased entries leave a tombstone, so
+   * erasing while iterating is safe. clear() keeps the allocated memory, which
+   * makes the containers cheap to reuse across scans.
+   *
+   * Inserting may rehash and invalidates all iterators, like in std::unordered_set.
+   *
+   * The tree uses these containers for the keys of scan insertions (computeUpdate(),
+   * computeDiscreteUpdate() and insertPointCloud()). The public KeySet and KeyBoolMap
+   * typedefs, and with them change detection (changedKeysBegin()), remain std
+   * unordered containers.
+   *
+   * \tparam VALUE stored type, OcTreeKey or std::pair<OcTreeKey, T>
+   * \tparam KEYOF functor returning the OcTreeKey of a VALUE
+   */
+  template <class VALUE, class KEYOF>
+  class KeyFlatHashTable {
+  protected:
+    enum SlotState {SLOT_EMPTY = 0, SLOT_FULL, SLOT_ERASED};
+
+    struct Slot {
+      VALUE value;
+      uint8_t state;
+    };
+
+  public:
+    typedef VALUE value_type;
+    typedef size_t size_type;
+
+    template <class SLOT_PTR, class REF, class PTR>
+    class iterator_impl {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef VALUE value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef PTR pointer;
+      typedef REF reference;
+
+      iterator_impl() : slot(NULL), slot_end(NULL) {}
+      iterator_impl(SLOT_PTR s, SLOT_PTR e) : slot(s), slot_end(e) { skipUnused(); }
+      /// conversion of iterator to const_iterator
+      template <class S, class R, class P>
+      iterator_impl(const iterator_impl<S, R, P>& other) : slot(other.slot), slot_end(other.slot_end) {}
+
+      REF operator*() const { return slot->value; }
+      PTR operator->() const { return &(slot->value); }
+
+      iterator_impl& operator++() {
+        ++slot;
+        skipUnused();
+        return *this;
+      }
+      iterator_impl operator++(int) {
+        iterator_impl result = *this;
+        ++(*this);
+        return result;
+      }
+
+      template <class S, class R, class P>
+      bool operator==(const iterator_impl<S, R, P>& other) const { return slot == other.slot; }
+      template <class S, class R, class P>
+      bool operator!=(const iterator_impl<S, R, P>& other) const { return slot != other.slot; }
+
+      SLOT_PTR slot;
+      SLOT_PTR slot_end;
+
+    protected:
+      void skipUnused() {
+        while (slot != slot_end && slot->state != SLOT_FULL)
+          ++slot;
+      }
+    };
+
+    typedef iterator_impl<Slot*, VALUE&, VALUE*> iterator;
+    typedef iterator_impl<const Slot*, const VALUE&, const VALUE*> const_iterator;
+
+    KeyFlatHashTable() : num_full(0), num_erased(0) {}
+
+    iterator begin() { return iterator(slotsBegin(), slotsEnd()); }
+    iterator end() { return iterator(slotsEnd(), slotsEnd()); }
+    const_iterator begin() const { return const_iterator(slotsBegin(), slotsEnd()); }
+    const_iterator end() const { return const_iterator(slotsEnd(), slotsEnd()); }
+
+    size_t size() const { return num_full; }
+    bool empty() const { return num_full == 0; }
+    /// @return number of slots currently allocated
+    size_t capacity() const { return slots.size(); }
+
+    /// Removes all entries but keeps the allocated memory
+    void clear() {
+      if (num_full + num_erased > 0){
+        for (size_t i = 0; i < slots.size(); ++i)
+          slots[i].state = SLOT_EMPTY;
+      }
+      num_full = num_erased = 0;
+    }
+
+    /// Makes room for n entries without rehashing
+    void reserve(size_t n) {
+      size_t needed = minCapacity(n);
+      if (needed > slots.size())
+        rehash(needed);
+    }
+
+    void swap(KeyFlatHashTable& other) {
+      slots.swap(other.slots);
+      std::swap(num_full, other.num_full);
+      std::swap(num_erased, other.num_erased);
+    }
+
+    iterator find(const OcTreeKey& key) {
+      size_t idx = findSlot(key);
+      return (idx == NOT_FOUND) ? end() : iterator(&slots[idx], slotsEnd());
+    }
+    const_iterator find(const OcTreeKey& key) const {
+      size_t idx = findSlot(key);
+      return (idx == NOT_FOUND) ? end() : const_iterator(&slots[idx], slotsEnd());
+    }
+    size_t count(const OcTreeKey& key) const { return (findSlot(key) == NOT_FOUND) ? 0 : 1; }
+
+    /**
+     * Inserts value if its key is not contained yet.
+     * @return iterator to the entry with the key of value and true if it was inserted
+     */
+    std::pair<iterator, bool> insert(const VALUE& value) {
+      bool inserted;
+      size_t idx = insertSlot(KEYOF()(value), inserted);
+      if (inserted)
+        slots[idx].value = value;
+      return std::make_pair(iterator(&slots[idx], slotsEnd()), inserted);
+    }
+
+    template <class INPUT_ITERATOR>
+    void insert(INPUT_ITERATOR first, INPUT_ITERATOR last) {
+      for (; first != last; ++first)
+        insert(*first);
+    }
+
+    /// Erases the entry at pos. @return iterator to the following entry
+    iterator erase(iterator pos) {
+      pos.slot->state = SLOT_ERASED;
+      --num_full;
+      ++num_erased;
+      return ++pos;
+    }
+
+    /// @return number of erased entries (0 or 1)
+    size_t erase(const OcTreeKey& key) {
+      size_t idx = findSlot(key);
+      if (idx == NOT_FOUND)
+        return 0;
+      slots[idx].state = SLOT_ERASED;
+      --num_full;
+      ++num_erased;
+      return 1;
+    }
+
+  protected:
+    static const size_t NOT_FOUND = size_t(-1);
+    static const size_t MIN_CAPACITY = 16;
+
+    Slot* slotsBegin() { return slots.empty() ? NULL : &slots[0]; }
+    Slot* slotsEnd() { return slots.empty() ? NULL : &slots[0] + slots.size(); }
+    const Slot* slotsBegin() const { return slots.empty() ? NULL : &slots[0]; }
+    const Slot* slotsEnd() const { return slots.empty() ? NULL : &slots[0] + slots.size(); }
+
+    /// smallest power of two capacity holding n entries at a maximum load of 3/4
+    static size_t minCapacity(size_t n) {
+      size_t capacity = MIN_CAPACITY;
+      while (capacity - capacity / 4 < n)
+        capacity *= 2;
+      return capacity;
+    }
+
+    size_t findSlot(const OcTreeKey& key) const {
+      if (num_full == 0)
+        return NOT_FOUND;
+
+      const size_t mask = slots.size() - 1;
+      for (size_t idx = OcTreeKey::KeyHash()(key) & mask; ; idx = (idx + 1) & mask) {
+        const Slot& slot = slots[idx];
+        if (slot.state == SLOT_EMPTY)
+          return NOT_FOUND;
+        if (slot.state == SLOT_FULL && KEYOF()(slot.value) == key)
+          return idx;
+      }
+    }
+
+    /// @return slot of key, which is claimed (but not initialized) if inserted is true
+    size_t insertSlot(const OcTreeKey& key, bool& inserted) {
+      // grow (or clean up tombstones) so that at least one slot stays empty
+      if (num_full + num_erased + 1 > slots.size() - slots.size() / 4){
+        size_t new_capacity = slots.empty() ? size_t(MIN_CAPACITY) : slots.size();
+        if (num_full + 1 > new_capacity / 2 - new_capacity / 8)
+          new_capacity *= 2;
+        rehash(new_capacity);
+      }
+
+      const size_t mask = slots.size() - 1;
+      size_t first_erased = NOT_FOUND;
+      size_t idx = OcTreeKey::KeyHash()(key) & mask;
+      for (; ; idx = (idx + 1) & mask) {
+        Slot& slot = slots[idx];
+        if (slot.state == SLOT_EMPTY)
+          break;
+        if (slot.state == SLOT_ERASED){
+          if (first_erased == NOT_FOUND)
+            first_erased = idx;
+        } else if (KEYOF()(slot.value) == key){
+          inserted = false;
+          return idx;
+        }
+      }
+
+      if (first_erased != NOT_FOUND){
+        idx = first_erased;
+        --num_erased;
+      }
+      slots[idx].state = SLOT_FULL;
+      ++num_full;
+      inserted = true;
+      return idx;
+    }
+
+    void rehash(size_t new_capacity) {
+      std::vector<Slot> old_slots(new_capacity);
+      old_slots.swap(slots);
+      for (size_t i = 0; i < slots.size(); ++i)
+        slots[i].state = SLOT_EMPTY;
+      num_full = num_erased = 0;
+
+      const size_t mask = slots.size() - 1;
+      for (size_t i = 0; i < old_slots.size(); ++i){
+        if (old_slots[i].state != SLOT_FULL)
+          continue;
+        size_t idx = OcTreeKey::KeyHash()(KEYOF()(old_slots[i].value)) & mask;
+        while (slots[idx].state != SLOT_EMPTY)
+          idx = (idx + 1) & mask;
+        slots[idx].value = old_slots[i].value;
+        slots[idx].state = SLOT_FULL;
+        ++num_full;
+      }
+    }
+
+    std::vector<Slot> slots;
+    size_t num_full;   ///< number of stored entries
+    size_t num_erased; ///< number of tombstones
+  };
+
+
+  struct KeyFlatSetKeyOf {
+    const OcTreeKey& operator()(const OcTreeKey& key) const { return key; }
+  };
+
+  template <class T>
+  struct KeyFlatMapKeyOf {
+    const OcTreeKey& operator()(const std::pair<OcTreeKey, T>& value) const { return value.first; }
+  };
+
+  /// Flat hash set of OcTreeKeys, interface compatible with the used parts of std::unordered_set
+  class KeyFlatSet : public KeyFlatHashTable<OcTreeKey, KeyFlatSetKeyOf> {
+  public:
+    typedef KeyFlatHashTable<OcTreeKey, KeyFlatSetKeyOf>::const_iterator iterator;
+    typedef KeyFlatHashTable<OcTreeKey, KeyFlatSetKeyOf>::const_iterator const_iterator;
+
+    iterator begin() const { return KeyFlatHashTable<OcTreeKey, KeyFlatSetKeyOf>::begin(); }
+    iterator end() const { return KeyFlatHashTable<OcTreeKey, KeyFlatSetKeyOf>::end(); }
+
+    iterator find(const OcTreeKey& key) const { return KeyFlatHashTable<OcTreeKey, KeyFlatSetKeyOf>::find(key); }
+
+    std::pair<iterator, bool> insert(const OcTreeKey& key) {
+      bool inserted;
+      size_t idx = insertSlot(key, inserted);
+      if (inserted)
+        slots[idx].value = key;
+      return std::make_pair(iterator(&slots[idx], slotsEnd()), inserted);
+    }
+
+    template <class INPUT_ITERATOR>
+    void insert(INPUT_ITERATOR first, INPUT_ITERATOR last) {
+      for (; first != last; ++first)
+        insert(*first);
+    }
+
+    /// Erases the entry at pos. @return iterator to the following entry
+    iterator erase(iterator pos) {
+      Slot* slot = &slots[0] + (pos.slot - &slots[0]);
+      slot->state = SLOT_ERASED;
+      --num_full;
+      ++num_erased;
+      return ++pos;
+    }
+
+    size_t erase(const OcTreeKey& key) { return KeyFlatHashTable<OcTreeKey, KeyFlatSetKeyOf>::erase(key); }
+  };
+
+  /// Flat hash map from OcTreeKeys to T, interface compatible with the used parts of std::unordered_map
+  template <class T>
+  class KeyFlatMap : public KeyFlatHashTable<std::pair<OcTreeKey, T>, KeyFlatMapKeyOf<T> > {
+  public:
+    typedef T mapped_type;
+
+    /// @return reference to the value of key, inserted with T() if not contained
+    T& operator[](const OcTreeKey& key) {
+      bool inserted;
+      size_t idx = this->insertSlot(key, inserted);
+      if (inserted)
+        this->slots[idx].value = std::pair<OcTreeKey, T>(key, T());
+      return this->slots[idx].value.second;
+    }
+  };
+
+} // namespace
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_OCTREE_MEMORY_POOL_H
+#define OCTOMAP_OCTREE_MEMORY_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <inttypes.h>
+
+namespace octomap {
+
+  /**
+   * Fixed-size block allocator, used by OcTreeBaseImpl to allocate nodes and
+   * the arrays of child pointers. Memory is requested from the system in
+   * chunks which grow in size (up to a limit) and is then handed out slot by
+   * slot. Released slots go onto a free list and are reused by the next
+   * allocation, so a tree which is pruned or cleared recycles its memory
+   * instead of returning it to the heap.
+   *
+   * \note The pool is not thread-safe.
+   */
+  class OcTreeMemoryPool {
+  public:
+    /**
+     * @param slot_size size of a single block in bytes (rounded up to pointer alignment)
+     * @param min_chunk_slots number of slots in the first chunk requested from the system
+     * @param max_chunk_slots maximum number of slots in one chunk, chunk sizes double until then
+     */
+    OcTreeMemoryPool(size_t slot_size, size_t min_chunk_slots = 64, size_t max_chunk_slots = 8192);
+    ~OcTreeMemoryPool();
+
+    /// @return pointer to uninitialized memory of getSlotSize() bytes
+    inline void* allocate() {
+      ++num_used;
+      if (free_list != NULL) {
+        FreeSlot* slot = free_list;
+        free_list = slot->next;
+        --num_free;
+        return slot;
+      }
+      if (chunk_pos == chunk_end)
+        addChunk();
+
+      void* p = chunk_pos;
+      chunk_pos += slot_size;
+      return p;
+    }
+
+    /// Puts a slot obtained from allocate() back onto the free list
+    inline void deallocate(void* p) {
+      FreeSlot* slot = static_cast<FreeSlot*>(p);
+      slot->next = free_list;
+      free_list = slot;
+      ++num_free;
+      --num_used;
+    }
+
+    /**
+     * Returns all chunks to the system. All slots must have been
+     * deallocated (or their contents be abandoned) before.
+     */
+    void release();
+
+    /// Swap contents with another pool of the same slot size
+    void swap(OcTreeMemoryPool& other);
+
+    /// @return size of a single slot in bytes
+    size_t getSlotSize() const { return slot_size; }
+    /// @return number of slots currently handed out
+    size_t getNumSlotsInUse() const { return num_used; }
+    /// @return number of slots reserved from the system but currently unused
+    size_t getNumFreeSlots() const { return num_free + (chunk_end - chunk_pos) / slot_size; }
+    /// @return bytes currently reserved from the system
+    size_t getMemoryReserved() const { return memory_reserved; }
+
+  protected:
+    struct FreeSlot {
+      FreeSlot* next;
+    };
+
+    /// requests a new chunk from the system and makes it current
+    void addChunk();
+
+    size_t slot_size;
+    size_t min_chunk_slots;
+    size_t max_chunk_slots;
+
+    std::vector<char*> chunks;
+    char* chunk_pos;  ///< next unused slot in the current chunk
+    char* chunk_end;  ///< end of the current chunk
+    FreeSlot* free_list;
+
+    size_t num_used;
+    size_t num_free;  ///< number of slots on the free list
+    size_t memory_reserved;
+
+  private:
+    /// Pools own their memory and can't be copied
+    OcTreeMemoryPool(const OcTreeMemoryPool&);
+    OcTreeMemoryPool& operator=(const OcTreeMemoryPool&);
+  };
+
+  /**
+   * Pool of blocks of eight node slots, addressed by 32-bit indices. It holds
+   * all nodes of a tree when built with OCTOMAP_INDEXED_CHILDREN: a node only
+   * stores the index of the block of its children (see OcTreeDataNode).
+   *
+   * Blocks are handed out from chunks which grow in size up to CHUNK_SIZE bytes
+   * and are aligned to CHUNK_SIZE. Each chunk starts with a header describing the
+   * pool, so that the children of a node can be found from the address of the
+   * node alone (getSlot(const void*, ...)), e.g. by the nodes themselves. The
+   * upper bits of an index select the chunk, the lower ones the block in it.
+   * Released blocks go onto a free list. Index 0 is never handed out and
+   * denotes "no block".
+   *
+   * \note The pool is not thread-safe. Lookups may run concurrently to
+   * allocations, since chunks never move.
+   */
+  class OcTreeBlockPool {
+  public:
+    enum {
+      CHUNK_SIZE = 1 << 20, ///< maximum size and alignment of the chunks in bytes
+      HEADER_SIZE = 64      ///< bytes reserved for the header at the start of a chunk
+    };
+
+    /**
+     * @param slot_size size of a single node in bytes, a block holds eight of them
+     * @param min_chunk_blocks number of blocks in the first chunk requested from the system
+     */
+    OcTreeBlockPool(size_t slot_size, size_t min_chunk_blocks = 64);
+    ~OcTreeBlockPool();
+
+    /// @return index of a block of uninitialized slots, never 0
+    inline uint32_t allocate() {
+      ++num_used;
+      if (free_list != 0) {
+        uint32_t block = free_list;
+        free_list = *static_cast<uint32_t*>(getSlot(block, 0));
+        --num_free;
+        return block;
+      }
+      if (next_block == end_block)
+        addChunk();
+      return next_block++;
+    }
+
+    /// Puts a block obtained from allocate() back onto the free list
+    inline void deallocate(uint32_t block) {
+      *static_cast<uint32_t*>(getSlot(block, 0)) = free_list;
+      free_list = block;
+      ++num_free;
+      --num_used;
+    }
+
+    /// @return address of slot i (0-7) of a block of this pool
+    inline void* getSlot(uint32_t block, unsigned int i) const {
+      return chunks[block >> chunk_shift] + HEADER_SIZE + (block & chunk_mask) * block_size + i * slot_size;
+    }
+
+    /// @return address of slot i (0-7) of a block in the pool which holds the node at address node
+    static inline void* getSlot(const void* node, uint32_t block, unsigned int i) {
+      const ChunkHeader* header = getHeader(node);
+      return header->chunks[block >> header->chunk_shift] + HEADER_SIZE
+        + (block & header->chunk_mask) * header->block_size + i * header->slot_size;
+    }
+
+    /// @return index of the block which holds the node at address node
+    static inline uint32_t getBlock(const void* node) {
+      const ChunkHeader* header = getHeader(node);
+      size_t offset = static_cast<const char*>(node) - reinterpret_cast<const char*>(header) - HEADER_SIZE;
+      return header->first_block + (uint32_t) (offset / header->block_size);
+    }
+
+    /// @return the pool which holds the node at address node
+    static inline OcTreeBlockPool* getPool(const void* node) { return getHeader(node)->pool; }
+
+    /**
+     * Returns all chunks to the system. All blocks must have been
+     * deallocated (or their contents be abandoned) before.
+     */
+    void release();
+
+    /// Swap contents with another pool of the same slot size
+    void swap(OcTreeBlockPool& other);
+
+    /// @return size of a node slot in bytes
+    size_t getSlotSize() const { return slot_size; }
+    /// @return size of a block (eight slots) in bytes
+    size_t getBlockSize() const { return block_size; }
+    /// @return number of blocks currently handed out
+    size_t getNumBlocksInUse() const { return num_used; }
+    /// @return bytes currently reserved from the system
+    size_t getMemoryReserved() const { return memory_reserved; }
+
+  protected:
+    /// start of each chunk, at most HEADER_SIZE bytes
+    struct ChunkHeader {
+      OcTreeBlockPool* pool;
+      char** chunks;         ///< chunk table of the pool, updated when it grows
+      size_t block_size;
+      size_t slot_size;
+      uint32_t chunk_shift;
+      uint32_t chunk_mask;
+      uint32_t first_block;  ///< index of the first block of the chunk
+    };
+
+    static inline ChunkHeader* getHeader(const void* node) {
+      return reinterpret_cast<ChunkHeader*>(reinterpret_cast<uintptr_t>(node) & ~uintptr_t(CHUNK_SIZE - 1));
+    }
+
+    /// requests a new chunk from the system, its blocks follow next_block
+    void addChunk();
+
+    /// points the headers of all chunks to this pool and its chunk table
+    void updateHeaders();
+
+    size_t slot_size;
+    size_t block_size;
+    size_t min_chunk_blocks;
+    size_t max_chunk_blocks; ///< blocks fitting into CHUNK_SIZE
+    uint32_t chunk_shift;  ///< number of index bits of the block within its chunk
+    uint32_t chunk_mask;
+
+    char** chunks;         ///< table of the chunks, indexed by block >> chunk_shift
+    size_t num_chunks;
+    size_t chunks_capacity;
+    /// tables replaced when the table grew, lookups of other threads may still read them
+    std::vector<char**> retired_tables;
+
+    uint32_t next_block;   ///< index of the next unused block in the last chunk
+    uint32_t end_block;    ///< end of the last chunk
+    uint32_t free_list;    ///< first free block (0: none), linked through the first slot
+
+    size_t num_used;
+    size_t num_free;       ///< number of blocks on the free list
+    size_t memory_reserved;
+
+  private:
+    /// Pools own their memory and can't be copied
+    OcTreeBlockPool(const OcTreeBlockPool&);
+    OcTreeBlockPool& operator=(const OcTreeBlockPool&);
+  };
+
+} // end namespace
+
+#endif
@@ -86,10 +86,61 @@ namespace octomap {
 
     /// adds p to the node's logOdds value (with no boundary / threshold checking!)
     void addValue(const float& p);
-    
+
+
+    // -- dirty-subtree tracking  ----------------------------
+
+    /// Flags marking that a node's subtree changed since the last
+    /// updateInnerOccupancy() resp. prune(), see OccupancyOcTreeBase::enableDirtyTracking().
+    /// They use spare low bits of the depth byte ("flags"), not storage of their own.
+    enum DirtyFlag { DIRTY_INNER_OCCUPANCY = 1, DIRTY_PRUNE = 2, DIRTY_ALL = 3 };
+
+#ifndef OCTOMAP_NO_NODE_FLAGS
+    /// \return true if any of the given dirty flags is set
+    inline bool isDirty(unsigned char flags = DIRTY_ALL) const { return (this->flags & flags) != 0; }
+    inline void setDirty(unsigned char flags = DIRTY_ALL) { this->flags |= flags; }
+    inline void clearDirty(unsigned char flags = DIRTY_ALL) { this->flags &= ~flags; }
+
+
+    // -- copy-on-write snapshots  ----------------------------
+
+    /// \return true if the node (and its subtree) may be referenced by a snapshot
+    /// and must not be modified, see OccupancyOcTreeBase::snapshot()
+    inline bool isShared() const { return (flags & SHARED) != 0; }
+    inline void setShared() { flags |= SHARED; }
+
+
+    // -- depth in the tree  ----------------------------
+
+    /// Depth of the node in its tree (0: root), maintained by OcTreeBaseImpl
+    /// in the upper bits of the flags, see OcTreeDataNode::storesDepth()
+    static bool storesDepth() { return true; }
+    inline unsigned int getStoredDepth() const { return flags >> DEPTH_SHIFT; }
+    inline void setStoredDepth(unsigned int depth) {
+      flags = (unsigned char) ((flags & ((1 << DEPTH_SHIFT) - 1)) | (depth << DEPTH_SHIFT));
+    }
+#else
+    // Built without node flags (OCTOMAP_NODE_FLAGS=OFF): every subtree counts as
+    // dirty, no node is shared (snapshots are not available) and the depth is not stored.
+    inline bool isDirty(unsigned char /*flags*/ = DIRTY_ALL) const { return true; }
+    inline void setDirty(unsigned char /*flags*/ = DIRTY_ALL) {}
+    inline void clearDirty(unsigned char /*flags*/ = DIRTY_ALL) {}
+    inline bool isShared() const { return false; }
+    inline void setShared() {}
+#endif
+
 
   protected:
     // "value" stores log odds occupancy probability
+
+#ifndef OCTOMAP_NO_NODE_FLAGS
+    enum { SHARED = 4, DEPTH_SHIFT = 3 };
+
+    /// The depth (upper 5 bits, up to 31 levels) and, in the spare low bits, the DirtyFlag
+    /// bits and SHARED. Fits into the padding after "value" on common ABIs, but not into
+    /// the one of derived nodes which fill it (OcTreeNodeStamped grows from 16 to 24 bytes).
+    unsigned char flags;
+#endif
   };
 
 } // end namespace
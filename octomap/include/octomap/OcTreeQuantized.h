@@ -0,0 +1,385 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_OCTREE_QUANTIZED_H
+#define OCTOMAP_OCTREE_QUANTIZED_H
+
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <bitset>
+
+#include "octomap_types.h"
+#include "octomap_utils.h"
+#include "OcTreeDataNode.h"
+#include "OcTreeBaseImpl.h"
+#include "AbstractOcTree.h"
+
+namespace octomap {
+
+  /**
+   * Occupancy node which stores its log-odds as a fixed-point integer of
+   * type T with FRAC_BITS fractional bits, i.e. in units of 1/2^FRAC_BITS.
+   * Values outside of the range of T saturate.
+   *
+   * With OCTOMAP_INDEXED_CHILDREN an OcTreeNodeQ16 takes 8 bytes: the 32 bit
+   * index of its children, the 16 bit value, the child mask and one byte of
+   * flags holding the depth. An 8 bit value would not make it smaller, as the
+   * node is padded to the alignment of the index.
+   *
+   * \tparam T signed integer type of the stored value
+   * \tparam FRAC_BITS number of fractional bits of the fixed-point log-odds
+   */
+  template <typename T, unsigned int FRAC_BITS>
+  class OcTreeNodeQuantized : public OcTreeDataNode<T> {
+  public:
+    OcTreeNodeQuantized()
+      : OcTreeDataNode<T>(0)
+#ifndef OCTOMAP_NO_NODE_FLAGS
+      , flags(0)
+#endif
+    {}
+
+    /// @return log-odds represented by one unit of the stored value
+    static float getQuantizationStep() { return 1.0f / (float) (1 << FRAC_BITS); }
+
+    /// @return log_odds rounded to the nearest representable value (saturating)
+    static T quantize(double log_odds) {
+      double q = floor(log_odds * (double) (1 << FRAC_BITS) + 0.5);
+      if (q > (double) std::numeric_limits<T>::max())
+        return std::numeric_limits<T>::max();
+      if (q < (double) std::numeric_limits<T>::min())
+        return std::numeric_limits<T>::min();
+      return (T) q;
+    }
+
+    /// @return log-odds of the fixed-point value q
+    static float dequantize(T q) { return (float) q * getQuantizationStep(); }
+
+    /// @return occupancy probability of node
+    inline double getOccupancy() const { return probability(getLogOdds()); }
+
+    /// @return log odds representation of occupancy probability of node
+    inline float getLogOdds() const { return dequantize(this->value); }
+    /// sets log odds occupancy of node (rounded to the quantization step)
+    inline void setLogOdds(float l) { this->value = quantize(l); }
+
+    /// @return maximum of children's fixed-point log-odds
+    T getMaxChildValue() const {
+      T max = std::numeric_limits<T>::min();
+      for (unsigned int i=0; i<8; i++) {
+        AbstractOcTreeNode* child = this->getChildPtr(i);
+        if (child != NULL) {
+          T v = static_cast<OcTreeNodeQuantized*>(child)->getValue();
+          if (v > max)
+            max = v;
+        }
+      }
+      return max;
+    }
+
+    /// update this node's occupancy according to its children's maximum occupancy
+    inline void updateOccupancyChildren() {
+      this->value = getMaxChildValue();  // conservative
+    }
+
+#ifndef OCTOMAP_NO_NODE_FLAGS
+    // -- depth in the tree  ----------------------------
+
+    /// Depth of the node in its tree (0: root), maintained by OcTreeBaseImpl,
+    /// see OcTreeDataNode::storesDepth()
+    static bool storesDepth() { return true; }
+    inline unsigned int getStoredDepth() const { return flags; }
+    inline void setStoredDepth(unsigned int depth) { flags = (unsigned char) depth; }
+
+  protected:
+    /// The depth of the node, fills the padding after "value" and the child mask
+    unsigned char flags;
+#endif
+  };
+
+  /// 16 bit log-odds in steps of 1/1024, range [-32, 32)
+  typedef OcTreeNodeQuantized<int16_t, 10> OcTreeNodeQ16;
+
+
+  /**
+   * Occupancy octree storing fixed-point log-odds in OcTreeNodeQuantized nodes.
+   * The sensor model (hit, miss, clamping and occupancy thresholds) is
+   * quantized once when it is set; updates of the nodes are then done in
+   * integer arithmetic. Apart from the rounding of the log-odds, updates
+   * behave like those of OccupancyOcTreeBase.
+   *
+   * The binary format (.bt, readBinary() / writeBinary()) is the
+   * maximum-likelihood format of OcTree, so files can be exchanged with
+   * all other occupancy trees.
+   *
+   * In the full format (.ot, AbstractOcTree::write() / read()) the data of
+   * every node is the stored fixed-point value, written as sizeof(T) bytes in
+   * host byte order like the payload of all other tree types. The id (see
+   * getTreeType()) determines T and the number of fractional bits.
+   *
+   * \note The nodes only get smaller than an OcTreeNode with the compact
+   * layout of OCTOMAP_INDEXED_CHILDREN (8 instead of 12 bytes). With the default
+   * pointer to the children array both take 16 bytes on 64 bit platforms.
+   */
+  template <class NODE>
+  class OcTreeQuantizedBase : public OcTreeBaseImpl<NODE,AbstractOcTree> {
+  public:
+    typedef typename NODE::DataType ValueType;
+
+    OcTreeQuantizedBase(double resolution);
+    virtual ~OcTreeQuantizedBase() {};
+
+    // -- occupancy queries
+
+    /// queries whether a node is occupied according to the tree's parameter for "occupancy"
+    inline bool isNodeOccupied(const NODE* occupancyNode) const {
+      return (occupancyNode->getValue() >= occ_prob_thres_q);
+    }
+    /// queries whether a node is occupied according to the tree's parameter for "occupancy"
+    inline bool isNodeOccupied(const NODE& occupancyNode) const {
+      return (occupancyNode.getValue() >= occ_prob_thres_q);
+    }
+    /// queries whether a node is at the clamping threshold according to the tree's parameter
+    inline bool isNodeAtThreshold(const NODE* occupancyNode) const {
+      return (occupancyNode->getValue() >= clamping_thres_max_q
+              || occupancyNode->getValue() <= clamping_thres_min_q);
+    }
+
+    // -- occupancy updates
+
+    /**
+     * Integrate occupancy measurement.
+     *
+     * @param key OcTreeKey of the NODE that is to be updated
+     * @param occupied true if the node was measured occupied, else false
+     * @param lazy_eval whether update of inner nodes is omitted after the update (default: false).
+     *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
+     * @return pointer to the updated NODE
+     */
+    NODE* updateNode(const OcTreeKey& key, bool occupied, bool lazy_eval = false);
+
+    /// Integrate occupancy measurement at a point, see updateNode(const OcTreeKey&, bool, bool)
+    NODE* updateNode(const point3d& value, bool occupied, bool lazy_eval = false);
+
+    /**
+     * Manipulate log_odds value of a voxel by changing it by log_odds_update
+     * (rounded to the quantization step).
+     *
+     * @param key OcTreeKey of the NODE that is to be updated
+     * @param log_odds_update value to be added (+) to log_odds value of node
+     * @param lazy_eval whether update of inner nodes is omitted after the update (default: false).
+     *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
+     * @return pointer to the updated NODE
+     */
+    NODE* updateNode(const OcTreeKey& key, float log_odds_update, bool lazy_eval = false);
+
+    /**
+     * Set log_odds value of a voxel to the given value (rounded to the quantization
+     * step and clamped to the thresholds).
+     *
+     * @param key OcTreeKey of the NODE that is to be updated
+     * @param log_odds_value value to be set as the log_odds value of the node
+     * @param lazy_eval whether update of inner nodes is omitted after the update (default: false).
+     *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
+     * @return pointer to the updated NODE
+     */
+    NODE* setNodeValue(const OcTreeKey& key, float log_odds_value, bool lazy_eval = false);
+
+    /**
+     * Integrate a Pointcloud (in global reference frame): all cells along the
+     * rays are updated as free, the endpoints as occupied. Endpoints have a
+     * preference over free cells.
+     *
+     * @param scan Pointcloud (measurement endpoints), in global reference frame
+     * @param sensor_origin measurement origin in global reference frame
+     * @param maxrange maximum range for how long individual beams are inserted (default -1: complete beam)
+     * @param lazy_eval whether update of inner nodes is omitted after the update (default: false).
+     *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
+     */
+    void insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin,
+                          double maxrange = -1., bool lazy_eval = false);
+
+    /**
+     * Updates the occupancy of all inner nodes to reflect their children's occupancy.
+     * If you performed batch-updates with lazy evaluation enabled, you must call this
+     * before any queries to ensure correct multi-resolution behavior.
+     **/
+    void updateInnerOccupancy();
+
+    /// Creates the maximum likelihood map by calling toMaxLikelihood on all tree nodes,
+    /// setting their occupancy to the corresponding occupancy thresholds.
+    void toMaxLikelihood();
+
+    //-- IO
+
+    /**
+     * Writes the tree to a binary file using writeBinary().
+     * The tree is first converted to the maximum likelihood estimate and pruned.
+     * @return success of operation
+     */
+    bool writeBinary(const std::string& filename);
+
+    /**
+     * Writes compressed maximum likelihood tree to a binary stream.
+     * The tree is first converted to the maximum likelihood estimate and pruned.
+     * @return success of operation
+     */
+    bool writeBinary(std::ostream &s);
+
+    /**
+     * Writes the maximum likelihood tree to a binary stream (const variant).
+     * The tree is not changed, in particular not pruned first.
+     * @return success of operation
+     */
+    bool writeBinaryConst(std::ostream &s) const;
+
+    /**
+     * Reads a binary tree (.bt) from a file, e.g. one written by an OcTree.
+     * Existing nodes of the tree are deleted before the tree is read.
+     * @return success of operation
+     */
+    bool readBinary(const std::string& filename);
+
+    /**
+     * Reads a binary tree (.bt) from an input stream.
+     * Existing nodes of the tree are deleted before the tree is read.
+     * @return success of operation
+     */
+    bool readBinary(std::istream &s);
+
+    //-- parameters for occupancy and sensor model:
+
+    /// sets the threshold for occupancy (sensor model)
+    void setOccupancyThres(double prob) { occ_prob_thres_q = NODE::quantize(logodds(prob)); }
+    /// sets the probability for a "hit" (will be converted to logodds) - sensor model
+    void setProbHit(double prob) { prob_hit_q = NODE::quantize(logodds(prob)); assert(prob_hit_q >= 0); }
+    /// sets the probability for a "miss" (will be converted to logodds) - sensor model
+    void setProbMiss(double prob) { prob_miss_q = NODE::quantize(logodds(prob)); assert(prob_miss_q <= 0); }
+    /// sets the minimum threshold for occupancy clamping (sensor model)
+    void setClampingThresMin(double thresProb) { clamping_thres_min_q = NODE::quantize(logodds(thresProb)); }
+    /// sets the maximum threshold for occupancy clamping (sensor model)
+    void setClampingThresMax(double thresProb) { clamping_thres_max_q = NODE::quantize(logodds(thresProb)); }
+
+    /// @return threshold (probability) for occupancy - sensor model
+    double getOccupancyThres() const { return probability(getOccupancyThresLog()); }
+    /// @return threshold (logodds, after quantization) for occupancy - sensor model
+    float getOccupancyThresLog() const { return NODE::dequantize(occ_prob_thres_q); }
+    /// @return probability for a "hit" in the sensor model (probability)
+    double getProbHit() const { return probability(getProbHitLog()); }
+    /// @return probability for a "hit" in the sensor model (logodds, after quantization)
+    float getProbHitLog() const { return NODE::dequantize(prob_hit_q); }
+    /// @return probability for a "miss" in the sensor model (probability)
+    double getProbMiss() const { return probability(getProbMissLog()); }
+    /// @return probability for a "miss" in the sensor model (logodds, after quantization)
+    float getProbMissLog() const { return NODE::dequantize(prob_miss_q); }
+    /// @return minimum threshold for occupancy clamping in the sensor model (probability)
+    double getClampingThresMin() const { return probability(getClampingThresMinLog()); }
+    /// @return minimum threshold for occupancy clamping in the sensor model (logodds, after quantization)
+    float getClampingThresMinLog() const { return NODE::dequantize(clamping_thres_min_q); }
+    /// @return maximum threshold for occupancy clamping in the sensor model (probability)
+    double getClampingThresMax() const { return probability(getClampingThresMaxLog()); }
+    /// @return maximum threshold for occupancy clamping in the sensor model (logodds, after quantization)
+    float getClampingThresMaxLog() const { return NODE::dequantize(clamping_thres_max_q); }
+
+  protected:
+    /// recursive call of updateNode() and setNodeValue(): adds update to the
+    /// leaf's value, or sets it to update if set_value is true
+    NODE* updateNodeRecurs(NODE* node, bool node_just_created, const OcTreeKey& key,
+                           unsigned int depth, int update, bool set_value, bool lazy_eval);
+
+    void updateInnerOccupancyRecurs(NODE* node, unsigned int depth);
+
+    void toMaxLikelihoodRecurs(NODE* node, unsigned int depth);
+
+    std::istream& readBinaryNode(std::istream &s, NODE* node);
+
+    std::ostream& writeBinaryNode(std::ostream &s, const NODE* node) const;
+
+    // occupancy parameters of tree, stored as fixed-point log-odds:
+    ValueType clamping_thres_min_q;
+    ValueType clamping_thres_max_q;
+    ValueType prob_hit_q;
+    ValueType prob_miss_q;
+    ValueType occ_prob_thres_q;
+  };
+
+
+  /**
+   * Occupancy octree with 16 bit fixed-point log-odds (steps of 1/1024).
+   * See OcTreeQuantizedBase for details.
+   */
+  class OcTreeQ16 : public OcTreeQuantizedBase<OcTreeNodeQ16> {
+  public:
+    /// Default constructor, sets resolution of leafs
+    OcTreeQ16(double resolution);
+
+    /// virtual constructor: creates a new object of same type
+    /// (Covariant return type requires an up-to-date compiler)
+    OcTreeQ16* create() const { return new OcTreeQ16(resolution); }
+
+    std::string getTreeType() const { return "OcTreeQ16"; }
+
+  protected:
+    /**
+     * Static member object which ensures that this OcTree's prototype
+     * ends up in the classIDMapping only once. You need this as a
+     * static member in any derived octree class in order to read .ot
+     * files through the AbstractOcTree factory. You should also call
+     * ensureLinking() once from the constructor.
+     */
+    class StaticMemberInitializer{
+    public:
+      StaticMemberInitializer() {
+        OcTreeQ16* tree = new OcTreeQ16(0.1);
+        tree->clearKeyRays();
+        AbstractOcTree::registerTreeType(tree);
+      }
+
+      /**
+       * Dummy function to ensure that MSVC does not drop the
+       * StaticMemberInitializer, causing this tree failing to register.
+       * Needs to be called from the constructor of this octree.
+       */
+      void ensureLinking() {};
+    };
+    /// static member to ensure static initialization (only once)
+    static StaticMemberInitializer ocTreeQ16MemberInit;
+  };
+
+} // end namespace
+
+#include "octomap/OcTreeQuantized.hxx"
+
+#endif
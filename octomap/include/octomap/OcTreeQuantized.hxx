@@ -0,0 +1,429 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <algorithm>
+
+namespace octomap {
+
+  template <class NODE>
+  OcTreeQuantizedBase<NODE>::OcTreeQuantizedBase(double in_resolution)
+    : OcTreeBaseImpl<NODE,AbstractOcTree>(in_resolution)
+  {
+    // same defaults as AbstractOccupancyOcTree:
+    setOccupancyThres(0.5);   // = 0.0 in logodds
+    setProbHit(0.7);          // = 0.85 in logodds
+    setProbMiss(0.4);         // = -0.4 in logodds
+
+    setClampingThresMin(0.1192); // = -2 in log odds
+    setClampingThresMax(0.971); // = 3.5 in log odds
+  }
+
+  template <class NODE>
+  NODE* OcTreeQuantizedBase<NODE>::updateNode(const OcTreeKey& key, bool occupied, bool lazy_eval) {
+    int update = occupied ? prob_hit_q : prob_miss_q;
+
+    // early abort (no change will happen), see OccupancyOcTreeBase::updateNode
+    NODE* leaf = this->search(key);
+    if (leaf
+        && ((update >= 0 && leaf->getValue() >= clamping_thres_max_q)
+        || ( update <= 0 && leaf->getValue() <= clamping_thres_min_q)))
+    {
+      return leaf;
+    }
+
+    bool createdRoot = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      createdRoot = true;
+    }
+
+    bool bounds_tracked = this->boundsTracked();
+    NODE* result = updateNodeRecurs(this->root, createdRoot, key, 0, update, false, lazy_eval);
+    if (bounds_tracked)
+      this->growBounds(key);
+    return result;
+  }
+
+  template <class NODE>
+  NODE* OcTreeQuantizedBase<NODE>::updateNode(const point3d& value, bool occupied, bool lazy_eval) {
+    OcTreeKey key;
+    if (!this->coordToKeyChecked(value, key))
+      return NULL;
+
+    return updateNode(key, occupied, lazy_eval);
+  }
+
+  template <class NODE>
+  NODE* OcTreeQuantizedBase<NODE>::updateNode(const OcTreeKey& key, float log_odds_update, bool lazy_eval) {
+    int update = NODE::quantize(log_odds_update);
+
+    NODE* leaf = this->search(key);
+    if (leaf
+        && ((update >= 0 && leaf->getValue() >= clamping_thres_max_q)
+        || ( update <= 0 && leaf->getValue() <= clamping_thres_min_q)))
+    {
+      return leaf;
+    }
+
+    bool createdRoot = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      createdRoot = true;
+    }
+
+    bool bounds_tracked = this->boundsTracked();
+    NODE* result = updateNodeRecurs(this->root, createdRoot, key, 0, update, false, lazy_eval);
+    if (bounds_tracked)
+      this->growBounds(key);
+    return result;
+  }
+
+  template <class NODE>
+  NODE* OcTreeQuantizedBase<NODE>::setNodeValue(const OcTreeKey& key, float log_odds_value, bool lazy_eval) {
+    bool createdRoot = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      createdRoot = true;
+    }
+
+    bool bounds_tracked = this->boundsTracked();
+    NODE* result = updateNodeRecurs(this->root, createdRoot, key, 0, NODE::quantize(log_odds_value), true, lazy_eval);
+    if (bounds_tracked)
+      this->growBounds(key);
+    return result;
+  }
+
+  template <class NODE>
+  NODE* OcTreeQuantizedBase<NODE>::updateNodeRecurs(NODE* node, bool node_just_created, const OcTreeKey& key,
+                                                    unsigned int depth, int update, bool set_value, bool lazy_eval) {
+    bool created_node = false;
+
+    assert(node);
+
+    // follow down to last level
+    if (depth < this->tree_depth) {
+      unsigned int pos = computeChildIdx(key, this->tree_depth -1 - depth);
+      if (!this->nodeChildExists(node, pos)) {
+        // child does not exist, but maybe it's a pruned node?
+        if (!this->nodeHasChildren(node) && !node_just_created ) {
+          // current node does not have children AND it is not a new node
+          // -> expand pruned node
+          this->expandNode(node);
+        }
+        else {
+          // not a pruned node, create requested child
+          this->createNodeChild(node, pos);
+          created_node = true;
+        }
+      }
+
+      if (lazy_eval)
+        return updateNodeRecurs(this->getNodeChild(node, pos), created_node, key, depth+1, update, set_value, lazy_eval);
+      else {
+        NODE* retval = updateNodeRecurs(this->getNodeChild(node, pos), created_node, key, depth+1, update, set_value, lazy_eval);
+        // prune node if possible, otherwise set own probability
+        if (this->pruneNode(node)){
+          // return pointer to current parent (pruned), the just updated node no longer exists
+          retval = node;
+        } else{
+          node->updateOccupancyChildren();
+        }
+
+        return retval;
+      }
+    }
+
+    // at last level, update node in integer arithmetic, end of recursion
+    else {
+      int value = set_value ? update : (int) node->getValue() + update;
+      value = std::min(std::max(value, (int) clamping_thres_min_q), (int) clamping_thres_max_q);
+      node->setValue((ValueType) value);
+      return node;
+    }
+  }
+
+  template <class NODE>
+  void OcTreeQuantizedBase<NODE>::insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin,
+                                                   double maxrange, bool lazy_eval) {
+    KeySet free_cells, occupied_cells;
+    KeyRay keyray;
+
+    for (int i = 0; i < (int)scan.size(); ++i) {
+      const point3d& p = scan[i];
+      if ((maxrange < 0.0) || ((p - sensor_origin).norm() <= maxrange) ) { // is not maxrange meas.
+        // free cells
+        if (this->computeRayKeys(sensor_origin, p, keyray))
+          free_cells.insert(keyray.begin(), keyray.end());
+        // occupied endpoint
+        OcTreeKey key;
+        if (this->coordToKeyChecked(p, key))
+          occupied_cells.insert(key);
+      } else { // user set a maxrange and length is above
+        point3d direction = (p - sensor_origin).normalized ();
+        point3d new_end = sensor_origin + direction * (float) maxrange;
+        if (this->computeRayKeys(sensor_origin, new_end, keyray))
+          free_cells.insert(keyray.begin(), keyray.end());
+      }
+    }
+
+    // insert data into tree, occupied endpoints have a preference over free cells
+    for (KeySet::iterator it = free_cells.begin(); it != free_cells.end(); ++it) {
+      if (occupied_cells.find(*it) == occupied_cells.end())
+        updateNode(*it, false, lazy_eval);
+    }
+    for (KeySet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it) {
+      updateNode(*it, true, lazy_eval);
+    }
+  }
+
+  template <class NODE>
+  void OcTreeQuantizedBase<NODE>::updateInnerOccupancy(){
+    if (this->root)
+      updateInnerOccupancyRecurs(this->root, 0);
+  }
+
+  template <class NODE>
+  void OcTreeQuantizedBase<NODE>::updateInnerOccupancyRecurs(NODE* node, unsigned int depth){
+    assert(node);
+
+    // only recurse and update for inner nodes:
+    if (this->nodeHasChildren(node)){
+      // return early for last level:
+      if (depth < this->tree_depth){
+        for (unsigned int i=0; i<8; i++) {
+          if (this->nodeChildExists(node, i)) {
+            updateInnerOccupancyRecurs(this->getNodeChild(node, i), depth+1);
+          }
+        }
+      }
+      node->updateOccupancyChildren();
+    }
+  }
+
+  template <class NODE>
+  void OcTreeQuantizedBase<NODE>::toMaxLikelihood() {
+    if (this->root)
+      toMaxLikelihoodRecurs(this->root, 0);
+  }
+
+  template <class NODE>
+  void OcTreeQuantizedBase<NODE>::toMaxLikelihoodRecurs(NODE* node, unsigned int depth) {
+    assert(node);
+
+    if (depth < this->tree_depth) {
+      for (unsigned int i=0; i<8; i++) {
+        if (this->nodeChildExists(node, i))
+          toMaxLikelihoodRecurs(this->getNodeChild(node, i), depth+1);
+      }
+    }
+    // the maximum of the children is preserved, so inner nodes stay consistent
+    node->setValue(isNodeOccupied(node) ? clamping_thres_max_q : clamping_thres_min_q);
+  }
+
+  template <class NODE>
+  bool OcTreeQuantizedBase<NODE>::writeBinary(const std::string& filename){
+    std::ofstream binary_outfile( filename.c_str(), std::ios_base::binary);
+
+    if (!binary_outfile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+    return writeBinary(binary_outfile);
+  }
+
+  template <class NODE>
+  bool OcTreeQuantizedBase<NODE>::writeBinary(std::ostream &s){
+    // convert to max likelihood first, this makes efficient pruning on binary data possible
+    this->toMaxLikelihood();
+    this->prune();
+    return writeBinaryConst(s);
+  }
+
+  template <class NODE>
+  bool OcTreeQuantizedBase<NODE>::writeBinaryConst(std::ostream &s) const{
+    // same header as AbstractOccupancyOcTree::writeBinaryConst
+    s << "# Octomap OcTree binary file" <<"\n# (feel free to add / change comments, but leave the first line as it is!)\n#\n";
+    s << "id " << this->getTreeType() << std::endl;
+    s << "size "<< this->size() << std::endl;
+    s << "res " << this->getResolution() << std::endl;
+#if OCTOMAP_TREE_DEPTH != 16
+    s << "depth " << OCTOMAP_TREE_DEPTH << std::endl;
+#endif
+    s << "data" << std::endl;
+
+    if (this->root)
+      writeBinaryNode(s, this->root);
+
+    if (s.good()){
+      OCTOMAP_DEBUG(" done.\n");
+      return true;
+    } else {
+      OCTOMAP_WARNING_STR("Output stream not \"good\" after writing tree");
+      return false;
+    }
+  }
+
+  template <class NODE>
+  bool OcTreeQuantizedBase<NODE>::readBinary(const std::string& filename){
+    std::ifstream binary_infile( filename.c_str(), std::ios_base::binary);
+    if (!binary_infile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing read.");
+      return false;
+    }
+    return readBinary(binary_infile);
+  }
+
+  template <class NODE>
+  bool OcTreeQuantizedBase<NODE>::readBinary(std::istream &s) {
+    if (!s.good()){
+      OCTOMAP_WARNING_STR("Input filestream not \"good\" in OcTreeQuantizedBase::readBinary");
+    }
+
+    // check if first line valid:
+    const std::string binary_file_header = "# Octomap OcTree binary file";
+    std::string line;
+    std::getline(s, line);
+    if (line.compare(0, binary_file_header.length(), binary_file_header) != 0){
+      OCTOMAP_ERROR_STR("First line of OcTree file header does not start with \""<< binary_file_header <<"\"");
+      return false;
+    }
+
+    std::string id;
+    unsigned size;
+    double res;
+    if (!AbstractOcTree::readHeader(s, id, size, res))
+      return false;
+    OCTOMAP_DEBUG_STR("Reading binary octree type "<< id);
+
+    this->clear();
+    this->setResolution(res);
+
+    if (size > 0) {
+      this->root = this->allocNode();
+      readBinaryNode(s, this->root);
+      if (this->nodeHasChildren(this->root))
+        this->root->updateOccupancyChildren();
+      this->size_changed = true;
+      this->tree_size = this->calcNumNodes();
+    }
+
+    if (size != this->size()){
+      OCTOMAP_ERROR("Tree size mismatch: # read nodes (%zu) != # expected nodes (%d)\n",this->size(), size);
+      return false;
+    }
+
+    return true;
+  }
+
+  template <class NODE>
+  std::istream& OcTreeQuantizedBase<NODE>::readBinaryNode(std::istream &s, NODE* node){
+    assert(node);
+
+    char child1to4_char;
+    char child5to8_char;
+    s.read((char*)&child1to4_char, sizeof(char));
+    s.read((char*)&child5to8_char, sizeof(char));
+
+    std::bitset<16> children ((unsigned long long) (unsigned char) child1to4_char
+                              | ((unsigned long long) (unsigned char) child5to8_char << 8));
+
+    // 2 bits per child, see writeBinaryNode()
+    for (unsigned int i=0; i<8; i++) {
+      bool bit0 = children[i*2];
+      bool bit1 = children[i*2+1];
+      if (bit0 || bit1) {
+        NODE* child = this->createNodeChild(node, i);
+        // inner nodes get their value from their children below
+        child->setValue((bit1 && !bit0) ? clamping_thres_max_q : clamping_thres_min_q);
+      }
+    }
+
+    // read children's children and set the label
+    for (unsigned int i=0; i<8; i++) {
+      if (children[i*2] && children[i*2+1]) {
+        NODE* child = this->getNodeChild(node, i);
+        readBinaryNode(s, child);
+        child->updateOccupancyChildren();
+      }
+    }
+
+    return s;
+  }
+
+  template <class NODE>
+  std::ostream& OcTreeQuantizedBase<NODE>::writeBinaryNode(std::ostream &s, const NODE* node) const{
+    assert(node);
+
+    // 2 bits for each children, 8 children per node -> 16 bits
+    // 10 : child is free node
+    // 01 : child is occupied node
+    // 00 : child is unkown node
+    // 11 : child has children
+    std::bitset<8> child1to4;
+    std::bitset<8> child5to8;
+
+    for (unsigned int i=0; i<8; i++) {
+      std::bitset<8>& bits = (i < 4) ? child1to4 : child5to8;
+      unsigned int b = (i % 4) * 2;
+      if (this->nodeChildExists(node, i)) {
+        const NODE* child = this->getNodeChild(node, i);
+        if      (this->nodeHasChildren(child)) { bits[b] = 1; bits[b+1] = 1; }
+        else if (isNodeOccupied(child))        { bits[b] = 0; bits[b+1] = 1; }
+        else                                   { bits[b] = 1; bits[b+1] = 0; }
+      }
+    }
+
+    char child1to4_char = (char) child1to4.to_ulong();
+    char child5to8_char = (char) child5to8.to_ulong();
+
+    s.write((char*)&child1to4_char, sizeof(char));
+    s.write((char*)&child5to8_char, sizeof(char));
+
+    // write children's children
+    for (unsigned int i=0; i<8; i++) {
+      if (this->nodeChildExists(node, i)) {
+        const NODE* child = this->getNodeChild(node, i);
+        if (this->nodeHasChildren(child)) {
+          writeBinaryNode(s, child);
+        }
+      }
+    }
+
+    return s;
+  }
+
+} // namespace
@@ -0,0 +1,190 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_OCTREE_RAY_CAST_H
+#define OCTOMAP_OCTREE_RAY_CAST_H
+
+#include <limits>
+#include <math.h>
+
+#include "octomap_types.h"
+#include "OcTreeKey.h"
+
+namespace octomap {
+
+  /**
+   * Node lookup of castRayDDA() by search() and isNodeOccupied() of the tree.
+   * Any other lookup functor needs the same operator().
+   */
+  template <class TREE>
+  class OccupancyRayLookup {
+  public:
+    explicit OccupancyRayLookup(const TREE& tree) : tree(tree) {}
+
+    /// @return false if key is in unknown space, otherwise sets occupied for its node
+    inline bool operator()(const OcTreeKey& key, bool& occupied) const {
+      const typename TREE::NodeType* node = tree.search(key);
+      if (!node)
+        return false;
+      occupied = tree.isNodeOccupied(node);
+      return true;
+    }
+
+  protected:
+    const TREE& tree;
+  };
+
+  /**
+   * 3D-DDA of castRay() for any tree type, see OccupancyOcTreeBase::castRay() for the
+   * parameters and the result. The tree only provides the key conversion
+   * (coordToKeyChecked(), keyToCoord(), getResolution() and getTreeDepth()),
+   * the nodes are looked up with lookup(key, occupied), see OccupancyRayLookup.
+   */
+  template <class TREE, class LOOKUP>
+  bool castRayDDA(const TREE& tree, const LOOKUP& lookup, const point3d& origin, const point3d& directionP,
+                  point3d& end, bool ignoreUnknown, double maxRange) {
+
+    // Initialization phase -------------------------------------------------------
+    OcTreeKey current_key;
+    if ( !tree.coordToKeyChecked(origin, current_key) ) {
+      OCTOMAP_WARNING_STR("Coordinates out of bounds during ray casting");
+      return false;
+    }
+
+    bool occupied = false;
+    if (lookup(current_key, occupied)){
+      if (occupied){
+        // Occupied node found at origin
+        // (need to convert from key, since origin does not need to be a voxel center)
+        end = tree.keyToCoord(current_key);
+        return true;
+      }
+    } else if(!ignoreUnknown){
+      end = tree.keyToCoord(current_key);
+      return false;
+    }
+
+    point3d direction = directionP.normalized();
+    bool max_range_set = (maxRange > 0.0);
+    const double resolution = tree.getResolution();
+    const unsigned int max_key = 2 * (1u << (tree.getTreeDepth() - 1)) - 1;
+
+    int step[3];
+    double tMax[3];
+    double tDelta[3];
+
+    for(unsigned int i=0; i < 3; ++i) {
+      // compute step direction
+      if (direction(i) > 0.0) step[i] =  1;
+      else if (direction(i) < 0.0)   step[i] = -1;
+      else step[i] = 0;
+
+      // compute tMax, tDelta
+      if (step[i] != 0) {
+        // corner point of voxel (in direction of ray)
+        double voxelBorder = tree.keyToCoord(current_key[i]);
+        voxelBorder += double(step[i] * resolution * 0.5);
+
+        tMax[i] = ( voxelBorder - origin(i) ) / direction(i);
+        tDelta[i] = resolution / fabs( direction(i) );
+      }
+      else {
+        tMax[i] =  std::numeric_limits<double>::max();
+        tDelta[i] = std::numeric_limits<double>::max();
+      }
+    }
+
+    if (step[0] == 0 && step[1] == 0 && step[2] == 0){
+      OCTOMAP_ERROR("Raycasting in direction (0,0,0) is not possible!");
+      return false;
+    }
+
+    // for speedup:
+    double maxrange_sq = maxRange *maxRange;
+
+    // Incremental phase  ---------------------------------------------------------
+
+    while (true) {
+      unsigned int dim;
+
+      // find minimum tMax:
+      if (tMax[0] < tMax[1]){
+        if (tMax[0] < tMax[2]) dim = 0;
+        else                   dim = 2;
+      }
+      else {
+        if (tMax[1] < tMax[2]) dim = 1;
+        else                   dim = 2;
+      }
+
+      // check for overflow:
+      if ((step[dim] < 0 && current_key[dim] == 0)
+          || (step[dim] > 0 && current_key[dim] == max_key))
+      {
+        OCTOMAP_WARNING("Coordinate hit bounds in dim %d, aborting raycast\n", dim);
+        // return border point nevertheless:
+        end = tree.keyToCoord(current_key);
+        return false;
+      }
+
+      // advance in direction "dim"
+      current_key[dim] += step[dim];
+      tMax[dim] += tDelta[dim];
+
+      // generate world coords from key
+      end = tree.keyToCoord(current_key);
+
+      // check for maxrange:
+      if (max_range_set){
+        double dist_from_origin_sq(0.0);
+        for (unsigned int j = 0; j < 3; j++) {
+          dist_from_origin_sq += ((end(j) - origin(j)) * (end(j) - origin(j)));
+        }
+        if (dist_from_origin_sq > maxrange_sq)
+          return false;
+      }
+
+      if (lookup(current_key, occupied)){
+        if (occupied)
+          return true;
+        // otherwise: node is free and valid, raycasting continues
+      } else if (!ignoreUnknown){ // no node found, this usually means we are in "unknown" areas
+        return false;
+      }
+    } // end while
+  }
+
+} // namespace
+
+#endif
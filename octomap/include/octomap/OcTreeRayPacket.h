@@ -0,0 +1,79 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_OCTREE_RAY_PACKET_H
+#define OCTOMAP_OCTREE_RAY_PACKET_H
+
+#include "OcTreeKey.h"
+
+namespace octomap {
+
+  /**
+   * Rays in the incremental phase of the 3D-DDA of OcTreeBaseImpl::computeRayKeys(),
+   * stored per dimension so that several rays can be traversed at once with SIMD
+   * instructions. Filled by OcTreeBaseImpl::computeRaysKeys(), see traverseRayPacket().
+   */
+  struct RayPacket {
+    enum { MAX_RAYS = 8 };
+
+    RayPacket() : num_rays(0) {}
+
+    unsigned int num_rays;
+    KeyRay* rays[MAX_RAYS];        ///< output, already containing the origin key
+    bool* valid[MAX_RAYS];         ///< output, set to false if a ray does not fit into its KeyRay
+    int key[3][MAX_RAYS];          ///< current key (of the origin)
+    int key_end[3][MAX_RAYS];
+    int step[3][MAX_RAYS];
+    double t_max[3][MAX_RAYS];
+    double t_delta[3][MAX_RAYS];
+    double length[MAX_RAYS];
+  };
+
+  /// Instruction sets for traverseRayPacket()
+  enum RaySIMD { RAY_SIMD_NONE = 0, RAY_SIMD_SSE41 = 1, RAY_SIMD_AVX2 = 2 };
+
+  /// @return the best instruction set for ray traversal supported by this CPU (detected at runtime)
+  RaySIMD detectRaySIMD();
+
+  /**
+   * Continues the DDA of all rays in the packet until they reach their end keys (or length),
+   * adding the keys on the way. The result is identical to the loop in computeRayKeys() for any
+   * instruction set, vectorized versions traverse four rays at a time. A ray which reaches
+   * KeyRay::sizeMax() is stopped there and marked invalid (*packet.valid[r] = false).
+   * @param simd best instruction set to use, limited to detectRaySIMD()
+   */
+  void traverseRayPacket(RayPacket& packet, RaySIMD simd = RAY_SIMD_AVX2);
+
+} // namespace
+
+#endif
@@ -81,6 +81,15 @@ namespace octomap {
     /// Default constructor, sets resolution of leafs
 	  OcTreeStamped(double resolution);
 
+    /// Deep copy constructor
+    OcTreeStamped(const OcTreeStamped& rhs) : OccupancyOcTreeBase<OcTreeNodeStamped>(rhs) {}
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Move constructor, takes over the tree of rhs in O(1)
+    OcTreeStamped(OcTreeStamped&& rhs) : OccupancyOcTreeBase<OcTreeNodeStamped>(std::move(rhs)) {}
+    OcTreeStamped& operator=(OcTreeStamped&& rhs) { swap(rhs); return *this; }
+#endif
+
     /// virtual constructor: creates a new object of same type
     /// (Covariant return type requires an up-to-date compiler)
     OcTreeStamped* create() const {return new OcTreeStamped(resolution); }
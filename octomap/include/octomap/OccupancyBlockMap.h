@@ -0,0 +1,375 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OCTOMAP_OCCUPANCY_BLOCK_MAP_H
+#define OCTOMAP_OCCUPANCY_BLOCK_MAP_H
+
+#include <deque>
+#include <string>
+#include <iterator>
+
+#include "octomap_types.h"
+#include "octomap_utils.h"
+#include "OcTreeKey.h"
+#include "Pointcloud.h"
+#include "OccupancyOcTreeBase.h"
+
+namespace octomap {
+
+  /**
+   * Voxel of an OccupancyBlockMap, only stores the log-odds occupancy.
+   * Provides the same occupancy accessors as OcTreeNode.
+   */
+  class OccupancyBlockMapVoxel {
+  public:
+    /// @return occupancy probability of voxel
+    inline double getOccupancy() const { return probability(log_odds); }
+    /// @return log odds representation of occupancy probability of voxel
+    inline float getLogOdds() const { return log_odds; }
+    inline float getValue() const { return log_odds; }
+    /// sets log odds occupancy of voxel
+    inline void setLogOdds(float l) { log_odds = l; }
+
+    float log_odds;
+  };
+
+
+  /**
+   * Occupancy map at the finest resolution, stored as dense blocks of 8x8x8
+   * voxels which are addressed through a hash table of block keys (voxel hashing).
+   * Accessing a voxel costs one hash lookup instead of a descent through all
+   * levels of an octree, and the voxels of a block are contiguous in memory so
+   * that operations on whole blocks (e.g. toMaxLikelihood()) vectorize.
+   * There are no inner nodes and no pruning, which makes the map suited for
+   * local, frequently updated maps of limited extent.
+   *
+   * The map uses the same key space, parameters and update semantics as
+   * OccupancyOcTreeBase: updateNode(), setNodeValue(), insertPointCloud(),
+   * search(), castRay() and leaf iteration yield the same values as an OcTree
+   * of the same resolution. Use exportTo() to convert the map into an octree
+   * (e.g. for storage, writeBinary() writes a .bt file of the map this way),
+   * and the constructor from an OccupancyOcTreeBase to convert back.
+   */
+  class OccupancyBlockMap {
+  public:
+    typedef OccupancyBlockMapVoxel NodeType;
+
+    /// number of voxels along each axis of a block (2^BLOCK_SHIFT)
+    enum { BLOCK_SHIFT = 3, BLOCK_WIDTH = 1 << BLOCK_SHIFT, BLOCK_VOXELS = BLOCK_WIDTH * BLOCK_WIDTH * BLOCK_WIDTH };
+
+    /// Dense block of voxels, the bits in "known" mark the voxels which have been observed
+    struct Block {
+      OcTreeKey key; ///< block key, the voxel keys shifted right by BLOCK_SHIFT
+      unsigned int num_known;
+      uint64_t known[BLOCK_VOXELS / 64];
+      OccupancyBlockMapVoxel voxels[BLOCK_VOXELS];
+
+      inline bool isKnown(unsigned int idx) const { return ((known[idx >> 6] >> (idx & 63)) & 1) != 0; }
+    };
+
+    /// Creates an empty map
+    OccupancyBlockMap(double resolution);
+
+    /// Creates a map of all leaves of tree, which are expanded to the finest
+    /// resolution. Also takes over the occupancy parameters of tree.
+    template <class NODE>
+    OccupancyBlockMap(const OccupancyOcTreeBase<NODE>& tree);
+
+    std::string getTreeType() const {return "OccupancyBlockMap";}
+
+    inline double getResolution() const { return resolution; }
+    inline unsigned int getTreeDepth () const { return tree_depth; }
+
+    /// @return number of known voxels
+    inline size_t size() const { return num_voxels; }
+    /// @return number of allocated blocks
+    inline size_t getNumBlocks() const { return blocks.size(); }
+    /// @return memory usage of the map in bytes
+    size_t memoryUsage() const;
+
+    /// Deletes all voxels and blocks
+    void clear();
+
+    // -- Parameters for occupancy and sensor model, see AbstractOccupancyOcTree
+
+    void setOccupancyThres(double prob){occ_prob_thres_log = logodds(prob); }
+    void setProbHit(double prob){prob_hit_log = logodds(prob); assert(prob_hit_log >= 0.0);}
+    void setProbMiss(double prob){prob_miss_log = logodds(prob); assert(prob_miss_log <= 0.0);}
+    void setClampingThresMin(double thresProb){clamping_thres_min = logodds(thresProb); }
+    void setClampingThresMax(double thresProb){clamping_thres_max = logodds(thresProb); }
+
+    double getOccupancyThres() const {return probability(occ_prob_thres_log); }
+    float getOccupancyThresLog() const {return occ_prob_thres_log; }
+    double getProbHit() const {return probability(prob_hit_log); }
+    float getProbHitLog() const {return prob_hit_log; }
+    double getProbMiss() const {return probability(prob_miss_log); }
+    float getProbMissLog() const {return prob_miss_log; }
+    double getClampingThresMin() const {return probability(clamping_thres_min); }
+    float getClampingThresMinLog() const {return clamping_thres_min; }
+    double getClampingThresMax() const {return probability(clamping_thres_max); }
+    float getClampingThresMaxLog() const {return clamping_thres_max; }
+
+    /// queries whether a voxel is occupied according to the map's parameter for "occupancy"
+    inline bool isNodeOccupied(const OccupancyBlockMapVoxel* voxel) const{
+      return (voxel->getLogOdds() >= this->occ_prob_thres_log);
+    }
+    /// queries whether a voxel is occupied according to the map's parameter for "occupancy"
+    inline bool isNodeOccupied(const OccupancyBlockMapVoxel& voxel) const{
+      return (voxel.getLogOdds() >= this->occ_prob_thres_log);
+    }
+    /// queries whether a voxel is at the clamping threshold according to the map's parameter
+    inline bool isNodeAtThreshold(const OccupancyBlockMapVoxel* voxel) const{
+      return (voxel->getLogOdds() >= this->clamping_thres_max
+              || voxel->getLogOdds() <= this->clamping_thres_min);
+    }
+
+    /**
+     *  Search the voxel of a key or 3d point.
+     *  You need to check if the returned voxel is NULL, since it can be in unknown space.
+     *  @return pointer to voxel if found, NULL otherwise
+     */
+    const OccupancyBlockMapVoxel* search(const OcTreeKey& key) const;
+    const OccupancyBlockMapVoxel* search(const point3d& value) const;
+    const OccupancyBlockMapVoxel* search(double x, double y, double z) const;
+
+    /**
+     * Integrate occupancy measurement, same as OccupancyOcTreeBase::updateNode().
+     * Unknown voxels start at log-odds 0, the result is clamped to the clamping thresholds.
+     *
+     * @param key OcTreeKey of the voxel that is to be updated
+     * @param log_odds_update value to be added (+) to log_odds value of voxel
+     * @return pointer to the updated voxel, NULL if the coordinates are out of bounds
+     */
+    OccupancyBlockMapVoxel* updateNode(const OcTreeKey& key, float log_odds_update);
+    OccupancyBlockMapVoxel* updateNode(const point3d& value, float log_odds_update);
+    OccupancyBlockMapVoxel* updateNode(double x, double y, double z, float log_odds_update);
+    /// Integrate a hit (occupied = true) or miss with the sensor model of the map
+    OccupancyBlockMapVoxel* updateNode(const OcTreeKey& key, bool occupied);
+    OccupancyBlockMapVoxel* updateNode(const point3d& value, bool occupied);
+    OccupancyBlockMapVoxel* updateNode(double x, double y, double z, bool occupied);
+
+    /// Set log-odds value of a voxel (clamped to the clamping thresholds),
+    /// same as OccupancyOcTreeBase::setNodeValue()
+    OccupancyBlockMapVoxel* setNodeValue(const OcTreeKey& key, float log_odds_value);
+    OccupancyBlockMapVoxel* setNodeValue(const point3d& value, float log_odds_value);
+    OccupancyBlockMapVoxel* setNodeValue(double x, double y, double z, float log_odds_value);
+
+    /**
+     * Integrate a Pointcloud (in global reference frame), same as
+     * OccupancyOcTreeBase::insertPointCloud(): the voxels along the rays are
+     * updated as free, the voxels of the endpoints as occupied, each voxel at
+     * most once per scan.
+     *
+     * @param scan Pointcloud (measurement endpoints), in global reference frame
+     * @param sensor_origin measurement origin in global reference frame
+     * @param maxrange maximum range for how long individual beams are inserted (default -1: complete beam)
+     * @param discretize whether the scan is discretized first into voxel centers, see
+     *   OccupancyOcTreeBase::computeDiscreteUpdate()
+     */
+    void insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin,
+                          double maxrange=-1., bool discretize = false);
+
+    /// Integrate a Pointcloud in the sensor frame, which is transformed into
+    /// the global frame with frame_origin first
+    void insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin, const pose6d& frame_origin,
+                          double maxrange=-1., bool discretize = false);
+
+    /**
+     * Performs raycasting in 3d, same as OccupancyOcTreeBase::castRay().
+     * A ray is cast from 'origin' with a given direction, the first non-free
+     * cell is returned in 'end' (as center coordinate). This could also be
+     * the origin voxel if it is occupied or unknown.
+     *
+     * @return true if an occupied cell was hit, false if the maximum range or
+     *   map bounds are reached, or if an unknown voxel was hit.
+     */
+    bool castRay(const point3d& origin, const point3d& direction, point3d& end,
+                 bool ignoreUnknownCells=false, double maxRange=-1.0) const;
+
+    /// Traces a ray from origin to end (excluding), see OcTreeBaseImpl::computeRayKeys()
+    bool computeRayKeys(const point3d& origin, const point3d& end, KeyRay& ray) const;
+
+    /// Sets all voxels to their maximum likelihood value (clamping thresholds)
+    void toMaxLikelihood();
+
+    /**
+     * Writes all voxels into tree, which needs to have the same resolution.
+     * Existing nodes of tree at the voxels are overwritten. Inner nodes
+     * are updated and the tree is pruned afterwards.
+     */
+    template <class NODE>
+    void exportTo(OccupancyOcTreeBase<NODE>& tree) const;
+
+    /// Writes the map as OcTree to a binary (.bt) file, see AbstractOccupancyOcTree::writeBinary()
+    bool writeBinary(const std::string& filename) const;
+    /// Writes the map as OcTree to a binary (.bt) stream, see AbstractOccupancyOcTree::writeBinary()
+    bool writeBinary(std::ostream &s) const;
+
+    // -- Key / coordinate conversion, see OcTreeBaseImpl
+
+    inline key_type coordToKey(double coordinate) const{
+      return ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+    }
+    inline OcTreeKey coordToKey(const point3d& coord) const{
+      return OcTreeKey(coordToKey(coord(0)), coordToKey(coord(1)), coordToKey(coord(2)));
+    }
+    bool coordToKeyChecked(double coordinate, key_type& key) const;
+    bool coordToKeyChecked(const point3d& coord, OcTreeKey& key) const;
+    bool coordToKeyChecked(double x, double y, double z, OcTreeKey& key) const;
+
+    inline double keyToCoord(key_type key) const{
+      return (double( (int) key - (int) this->tree_max_val ) +0.5) * this->resolution;
+    }
+    inline point3d keyToCoord(const OcTreeKey& key) const{
+      return point3d(float(keyToCoord(key[0])), float(keyToCoord(key[1])), float(keyToCoord(key[2])));
+    }
+
+    /// @return key of the block containing the voxel key
+    static inline OcTreeKey blockKey(const OcTreeKey& key){
+      return OcTreeKey(key[0] >> BLOCK_SHIFT, key[1] >> BLOCK_SHIFT, key[2] >> BLOCK_SHIFT);
+    }
+    /// @return index of the voxel key within its block
+    static inline unsigned int voxelIndex(const OcTreeKey& key){
+      const unsigned int mask = BLOCK_WIDTH - 1;
+      return (key[0] & mask) | ((key[1] & mask) << BLOCK_SHIFT) | ((key[2] & mask) << (2 * BLOCK_SHIFT));
+    }
+    /// @return key of the voxel with index idx in the block with block_key
+    static inline OcTreeKey voxelKey(const OcTreeKey& block_key, unsigned int idx){
+      const unsigned int mask = BLOCK_WIDTH - 1;
+      return OcTreeKey(key_type((block_key[0] << BLOCK_SHIFT) | (idx & mask)),
+                       key_type((block_key[1] << BLOCK_SHIFT) | ((idx >> BLOCK_SHIFT) & mask)),
+                       key_type((block_key[2] << BLOCK_SHIFT) | (idx >> (2 * BLOCK_SHIFT))));
+    }
+
+    /**
+     * Iterator over all known voxels, in block order. The interface matches
+     * OcTreeBaseImpl::leaf_iterator, all leaves are at the full tree depth.
+     */
+    class leaf_iterator : public std::iterator<std::forward_iterator_tag, const OccupancyBlockMapVoxel>{
+    public:
+      /// Default ctor, only used for the end-iterator
+      leaf_iterator() : map(NULL), block(0), idx(0){}
+      leaf_iterator(const OccupancyBlockMap* pmap);
+
+      bool operator==(const leaf_iterator& other) const {
+        return (map == other.map && block == other.block && idx == other.idx);
+      }
+      bool operator!=(const leaf_iterator& other) const {
+        return !(*this == other);
+      }
+
+      leaf_iterator operator++(int){
+        leaf_iterator result = *this;
+        ++(*this);
+        return result;
+      }
+      leaf_iterator& operator++(){
+        ++idx;
+        skipUnknown();
+        return *this;
+      }
+
+      const OccupancyBlockMapVoxel* operator->() const { return &map->blocks[block].voxels[idx];}
+      const OccupancyBlockMapVoxel& operator*() const { return map->blocks[block].voxels[idx];}
+
+      /// return the center coordinate of the current voxel
+      point3d getCoordinate() const { return map->keyToCoord(getKey()); }
+      double getX() const{ return map->keyToCoord(getKey()[0]); }
+      double getY() const{ return map->keyToCoord(getKey()[1]); }
+      double getZ() const{ return map->keyToCoord(getKey()[2]); }
+      /// @return the side of the volume occupied by the current voxel
+      double getSize() const {return map->resolution; }
+      /// return depth of the current voxel (always the tree depth)
+      unsigned getDepth() const {return map->tree_depth; }
+      /// @return the OcTreeKey of the current voxel
+      OcTreeKey getKey() const { return voxelKey(map->blocks[block].key, idx); }
+
+    protected:
+      /// advances to the next known voxel, starting at the current position.
+      /// Becomes the end-iterator after the last voxel.
+      void skipUnknown();
+
+      const OccupancyBlockMap* map;
+      size_t block;
+      unsigned int idx;
+    };
+
+    leaf_iterator begin_leafs() const {return leaf_iterator(this);}
+    leaf_iterator end_leafs() const {return leaf_iterator();}
+
+    /// @return all blocks of the map, e.g. for processing them in parallel
+    const std::deque<Block>& getBlocks() const { return blocks; }
+
+  protected:
+    void init(double resolution, unsigned int tree_depth);
+
+    /// @return the block with the block key, NULL if it does not exist
+    const Block* findBlock(const OcTreeKey& block_key) const;
+    /// @return the block with the block key, which is created if it does not exist
+    Block* getOrCreateBlock(const OcTreeKey& block_key);
+
+    /// @return voxel of key, marked as known (initialized with log-odds 0 if it was unknown)
+    OccupancyBlockMapVoxel* touchVoxel(const OcTreeKey& key);
+    /// @return voxel idx of block, marked as known (initialized with log-odds 0 if it was unknown)
+    OccupancyBlockMapVoxel* touchVoxel(Block* block, unsigned int idx);
+
+    /// Computes the free and occupied voxels of a scan, see OccupancyOcTreeBase::computeUpdate()
+    void computeUpdate(const Pointcloud& scan, const point3d& origin,
+                       KeyFlatSet& free_cells, KeyFlatSet& occupied_cells, double maxrange);
+
+    std::deque<Block> blocks;       ///< deque: pointers to voxels stay valid when blocks are added
+    KeyFlatMap<size_t> block_index; ///< block key -> index in blocks
+    size_t num_voxels;
+
+    unsigned int tree_depth;
+    unsigned int tree_max_val;
+    double resolution;  ///< in meters
+    double resolution_factor; ///< = 1. / resolution
+
+    float clamping_thres_min;
+    float clamping_thres_max;
+    float prob_hit_log;
+    float prob_miss_log;
+    float occ_prob_thres_log;
+
+    /// buffers of insertPointCloud, kept to reuse their memory for the next scan
+    KeyFlatSet scan_free_cells;
+    KeyFlatSet scan_occupied_cells;
+    KeyRay keyray;
+  };
+
+} // end namespace
+
+#include "octomap/OccupancyBlockMap.hxx"
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+namespace octomap {
+
+  template <class NODE>
+  OccupancyBlockMap::OccupancyBlockMap(const OccupancyOcTreeBase<NODE>& tree)
+    : num_voxels(0)
+  {
+    init(tree.getResolution(), tree.getTreeDepth());
+    occ_prob_thres_log = tree.getOccupancyThresLog();
+    prob_hit_log = tree.getProbHitLog();
+    prob_miss_log = tree.getProbMissLog();
+    clamping_thres_min = tree.getClampingThresMinLog();
+    clamping_thres_max = tree.getClampingThresMaxLog();
+
+    for (typename OccupancyOcTreeBase<NODE>::leaf_iterator it = tree.begin_leafs(),
+         end = tree.end_leafs(); it != end; ++it)
+    {
+      const float log_odds = it->getLogOdds();
+      const OcTreeKey& leaf_key = it.getKey();
+      if (it.getDepth() == tree_depth){
+        touchVoxel(leaf_key)->setLogOdds(log_odds);
+        continue;
+      }
+
+      // pruned leaf: expand into all voxels of its volume
+      const unsigned int width = 1 << (tree_depth - it.getDepth());
+      OcTreeKey min_key;
+      for (unsigned int i = 0; i < 3; ++i)
+        min_key[i] = key_type(leaf_key[i] & ~(width - 1));
+
+      OcTreeKey key;
+      for (unsigned int dz = 0; dz < width; ++dz){
+        key[2] = key_type(min_key[2] + dz);
+        for (unsigned int dy = 0; dy < width; ++dy){
+          key[1] = key_type(min_key[1] + dy);
+          for (unsigned int dx = 0; dx < width; ++dx){
+            key[0] = key_type(min_key[0] + dx);
+            touchVoxel(key)->setLogOdds(log_odds);
+          }
+        }
+      }
+    }
+  }
+
+  template <class NODE>
+  void OccupancyBlockMap::exportTo(OccupancyOcTreeBase<NODE>& tree) const {
+    if (tree.getResolution() != resolution || tree.getTreeDepth() != tree_depth){
+      OCTOMAP_ERROR("Cannot export block map with resolution %f into tree with resolution %f\n",
+                    resolution, tree.getResolution());
+      return;
+    }
+
+    for (std::deque<Block>::const_iterator block = blocks.begin(); block != blocks.end(); ++block){
+      if (block->num_known == 0)
+        continue;
+      for (unsigned int idx = 0; idx < BLOCK_VOXELS; ++idx){
+        if (block->isKnown(idx))
+          tree.setNodeValue(voxelKey(block->key, idx), block->voxels[idx].getLogOdds(), true);
+      }
+    }
+
+    tree.updateInnerOccupancy();
+    tree.prune();
+  }
+
+} // end namespace
@@ -42,7 +42,10 @@
 #include "octomap_types.h"
 #include "octomap_utils.h"
 #include "OcTreeBaseImpl.h"
+#include "OcTreeRayCast.h"
 #include "AbstractOccupancyOcTree.h"
+#include "OcTreeSnapshotRecord.h"
+#include "DepthImagePyramid.h"
 
 
 namespace octomap {
@@ -54,7 +57,7 @@ namespace octomap {
    * Each class used as NODE type needs to be derived from
    * OccupancyOcTreeNode.
    *
-   * This tree implementation has a maximum depth of 16. 
+   * This tree implementation has a maximum depth of 16 by default (see OCTOMAP_TREE_DEPTH).
    * At a resolution of 1 cm, values have to be < +/- 327.68 meters (2^15)
    *
    * This limitation enables the use of an efficient key generation 
@@ -76,6 +79,21 @@ namespace octomap {
     /// Copy constructor
     OccupancyOcTreeBase(const OccupancyOcTreeBase<NODE>& rhs);
 
+    /// Swap the complete contents and all parameters (sensor model, bounding box,
+    /// change detection, ...) with another tree of the same depth in O(1)
+    void swap(OccupancyOcTreeBase<NODE>& other);
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Move constructor, takes over the tree and parameters of rhs in O(1)
+    OccupancyOcTreeBase(OccupancyOcTreeBase<NODE>&& rhs);
+
+    /// Move assignment in O(1), exchanges the contents with rhs (see swap())
+    OccupancyOcTreeBase<NODE>& operator=(OccupancyOcTreeBase<NODE>&& rhs) {
+      swap(rhs);
+      return *this;
+    }
+#endif
+
     /**
     * Integrate a Pointcloud (in global reference frame), parallelized with OpenMP.
     * Special care is taken that each voxel
@@ -92,6 +110,9 @@ namespace octomap {
     *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
     * @param discretize whether the scan is discretized first into octree key cells (default: false).
     *   This reduces the number of raycasts using computeDiscreteUpdate(), resulting in a potential speedup.*
+    *
+    * @note Not reentrant: the keys of the scan are collected in buffers of the tree, which are
+    *   reused for the next scan. Do not call it concurrently on the same tree.
     */
     virtual void insertPointCloud(const Pointcloud& scan, const octomap::point3d& sensor_origin,
                    double maxrange=-1., bool lazy_eval = false, bool discretize = false);
@@ -117,6 +138,13 @@ namespace octomap {
     virtual void insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin, const pose6d& frame_origin,
                    double maxrange=-1., bool lazy_eval = false, bool discretize = false);
 
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Same as above, but transforms the scan in place instead of a copy of it,
+    /// e.g. for insertPointCloud(std::move(scan), ...) with a scan which is no longer needed
+    void insertPointCloud(Pointcloud&& scan, const point3d& sensor_origin, const pose6d& frame_origin,
+                   double maxrange=-1., bool lazy_eval = false, bool discretize = false);
+#endif
+
     /**
     * Insert a 3d scan (given as a ScanNode) into the tree, parallelized with OpenMP.
     *
@@ -145,6 +173,32 @@ namespace octomap {
      */
      virtual void insertPointCloudRays(const Pointcloud& scan, const point3d& sensor_origin, double maxrange = -1., bool lazy_eval = false);
 
+    /**
+     * Integrate an organized depth image (e.g. of an RGB-D camera) without casting a ray per
+     * pixel: the octree is traversed within the camera frustum and its nodes are projected
+     * into the image, as in projective TSDF integration. A node in front of the smallest
+     * depth within its projection is updated as free as a whole (see enableMultiResolutionFreeSpace()),
+     * a node behind the largest depth is skipped (occluded or not observed), the others are
+     * split down to the leaves, which are free if their center is in front of the depth of
+     * the pixel it projects to. The pixels themselves are inserted as occupied endpoints,
+     * occupied nodes have a preference over free ones as in insertPointCloud().
+     *
+     * @param depth depth (along the optical axis) per pixel in meters, row after row.
+     *   Pixels which are not positive or not finite are invalid and update nothing.
+     * @param width number of pixels per row
+     * @param height number of rows
+     * @param intrinsics pinhole model of the camera
+     * @param pose pose of the camera in the tree's frame (optical axis along z, x to the right, y down)
+     * @param maxrange maximum depth (-1: unlimited), larger depths only update free space up to maxrange
+     * @param row_pitch bytes from the start of one row to the next, e.g. to pass a driver's buffer
+     *   with padding (0: width * sizeof(float))
+     * @param lazy_eval whether update of inner nodes is omitted after the update (default: false).
+     *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
+     */
+    void insertDepthImage(const float* depth, unsigned int width, unsigned int height,
+                          const CameraIntrinsics& intrinsics, const pose6d& pose,
+                          double maxrange = -1., size_t row_pitch = 0, bool lazy_eval = false);
+
      /**
       * Set log_odds value of voxel to log_odds_value. This only works if key is at the lowest
       * octree level
@@ -221,6 +275,19 @@ namespace octomap {
       */
      virtual NODE* updateNode(double x, double y, double z, float log_odds_update, bool lazy_eval = false);
 
+     /**
+      * Manipulate the log_odds values of many voxels at once, with the same result as calling
+      * updateNode(key, log_odds_update, lazy_eval) for each of them in order. The updates are
+      * sorted in Morton order and applied in one recursive pass, so the path from the root is
+      * only traversed once for all keys below a common inner node and every touched inner node
+      * is updated (or pruned) only once.
+      *
+      * @param updates pairs of OcTreeKey (at the lowest octree level) and log_odds_update
+      * @param lazy_eval whether update of inner nodes is omitted after the update (default: false).
+      *   This speeds up the insertion, but you need to call updateInnerOccupancy() when done.
+      */
+     void updateNodes(const std::vector<std::pair<OcTreeKey, float> >& updates, bool lazy_eval = false);
+
     /**
      * Integrate occupancy measurement.
      *
@@ -266,6 +333,16 @@ namespace octomap {
      */
     virtual void toMaxLikelihood();
 
+    /**
+     * Lossless compression of the octree, see OcTreeBaseImpl::prune().
+     * With dirty tracking enabled, only subtrees changed since the last
+     * call are visited.
+     */
+    virtual void prune();
+
+    /// Expands all pruned nodes (reverse of prune())
+    virtual void expand();
+
     /**
      * Insert one ray between origin and end into the tree.
      * integrateMissOnRay() is called for the ray, the end point is updated as occupied.
@@ -348,17 +425,76 @@ namespace octomap {
     /// @return true if key is in the currently set bounding box
     bool inBBX(const OcTreeKey& key) const;
 
+    //-- scrolling window (local maps):
+    /**
+     * Keep only a cube with edge length size around a moving center, e.g. the robot
+     * pose, see moveScrollingWindow(). The BBX limit is set to the window, so that
+     * insertPointCloud() only updates voxels inside.
+     *
+     * @param size edge length of the window, at most getNodeSize(2) (a quarter of the key range)
+     * @param recenter_keys translate the tree when the window gets close to the boundary
+     *   of the key range (see moveScrollingWindow(), getScrollingWindowOffset())
+     */
+    void enableScrollingWindow(double size, bool recenter_keys = false);
+    /// stops deleting nodes outside of the window and disables the BBX limit
+    void disableScrollingWindow();
+    bool isScrollingWindowEnabled() const { return use_scrolling_window; }
+
+    /**
+     * Moves the scrolling window to center and deletes everything outside of it.
+     * Subtrees completely outside are deleted as a whole (see deleteOutsideBBX()),
+     * so the cost depends on the number of subtrees on the boundary of the window.
+     *
+     * With recenter_keys, the contents of the tree are translated by whole subtrees
+     * (see shiftKeys()) when the window would reach the boundary of the key range.
+     * All coordinates of the tree, including center, are then relative to
+     * getScrollingWindowOffset(): tree coordinates = world coordinates - offset.
+     */
+    void moveScrollingWindow(const point3d& center);
+
+    /// Accumulated translation of the tree by moveScrollingWindow() (with recenter_keys)
+    point3d getScrollingWindowOffset() const { return scrolling_window_offset; }
+
+    //-- multi-resolution free space:
+    /**
+     * Updates the free space of long rays in insertPointCloud() at coarser depth. A node
+     * l levels above the leaves (edge length getResolution() * 2^l) is updated instead of the
+     * leaves it contains when it is at least range * 2^(l-1) away from the sensor origin,
+     * one edge length away from the end of the ray and contains no endpoint of the scan.
+     * Otherwise the ray is traversed one level finer within the node, down to the leaves.
+     *
+     * Such a node receives one "miss" for its whole volume, as if every leaf in it was
+     * updated once: a leaf (pruned node) is updated as a whole, the leaves of an inner node
+     * individually, and unknown space in it becomes free. Free space within an already
+     * free pruned node without endpoints updates that pruned node as a whole (once per scan)
+     * instead of expanding it. With change detection, updated nodes
+     * above the lowest level are tracked by their key at their depth (see adjustKeyAtDepth()).
+     *
+     * Not used together with the BBX limit or paging, insertPointCloud() then updates
+     * all free space at the lowest level.
+     *
+     * @param range distance from the sensor origin up to which free space is updated at the lowest level
+     * @param max_levels number of coarser levels to use at most (limited to getTreeDepth()-1)
+     */
+    void enableMultiResolutionFreeSpace(double range, unsigned int max_levels = 4);
+    void disableMultiResolutionFreeSpace() { free_space_levels = 0; }
+    bool isMultiResolutionFreeSpaceEnabled() const { return free_space_levels > 0; }
+
     //-- change detection on occupancy:
     /// track or ignore changes while inserting scans (default: ignore)
     void enableChangeDetection(bool enable) { use_change_detection = enable; }
     bool isChangeDetectionEnabled() const { return use_change_detection; }
     /// Reset the set of changed keys. Call this after you obtained all changed nodes.
-    void resetChangeDetection() { changed_keys.clear(); }
+    void resetChangeDetection() { changed_keys.clear(); changed_key_depths.clear(); }
 
     /**
      * Iterator to traverse all keys of changed nodes.
-     * you need to enableChangeDetection() first. Here, an OcTreeKey always
-     * refers to a node at the lowest tree level (its size is the minimum tree resolution)
+     * you need to enableChangeDetection() first. Here, an OcTreeKey refers to a node at
+     * the lowest tree level (its size is the minimum tree resolution), except for free
+     * nodes which multi-resolution free space (see enableMultiResolutionFreeSpace())
+     * updated as a whole: their key is the one of the node at changedKeyDepth(key).
+     * The changes are tracked in a KeyBoolMap (a std unordered container), unlike the
+     * keys of the scan insertion which use the open-addressing KeyFlatSet.
      */
     KeyBoolMap::const_iterator changedKeysBegin() const {return changed_keys.begin();}
 
@@ -368,6 +504,59 @@ namespace octomap {
     /// Number of changes since last reset.
     size_t numChangesDetected() const { return changed_keys.size(); }
 
+    /// @return depth of the changed node with key (see changedKeysBegin()), the tree depth for leaves at the lowest level
+    unsigned int changedKeyDepth(const OcTreeKey& key) const {
+      KeyDepthMap::const_iterator it = changed_key_depths.find(key);
+      return (it == changed_key_depths.end()) ? this->tree_depth : it->second;
+    }
+
+    //-- dirty-subtree tracking:
+    /**
+     * Track which subtrees are modified by lazy updates (lazy_eval = true in
+     * updateNode(), setNodeValue(), updateNodes(), insertPointCloud(), ...) so that
+     * updateInnerOccupancy() and prune() only visit the changed branches instead
+     * of the whole tree (default: off). Enabling it marks the whole tree as dirty.
+     * If you modify nodes directly (e.g. through search()), call markTreeDirty().
+     * Without node flags (built with OCTOMAP_NODE_FLAGS=OFF), the whole tree is visited.
+     */
+    void enableDirtyTracking(bool enable);
+    bool isDirtyTrackingEnabled() const { return use_dirty_tracking; }
+    /// Makes the next updateInnerOccupancy() and prune() visit the whole tree
+    void markTreeDirty() { tree_dirty_flags = OcTreeNode::DIRTY_ALL; }
+
+    //-- copy-on-write snapshots:
+    /**
+     * Creates a read-only snapshot of the current tree, which can be queried
+     * (e.g. from another thread) while this tree keeps being updated. The snapshot
+     * shares all nodes with the tree, afterwards every update copies the nodes on
+     * the path it modifies before changing them. Taking a snapshot takes constant
+     * time: only the root is copied, its children are marked as shared and pass
+     * the mark on to their own children when they are copied.
+     *
+     * Delete the snapshot when done with it, which may happen in any thread.
+     * Its memory is reclaimed by the tree in the next snapshot(), updateNodes()
+     * or releaseSnapshotMemory(), which also stop the copying once no snapshot
+     * is left. All snapshots need to be deleted before the tree.
+     *
+     * \note Nodes which are modified directly (e.g. obtained through search())
+     * are not copied, use the tree's update functions instead. Builds without
+     * node flags (OCTOMAP_NODE_FLAGS=OFF) or with indexed children
+     * (OCTOMAP_INDEXED_CHILDREN=ON) do not support snapshots.
+     *
+     * @return snapshot of the same tree type, NULL on error
+     */
+    const OccupancyOcTreeBase<NODE>* snapshot();
+
+    /// @return true if the tree is a snapshot of another tree (see snapshot())
+    bool isSnapshot() const { return snapshot_record != NULL; }
+
+    /// @return number of snapshots of this tree which have not been deleted yet
+    size_t numSnapshots() const;
+
+    /// Frees all nodes which were only referenced by snapshots deleted in the meantime,
+    /// turns copy-on-write off if there are no snapshots left
+    void releaseSnapshotMemory();
+
 
     /**
      * Helper for insertPointCloud(). Computes all octree nodes affected by the point cloud
@@ -385,6 +574,13 @@ namespace octomap {
                        KeySet& occupied_cells,
                        double maxrange);
 
+    /// computeUpdate() into flat hash sets, which avoids one allocation per key
+    /// and keeps their memory when they are reused for the next scan
+    void computeUpdate(const Pointcloud& scan, const octomap::point3d& origin,
+                       KeyFlatSet& free_cells,
+                       KeyFlatSet& occupied_cells,
+                       double maxrange);
+
 
     /**
      * Helper for insertPointCloud(). Computes all octree nodes affected by the point cloud
@@ -403,6 +599,43 @@ namespace octomap {
                        KeySet& occupied_cells,
                        double maxrange);
 
+    /// computeDiscreteUpdate() into flat hash sets, see computeUpdate()
+    void computeDiscreteUpdate(const Pointcloud& scan, const octomap::point3d& origin,
+                       KeyFlatSet& free_cells,
+                       KeyFlatSet& occupied_cells,
+                       double maxrange);
+
+
+    /**
+     * Helper for insertPointCloud() with multi-resolution free space (see
+     * enableMultiResolutionFreeSpace()). Like computeUpdate(), but free_cells[l] holds
+     * the free nodes l levels above the leaves, by their key with the lower l bits cleared
+     * (see computeIndexKey()). Free nodes do not overlap each other or occupied_cells,
+     * free pruned nodes of the tree may add levels above the coarsest one.
+     *
+     * @param scan point cloud measurement to be integrated
+     * @param origin origin of the sensor for ray casting
+     * @param free_cells keys of nodes to be cleared per level, resized to the number of levels used
+     * @param occupied_cells keys of nodes to be marked occupied
+     * @param maxrange maximum range for raycasting (-1: unlimited)
+     */
+    void computeMultiResolutionUpdate(const Pointcloud& scan, const octomap::point3d& origin,
+                                      std::vector<KeyFlatSet>& free_cells,
+                                      KeyFlatSet& occupied_cells,
+                                      double maxrange);
+
+
+    /**
+     * Helper for insertDepthImage(). Computes all octree nodes affected by the depth image,
+     * free_cells[l] holds the free nodes l levels above the leaves by their key with the
+     * lower l bits cleared (see computeIndexKey()). Free nodes do not overlap occupied_cells.
+     * Parameters as in insertDepthImage().
+     */
+    void computeDepthImageUpdate(const float* depth, unsigned int width, unsigned int height,
+                                 const CameraIntrinsics& intrinsics, const pose6d& pose,
+                                 double maxrange, size_t row_pitch,
+                                 std::vector<KeyFlatSet>& free_cells, KeyFlatSet& occupied_cells);
+
 
     // -- I/O  -----------------------------------------
 
@@ -431,9 +664,10 @@ namespace octomap {
      *
      * @param s
      * @param node OcTreeNode to write out, will recurse to all children
+     * @param paging_reader stream on the paging file to read paged-out subtrees from (see enablePaging())
      * @return
      */
-    std::ostream& writeBinaryNode(std::ostream &s, const NODE* node) const;
+    std::ostream& writeBinaryNode(std::ostream &s, const NODE* node, std::istream* paging_reader = NULL) const;
 
     /**
      * Writes the data of the tree (without header) to the stream, recursively
@@ -473,19 +707,182 @@ namespace octomap {
      */
     inline bool integrateMissOnRay(const point3d& origin, const point3d& end, bool lazy_eval = false);
 
+    /**
+     * Helper for computeUpdate(): casts the rays to the endpoints scan[begin..end) (at most
+     * RayPacket::MAX_RAYS) with computeRaysKeys() and inserts their keys into free_cells and
+     * occupied_cells (without resolving conflicts between both). Only reads the tree, may be
+     * called concurrently with distinct rays and sets.
+     */
+    void computeRayUpdates(const Pointcloud& scan, int begin, int end, const point3d& origin, double maxrange,
+                           KeyRay* rays, KeyFlatSet& free_cells, KeyFlatSet& occupied_cells) const;
+
+    /// Moves the keys of all sets into cells, see computeUpdate()
+    static void mergeKeySets(std::vector<KeyFlatSet>& sets, KeyFlatSet& cells);
+
+
+    /// Change of a leaf's occupancy in updateNodesRecurs(), applied to changed_keys later
+    /// when the subtrees are updated in parallel
+    struct KeyChange {
+      KeyChange(const OcTreeKey& k, bool c, bool f, unsigned int d) : key(k), created(c), flipped(f), depth(d) {}
+      OcTreeKey key;
+      bool created;  ///< leaf was created by the update
+      bool flipped;  ///< occupancy of an existing leaf changed (an odd number of times)
+      unsigned int depth;  ///< depth of the leaf
+    };
+
+    /// Subtree at UpdateTasks::depth with its range of the sorted updates
+    struct UpdateTask {
+      UpdateTask(NODE* n, bool c, const std::pair<morton_type, size_t>* b, const std::pair<morton_type, size_t>* e)
+        : node(n), created(c), begin(b), end(e), changed(false) {}
+      NODE* node;
+      bool created;
+      const std::pair<morton_type, size_t>* begin;
+      const std::pair<morton_type, size_t>* end;
+      bool changed;  ///< result of updateNodesRecurs() for the subtree
+      std::vector<KeyChange> key_changes;
+    };
+
+    /**
+     * Splits updateNodesRecurs() at a fixed depth: the first (serial) traversal collects the
+     * subtrees as tasks instead of descending, the second one only updates the inner nodes
+     * above them with the results of the tasks, which are consumed in the same order.
+     */
+    struct UpdateTasks {
+      UpdateTasks(unsigned int d) : depth(d), collect(true), next(0) {}
+      unsigned int depth;
+      bool collect;
+      size_t next;
+      std::vector<UpdateTask> list;
+    };
+
+    /// updateNodesAtDepth() on the subtrees two levels below the root in parallel (see setNumThreads())
+    void updateNodesParallel(bool created_root, unsigned int target_depth,
+                             const std::vector<std::pair<OcTreeKey, float> >& updates,
+                             const std::vector<std::pair<morton_type, size_t> >& order, bool lazy_eval);
+
+    /// discretizes the scan with the octree grid, one point per leaf (see computeDiscreteUpdate())
+    void discretizeScan(const Pointcloud& scan, Pointcloud& discrete_scan) const;
+
+    /// one ray of computeMultiResolutionUpdate(), positions in key units
+    struct MultiResolutionRay {
+      unsigned int frac_bits;   ///< see getKeyPositionBits()
+      double origin[3];
+      double end[3];
+      double range;             ///< range of the lowest level
+      const std::vector<KeyFlatSet>* occupied;  ///< per level, the nodes containing an endpoint
+    };
+
+    /**
+     * Traverses the ray between the key positions from and to (see coordToKeyPositionChecked())
+     * with nodes at level, which are added to free_cells or traversed one level finer.
+     * @param ray_end to is the end of the ray, its node at the lowest level is excluded
+     */
+    void computeMultiResolutionRayRecurs(const uint64_t from[3], const uint64_t to[3], unsigned int level, bool ray_end,
+                                         const MultiResolutionRay& ray, std::vector<KeyFlatSet>& free_cells) const;
+
+    /// inserts the keys of the nodes at level containing keys (see computeIndexKey())
+    static void computeIndexKeys(const KeyFlatSet& keys, unsigned int level, KeyFlatSet& index_keys);
+
+    /// @return true if the ray needs to be traversed with smaller nodes than the one at cell (see enableMultiResolutionFreeSpace())
+    bool refineFreeNode(const uint64_t cell[3], unsigned int level, const MultiResolutionRay& ray) const;
+
+    /// camera of computeDepthImageUpdate()
+    struct DepthImageProjection {
+      const DepthImagePyramid* pyramid;
+      CameraIntrinsics intrinsics;
+      double rotation[3][3];        ///< tree frame to camera frame
+      double translation[3];
+      double max_depth;             ///< largest depth of the image
+      unsigned int max_free_level;  ///< largest free nodes, levels above the leaves
+    };
+
+    /// classifies the node at level with key (lower bits cleared) for computeDepthImageUpdate(), descending if needed
+    void computeDepthImageRecurs(const OcTreeKey& key, unsigned int level, const DepthImageProjection& camera,
+                                 std::vector<KeyFlatSet>& free_cells) const;
+
+    /// updates the tree with the cells of one scan (scan_free_cells, scan_free_levels, scan_occupied_cells) and clears them
+    void insertScanCells(bool lazy_eval);
+
+    /**
+     * updateNodes() for the nodes at depth: each update applies to the whole volume of the node
+     * with its key (see enableMultiResolutionFreeSpace()), batched in the same Morton-sorted
+     * and parallel traversal. At the tree depth, this is updateNodes().
+     */
+    void updateNodesAtDepth(const std::vector<std::pair<OcTreeKey, float> >& updates, unsigned int depth, bool lazy_eval);
+
+    /// tracks the change of a leaf at depth in changed_keys (and changed_key_depths), see KeyChange
+    void trackChangedKey(const OcTreeKey& key, bool created, bool flipped, unsigned int depth);
+
+    /// records the access to the subtrees of the sorted updates for paging (see enablePaging())
+    void touchSubtrees(const std::vector<std::pair<OcTreeKey, float> >& updates,
+                       const std::vector<std::pair<morton_type, size_t> >& order);
+
 
     // recursive calls ----------------------------
 
     NODE* updateNodeRecurs(NODE* node, bool node_just_created, const OcTreeKey& key,
                            unsigned int depth, const float& log_odds_update, bool lazy_eval = false);
     
+    /**
+     * recursive helper of updateNodesAtDepth, applies the sorted updates [begin, end) below node
+     * @param target_depth depth of the updated nodes, see updateNodesAtDepth()
+     * @param tasks split the traversal at tasks->depth (see UpdateTasks), NULL: complete traversal
+     * @param key_changes collects the changes for change detection instead of changed_keys
+     * @return true if any node below was changed
+     */
+    bool updateNodesRecurs(NODE* node, bool node_just_created, unsigned int depth, unsigned int target_depth,
+                           const std::vector<std::pair<OcTreeKey, float> >& updates,
+                           const std::pair<morton_type, size_t>* begin, const std::pair<morton_type, size_t>* end,
+                           bool lazy_eval, UpdateTasks* tasks = NULL, std::vector<KeyChange>* key_changes = NULL);
+
+    /// updates all leaves below node (key with the lower bits cleared), creating unknown ones
+    /// @param key_changes see updateNodesRecurs()
+    bool updateVolumeRecurs(NODE* node, bool node_just_created, const OcTreeKey& key, unsigned int depth,
+                            float log_odds_update, bool lazy_eval, std::vector<KeyChange>* key_changes);
+
+    /// prunes node or updates its occupancy after its children changed, as in updateNodesRecurs()
+    void updateChangedInnerNode(NODE* node, bool lazy_eval);
+
     NODE* setNodeValueRecurs(NODE* node, bool node_just_created, const OcTreeKey& key,
                            unsigned int depth, const float& log_odds_value, bool lazy_eval = false);
 
     void updateInnerOccupancyRecurs(NODE* node, unsigned int depth);
+
+    /// recursive call of updateInnerOccupancy() with dirty tracking, visits dirty subtrees only (all if full)
+    void updateInnerOccupancyDirtyRecurs(NODE* node, unsigned int depth, bool full);
+
+    /// recursive call of prune() with dirty tracking, visits dirty subtrees only (all if full)
+    void pruneDirtyRecurs(NODE* node, unsigned int depth, bool full);
     
     void toMaxLikelihoodRecurs(NODE* node, unsigned int depth, unsigned int max_depth);
 
+    /// copy-on-write hooks (see OcTreeBaseImpl), active once snapshot() was called
+    virtual NODE* unshareNodeChild(NODE* node, unsigned int childIdx);
+    virtual bool retainSubtree(NODE* node);
+
+    /// paging hook (see OcTreeBaseImpl), updates the inner occupancy of the subtree
+    virtual void beforePageOut(NODE* node);
+
+    /// updates the occupancy of the inner node from its children (see OcTreeBaseImpl)
+    virtual void updateInnerNode(NODE* node) { node->updateOccupancyChildren(); }
+
+    /// updateInnerOccupancyRecurs() for a shared node, which is left untouched.
+    /// @return private copy of node with the updated occupancy, NULL if nothing changed
+    NODE* updateSharedInnerOccupancyRecurs(const NODE* node, unsigned int depth);
+
+    /// @return private copy of the shared node, whose children are now shared by both
+    NODE* copySharedNode(const NODE* node);
+
+    /// Replaces the shared child childIdx of node by copy (see copySharedNode())
+    void replaceSharedNodeChild(NODE* node, unsigned int childIdx, NODE* copy);
+
+    /// marks the children (not the subtrees) of node as shared, nodes below a shared node
+    /// are implicitly shared as well
+    void markChildrenShared(NODE* node);
+
+    /// frees node and its subtree, bypassing the copy-on-write hooks
+    void deleteRetiredNodeRecurs(NODE* node);
+
 
   protected:
     bool use_bbx_limit;  ///< use bounding box for queries (needs to be set)?
@@ -494,9 +891,51 @@ namespace octomap {
     OcTreeKey bbx_min_key;
     OcTreeKey bbx_max_key;
 
+    bool use_scrolling_window;
+    double scrolling_window_size;
+    bool scrolling_window_recenter;
+    point3d scrolling_window_offset;
+
+    /// multi-resolution free space (see enableMultiResolutionFreeSpace()), 0 levels: disabled
+    double free_space_range;
+    unsigned int free_space_levels;
+
     bool use_change_detection;
     /// Set of leaf keys (lowest level) which changed since last resetChangeDetection
     KeyBoolMap changed_keys;
+    /// depths of the keys in changed_keys which are not at the lowest level
+    KeyDepthMap changed_key_depths;
+
+    bool use_dirty_tracking;
+    /// dirty flags of the whole tree (see OcTreeNode::DirtyFlag), forcing a full traversal
+    unsigned char tree_dirty_flags;
+
+    /// buffers of insertPointCloud() and insertDepthImage(), kept to reuse their memory for
+    /// the next scan. Like the ray buffers below, they make the insertions (and computeUpdate())
+    /// of one tree non-reentrant.
+    KeyFlatSet scan_free_cells, scan_occupied_cells;
+    /// free nodes per level of insertPointCloud() with multi-resolution free space
+    std::vector<KeyFlatSet> scan_free_levels;
+    /// depth bounds of the image in insertDepthImage()
+    DepthImagePyramid depth_pyramid;
+    /// per-thread buffers of computeUpdate() (with OpenMP), merged once after ray casting
+    std::vector<KeyFlatSet> thread_free_cells, thread_occupied_cells;
+    /// RayPacket::MAX_RAYS KeyRays per thread for computeUpdate(), sized to the longest rays so far
+    std::vector<KeyRay> ray_packets;
+
+    /// node replaced (or deleted) in the tree while snapshots may still reference it
+    struct RetiredNode {
+      NODE* node;
+      unsigned long sequence;  ///< sequence number of the newest snapshot which can see it
+      bool subtree;            ///< free the whole subtree, not only the node
+    };
+    std::vector<RetiredNode> retired_nodes;
+    /// snapshots taken from this tree and not collected yet
+    std::vector<OcTreeSnapshotRecord*> snapshot_records;
+    /// sequence number of the last snapshot taken
+    unsigned long snapshot_sequence;
+    /// only set in snapshots, shared with the tree they were taken from
+    OcTreeSnapshotRecord* snapshot_record;
     
 
   };
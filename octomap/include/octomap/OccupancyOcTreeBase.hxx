@@ -33,6 +33,7 @@
 
 #include <bitset>
 #include <algorithm>
+#include <limits>
 
 #include <octomap/MCTables.h>
 
@@ -40,20 +41,45 @@ namespace octomap {
 
   template <class NODE>
   OccupancyOcTreeBase<NODE>::OccupancyOcTreeBase(double in_resolution)
-    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(in_resolution), use_bbx_limit(false), use_change_detection(false)
+    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(in_resolution), use_bbx_limit(false),
+      use_scrolling_window(false), scrolling_window_size(0.0), scrolling_window_recenter(false),
+      free_space_range(0.0), free_space_levels(0),
+      use_change_detection(false),
+      use_dirty_tracking(false), tree_dirty_flags(OcTreeNode::DIRTY_ALL),
+      snapshot_sequence(0), snapshot_record(NULL)
   {
 
   }
 
   template <class NODE>
   OccupancyOcTreeBase<NODE>::OccupancyOcTreeBase(double in_resolution, unsigned int in_tree_depth, unsigned int in_tree_max_val)
-    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(in_resolution, in_tree_depth, in_tree_max_val), use_bbx_limit(false), use_change_detection(false)
+    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(in_resolution, in_tree_depth, in_tree_max_val), use_bbx_limit(false),
+      use_scrolling_window(false), scrolling_window_size(0.0), scrolling_window_recenter(false),
+      free_space_range(0.0), free_space_levels(0),
+      use_change_detection(false),
+      use_dirty_tracking(false), tree_dirty_flags(OcTreeNode::DIRTY_ALL),
+      snapshot_sequence(0), snapshot_record(NULL)
   {
 
   }
 
   template <class NODE>
   OccupancyOcTreeBase<NODE>::~OccupancyOcTreeBase(){
+    if (snapshot_record != NULL) {
+      // the nodes belong to the tree the snapshot was taken from
+      this->root = NULL;
+      this->tree_size = 0;
+      snapshot_record->release();
+      return;
+    }
+
+    releaseSnapshotMemory();
+    if (!snapshot_records.empty()) {
+      OCTOMAP_ERROR("%u snapshots of the octree are still in use and become invalid\n",
+                    (unsigned) snapshot_records.size());
+      this->copy_on_write = false;
+    }
+    this->clear();
   }
 
   template <class NODE>
@@ -61,7 +87,12 @@ namespace octomap {
   OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(rhs), use_bbx_limit(rhs.use_bbx_limit),
     bbx_min(rhs.bbx_min), bbx_max(rhs.bbx_max),
     bbx_min_key(rhs.bbx_min_key), bbx_max_key(rhs.bbx_max_key),
-    use_change_detection(rhs.use_change_detection), changed_keys(rhs.changed_keys)
+    use_scrolling_window(rhs.use_scrolling_window), scrolling_window_size(rhs.scrolling_window_size),
+    scrolling_window_recenter(rhs.scrolling_window_recenter), scrolling_window_offset(rhs.scrolling_window_offset),
+    free_space_range(rhs.free_space_range), free_space_levels(rhs.free_space_levels),
+    use_change_detection(rhs.use_change_detection), changed_keys(rhs.changed_keys), changed_key_depths(rhs.changed_key_depths),
+    use_dirty_tracking(rhs.use_dirty_tracking), tree_dirty_flags(OcTreeNode::DIRTY_ALL),
+    snapshot_sequence(0), snapshot_record(NULL)
   {
     this->clamping_thres_min = rhs.clamping_thres_min;
     this->clamping_thres_max = rhs.clamping_thres_max;
@@ -72,6 +103,60 @@ namespace octomap {
 
   }
 
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+  template <class NODE>
+  OccupancyOcTreeBase<NODE>::OccupancyOcTreeBase(OccupancyOcTreeBase<NODE>&& rhs)
+    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(rhs.resolution, rhs.tree_depth, rhs.tree_max_val),
+      use_bbx_limit(false),
+      use_scrolling_window(false), scrolling_window_size(0.0), scrolling_window_recenter(false),
+      free_space_range(0.0), free_space_levels(0),
+      use_change_detection(false),
+      use_dirty_tracking(false), tree_dirty_flags(OcTreeNode::DIRTY_ALL),
+      snapshot_sequence(0), snapshot_record(NULL)
+  {
+    swap(rhs);
+  }
+#endif
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::swap(OccupancyOcTreeBase<NODE>& other) {
+    if (this->tree_depth != other.tree_depth || this->tree_max_val != other.tree_max_val) {
+      OCTOMAP_ERROR("Cannot swap octrees of different tree depth\n");
+      return;
+    }
+    OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::swap(other);
+
+    std::swap(this->clamping_thres_min, other.clamping_thres_min);
+    std::swap(this->clamping_thres_max, other.clamping_thres_max);
+    std::swap(this->prob_hit_log, other.prob_hit_log);
+    std::swap(this->prob_miss_log, other.prob_miss_log);
+    std::swap(this->occ_prob_thres_log, other.occ_prob_thres_log);
+
+    std::swap(use_bbx_limit, other.use_bbx_limit);
+    std::swap(bbx_min, other.bbx_min);
+    std::swap(bbx_max, other.bbx_max);
+    std::swap(bbx_min_key, other.bbx_min_key);
+    std::swap(bbx_max_key, other.bbx_max_key);
+    std::swap(use_scrolling_window, other.use_scrolling_window);
+    std::swap(scrolling_window_size, other.scrolling_window_size);
+    std::swap(scrolling_window_recenter, other.scrolling_window_recenter);
+    std::swap(scrolling_window_offset, other.scrolling_window_offset);
+    std::swap(free_space_range, other.free_space_range);
+    std::swap(free_space_levels, other.free_space_levels);
+
+    std::swap(use_change_detection, other.use_change_detection);
+    changed_keys.swap(other.changed_keys);
+    changed_key_depths.swap(other.changed_key_depths);
+    std::swap(use_dirty_tracking, other.use_dirty_tracking);
+    std::swap(tree_dirty_flags, other.tree_dirty_flags);
+
+    // snapshot bookkeeping belongs to the nodes
+    retired_nodes.swap(other.retired_nodes);
+    snapshot_records.swap(other.snapshot_records);
+    std::swap(snapshot_sequence, other.snapshot_sequence);
+    std::swap(snapshot_record, other.snapshot_record);
+  }
+
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::insertPointCloud(const ScanNode& scan, double maxrange, bool lazy_eval, bool discretize) {
     // performs transformation to data and sensor origin first
@@ -86,19 +171,57 @@ namespace octomap {
   void OccupancyOcTreeBase<NODE>::insertPointCloud(const Pointcloud& scan, const octomap::point3d& sensor_origin,
                                              double maxrange, bool lazy_eval, bool discretize) {
 
-    KeySet free_cells, occupied_cells;
-    if (discretize)
+    KeyFlatSet& free_cells = scan_free_cells;
+    KeyFlatSet& occupied_cells = scan_occupied_cells;
+    free_cells.clear();
+    occupied_cells.clear();
+    if (free_space_levels > 0 && !use_bbx_limit && this->paging_depth == 0) {
+      if (discretize) {
+        Pointcloud discrete_scan;
+        discretizeScan(scan, discrete_scan);
+        computeMultiResolutionUpdate(discrete_scan, sensor_origin, scan_free_levels, occupied_cells, maxrange);
+      } else {
+        computeMultiResolutionUpdate(scan, sensor_origin, scan_free_levels, occupied_cells, maxrange);
+      }
+      free_cells.swap(scan_free_levels[0]);
+    }
+    else if (discretize)
       computeDiscreteUpdate(scan, sensor_origin, free_cells, occupied_cells, maxrange);
     else
       computeUpdate(scan, sensor_origin, free_cells, occupied_cells, maxrange);
 
+    insertScanCells(lazy_eval);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::insertScanCells(bool lazy_eval) {
+    KeyFlatSet& free_cells = scan_free_cells;
+    KeyFlatSet& occupied_cells = scan_occupied_cells;
+
     // insert data into tree  -----------------------
-    for (KeySet::iterator it = free_cells.begin(); it != free_cells.end(); ++it) {
-      updateNode(*it, false, lazy_eval);
+    std::vector<std::pair<OcTreeKey, float> > updates;
+    updates.reserve(free_cells.size() + occupied_cells.size());
+    for (KeyFlatSet::iterator it = free_cells.begin(); it != free_cells.end(); ++it) {
+      updates.push_back(std::make_pair(*it, this->prob_miss_log));
+    }
+    for (KeyFlatSet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it) {
+      updates.push_back(std::make_pair(*it, this->prob_hit_log));
     }
-    for (KeySet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it) {
-      updateNode(*it, true, lazy_eval);
+    updateNodes(updates, lazy_eval);
+
+    // free nodes above the lowest level, each one as a whole
+    for (size_t level = 1; level < scan_free_levels.size(); ++level) {
+      KeyFlatSet& level_cells = scan_free_levels[level];
+      updates.clear();
+      for (KeyFlatSet::iterator it = level_cells.begin(); it != level_cells.end(); ++it)
+        updates.push_back(std::make_pair(*it, this->prob_miss_log));
+      updateNodesAtDepth(updates, this->tree_depth - (unsigned int) level, lazy_eval);
+      level_cells.clear();
     }
+
+    // keep the memory for the next scan
+    free_cells.clear();
+    occupied_cells.clear();
   }
 
   template <class NODE>
@@ -111,6 +234,30 @@ namespace octomap {
     insertPointCloud(transformed_scan, transformed_sensor_origin, maxrange, lazy_eval, discretize);
   }
 
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::insertPointCloud(Pointcloud&& pc, const point3d& sensor_origin, const pose6d& frame_origin,
+                                             double maxrange, bool lazy_eval, bool discretize) {
+    pc.transform(frame_origin);
+    point3d transformed_sensor_origin = frame_origin.transform(sensor_origin);
+    insertPointCloud(pc, transformed_sensor_origin, maxrange, lazy_eval, discretize);
+  }
+#endif
+
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::insertDepthImage(const float* depth, unsigned int width, unsigned int height,
+                                                   const CameraIntrinsics& intrinsics, const pose6d& pose,
+                                                   double maxrange, size_t row_pitch, bool lazy_eval) {
+    scan_free_cells.clear();
+    scan_occupied_cells.clear();
+    for (size_t level = 0; level < scan_free_levels.size(); ++level)
+      scan_free_levels[level].clear();
+    computeDepthImageUpdate(depth, width, height, intrinsics, pose, maxrange, row_pitch,
+                            scan_free_levels, scan_occupied_cells);
+    scan_free_cells.swap(scan_free_levels[0]);
+    insertScanCells(lazy_eval);
+  }
 
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::insertPointCloudRays(const Pointcloud& pc, const point3d& origin, double /* maxrange */, bool lazy_eval) {
@@ -149,118 +296,576 @@ namespace octomap {
                                                 KeySet& free_cells, KeySet& occupied_cells,
                                                 double maxrange)
  {
-   Pointcloud discretePC;
-   discretePC.reserve(scan.size());
-   KeySet endpoints;
-
-   for (int i = 0; i < (int)scan.size(); ++i) {
-     OcTreeKey k = this->coordToKey(scan[i]);
-     std::pair<KeySet::iterator,bool> ret = endpoints.insert(k);
-     if (ret.second){ // insertion took place => k was not in set
-       discretePC.push_back(this->keyToCoord(k));
-     }
-   }
+   KeyFlatSet flat_free_cells, flat_occupied_cells;
+   computeDiscreteUpdate(scan, origin, flat_free_cells, flat_occupied_cells, maxrange);
+   free_cells.insert(flat_free_cells.begin(), flat_free_cells.end());
+   occupied_cells.insert(flat_occupied_cells.begin(), flat_occupied_cells.end());
+ }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeDiscreteUpdate(const Pointcloud& scan, const octomap::point3d& origin,
+                                                KeyFlatSet& free_cells, KeyFlatSet& occupied_cells,
+                                                double maxrange)
+ {
+   Pointcloud discretePC;
+   discretizeScan(scan, discretePC);
    computeUpdate(discretePC, origin, free_cells, occupied_cells, maxrange);
  }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::discretizeScan(const Pointcloud& scan, Pointcloud& discrete_scan) const {
+    discrete_scan.reserve(scan.size());
+    KeyFlatSet endpoints;
+    endpoints.reserve(scan.size());
+
+    for (int i = 0; i < (int)scan.size(); ++i) {
+      OcTreeKey k = this->coordToKey(scan[i]);
+      std::pair<KeyFlatSet::iterator,bool> ret = endpoints.insert(k);
+      if (ret.second){ // insertion took place => k was not in set
+        discrete_scan.push_back(this->keyToCoord(k));
+      }
+    }
+  }
+
 
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::computeUpdate(const Pointcloud& scan, const octomap::point3d& origin,
                                                 KeySet& free_cells, KeySet& occupied_cells,
                                                 double maxrange)
   {
+    KeyFlatSet flat_free_cells, flat_occupied_cells;
+    computeUpdate(scan, origin, flat_free_cells, flat_occupied_cells, maxrange);
+    free_cells.insert(flat_free_cells.begin(), flat_free_cells.end());
+    occupied_cells.insert(flat_occupied_cells.begin(), flat_occupied_cells.end());
+  }
 
-
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeUpdate(const Pointcloud& scan, const octomap::point3d& origin,
+                                                KeyFlatSet& free_cells, KeyFlatSet& occupied_cells,
+                                                double maxrange)
+  {
+    // at least one key per endpoint, avoids most rehashing on the first scans
+    occupied_cells.reserve(occupied_cells.size() + scan.size());
 
 #ifdef _OPENMP
-    omp_set_num_threads(this->keyrays.size());
-    #pragma omp parallel for schedule(guided)
-#endif
-    for (int i = 0; i < (int)scan.size(); ++i) {
-      const point3d& p = scan[i];
-      unsigned threadIdx = 0;
-#ifdef _OPENMP
-      threadIdx = omp_get_thread_num();
+    if (this->keyrays.size() > 1) {
+      // every thread collects the keys of its rays in its own sets (no locking),
+      // these are merged once after the parallel loop
+      const unsigned int num_keyrays = (unsigned int) this->keyrays.size();
+      thread_free_cells.resize(num_keyrays);
+      thread_occupied_cells.resize(num_keyrays);
+      ray_packets.resize(num_keyrays * RayPacket::MAX_RAYS, KeyRay(0)); // grown to the rays in computeRaysKeys()
+      for (unsigned int t = 0; t < num_keyrays; ++t) {
+        thread_free_cells[t].clear();
+        thread_occupied_cells[t].clear();
+      }
+
+      #pragma omp parallel num_threads(num_keyrays)
+      {
+        const unsigned int threadIdx = omp_get_thread_num();
+        KeyFlatSet& thread_free = thread_free_cells[threadIdx];
+        KeyFlatSet& thread_occupied = thread_occupied_cells[threadIdx];
+
+        #pragma omp for schedule(guided)
+        for (int i = 0; i < (int)scan.size(); i += RayPacket::MAX_RAYS)
+          computeRayUpdates(scan, i, std::min(i + (int)RayPacket::MAX_RAYS, (int)scan.size()), origin, maxrange,
+                            &ray_packets[threadIdx * RayPacket::MAX_RAYS], thread_free, thread_occupied);
+      } // end of parallel OMP region
+
+      mergeKeySets(thread_free_cells, free_cells);
+      mergeKeySets(thread_occupied_cells, occupied_cells);
+    } else
 #endif
-      KeyRay* keyray = &(this->keyrays.at(threadIdx));
+    {
+      ray_packets.resize(RayPacket::MAX_RAYS, KeyRay(0));
+      for (int i = 0; i < (int)scan.size(); i += RayPacket::MAX_RAYS)
+        computeRayUpdates(scan, i, std::min(i + (int)RayPacket::MAX_RAYS, (int)scan.size()), origin, maxrange,
+                          &ray_packets[0], free_cells, occupied_cells);
+    }
 
+    // prefer occupied cells over free ones (and make sets disjunct)
+    for(KeyFlatSet::iterator it = free_cells.begin(), end=free_cells.end(); it!= end; ){
+      if (occupied_cells.find(*it) != occupied_cells.end()){
+        it = free_cells.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeRayUpdates(const Pointcloud& scan, int begin, int end,
+                                                    const point3d& origin, double maxrange,
+                                                    KeyRay* rays, KeyFlatSet& free_cells, KeyFlatSet& occupied_cells) const
+  {
+    assert(end - begin <= (int) RayPacket::MAX_RAYS);
+    point3d ray_ends[RayPacket::MAX_RAYS];
+    bool valid[RayPacket::MAX_RAYS];
+    size_t num_rays = 0;
+
+    for (int i = begin; i < end; ++i) {
+      const point3d& p = scan[i];
       if (!use_bbx_limit) { // no BBX specified
         if ((maxrange < 0.0) || ((p - origin).norm() <= maxrange) ) { // is not maxrange meas.
-          // free cells
-          if (this->computeRayKeys(origin, p, *keyray)){
-#ifdef _OPENMP
-            #pragma omp critical (free_insert)
-#endif
-            {
-              free_cells.insert(keyray->begin(), keyray->end());
-            }
-          }
+          // free cells up to the endpoint
+          ray_ends[num_rays++] = p;
           // occupied endpoint
           OcTreeKey key;
           if (this->coordToKeyChecked(p, key)){
-#ifdef _OPENMP
-            #pragma omp critical (occupied_insert)
-#endif
-            {
-              occupied_cells.insert(key);
-            }
+            occupied_cells.insert(key);
           }
         } else { // user set a maxrange and length is above
           point3d direction = (p - origin).normalized ();
-          point3d new_end = origin + direction * (float) maxrange;
-          if (this->computeRayKeys(origin, new_end, *keyray)){
-#ifdef _OPENMP
-            #pragma omp critical (free_insert)
-#endif
-            {
-              free_cells.insert(keyray->begin(), keyray->end());
-            }
-          }
+          ray_ends[num_rays++] = origin + direction * (float) maxrange;
         } // end if maxrange
       } else { // BBX was set
         // endpoint in bbx and not maxrange?
         if ( inBBX(p) && ((maxrange < 0.0) || ((p - origin).norm () <= maxrange) ) )  {
-
           // occupied endpoint
           OcTreeKey key;
           if (this->coordToKeyChecked(p, key)){
-#ifdef _OPENMP
-            #pragma omp critical (occupied_insert)
-#endif
-            {
-              occupied_cells.insert(key);
-            }
+            occupied_cells.insert(key);
           }
-
-          // update freespace, break as soon as bbx limit is reached
-          if (this->computeRayKeys(origin, p, *keyray)){
-            for(KeyRay::reverse_iterator rit=keyray->rbegin(); rit != keyray->rend(); rit++) {
-              if (inBBX(*rit)) {
-#ifdef _OPENMP
-                #pragma omp critical (free_insert)
-#endif
-                {
-                  free_cells.insert(*rit);
-                }
-              }
-              else break;
-            }
-          } // end if compute ray
+          ray_ends[num_rays++] = p;
         } // end if in BBX and not maxrange
       } // end bbx case
+    }
 
-    } // end for all points, end of parallel OMP loop
+    // free cells of all rays at once (each ray is grown to the room it needs)
+    this->computeRaysKeys(origin, ray_ends, num_rays, rays, valid);
+    for (size_t r = 0; r < num_rays; ++r) {
+      if (!valid[r])
+        continue;
+      if (!use_bbx_limit) {
+        free_cells.insert(rays[r].begin(), rays[r].end());
+      } else {
+        // update freespace, break as soon as bbx limit is reached
+        for(KeyRay::reverse_iterator rit=rays[r].rbegin(); rit != rays[r].rend(); rit++) {
+          if (inBBX(*rit)) {
+            free_cells.insert(*rit);
+          }
+          else break;
+        }
+      }
+    }
+  }
 
-    // prefer occupied cells over free ones (and make sets disjunct)
-    for(KeySet::iterator it = free_cells.begin(), end=free_cells.end(); it!= end; ){
-      if (occupied_cells.find(*it) != occupied_cells.end()){
-        it = free_cells.erase(it);
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeMultiResolutionUpdate(const Pointcloud& scan, const octomap::point3d& origin,
+                                                               std::vector<KeyFlatSet>& free_cells, KeyFlatSet& occupied_cells,
+                                                               double maxrange)
+  {
+    const unsigned int num_levels = std::min(free_space_levels, this->tree_depth - 1);
+    free_cells.resize(num_levels + 1);
+
+    MultiResolutionRay ray;
+    ray.frac_bits = this->getKeyPositionBits();
+    const double one = (double) ((uint64_t) 1 << ray.frac_bits);
+    OcTreeKey key_origin;
+    uint64_t pos_origin[3];
+    if (!this->coordToKeyPositionChecked(origin, key_origin, pos_origin)) {
+      OCTOMAP_WARNING_STR("sensor origin " << origin << " out of bounds in computeMultiResolutionUpdate");
+      return;
+    }
+    for (unsigned int i = 0; i < 3; ++i)
+      ray.origin[i] = (double) pos_origin[i] / one;
+    ray.range = free_space_range * this->resolution_factor;
+
+    // endpoints first, nodes containing one are never updated as a whole
+    occupied_cells.reserve(occupied_cells.size() + scan.size());
+    for (int i = 0; i < (int)scan.size(); ++i) {
+      OcTreeKey key;
+      if (((maxrange < 0.0) || ((scan[i] - origin).norm() <= maxrange)) && this->coordToKeyChecked(scan[i], key))
+        occupied_cells.insert(key);
+    }
+    std::vector<KeyFlatSet> occupied_levels(this->tree_depth);
+    for (unsigned int level = 1; level <= num_levels; ++level)
+      computeIndexKeys(occupied_cells, level, occupied_levels[level]);
+    ray.occupied = &occupied_levels;
+
+    // rays from the coarsest level, refined where needed
+    for (int i = 0; i < (int)scan.size(); ++i) {
+      point3d end = scan[i];
+      if ((maxrange >= 0.0) && ((end - origin).norm() > maxrange))
+        end = origin + (end - origin).normalized() * (float) maxrange;
+
+      OcTreeKey key_end;
+      uint64_t pos_end[3];
+      if (!this->coordToKeyPositionChecked(end, key_end, pos_end))
+        continue;
+      for (unsigned int d = 0; d < 3; ++d)
+        ray.end[d] = (double) pos_end[d] / one;
+      computeMultiResolutionRayRecurs(pos_origin, pos_end, num_levels, true, ray, free_cells);
+    }
+
+    // free nodes within a larger free pruned node of the tree update that one as a whole
+    // instead of expanding it, unless it contains an endpoint
+    std::vector<std::pair<unsigned int, OcTreeKey> > pruned_nodes;
+    for (unsigned int level = 0; this->root != NULL && level <= num_levels; ++level) {
+      for (KeyFlatSet::iterator it = free_cells[level].begin(), end = free_cells[level].end(); it != end; ) {
+        // deepest existing node containing the free one
+        const NODE* node = this->root;
+        unsigned int depth = 0;
+        for (; depth < this->tree_depth - level && this->nodeHasChildren(node); ++depth) {
+          unsigned int pos = computeChildIdx(*it, this->tree_depth - 1 - depth);
+          if (!this->nodeChildExists(node, pos))
+            break;
+          node = this->getNodeChild(node, pos);
+        }
+
+        const unsigned int pruned_level = this->tree_depth - depth;
+        bool promote = false;
+        if (depth > 0 && pruned_level > level && !this->nodeHasChildren(node) && !this->isNodeOccupied(node)) {
+          if (occupied_levels[pruned_level].empty())
+            computeIndexKeys(occupied_cells, pruned_level, occupied_levels[pruned_level]);
+          OcTreeKey pruned_key = computeIndexKey((key_type) pruned_level, *it);
+          promote = (occupied_levels[pruned_level].find(pruned_key) == occupied_levels[pruned_level].end());
+          if (promote)
+            pruned_nodes.push_back(std::make_pair(pruned_level, pruned_key));
+        }
+        if (promote)
+          it = free_cells[level].erase(it);
+        else
+          ++it;
+      }
+    }
+    for (size_t i = 0; i < pruned_nodes.size(); ++i) {
+      if (free_cells.size() <= pruned_nodes[i].first)
+        free_cells.resize(pruned_nodes[i].first + 1);
+      free_cells[pruned_nodes[i].first].insert(pruned_nodes[i].second);
+    }
+
+    // prefer occupied cells over free ones, and nodes covered by a larger free node
+    // (of another ray) are already updated with it
+    const unsigned int max_level = (unsigned int) free_cells.size() - 1;
+    for (unsigned int level = 0; level < max_level; ++level) {
+      for (KeyFlatSet::iterator it = free_cells[level].begin(), end = free_cells[level].end(); it != end; ) {
+        bool covered = (level == 0 && occupied_cells.find(*it) != occupied_cells.end());
+        for (unsigned int coarse = level + 1; coarse <= max_level && !covered; ++coarse)
+          covered = (free_cells[coarse].find(computeIndexKey((key_type) coarse, *it)) != free_cells[coarse].end());
+        if (covered)
+          it = free_cells[level].erase(it);
+        else
+          ++it;
+      }
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeDepthImageUpdate(const float* depth, unsigned int width, unsigned int height,
+                                                          const CameraIntrinsics& intrinsics, const pose6d& pose,
+                                                          double maxrange, size_t row_pitch,
+                                                          std::vector<KeyFlatSet>& free_cells, KeyFlatSet& occupied_cells)
+  {
+    if (row_pitch == 0)
+      row_pitch = width * sizeof(float);
+    DepthImageProjection camera;
+    camera.max_free_level = (this->paging_depth == 0) ? this->tree_depth - 1 : this->tree_depth - this->paging_depth;
+    free_cells.resize(std::max(free_cells.size(), (size_t) camera.max_free_level + 1));
+
+    // occupied endpoints: the pixels within maxrange
+    occupied_cells.reserve(occupied_cells.size() + (size_t) width * height);
+    for (unsigned int v = 0; v < height; ++v) {
+      const float* row = (const float*) ((const char*) depth + v * row_pitch);
+      for (unsigned int u = 0; u < width; ++u) {
+        const float d = row[u];
+        if (!(d > 0.0f) || d == std::numeric_limits<float>::infinity() || (maxrange >= 0.0 && d > maxrange))
+          continue;
+        point3d p = pose.transform(point3d((float) (((double) u - intrinsics.cx) * d / intrinsics.fx),
+                                           (float) (((double) v - intrinsics.cy) * d / intrinsics.fy), d));
+        OcTreeKey key;
+        if (this->coordToKeyChecked(p, key) && (!use_bbx_limit || inBBX(key)))
+          occupied_cells.insert(key);
+      }
+    }
+
+    // free nodes: projection of the octree into the image
+    depth_pyramid.build(depth, width, height, row_pitch, maxrange);
+    float min_depth;
+    float max_depth;
+    if (!depth_pyramid.getDepthRange(0, 0, (int) width - 1, (int) height - 1, min_depth, max_depth))
+      return;
+    camera.pyramid = &depth_pyramid;
+    camera.intrinsics = intrinsics;
+    camera.max_depth = max_depth;
+    const pose6d to_camera = pose.inv();
+    for (unsigned int c = 0; c < 3; ++c) {
+      point3d axis (0.0f, 0.0f, 0.0f);
+      axis(c) = 1.0f;
+      point3d column = to_camera.rot().rotate(axis);
+      for (unsigned int r = 0; r < 3; ++r)
+        camera.rotation[r][c] = column(r);
+      camera.translation[c] = to_camera.trans()(c);
+    }
+    computeDepthImageRecurs(OcTreeKey(0, 0, 0), this->tree_depth, camera, free_cells);
+
+    // prefer occupied cells over free ones (a free node cannot contain an endpoint up to rounding)
+    KeyFlatSet occupied_nodes;
+    for (unsigned int level = 0; level < free_cells.size(); ++level) {
+      if (free_cells[level].empty())
+        continue;
+      occupied_nodes.clear();
+      computeIndexKeys(occupied_cells, level, occupied_nodes);
+      for (KeyFlatSet::iterator it = free_cells[level].begin(), end = free_cells[level].end(); it != end; ) {
+        if (occupied_nodes.find(*it) != occupied_nodes.end())
+          it = free_cells[level].erase(it);
+        else
+          ++it;
+      }
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeDepthImageRecurs(const OcTreeKey& key, unsigned int level,
+                                                          const DepthImageProjection& camera,
+                                                          std::vector<KeyFlatSet>& free_cells) const
+  {
+    // corners of the node in the camera frame
+    const double size = this->resolution * (double) (1 << level);
+    double base[3];
+    double edge[3][3];
+    for (unsigned int r = 0; r < 3; ++r) {
+      base[r] = camera.translation[r];
+      for (unsigned int c = 0; c < 3; ++c) {
+        base[r] += camera.rotation[r][c] * ((double) key[c] - (double) this->tree_max_val) * this->resolution;
+        edge[r][c] = camera.rotation[r][c] * size;
+      }
+    }
+    double corners[8][3];
+    for (unsigned int i = 0; i < 8; ++i) {
+      for (unsigned int r = 0; r < 3; ++r)
+        corners[i][r] = base[r] + ((i & 1) ? edge[r][0] : 0.0) + ((i & 2) ? edge[r][1] : 0.0) + ((i & 4) ? edge[r][2] : 0.0);
+    }
+
+    // frustum culling: skip the node if all corners are outside of one of its planes
+    const CameraIntrinsics& K = camera.intrinsics;
+    const double width = (double) camera.pyramid->getWidth();
+    const double height = (double) camera.pyramid->getHeight();
+    bool outside[6] = {true, true, true, true, true, true};
+    double z_min = std::numeric_limits<double>::max();
+    double z_max = -std::numeric_limits<double>::max();
+    for (unsigned int i = 0; i < 8; ++i) {
+      const double x = corners[i][0];
+      const double y = corners[i][1];
+      const double z = corners[i][2];
+      z_min = std::min(z_min, z);
+      z_max = std::max(z_max, z);
+      if (z > 0.0) outside[0] = false;
+      if (z <= camera.max_depth) outside[1] = false;
+      if (K.fx * x + (K.cx + 0.5) * z >= 0.0) outside[2] = false;
+      if ((width - 0.5 - K.cx) * z - K.fx * x >= 0.0) outside[3] = false;
+      if (K.fy * y + (K.cy + 0.5) * z >= 0.0) outside[4] = false;
+      if ((height - 0.5 - K.cy) * z - K.fy * y >= 0.0) outside[5] = false;
+    }
+    for (unsigned int p = 0; p < 6; ++p) {
+      if (outside[p])
+        return;
+    }
+
+    bool in_bbx = true;
+    if (use_bbx_limit) {
+      const int last = (1 << level) - 1;
+      for (unsigned int i = 0; i < 3; ++i) {
+        if ((int) key[i] + last < (int) bbx_min_key[i] || key[i] > bbx_max_key[i])
+          return;
+        if (key[i] < bbx_min_key[i] || (int) key[i] + last > (int) bbx_max_key[i])
+          in_bbx = false;
+      }
+    }
+
+    // depth range within the projection (only bounded in front of the camera)
+    if (z_min > 0.0) {
+      double u_min = std::numeric_limits<double>::max();
+      double u_max = -std::numeric_limits<double>::max();
+      double v_min = u_min;
+      double v_max = u_max;
+      for (unsigned int i = 0; i < 8; ++i) {
+        const double u = K.fx * corners[i][0] / corners[i][2] + K.cx;
+        const double v = K.fy * corners[i][1] / corners[i][2] + K.cy;
+        u_min = std::min(u_min, u);
+        u_max = std::max(u_max, u);
+        v_min = std::min(v_min, v);
+        v_max = std::max(v_max, v);
+      }
+      // pixel i covers [i-0.5, i+0.5), limited to one pixel outside of the image
+      const int u0 = (int) floor(std::max(u_min, -1.0) + 0.5);
+      const int u1 = (int) floor(std::min(u_max, width) + 0.5);
+      const int v0 = (int) floor(std::max(v_min, -1.0) + 0.5);
+      const int v1 = (int) floor(std::min(v_max, height) + 0.5);
+
+      float min_depth;
+      float max_depth;
+      if (!camera.pyramid->getDepthRange(u0, v0, u1, v1, min_depth, max_depth) || z_min > max_depth)
+        return; // behind all surfaces or not observed
+      if (z_max < min_depth && level <= camera.max_free_level && in_bbx
+          && u0 >= 0 && v0 >= 0 && u1 < (int) width && v1 < (int) height) {
+        free_cells[level].insert(key); // in front of all surfaces
+        return;
+      }
+    }
+
+    if (level == 0) {
+      // leaf: depth of the pixel its center projects to
+      double center[3];
+      for (unsigned int r = 0; r < 3; ++r)
+        center[r] = base[r] + 0.5 * (edge[r][0] + edge[r][1] + edge[r][2]);
+      if (center[2] <= 0.0 || !in_bbx)
+        return;
+      const double u = floor(K.fx * center[0] / center[2] + K.cx + 0.5);
+      const double v = floor(K.fy * center[1] / center[2] + K.cy + 0.5);
+      if (u < 0.0 || v < 0.0 || u >= width || v >= height)
+        return;
+      if (center[2] < camera.pyramid->getDepth((unsigned int) u, (unsigned int) v))
+        free_cells[0].insert(key);
+      return;
+    }
+
+    const key_type child_bit = (key_type) (1 << (level - 1));
+    for (unsigned int i = 0; i < 8; ++i) {
+      OcTreeKey child_key (key);
+      if (i & 1) child_key[0] |= child_bit;
+      if (i & 2) child_key[1] |= child_bit;
+      if (i & 4) child_key[2] |= child_bit;
+      computeDepthImageRecurs(child_key, level - 1, camera, free_cells);
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeIndexKeys(const KeyFlatSet& keys, unsigned int level, KeyFlatSet& index_keys) {
+    index_keys.reserve(keys.size());
+    for (KeyFlatSet::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      index_keys.insert(computeIndexKey((key_type) level, *it));
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeMultiResolutionRayRecurs(const uint64_t from[3], const uint64_t to[3],
+                                                                  unsigned int level, bool ray_end,
+                                                                  const MultiResolutionRay& ray,
+                                                                  std::vector<KeyFlatSet>& free_cells) const
+  {
+    // DDA as in computeRayKeysExact(), with nodes of 2^level keys
+    const unsigned int shift = ray.frac_bits + level;
+    const uint64_t size = (uint64_t) 1 << shift;
+
+    uint64_t cell[3];
+    uint64_t dist[3];
+    uint64_t delta[3];
+    int step[3];
+    unsigned int remaining[3];
+    for (unsigned int i = 0; i < 3; ++i) {
+      cell[i] = from[i] >> shift;
+      const uint64_t cell_end = to[i] >> shift;
+      if (to[i] > from[i]) {
+        step[i] = 1;
+        delta[i] = to[i] - from[i];
+        dist[i] = ((cell[i] + 1) << shift) - from[i];
+        remaining[i] = (unsigned int) (cell_end - cell[i]);
+      } else if (to[i] < from[i]) {
+        step[i] = -1;
+        delta[i] = from[i] - to[i];
+        dist[i] = from[i] - (cell[i] << shift);
+        remaining[i] = (unsigned int) (cell[i] - cell_end);
       } else {
-        ++it;
+        step[i] = 0;
+        delta[i] = 0;
+        dist[i] = 0;
+        remaining[i] = 0;
+      }
+    }
+
+    uint64_t entry[3] = {from[0], from[1], from[2]};
+    uint64_t exit[3];
+    while (true) {
+      // next border crossed: minimum of dist[i] / delta[i], none in the last node
+      unsigned int dim = 3;
+      for (unsigned int i = 0; i < 3; ++i) {
+        if (remaining[i] > 0 && (dim == 3 || dist[i] * delta[dim] < dist[dim] * delta[i]))
+          dim = i;
+      }
+
+      // point where the ray leaves the node, on its border
+      for (unsigned int i = 0; i < 3; ++i) {
+        if (dim == 3)
+          exit[i] = to[i];
+        else if (i == dim)
+          exit[i] = (step[i] > 0) ? (cell[i] + 1) << shift : cell[i] << shift;
+        else {
+          const uint64_t offset = delta[i] * dist[dim] / delta[dim];
+          exit[i] = (step[i] >= 0) ? from[i] + offset : from[i] - offset;
+        }
+      }
+
+      const bool last = ray_end && dim == 3;
+      if (level == 0) {
+        if (!last) // the endpoint is not free
+          free_cells[0].insert(OcTreeKey((key_type) cell[0], (key_type) cell[1], (key_type) cell[2]));
+      } else if (last || refineFreeNode(cell, level, ray)) {
+        // same segment within the node (rounded onto it), one level finer
+        uint64_t sub_from[3], sub_to[3];
+        for (unsigned int i = 0; i < 3; ++i) {
+          const uint64_t lo = cell[i] << shift;
+          const uint64_t hi = lo + size - 1;
+          sub_from[i] = std::min(std::max(entry[i], lo), hi);
+          sub_to[i] = std::min(std::max(exit[i], lo), hi);
+        }
+        computeMultiResolutionRayRecurs(sub_from, sub_to, level - 1, last, ray, free_cells);
+      } else {
+        free_cells[level].insert(OcTreeKey((key_type) (cell[0] << level), (key_type) (cell[1] << level),
+                                           (key_type) (cell[2] << level)));
+      }
+
+      if (dim == 3)
+        break;
+      cell[dim] += step[dim];
+      dist[dim] += size;
+      --remaining[dim];
+      for (unsigned int i = 0; i < 3; ++i)
+        entry[i] = exit[i];
+    }
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::refineFreeNode(const uint64_t cell[3], unsigned int level,
+                                                 const MultiResolutionRay& ray) const
+  {
+    const KeyFlatSet& occupied = (*ray.occupied)[level];
+    OcTreeKey key ((key_type) (cell[0] << level), (key_type) (cell[1] << level), (key_type) (cell[2] << level));
+    if (occupied.find(key) != occupied.end())
+      return true;
+
+    // distances to the bounding sphere of the node, in key units
+    const double edge = (double) (1 << level);
+    double dist_origin = 0.0;
+    double dist_end = 0.0;
+    for (unsigned int i = 0; i < 3; ++i) {
+      const double center = (double) key[i] + 0.5 * edge;
+      dist_origin += (center - ray.origin[i]) * (center - ray.origin[i]);
+      dist_end += (center - ray.end[i]) * (center - ray.end[i]);
+    }
+    const double radius = 0.5 * sqrt(3.0) * edge;
+    return (sqrt(dist_origin) - radius < ray.range * 0.5 * edge)
+        || (sqrt(dist_end) - radius < edge);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::mergeKeySets(std::vector<KeyFlatSet>& sets, KeyFlatSet& cells) {
+    size_t total = cells.size();
+    for (size_t t = 0; t < sets.size(); ++t)
+      total += sets[t].size();
+
+    // an empty target takes over the largest set instead of copying it
+    if (cells.empty()) {
+      size_t largest = 0;
+      for (size_t t = 1; t < sets.size(); ++t) {
+        if (sets[t].size() > sets[largest].size())
+          largest = t;
       }
+      if (!sets.empty())
+        cells.swap(sets[largest]);
     }
+    cells.reserve(total); // upper bound, avoids rehashing while merging
+    for (size_t t = 0; t < sets.size(); ++t)
+      cells.insert(sets[t].begin(), sets[t].end());
   }
 
   template <class NODE>
@@ -268,14 +873,26 @@ namespace octomap {
     // clamp log odds within range:
     log_odds_value = std::min(std::max(log_odds_value, this->clamping_thres_min), this->clamping_thres_max);
 
+    if (this->paging_depth != 0)
+      this->touchSubtree(key);
+
     bool createdRoot = false;
     if (this->root == NULL){
-      this->root = new NODE();
+      this->root = this->allocNode();
       this->tree_size++;
       createdRoot = true;
     }
 
-    return setNodeValueRecurs(this->root, createdRoot, key, 0, log_odds_value, lazy_eval);
+    bool bounds_tracked = this->boundsTracked();
+    NODE* result = setNodeValueRecurs(this->root, createdRoot, key, 0, log_odds_value, lazy_eval);
+    if (bounds_tracked)
+      this->growBounds(key);
+    if (this->paging_depth != 0) {
+      // the subtree of result may just have been created
+      this->touchSubtree(key);
+      this->enforceMemoryBudget();
+    }
+    return result;
   }
 
   template <class NODE>
@@ -299,6 +916,10 @@ namespace octomap {
 
   template <class NODE>
   NODE* OccupancyOcTreeBase<NODE>::updateNode(const OcTreeKey& key, float log_odds_update, bool lazy_eval) {
+    // search() stops at paged-out subtrees
+    if (this->paging_depth != 0)
+      this->touchSubtree(key);
+
     // early abort (no change will happen).
     // may cause an overhead in some configuration, but more often helps
     NODE* leaf = this->search(key);
@@ -312,12 +933,150 @@ namespace octomap {
 
     bool createdRoot = false;
     if (this->root == NULL){
-      this->root = new NODE();
+      this->root = this->allocNode();
       this->tree_size++;
       createdRoot = true;
     }
 
-    return updateNodeRecurs(this->root, createdRoot, key, 0, log_odds_update, lazy_eval);
+    bool bounds_tracked = this->boundsTracked();
+    NODE* result = updateNodeRecurs(this->root, createdRoot, key, 0, log_odds_update, lazy_eval);
+    if (bounds_tracked)
+      this->growBounds(key);
+    if (this->paging_depth != 0) {
+      // the subtree of result may just have been created
+      this->touchSubtree(key);
+      this->enforceMemoryBudget();
+    }
+    return result;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateNodes(const std::vector<std::pair<OcTreeKey, float> >& updates, bool lazy_eval) {
+    updateNodesAtDepth(updates, this->tree_depth, lazy_eval);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateNodesAtDepth(const std::vector<std::pair<OcTreeKey, float> >& updates,
+                                                     unsigned int depth, bool lazy_eval) {
+    assert(depth > 0 && depth <= this->tree_depth);
+    if (updates.empty())
+      return;
+
+    // stop copying on write once the last snapshot is gone
+    if (this->copy_on_write && numSnapshots() == 0)
+      releaseSnapshotMemory();
+
+    // Morton order groups all updates below the same inner node, the index
+    // keeps updates of the same key in their original order
+    std::vector<std::pair<morton_type, size_t> > order;
+    order.reserve(updates.size());
+    for (size_t i = 0; i < updates.size(); ++i)
+      order.push_back(std::make_pair(computeMortonCode(updates[i].first), i));
+    std::sort(order.begin(), order.end());
+
+    // page in before, record the access to new subtrees after the updates
+    // (each node is within one subtree for paging)
+    assert(this->paging_depth == 0 || depth >= this->paging_depth);
+    if (this->paging_depth != 0)
+      touchSubtrees(updates, order);
+
+    bool createdRoot = false;
+    if (this->root == NULL){
+      this->root = this->allocNode();
+      this->tree_size++;
+      createdRoot = true;
+    }
+
+    bool bounds_tracked = this->boundsTracked();
+    if (this->useParallelTraversal(true) && depth > 2)
+      updateNodesParallel(createdRoot, depth, updates, order, lazy_eval);
+    else
+      updateNodesRecurs(this->root, createdRoot, 0, depth, updates, &order[0], &order[0] + order.size(), lazy_eval);
+    if (bounds_tracked) {
+      // both corners of the nodes
+      const key_type level = (key_type) (this->tree_depth - depth);
+      const key_type mask = (key_type) ((1 << level) - 1);
+      for (size_t i = 0; i < updates.size(); ++i) {
+        const OcTreeKey& key = updates[i].first;
+        this->growBounds(computeIndexKey(level, key));
+        if (level > 0)
+          this->growBounds(OcTreeKey(key[0] | mask, key[1] | mask, key[2] | mask));
+      }
+    }
+    if (this->paging_depth != 0) {
+      touchSubtrees(updates, order);
+      this->enforceMemoryBudget();
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateNodesParallel(bool created_root, unsigned int target_depth,
+                                                      const std::vector<std::pair<OcTreeKey, float> >& updates,
+                                                      const std::vector<std::pair<morton_type, size_t> >& order, bool lazy_eval) {
+    const std::pair<morton_type, size_t>* begin = &order[0];
+    const std::pair<morton_type, size_t>* end = begin + order.size();
+
+    // creates (or expands) the nodes above the subtrees, collects the subtrees
+    UpdateTasks tasks (2);
+    updateNodesRecurs(this->root, created_root, 0, target_depth, updates, begin, end, lazy_eval, &tasks);
+
+    // the subtrees are disjoint, only node memory (see updateNodesRecurs) and
+    // the changed keys (collected per subtree) are shared
+    std::vector<UpdateTask>& list = tasks.list;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(this->num_threads)
+#endif
+    for (int i = 0; i < (int)list.size(); ++i) {
+      list[i].changed = updateNodesRecurs(list[i].node, list[i].created, tasks.depth, target_depth, updates,
+                                          list[i].begin, list[i].end, lazy_eval, NULL,
+                                          use_change_detection ? &list[i].key_changes : NULL);
+    }
+
+    for (size_t i = 0; i < list.size(); ++i) {
+      for (size_t k = 0; k < list[i].key_changes.size(); ++k) {
+        const KeyChange& change = list[i].key_changes[k];
+        trackChangedKey(change.key, change.created, change.flipped, change.depth);
+      }
+    }
+
+    // serial fix-up of the few inner nodes above the subtrees
+    tasks.collect = false;
+    updateNodesRecurs(this->root, false, 0, target_depth, updates, begin, end, lazy_eval, &tasks);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::trackChangedKey(const OcTreeKey& key, bool created, bool flipped, unsigned int depth) {
+    if (created)
+      changed_keys.insert(std::pair<OcTreeKey,bool>(key, true));
+    if (flipped) {
+      KeyBoolMap::iterator it = changed_keys.find(key);
+      if (it == changed_keys.end())
+        changed_keys.insert(std::pair<OcTreeKey,bool>(key, false));
+      else if (it->second == false) {
+        changed_keys.erase(it);
+        changed_key_depths.erase(key);
+        return;
+      }
+    }
+
+    // a coarse node contains the leaf with its key, the coarsest change covers both
+    if (depth < this->tree_depth && (created || flipped)) {
+      std::pair<KeyDepthMap::iterator, bool> entry = changed_key_depths.insert(std::make_pair(key, depth));
+      if (!entry.second && depth < entry.first->second)
+        entry.first->second = depth;
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::touchSubtrees(const std::vector<std::pair<OcTreeKey, float> >& updates,
+                                                const std::vector<std::pair<morton_type, size_t> >& order) {
+    // all updates of a subtree are adjacent in Morton order
+    key_type level = (key_type) (this->tree_depth - this->paging_depth);
+    for (size_t i = 0; i < order.size(); ++i) {
+      const OcTreeKey& key = updates[order[i].second].first;
+      if (i == 0 || computeIndexKey(level, key) != computeIndexKey(level, updates[order[i-1].second].first))
+        this->touchSubtree(key);
+    }
   }
 
   template <class NODE>
@@ -387,42 +1146,241 @@ namespace octomap {
         }
       }
 
-      if (lazy_eval)
-        return updateNodeRecurs(this->getNodeChild(node, pos), created_node, key, depth+1, log_odds_update, lazy_eval);
-      else {
-        NODE* retval = updateNodeRecurs(this->getNodeChild(node, pos), created_node, key, depth+1, log_odds_update, lazy_eval);
-        // prune node if possible, otherwise set own probability
-        // note: combining both did not lead to a speedup!
-        if (this->pruneNode(node)){
-          // return pointer to current parent (pruned), the just updated node no longer exists
-          retval = node;
-        } else{
-          node->updateOccupancyChildren();
-        }
+      if (lazy_eval) {
+        if (use_dirty_tracking)
+          node->setDirty();
+        return updateNodeRecurs(this->getNodeChildForWrite(node, pos), created_node, key, depth+1, log_odds_update, lazy_eval);
+      }
+      else {
+        NODE* retval = updateNodeRecurs(this->getNodeChildForWrite(node, pos), created_node, key, depth+1, log_odds_update, lazy_eval);
+        // prune node if possible, otherwise set own probability
+        // note: combining both did not lead to a speedup!
+        if (this->pruneNode(node)){
+          // return pointer to current parent (pruned), the just updated node no longer exists
+          retval = node;
+        } else{
+          node->updateOccupancyChildren();
+        }
+
+        return retval;
+      }
+    }
+
+    // at last level, update node, end of recursion
+    else {
+      if (use_change_detection) {
+        bool occBefore = this->isNodeOccupied(node);
+        updateNodeLogOdds(node, log_odds_update);
+
+        // new node or occupancy changed, track it
+        trackChangedKey(key, node_just_created, !node_just_created && occBefore != this->isNodeOccupied(node),
+                        this->tree_depth);
+      } else {
+        updateNodeLogOdds(node, log_odds_update);
+      }
+      return node;
+    }
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::updateNodesRecurs(NODE* node, bool node_just_created, unsigned int depth,
+                                                    unsigned int target_depth,
+                                                    const std::vector<std::pair<OcTreeKey, float> >& updates,
+                                                    const std::pair<morton_type, size_t>* begin, const std::pair<morton_type, size_t>* end,
+                                                    bool lazy_eval, UpdateTasks* tasks, std::vector<KeyChange>* key_changes) {
+    assert(node && begin != end);
+
+    if (tasks != NULL && depth == tasks->depth) {
+      if (tasks->collect) {
+        tasks->list.push_back(UpdateTask(node, node_just_created, begin, end));
+        return false;
+      }
+      return tasks->list[tasks->next++].changed;
+    }
+
+    // coarse target: each update covers the whole volume of the node, in their original order
+    if (depth == target_depth && target_depth < this->tree_depth) {
+      const OcTreeKey node_key = computeIndexKey(this->tree_depth - depth, updates[begin->second].first);
+      bool changed = false;
+      for (const std::pair<morton_type, size_t>* it = begin; it != end; ++it) {
+        if (updateVolumeRecurs(node, node_just_created, node_key, depth, updates[it->second].second, lazy_eval, key_changes))
+          changed = true;
+        node_just_created = false;
+      }
+      return changed;
+    }
+
+    // at last level, apply all updates of this key in their original order
+    // note: the node operations (updateNodeLogOdds, isNodeCollapsible, pruneNode, expandNode)
+    // stay virtual here and in updateNodeRecurs, inlined calls did not lead to a speedup!
+    if (depth == this->tree_depth) {
+      const bool created = node_just_created;
+      bool flipped = false;
+      bool changed = false;
+      for (const std::pair<morton_type, size_t>* it = begin; it != end; ++it) {
+        float log_odds_update = updates[it->second].second;
+
+        // same early abort as in updateNode (no change will happen)
+        if (!node_just_created
+            && ((log_odds_update >= 0 && node->getLogOdds() >= this->clamping_thres_max)
+            || ( log_odds_update <= 0 && node->getLogOdds() <= this->clamping_thres_min)))
+        {
+          continue;
+        }
+
+        if (use_change_detection && !node_just_created) {
+          bool occBefore = this->isNodeOccupied(node);
+          updateNodeLogOdds(node, log_odds_update);
+          if (occBefore != this->isNodeOccupied(node))
+            flipped = !flipped; // tracking it twice would undo it again
+        } else {
+          updateNodeLogOdds(node, log_odds_update);
+        }
+        node_just_created = false;
+        changed = true;
+      }
+
+      if (use_change_detection && (created || flipped)) {
+        const OcTreeKey& key = updates[begin->second].first;
+        if (key_changes != NULL)
+          key_changes->push_back(KeyChange(key, created, flipped, this->tree_depth));
+        else
+          trackChangedKey(key, created, flipped, this->tree_depth);
+      }
+      return changed;
+    }
+
+    if (!this->nodeHasChildren(node) && !node_just_created) {
+      // pruned node: only expand it if any update changes something
+      bool all_at_threshold = true;
+      for (const std::pair<morton_type, size_t>* it = begin; it != end && all_at_threshold; ++it) {
+        float log_odds_update = updates[it->second].second;
+        all_at_threshold = ((log_odds_update >= 0 && node->getLogOdds() >= this->clamping_thres_max)
+                            || ( log_odds_update <= 0 && node->getLogOdds() <= this->clamping_thres_min));
+      }
+      if (all_at_threshold)
+        return false;
+
+      // node memory is shared with parallel updates of other subtrees (see updateNodesParallel)
+#ifdef _OPENMP
+      #pragma omp critical (octomap_node_memory)
+#endif
+      this->expandNode(node);
+    }
+
+    // split the (sorted) updates by child index and follow down
+    const unsigned int level = this->tree_depth - 1 - depth;
+    bool changed = false;
+    for (const std::pair<morton_type, size_t>* child_begin = begin; child_begin != end; ) {
+      unsigned int pos = computeMortonChildIdx(child_begin->first, level);
+      const std::pair<morton_type, size_t>* child_end = child_begin + 1;
+      while (child_end != end && computeMortonChildIdx(child_end->first, level) == pos)
+        ++child_end;
+
+      bool created_node = false;
+      if (!this->nodeChildExists(node, pos)) {
+#ifdef _OPENMP
+        #pragma omp critical (octomap_node_memory)
+#endif
+        this->createNodeChild(node, pos);
+        created_node = true;
+      }
+      if (updateNodesRecurs(this->getNodeChildForWrite(node, pos), created_node, depth+1, target_depth, updates,
+                            child_begin, child_end, lazy_eval, tasks, key_changes))
+        changed = true;
+
+      child_begin = child_end;
+    }
 
-        return retval;
+    // prune node if possible, otherwise set own probability (once for all updates)
+    if (changed && !lazy_eval) {
+      bool pruned = false;
+      if (this->isNodeCollapsible(node)) {
+#ifdef _OPENMP
+        #pragma omp critical (octomap_node_memory)
+#endif
+        pruned = this->pruneNode(node);
       }
+      if (!pruned)
+        node->updateOccupancyChildren();
+    }
+    else if (changed && use_dirty_tracking) {
+      node->setDirty();
     }
 
-    // at last level, update node, end of recursion
-    else {
-      if (use_change_detection) {
-        bool occBefore = this->isNodeOccupied(node);
-        updateNodeLogOdds(node, log_odds_update);
+    return changed;
+  }
 
-        if (node_just_created){  // new node
-          changed_keys.insert(std::pair<OcTreeKey,bool>(key, true));
-        } else if (occBefore != this->isNodeOccupied(node)) {  // occupancy changed, track it
-          KeyBoolMap::iterator it = changed_keys.find(key);
-          if (it == changed_keys.end())
-            changed_keys.insert(std::pair<OcTreeKey,bool>(key, false));
-          else if (it->second == false)
-            changed_keys.erase(it);
-        }
-      } else {
-        updateNodeLogOdds(node, log_odds_update);
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::updateVolumeRecurs(NODE* node, bool node_just_created, const OcTreeKey& key,
+                                                     unsigned int depth, float log_odds_update, bool lazy_eval,
+                                                     std::vector<KeyChange>* key_changes) {
+    assert(node);
+    if (!this->nodeHasChildren(node)) {
+      // leaf at any depth: one update for its whole volume
+      if (!node_just_created
+          && ((log_odds_update >= 0 && node->getLogOdds() >= this->clamping_thres_max)
+          || ( log_odds_update <= 0 && node->getLogOdds() <= this->clamping_thres_min)))
+      {
+        return false;
       }
-      return node;
+
+      bool occBefore = this->isNodeOccupied(node);
+      this->updateNodeLogOdds(node, log_odds_update);
+      bool flipped = !node_just_created && occBefore != this->isNodeOccupied(node);
+      if (use_change_detection && (node_just_created || flipped)) {
+        // the key of the node at its depth (center key), see changedKeyDepth
+        OcTreeKey node_key = this->adjustKeyAtDepth(key, depth);
+        if (key_changes != NULL)
+          key_changes->push_back(KeyChange(node_key, node_just_created, flipped, depth));
+        else
+          trackChangedKey(node_key, node_just_created, flipped, depth);
+      }
+      return true;
+    }
+
+    // inner node: all leaves below, unknown space in it becomes new leaves
+    const key_type child_bit = (key_type) (1 << (this->tree_depth - 1 - depth));
+    bool changed = false;
+    for (unsigned int i = 0; i < 8; ++i) {
+      OcTreeKey child_key (key);
+      if (i & 1) child_key[0] |= child_bit;
+      if (i & 2) child_key[1] |= child_bit;
+      if (i & 4) child_key[2] |= child_bit;
+
+      bool created_node = false;
+      if (!this->nodeChildExists(node, i)) {
+#ifdef _OPENMP
+        #pragma omp critical (octomap_node_memory)
+#endif
+        this->createNodeChild(node, i);
+        created_node = true;
+      }
+      if (updateVolumeRecurs(this->getNodeChildForWrite(node, i), created_node, child_key, depth+1, log_odds_update,
+                             lazy_eval, key_changes))
+        changed = true;
+    }
+    if (changed)
+      updateChangedInnerNode(node, lazy_eval);
+    return changed;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateChangedInnerNode(NODE* node, bool lazy_eval) {
+    if (!lazy_eval) {
+      // node memory is shared with parallel updates of other subtrees (see updateNodesParallel)
+      bool pruned = false;
+      if (this->isNodeCollapsible(node)) {
+#ifdef _OPENMP
+        #pragma omp critical (octomap_node_memory)
+#endif
+        pruned = this->pruneNode(node);
+      }
+      if (!pruned)
+        node->updateOccupancyChildren();
+    }
+    else if (use_dirty_tracking) {
+      node->setDirty();
     }
   }
 
@@ -451,10 +1409,13 @@ namespace octomap {
         }
       }
 
-      if (lazy_eval)
-        return setNodeValueRecurs(this->getNodeChild(node, pos), created_node, key, depth+1, log_odds_value, lazy_eval);
+      if (lazy_eval) {
+        if (use_dirty_tracking)
+          node->setDirty();
+        return setNodeValueRecurs(this->getNodeChildForWrite(node, pos), created_node, key, depth+1, log_odds_value, lazy_eval);
+      }
       else {
-        NODE* retval = setNodeValueRecurs(this->getNodeChild(node, pos), created_node, key, depth+1, log_odds_value, lazy_eval);
+        NODE* retval = setNodeValueRecurs(this->getNodeChildForWrite(node, pos), created_node, key, depth+1, log_odds_value, lazy_eval);
         // prune node if possible, otherwise set own probability
         // note: combining both did not lead to a speedup!
         if (this->pruneNode(node)){
@@ -474,15 +1435,9 @@ namespace octomap {
         bool occBefore = this->isNodeOccupied(node);
         node->setLogOdds(log_odds_value);
 
-        if (node_just_created){  // new node
-          changed_keys.insert(std::pair<OcTreeKey,bool>(key, true));
-        } else if (occBefore != this->isNodeOccupied(node)) {  // occupancy changed, track it
-          KeyBoolMap::iterator it = changed_keys.find(key);
-          if (it == changed_keys.end())
-            changed_keys.insert(std::pair<OcTreeKey,bool>(key, false));
-          else if (it->second == false)
-            changed_keys.erase(it);
-        }
+        // new node or occupancy changed, track it
+        trackChangedKey(key, node_just_created, !node_just_created && occBefore != this->isNodeOccupied(node),
+                        this->tree_depth);
       } else {
         node->setLogOdds(log_odds_value);
       }
@@ -492,8 +1447,47 @@ namespace octomap {
 
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::updateInnerOccupancy(){
-    if (this->root)
-      this->updateInnerOccupancyRecurs(this->root, 0);
+    if (this->root == NULL)
+      return;
+
+    bool full = true;
+    if (use_dirty_tracking) {
+      full = (tree_dirty_flags & OcTreeNode::DIRTY_INNER_OCCUPANCY) != 0;
+      tree_dirty_flags &= ~OcTreeNode::DIRTY_INNER_OCCUPANCY;
+      if (!this->nodeHasChildren(this->root) || !(full || this->root->isDirty(OcTreeNode::DIRTY_INNER_OCCUPANCY)))
+        return;
+    }
+
+    if (!this->useParallelTraversal(true) || !this->nodeHasChildren(this->root)) {
+      if (use_dirty_tracking)
+        this->updateInnerOccupancyDirtyRecurs(this->root, 0, full);
+      else
+        this->updateInnerOccupancyRecurs(this->root, 0);
+      return;
+    }
+
+    // the subtrees of the root in parallel, then the root itself
+    NODE* root = this->root;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(this->num_threads)
+#endif
+    for (int i=0; i<8; i++) {
+      if (!this->nodeChildExists(root, i))
+        continue;
+      NODE* child = this->getNodeChild(root, i);
+      if (!use_dirty_tracking)
+        this->updateInnerOccupancyRecurs(child, 1);
+      else if (this->nodeHasChildren(child) && (full || child->isDirty(OcTreeNode::DIRTY_INNER_OCCUPANCY)))
+        this->updateInnerOccupancyDirtyRecurs(child, 1, full);
+    }
+    root->updateOccupancyChildren();
+    root->clearDirty(OcTreeNode::DIRTY_INNER_OCCUPANCY);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::beforePageOut(NODE* node) {
+    // lazy updates may have left the inner nodes outdated, their dirty flags are not stored
+    updateInnerOccupancyRecurs(node, this->paging_depth);
   }
 
   template <class NODE>
@@ -506,7 +1500,15 @@ namespace octomap {
       if (depth < this->tree_depth){
         for (unsigned int i=0; i<8; i++) {
           if (this->nodeChildExists(node, i)) {
-            updateInnerOccupancyRecurs(this->getNodeChild(node, i), depth+1);
+            NODE* child = this->getNodeChild(node, i);
+            if (this->copy_on_write && child->isShared()) {
+              // only copy the shared nodes which change
+              NODE* copy = updateSharedInnerOccupancyRecurs(child, depth+1);
+              if (copy != NULL)
+                replaceSharedNodeChild(node, i, copy);
+            } else {
+              updateInnerOccupancyRecurs(child, depth+1);
+            }
           }
         }
       }
@@ -514,18 +1516,319 @@ namespace octomap {
     }
   }
 
+  template <class NODE>
+  NODE* OccupancyOcTreeBase<NODE>::updateSharedInnerOccupancyRecurs(const NODE* node, unsigned int depth){
+    if (!this->nodeHasChildren(node))
+      return NULL;
+
+    // all nodes below are shared as well, the copy takes over the changed children
+    NODE* copy = NULL;
+    if (depth < this->tree_depth){
+      for (unsigned int i=0; i<8; i++) {
+        if (this->nodeChildExists(node, i)) {
+          NODE* child_copy = updateSharedInnerOccupancyRecurs(this->getNodeChild(node, i), depth+1);
+          if (child_copy != NULL) {
+            if (copy == NULL)
+              copy = copySharedNode(node);
+            replaceSharedNodeChild(copy, i, child_copy);
+          }
+        }
+      }
+    }
+
+    // without changed children, the copy is only kept if the node itself changes
+    bool children_changed = (copy != NULL);
+    if (!children_changed)
+      copy = copySharedNode(node);
+    copy->updateOccupancyChildren();
+    if (!children_changed && *copy == *node) {
+      this->freeNodeChildren(copy);
+      this->freeNode(copy);
+      return NULL;
+    }
+    return copy;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateInnerOccupancyDirtyRecurs(NODE* node, unsigned int depth, bool full){
+    assert(node && this->nodeHasChildren(node));
+
+    // clean subtrees are up to date, only follow dirty ones
+    for (unsigned int i=0; i<8; i++) {
+      if (this->nodeChildExists(node, i)) {
+        const NODE* child = this->getNodeChild(node, i);
+        if (this->nodeHasChildren(child) && (full || child->isDirty(OcTreeNode::DIRTY_INNER_OCCUPANCY)))
+          updateInnerOccupancyDirtyRecurs(this->getNodeChildForWrite(node, i), depth+1, full);
+      }
+    }
+    node->updateOccupancyChildren();
+    node->clearDirty(OcTreeNode::DIRTY_INNER_OCCUPANCY);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::enableDirtyTracking(bool enable) {
+    // nothing is known about changes made while tracking was off
+    if (enable && !use_dirty_tracking)
+      markTreeDirty();
+    use_dirty_tracking = enable;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::prune() {
+    if (!use_dirty_tracking) {
+      OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::prune();
+      return;
+    }
+    if (this->root == NULL)
+      return;
+
+    bool full = (tree_dirty_flags & OcTreeNode::DIRTY_PRUNE) != 0;
+    bool bounds_tracked = this->boundsTracked();
+    if (full || this->root->isDirty(OcTreeNode::DIRTY_PRUNE))
+      pruneDirtyRecurs(this->root, 0, full);
+    tree_dirty_flags &= ~OcTreeNode::DIRTY_PRUNE;
+    if (bounds_tracked)
+      this->size_changed = false;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::pruneDirtyRecurs(NODE* node, unsigned int depth, bool full) {
+    assert(node);
+
+    // bottom-up in a single pass: children are pruned before their parent is tested
+    for (unsigned int i=0; i<8; i++) {
+      if (this->nodeChildExists(node, i)) {
+        const NODE* child = this->getNodeChild(node, i);
+        if (this->nodeHasChildren(child) && (full || child->isDirty(OcTreeNode::DIRTY_PRUNE)))
+          pruneDirtyRecurs(this->getNodeChildForWrite(node, i), depth+1, full);
+      }
+    }
+    node->clearDirty(OcTreeNode::DIRTY_PRUNE);
+
+    // as in OcTreeBaseImpl::prune(), the root is never pruned
+    if (depth > 0)
+      this->pruneNode(node);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::expand() {
+    OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::expand();
+    tree_dirty_flags |= OcTreeNode::DIRTY_PRUNE;
+  }
+
+  template <class NODE>
+  const OccupancyOcTreeBase<NODE>* OccupancyOcTreeBase<NODE>::snapshot() {
+    if (snapshot_record != NULL) {
+      OCTOMAP_ERROR("Cannot take a snapshot of a snapshot\n");
+      return NULL;
+    }
+    if (this->isPagingEnabled()) {
+      OCTOMAP_ERROR("Snapshots are not supported together with paging\n");
+      return NULL;
+    }
+#ifdef OCTOMAP_NO_NODE_FLAGS
+    OCTOMAP_ERROR("Snapshots need the node flags, which are not compiled in (OCTOMAP_NODE_FLAGS)\n");
+    return NULL;
+#endif
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // copy-on-write replaces single nodes, the slots of a block can't be redirected
+    OCTOMAP_ERROR("Snapshots are not supported with indexed children (OCTOMAP_INDEXED_CHILDREN)\n");
+    return NULL;
+#endif
+
+    OccupancyOcTreeBase<NODE>* snap = dynamic_cast<OccupancyOcTreeBase<NODE>*>(this->create());
+    if (snap == NULL) {
+      OCTOMAP_ERROR("Could not create a snapshot of tree type %s\n", this->getTreeType().c_str());
+      return NULL;
+    }
+    snap->clearKeyRays();
+    releaseSnapshotMemory();
+
+    snap->clamping_thres_min = this->clamping_thres_min;
+    snap->clamping_thres_max = this->clamping_thres_max;
+    snap->prob_hit_log = this->prob_hit_log;
+    snap->prob_miss_log = this->prob_miss_log;
+    snap->occ_prob_thres_log = this->occ_prob_thres_log;
+    snap->use_bbx_limit = use_bbx_limit;
+    snap->bbx_min = bbx_min;
+    snap->bbx_max = bbx_max;
+    snap->bbx_min_key = bbx_min_key;
+    snap->bbx_max_key = bbx_max_key;
+
+    snap->root = this->root;
+    snap->tree_size = this->tree_size;
+    snap->num_nodes_depth = this->num_nodes_depth;
+    snap->num_child_arrays = this->num_child_arrays - this->num_retired_child_arrays;
+    snap->snapshot_record = new OcTreeSnapshotRecord(++snapshot_sequence);
+    snapshot_records.push_back(snap->snapshot_record);
+
+    // from now on, shared nodes are copied before they are modified. Nodes below
+    // a shared node are shared as well and get marked when their parent is copied.
+    this->copy_on_write = true;
+    if (this->root != NULL) {
+      // the root has no parent to be copied from, replace it right away
+      NODE* old_root = this->root;
+      this->root = copySharedNode(old_root);
+      RetiredNode retired = {old_root, snapshot_sequence, false};
+      retired_nodes.push_back(retired);
+      this->num_retired_child_arrays += this->countChildArrays(old_root);
+    }
+
+    return snap;
+  }
+
+  template <class NODE>
+  size_t OccupancyOcTreeBase<NODE>::numSnapshots() const {
+    size_t num = 0;
+    for (size_t i = 0; i < snapshot_records.size(); ++i) {
+      if (!snapshot_records[i]->isReleased())
+        ++num;
+    }
+    return num;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::releaseSnapshotMemory() {
+    // collect deleted snapshots, find the oldest one still alive
+    unsigned long min_sequence = std::numeric_limits<unsigned long>::max();
+    size_t num_alive = 0;
+    for (size_t i = 0; i < snapshot_records.size(); ++i) {
+      OcTreeSnapshotRecord* record = snapshot_records[i];
+      if (record->isReleased()) {
+        delete record;
+      } else {
+        min_sequence = std::min(min_sequence, record->getSequence());
+        snapshot_records[num_alive++] = record;
+      }
+    }
+    snapshot_records.resize(num_alive);
+
+    // a retired node can only be seen by snapshots up to its sequence number
+    size_t num_kept = 0;
+    for (size_t i = 0; i < retired_nodes.size(); ++i) {
+      const RetiredNode& retired = retired_nodes[i];
+      if (retired.sequence >= min_sequence) {
+        retired_nodes[num_kept++] = retired;
+      } else if (retired.subtree) {
+        size_t num_allocated = this->num_child_arrays;
+        deleteRetiredNodeRecurs(retired.node);
+        this->num_retired_child_arrays -= num_allocated - this->num_child_arrays;
+      } else {
+        // the children were taken over by the node's replacement
+        this->num_retired_child_arrays -= this->countChildArrays(retired.node);
+        this->freeNodeChildren(retired.node);
+        this->freeNode(retired.node);
+      }
+    }
+    retired_nodes.resize(num_kept);
+
+    // the tree is no longer shared, remaining SHARED marks only cause an extra
+    // copy after the next snapshot
+    if (snapshot_records.empty())
+      this->copy_on_write = false;
+  }
+
+  template <class NODE>
+  NODE* OccupancyOcTreeBase<NODE>::unshareNodeChild(NODE* node, unsigned int childIdx) {
+    NODE* child = this->getNodeChild(node, childIdx);
+    if (!child->isShared())
+      return child;
+
+    NODE* copy = copySharedNode(child);
+    replaceSharedNodeChild(node, childIdx, copy);
+    return copy;
+  }
+
+  template <class NODE>
+  NODE* OccupancyOcTreeBase<NODE>::copySharedNode(const NODE* node) {
+    NODE* copy = this->copyNodeShallow(node);
+    if (node->isDirty(OcTreeNode::DIRTY_INNER_OCCUPANCY))
+      copy->setDirty(OcTreeNode::DIRTY_INNER_OCCUPANCY);
+    if (node->isDirty(OcTreeNode::DIRTY_PRUNE))
+      copy->setDirty(OcTreeNode::DIRTY_PRUNE);
+    markChildrenShared(copy);
+    return copy;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::replaceSharedNodeChild(NODE* node, unsigned int childIdx, NODE* copy) {
+    NODE* child = this->getNodeChild(node, childIdx);
+    this->replaceNodeChild(node, childIdx, copy);
+
+    // the children were taken over by the copy
+    if (snapshot_records.empty()) {
+      this->freeNodeChildren(child);
+      this->freeNode(child);
+    } else {
+      RetiredNode retired = {child, snapshot_sequence, false};
+      retired_nodes.push_back(retired);
+      this->num_retired_child_arrays += this->countChildArrays(child);
+    }
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::retainSubtree(NODE* node) {
+    if (!node->isShared() || snapshot_records.empty())
+      return false;
+
+    // the caller counts the child arrays of the subtree as retired
+    RetiredNode retired = {node, snapshot_sequence, true};
+    retired_nodes.push_back(retired);
+    return true;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::markChildrenShared(NODE* node) {
+    if (!this->nodeHasChildren(node))
+      return;
+    for (unsigned int i=0; i<8; i++) {
+      if (this->nodeChildExists(node, i))
+        this->getNodeChild(node, i)->setShared();
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::deleteRetiredNodeRecurs(NODE* node) {
+    if (this->nodeHasChildren(node)) {
+      for (unsigned int i=0; i<8; i++) {
+        if (this->nodeChildExists(node, i))
+          deleteRetiredNodeRecurs(this->getNodeChild(node, i));
+      }
+    }
+    this->freeNodeChildren(node);
+    this->freeNode(node);
+  }
+
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::toMaxLikelihood() {
     if (this->root == NULL)
       return;
+    this->pageInAll();
 
     // convert bottom up
-    for (unsigned int depth=this->tree_depth; depth>0; depth--) {
-      toMaxLikelihoodRecurs(this->root, 0, depth);
+    if (this->useParallelTraversal(true)) {
+      // each subtree of the root on its own
+      NODE* root = this->root;
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(this->num_threads)
+#endif
+      for (int i=0; i<8; i++) {
+        if (this->nodeChildExists(root, i)) {
+          for (unsigned int depth=this->tree_depth; depth>0; depth--)
+            toMaxLikelihoodRecurs(this->getNodeChild(root, i), 1, depth);
+        }
+      }
+    } else {
+      for (unsigned int depth=this->tree_depth; depth>0; depth--) {
+        toMaxLikelihoodRecurs(this->root, 0, depth);
+      }
     }
 
     // convert root
     nodeToMaxLikelihood(this->root);
+
+    // all leaves changed, the next prune() has to visit the whole tree
+    tree_dirty_flags |= OcTreeNode::DIRTY_PRUNE;
   }
 
   template <class NODE>
@@ -537,7 +1840,7 @@ namespace octomap {
     if (depth < max_depth) {
       for (unsigned int i=0; i<8; i++) {
         if (this->nodeChildExists(node, i)) {
-          toMaxLikelihoodRecurs(this->getNodeChild(node, i), depth+1, max_depth);
+          toMaxLikelihoodRecurs(this->getNodeChildForWrite(node, i), depth+1, max_depth);
         }
       }
     }
@@ -638,124 +1941,9 @@ namespace octomap {
   template <class NODE>
   bool OccupancyOcTreeBase<NODE>::castRay(const point3d& origin, const point3d& directionP, point3d& end,
                                           bool ignoreUnknown, double maxRange) const {
-
-    /// ----------  see OcTreeBase::computeRayKeys  -----------
-
-    // Initialization phase -------------------------------------------------------
-    OcTreeKey current_key;
-    if ( !OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::coordToKeyChecked(origin, current_key) ) {
-      OCTOMAP_WARNING_STR("Coordinates out of bounds during ray casting");
-      return false;
-    }
-
-    NODE* startingNode = this->search(current_key);
-    if (startingNode){
-      if (this->isNodeOccupied(startingNode)){
-        // Occupied node found at origin
-        // (need to convert from key, since origin does not need to be a voxel center)
-        end = this->keyToCoord(current_key);
-        return true;
-      }
-    } else if(!ignoreUnknown){
-      end = this->keyToCoord(current_key);
-      return false;
-    }
-
-    point3d direction = directionP.normalized();
-    bool max_range_set = (maxRange > 0.0);
-
-    int step[3];
-    double tMax[3];
-    double tDelta[3];
-
-    for(unsigned int i=0; i < 3; ++i) {
-      // compute step direction
-      if (direction(i) > 0.0) step[i] =  1;
-      else if (direction(i) < 0.0)   step[i] = -1;
-      else step[i] = 0;
-
-      // compute tMax, tDelta
-      if (step[i] != 0) {
-        // corner point of voxel (in direction of ray)
-        double voxelBorder = this->keyToCoord(current_key[i]);
-        voxelBorder += double(step[i] * this->resolution * 0.5);
-
-        tMax[i] = ( voxelBorder - origin(i) ) / direction(i);
-        tDelta[i] = this->resolution / fabs( direction(i) );
-      }
-      else {
-        tMax[i] =  std::numeric_limits<double>::max();
-        tDelta[i] = std::numeric_limits<double>::max();
-      }
-    }
-
-    if (step[0] == 0 && step[1] == 0 && step[2] == 0){
-    	OCTOMAP_ERROR("Raycasting in direction (0,0,0) is not possible!");
-    	return false;
-    }
-
-    // for speedup:
-    double maxrange_sq = maxRange *maxRange;
-
-    // Incremental phase  ---------------------------------------------------------
-
-    bool done = false;
-
-    while (!done) {
-      unsigned int dim;
-
-      // find minimum tMax:
-      if (tMax[0] < tMax[1]){
-        if (tMax[0] < tMax[2]) dim = 0;
-        else                   dim = 2;
-      }
-      else {
-        if (tMax[1] < tMax[2]) dim = 1;
-        else                   dim = 2;
-      }
-
-      // check for overflow:
-      if ((step[dim] < 0 && current_key[dim] == 0)
-    		  || (step[dim] > 0 && current_key[dim] == 2* this->tree_max_val-1))
-      {
-        OCTOMAP_WARNING("Coordinate hit bounds in dim %d, aborting raycast\n", dim);
-        // return border point nevertheless:
-        end = this->keyToCoord(current_key);
-        return false;
-      }
-
-      // advance in direction "dim"
-      current_key[dim] += step[dim];
-      tMax[dim] += tDelta[dim];
-
-
-      // generate world coords from key
-      end = this->keyToCoord(current_key);
-
-      // check for maxrange:
-      if (max_range_set){
-        double dist_from_origin_sq(0.0);
-        for (unsigned int j = 0; j < 3; j++) {
-          dist_from_origin_sq += ((end(j) - origin(j)) * (end(j) - origin(j)));
-        }
-        if (dist_from_origin_sq > maxrange_sq)
-          return false;
-
-      }
-
-      NODE* currentNode = this->search(current_key);
-      if (currentNode){
-        if (this->isNodeOccupied(currentNode)) {
-          done = true;
-          break;
-        }
-        // otherwise: node is free and valid, raycasting continues
-      } else if (!ignoreUnknown){ // no node found, this usually means we are in "unknown" areas
-        return false;
-      }
-    } // end while
-
-    return true;
+    // 3D-DDA in key space, shared with OcTreeFrozen::castRay()
+    return castRayDDA(*this, OccupancyRayLookup<OccupancyOcTreeBase<NODE> >(*this), origin, directionP, end,
+                      ignoreUnknown, maxRange);
   }
 
   template <class NODE>
@@ -898,6 +2086,115 @@ namespace octomap {
   }
 
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::enableScrollingWindow(double size, bool recenter_keys) {
+    if (size <= 0.0 || size > this->getNodeSize(2)) {
+      OCTOMAP_ERROR("Scrolling window size %f needs to be in (0, %f]\n", size, this->getNodeSize(2));
+      return;
+    }
+    use_scrolling_window = true;
+    scrolling_window_size = size;
+    scrolling_window_recenter = recenter_keys;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::enableMultiResolutionFreeSpace(double range, unsigned int max_levels) {
+    if (range <= 0.0) {
+      OCTOMAP_ERROR("Range of multi-resolution free space %f needs to be positive\n", range);
+      return;
+    }
+    free_space_range = range;
+    free_space_levels = std::min(max_levels, this->tree_depth - 1);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::disableScrollingWindow() {
+    use_scrolling_window = false;
+    use_bbx_limit = false;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::moveScrollingWindow(const point3d& center) {
+    if (!use_scrolling_window) {
+      OCTOMAP_ERROR("Scrolling window is not enabled\n");
+      return;
+    }
+
+    const double half_size = scrolling_window_size / 2.0;
+    const double max_key = double(2*this->tree_max_val - 1);
+    point3d window_min (center - point3d(half_size, half_size, half_size));
+    point3d window_max (center + point3d(half_size, half_size, half_size));
+    this->deleteOutsideBBX(window_min, window_max);
+
+    if (scrolling_window_recenter) {
+      // shift by whole subtrees which are not larger than the window
+      unsigned int depth = 1;
+      while (this->getNodeSize(depth) > scrolling_window_size)
+        ++depth;
+      const double unit = double(1 << (this->tree_depth - depth));
+
+      bool recenter = false;
+      for (unsigned int j=0; j<3; j++) {
+        double min_scaled = floor(this->resolution_factor * window_min(j)) + double(this->tree_max_val);
+        double max_scaled = floor(this->resolution_factor * window_max(j)) + double(this->tree_max_val);
+        if (min_scaled < unit || max_scaled > max_key - unit)
+          recenter = true;
+      }
+      if (recenter) {
+        int shift[3];
+        for (unsigned int j=0; j<3; j++)
+          shift[j] = int(unit * floor(this->resolution_factor * center(j) / unit + 0.5));
+        this->shiftKeys(-shift[0], -shift[1], -shift[2]);
+
+        point3d translation (float(shift[0] * this->resolution), float(shift[1] * this->resolution),
+                             float(shift[2] * this->resolution));
+        scrolling_window_offset += translation;
+        window_min -= translation;
+        window_max -= translation;
+
+        // keys of changes and subtrees moved
+        KeyBoolMap shifted_keys;
+        for (KeyBoolMap::const_iterator it = changed_keys.begin(); it != changed_keys.end(); ++it) {
+          OcTreeKey key = it->first;
+          bool in_range = true;
+          for (unsigned int j=0; j<3; j++) {
+            int k = int(key[j]) - shift[j];
+            in_range = in_range && (k >= 0) && (k <= int(max_key));
+            key[j] = (key_type) k;
+          }
+          if (in_range)
+            shifted_keys.insert(std::pair<OcTreeKey,bool>(key, it->second));
+        }
+        changed_keys.swap(shifted_keys);
+        KeyDepthMap shifted_depths;
+        for (KeyDepthMap::const_iterator it = changed_key_depths.begin(); it != changed_key_depths.end(); ++it) {
+          OcTreeKey key = it->first;
+          bool in_range = true;
+          for (unsigned int j=0; j<3; j++) {
+            int k = int(key[j]) - shift[j];
+            in_range = in_range && (k >= 0) && (k <= int(max_key));
+            key[j] = (key_type) k;
+          }
+          if (in_range)
+            shifted_depths.insert(std::make_pair(key, it->second));
+        }
+        changed_key_depths.swap(shifted_depths);
+        tree_dirty_flags |= OcTreeNode::DIRTY_ALL;
+      }
+    }
+
+    // limit updates to the window (clamped to the key range)
+    use_bbx_limit = true;
+    bbx_min = window_min;
+    bbx_max = window_max;
+    for (unsigned int j=0; j<3; j++) {
+      double min_scaled = floor(this->resolution_factor * window_min(j)) + double(this->tree_max_val);
+      double max_scaled = floor(this->resolution_factor * window_max(j)) + double(this->tree_max_val);
+      bbx_min_key[j] = (key_type) std::min(std::max(min_scaled, 0.0), max_key);
+      bbx_max_key[j] = (key_type) std::min(std::max(max_scaled, 0.0), max_key);
+    }
+  }
+
   template <class NODE>
   bool OccupancyOcTreeBase<NODE>::inBBX(const point3d& p) const {
     return ((p.x() >= bbx_min.x()) && (p.y() >= bbx_min.y()) && (p.z() >= bbx_min.z()) &&
@@ -935,7 +2232,7 @@ namespace octomap {
       return s;
     }
 
-    this->root = new NODE();
+    this->root = this->allocNode();
     this->readBinaryNode(s, this->root);
     this->size_changed = true;
     this->tree_size = OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::calcNumNodes();  // compute number of nodes
@@ -945,7 +2242,13 @@ namespace octomap {
   template <class NODE>
   std::ostream& OccupancyOcTreeBase<NODE>::writeBinaryData(std::ostream &s) const{
     OCTOMAP_DEBUG("Writing %zu nodes to output stream...", this->size());
-    if (this->root)
+    if (this->root == NULL)
+      return s;
+
+    std::ifstream paging_reader;
+    if (this->getNumPagedSubtrees() > 0 && this->openPagingReader(paging_reader))
+      this->writeBinaryNode(s, this->root, &paging_reader);
+    else
       this->writeBinaryNode(s, this->root);
     return s;
   }
@@ -1022,10 +2325,18 @@ namespace octomap {
   }
 
   template <class NODE>
-  std::ostream& OccupancyOcTreeBase<NODE>::writeBinaryNode(std::ostream &s, const NODE* node) const{
+  std::ostream& OccupancyOcTreeBase<NODE>::writeBinaryNode(std::ostream &s, const NODE* node, std::istream* paging_reader) const{
 
     assert(node);
 
+    // a paged-out subtree is written from a copy read from the paging file
+    if (paging_reader != NULL && this->isPagedOut(node)) {
+      NODE* paged = this->readPagedSubtree(node, *paging_reader);
+      writeBinaryNode(s, paged);
+      this->deletePagedSubtree(paged);
+      return s;
+    }
+
     // 2 bits for each children, 8 children per node -> 16 bits
     std::bitset<8> child1to4;
     std::bitset<8> child5to8;
@@ -1042,7 +2353,8 @@ namespace octomap {
     for (unsigned int i=0; i<4; i++) {
       if (this->nodeChildExists(node, i)) {
         const NODE* child = this->getNodeChild(node, i);
-        if      (this->nodeHasChildren(child))  { child1to4[i*2] = 1; child1to4[i*2+1] = 1; }
+        if      (this->nodeHasChildren(child) || (paging_reader != NULL && this->isPagedOut(child)))
+                                          { child1to4[i*2] = 1; child1to4[i*2+1] = 1; }
         else if (this->isNodeOccupied(child)) { child1to4[i*2] = 0; child1to4[i*2+1] = 1; }
         else                            { child1to4[i*2] = 1; child1to4[i*2+1] = 0; }
       }
@@ -1054,7 +2366,8 @@ namespace octomap {
     for (unsigned int i=0; i<4; i++) {
       if (this->nodeChildExists(node, i+4)) {
         const NODE* child = this->getNodeChild(node, i+4);
-        if      (this->nodeHasChildren(child))  { child5to8[i*2] = 1; child5to8[i*2+1] = 1; }
+        if      (this->nodeHasChildren(child) || (paging_reader != NULL && this->isPagedOut(child)))
+                                          { child5to8[i*2] = 1; child5to8[i*2+1] = 1; }
         else if (this->isNodeOccupied(child)) { child5to8[i*2] = 0; child5to8[i*2+1] = 1; }
         else                            { child5to8[i*2] = 1; child5to8[i*2+1] = 0; }
       }
@@ -1076,8 +2389,8 @@ namespace octomap {
     for (unsigned int i=0; i<8; i++) {
       if (this->nodeChildExists(node, i)) {
         const NODE* child = this->getNodeChild(node, i);
-        if (this->nodeHasChildren(child)) {
-          writeBinaryNode(s, child);
+        if (this->nodeHasChildren(child) || (paging_reader != NULL && this->isPagedOut(child))) {
+          writeBinaryNode(s, child, paging_reader);
         }
       }
     }
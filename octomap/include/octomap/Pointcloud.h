@@ -36,6 +36,8 @@
 
 #include <vector>
 #include <list>
+#include <algorithm>
+#include <utility>
 #include <octomap/octomap_types.h>
 
 namespace octomap {
@@ -54,6 +56,29 @@ namespace octomap {
     Pointcloud(const Pointcloud& other);
     Pointcloud(Pointcloud* other);
 
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Takes over the points of other in O(1), other is left empty
+    Pointcloud(Pointcloud&& other)
+      : current_inv_transform(other.current_inv_transform), points(std::move(other.points)) {
+      other.points.clear();
+    }
+    Pointcloud& operator=(const Pointcloud& other) = default;
+    Pointcloud& operator=(Pointcloud&& other) {
+      if (this != &other) {
+        current_inv_transform = other.current_inv_transform;
+        points = std::move(other.points);
+        other.points.clear();
+      }
+      return *this;
+    }
+#endif
+
+    /// Exchange the points (and transform) of two Pointclouds in O(1)
+    void swap(Pointcloud& other) {
+      points.swap(other.points);
+      std::swap(current_inv_transform, other.current_inv_transform);
+    }
+
     size_t size() const {  return points.size(); }
     void clear();
     inline void reserve(size_t size) {points.reserve(size); }
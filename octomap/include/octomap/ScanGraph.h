@@ -60,6 +60,29 @@ namespace octomap {
 
     ~ScanNode();
 
+    /// Deep copy: the copy owns its own duplicate of other's scan
+    ScanNode(const ScanNode& other);
+    ScanNode& operator=(const ScanNode& other);
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Takes over the scan of other, which is left without one
+    ScanNode(ScanNode&& other)
+      : scan(other.scan), pose(other.pose), id(other.id) {
+      other.scan = NULL;
+    }
+    ScanNode& operator=(ScanNode&& other) {
+      swap(other);
+      return *this;
+    }
+#endif
+
+    /// Exchange scan (ownership), pose and id with other
+    void swap(ScanNode& other) {
+      std::swap(scan, other.scan);
+      std::swap(pose, other.pose);
+      std::swap(id, other.id);
+    }
+
     bool operator == (const ScanNode& other) {
       return (id == other.id);
     }
@@ -118,6 +141,27 @@ namespace octomap {
     ScanGraph() {};
     ~ScanGraph();
 
+    /// Deep copy of all nodes (including their scans) and edges of other
+    ScanGraph(const ScanGraph& other);
+    ScanGraph& operator=(const ScanGraph& other);
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    /// Takes over all nodes and edges of other, which is left empty
+    ScanGraph(ScanGraph&& other) {
+      swap(other);
+    }
+    ScanGraph& operator=(ScanGraph&& other) {
+      swap(other);
+      return *this;
+    }
+#endif
+
+    /// Exchange all nodes and edges (and their ownership) with other in O(1)
+    void swap(ScanGraph& other) {
+      nodes.swap(other.nodes);
+      edges.swap(other.edges);
+    }
+
     /// Clears all nodes and edges, and will delete the corresponding objects
     void clear();
 
@@ -58,6 +58,11 @@ namespace octomap {
 
 }
 
+  // move constructors and move assignment are only available with C++11
+  #if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+    #define OCTOMAP_HAS_MOVE_SEMANTICS
+  #endif
+
   // no debug output if not in debug mode:
   #ifdef NDEBUG
     #ifndef OCTOMAP_NODEBUGOUT
@@ -63,6 +63,9 @@ namespace octomap {
     s << "id " << getTreeType() << std::endl;
     s << "size "<< size() << std::endl;
     s << "res " << getResolution() << std::endl;
+#if OCTOMAP_TREE_DEPTH != 16
+    s << "depth " << OCTOMAP_TREE_DEPTH << std::endl;
+#endif
     s << "data" << std::endl;
 
     // write the actual data:
@@ -121,6 +124,9 @@ namespace octomap {
     size = 0;
     res = 0.0;
 
+    // files without depth are written by trees of the default depth
+    unsigned int depth = 16;
+
     std::string token;
     bool headerRead = false;
     while(s.good() && !headerRead) {
@@ -146,6 +152,8 @@ namespace octomap {
         s >> res;
       else if (token == "size")
         s >> size;
+      else if (token == "depth")
+        s >> depth;
       else{
         OCTOMAP_WARNING_STR("Unknown keyword in OcTree header, skipping: "<<token);
         char c;
@@ -171,6 +179,12 @@ namespace octomap {
       OCTOMAP_ERROR_STR("Error reading OcTree header, res <= 0.0");
       return false;
     }
+
+    if (depth != OCTOMAP_TREE_DEPTH) {
+      OCTOMAP_ERROR("Error reading OcTree header, tree depth %u differs from the compiled tree depth %d (see OCTOMAP_TREE_DEPTH)\n",
+                    depth, OCTOMAP_TREE_DEPTH);
+      return false;
+    }
     // fix deprecated id value:
     if (id == "1"){
       OCTOMAP_WARNING("You are using a deprecated id \"%s\", changing to \"OcTree\" (you should update your file header)\n", id.c_str());
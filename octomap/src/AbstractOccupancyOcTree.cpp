@@ -82,6 +82,9 @@ namespace octomap {
     s << "id " << this->getTreeType() << std::endl;
     s << "size "<< this->size() << std::endl;
     s << "res " << this->getResolution() << std::endl;
+#if OCTOMAP_TREE_DEPTH != 16
+    s << "depth " << OCTOMAP_TREE_DEPTH << std::endl;
+#endif
     s << "data" << std::endl;
 
     writeBinaryData(s);
@@ -165,6 +168,12 @@ namespace octomap {
     // otherwise: values are valid, stream is now at binary data!
     this->clear();
     this->setResolution(res);
+    if (this->getResolution() != res){
+      // e.g. trees with a fixed resolution, see OcTreeFixed
+      OCTOMAP_ERROR("Cannot read a tree with resolution %f into a tree with resolution %f\n",
+                    res, this->getResolution());
+      return false;
+    }
     
     if (size > 0)
       this->readBinaryData(s);
@@ -57,16 +57,14 @@ namespace octomap {
     int mb = 0;
     int c = 0;
 
-    if (children != NULL){
-      for (int i=0; i<8; i++) {
-        ColorOcTreeNode* child = static_cast<ColorOcTreeNode*>(children[i]);
-
-        if (child != NULL && child->isColorSet()) {
-          mr += child->getColor().r;
-          mg += child->getColor().g;
-          mb += child->getColor().b;
-          ++c;
-        }
+    for (int i=0; i<8; i++) {
+      ColorOcTreeNode* child = static_cast<ColorOcTreeNode*>(getChildPtr(i));
+
+      if (child != NULL && child->isColorSet()) {
+        mr += child->getColor().r;
+        mg += child->getColor().g;
+        mb += child->getColor().b;
+        ++c;
       }
     }
 
@@ -97,7 +95,7 @@ namespace octomap {
                                              uint8_t r,
                                              uint8_t g,
                                              uint8_t b) {
-    ColorOcTreeNode* n = search (key);
+    ColorOcTreeNode* n = searchForWrite(key);
     if (n != 0) {
       n->setColor(r, g, b);
     }
@@ -118,8 +116,7 @@ namespace octomap {
     for (unsigned int i=0;i<8;i++) {
       deleteNodeChild(node, i);
     }
-    delete[] node->children;
-    node->children = NULL;
+    freeNodeChildren(node);
 
     return true;
   }
@@ -131,12 +128,13 @@ namespace octomap {
       return false;
 
     const ColorOcTreeNode* firstChild = getNodeChild(node, 0);
-    if (nodeHasChildren(firstChild))
+    if (nodeHasChildren(firstChild) || isPagedOut(firstChild))
       return false;
 
     for (unsigned int i = 1; i<8; i++) {
       // compare nodes only using their occupancy, ignoring color for pruning
-      if (!nodeChildExists(node, i) || nodeHasChildren(getNodeChild(node, i)) || !(getNodeChild(node, i)->getValue() == firstChild->getValue()))
+      if (!nodeChildExists(node, i) || nodeHasChildren(getNodeChild(node, i)) || !(getNodeChild(node, i)->getValue() == firstChild->getValue())
+          || isPagedOut(getNodeChild(node, i)))
         return false;
     }
 
@@ -147,7 +145,7 @@ namespace octomap {
                                                  uint8_t r,
                                                  uint8_t g,
                                                  uint8_t b) {
-    ColorOcTreeNode* n = search(key);
+    ColorOcTreeNode* n = searchForWrite(key);
     if (n != 0) {
       if (n->isColorSet()) {
         ColorOcTreeNode::Color prev_color = n->getColor();
@@ -164,7 +162,7 @@ namespace octomap {
                                                    uint8_t r,
                                                    uint8_t g,
                                                    uint8_t b) {
-    ColorOcTreeNode* n = search (key);
+    ColorOcTreeNode* n = searchForWrite(key);
     if (n != 0) {
       if (n->isColorSet()) {
         ColorOcTreeNode::Color prev_color = n->getColor();
@@ -196,7 +194,7 @@ namespace octomap {
       if (depth < this->tree_depth){
         for (unsigned int i=0; i<8; i++) {
           if (nodeChildExists(node, i)) {
-            updateInnerOccupancyRecurs(getNodeChild(node, i), depth+1);
+            updateInnerOccupancyRecurs(getNodeChildForWrite(node, i), depth+1);
           }
         }
       }
@@ -66,9 +66,10 @@ namespace octomap {
   CountingOcTreeNode* CountingOcTree::updateNode(const OcTreeKey& k) {
 
     if (root == NULL) {
-      root = new CountingOcTreeNode();
+      root = allocNode();
       tree_size++;
     }
+    bool bounds_tracked = boundsTracked();
     CountingOcTreeNode* curNode (root);
     curNode->increaseCount();
 
@@ -87,6 +88,8 @@ namespace octomap {
       curNode->increaseCount(); // modify traversed nodes
     }
 
+    if (bounds_tracked)
+      growBounds(k);
     return curNode;
   }
 
@@ -0,0 +1,119 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <octomap/DepthImagePyramid.h>
+
+namespace octomap {
+
+  void DepthImagePyramid::build(const float* depth, unsigned int w, unsigned int h, size_t row_pitch, double maxrange) {
+    if (row_pitch == 0)
+      row_pitch = w * sizeof(float);
+    width = w;
+    height = h;
+    level_widths.assign(1, w);
+    level_heights.assign(1, h);
+    while (level_widths.back() > 1 || level_heights.back() > 1) {
+      level_widths.push_back((level_widths.back() + 1) / 2);
+      level_heights.push_back((level_heights.back() + 1) / 2);
+    }
+    depths.resize(level_widths.size());
+    max_depths.resize(level_widths.size());
+
+    const float max_depth = (maxrange < 0.0) ? std::numeric_limits<float>::max() : (float) maxrange;
+    depths[0].resize((size_t) w * h);
+    for (unsigned int v = 0; v < h; ++v) {
+      const float* row = (const float*) ((const char*) depth + v * row_pitch);
+      float* level_row = &depths[0][(size_t) v * w];
+      for (unsigned int u = 0; u < w; ++u) {
+        float d = row[u];
+        if (!(d > 0.0f) || d == std::numeric_limits<float>::infinity()) // also NaN
+          d = 0.0f;
+        level_row[u] = std::min(d, max_depth);
+      }
+    }
+
+    for (size_t level = 1; level < level_widths.size(); ++level) {
+      const unsigned int lw = level_widths[level];
+      const unsigned int lh = level_heights[level];
+      const unsigned int cw = level_widths[level-1];
+      const unsigned int ch = level_heights[level-1];
+      const std::vector<float>& child_min = depths[level-1];
+      const std::vector<float>& child_max = (level == 1) ? depths[0] : max_depths[level-1];
+      depths[level].resize((size_t) lw * lh);
+      max_depths[level].resize((size_t) lw * lh);
+      for (unsigned int v = 0; v < lh; ++v) {
+        for (unsigned int u = 0; u < lw; ++u) {
+          float min_d = std::numeric_limits<float>::max();
+          float max_d = 0.0f;
+          for (unsigned int cv = 2*v; cv < std::min(2*v + 2, ch); ++cv) {
+            for (unsigned int cu = 2*u; cu < std::min(2*u + 2, cw); ++cu) {
+              min_d = std::min(min_d, child_min[(size_t) cv * cw + cu]);
+              max_d = std::max(max_d, child_max[(size_t) cv * cw + cu]);
+            }
+          }
+          depths[level][(size_t) v * lw + u] = min_d;
+          max_depths[level][(size_t) v * lw + u] = max_d;
+        }
+      }
+    }
+  }
+
+  bool DepthImagePyramid::getDepthRange(int u0, int v0, int u1, int v1, float& min_depth, float& max_depth) const {
+    u0 = std::max(u0, 0);
+    v0 = std::max(v0, 0);
+    u1 = std::min(u1, (int) width - 1);
+    v1 = std::min(v1, (int) height - 1);
+    if (u0 > u1 || v0 > v1)
+      return false;
+
+    size_t level = 0;
+    while (level + 1 < depths.size() && ((u1 >> level) - (u0 >> level) > 1 || (v1 >> level) - (v0 >> level) > 1))
+      ++level;
+
+    const unsigned int lw = level_widths[level];
+    const std::vector<float>& level_max = (level == 0) ? depths[0] : max_depths[level];
+    min_depth = std::numeric_limits<float>::max();
+    max_depth = 0.0f;
+    for (int v = v0 >> level; v <= (v1 >> level); ++v) {
+      for (int u = u0 >> level; u <= (u1 >> level); ++u) {
+        min_depth = std::min(min_depth, depths[level][(size_t) v * lw + u]);
+        max_depth = std::max(max_depth, level_max[(size_t) v * lw + u]);
+      }
+    }
+    return true;
+  }
+
+} // namespace
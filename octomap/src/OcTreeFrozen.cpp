@@ -0,0 +1,124 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <octomap/OcTreeFrozen.h>
+
+namespace octomap {
+
+  OcTreeFrozen::OcTreeFrozen(double in_resolution)
+  {
+    init(in_resolution, OCTOMAP_TREE_DEPTH, logodds(0.5));
+  }
+
+  void OcTreeFrozen::init(double in_resolution, unsigned int in_tree_depth, float in_occ_prob_thres_log){
+    tree_depth = in_tree_depth;
+    tree_max_val = 1 << (tree_depth - 1);
+    resolution = in_resolution;
+    resolution_factor = 1. / resolution;
+    occ_prob_thres_log = in_occ_prob_thres_log;
+
+    sizeLookupTable.resize(tree_depth+1);
+    for(unsigned i = 0; i <= tree_depth; ++i){
+      sizeLookupTable[i] = resolution * double(1 << (tree_depth - i));
+    }
+  }
+
+  size_t OcTreeFrozen::memoryUsage() const{
+    return sizeof(OcTreeFrozen) + nodes.capacity() * sizeof(OcTreeFrozenNode)
+        + sizeLookupTable.capacity() * sizeof(double);
+  }
+
+  const OcTreeFrozenNode* OcTreeFrozen::search(const point3d& value, unsigned int depth) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(value, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< value <<"] is out of OcTree bounds!");
+      return NULL;
+    }
+    else {
+      return this->search(key, depth);
+    }
+  }
+
+  const OcTreeFrozenNode* OcTreeFrozen::search(double x, double y, double z, unsigned int depth) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(x, y, z, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< x <<" "<< y << " " << z << "] is out of OcTree bounds!");
+      return NULL;
+    }
+    else {
+      return this->search(key, depth);
+    }
+  }
+
+  const OcTreeFrozenNode* OcTreeFrozen::search(const OcTreeKey& key, unsigned int depth) const {
+    assert(depth <= tree_depth);
+    if (nodes.empty())
+      return NULL;
+
+    if (depth == 0)
+      depth = tree_depth;
+
+    // generate appropriate key_at_depth for queried depth
+    OcTreeKey key_at_depth = key;
+    if (depth != tree_depth){
+      for (unsigned int i=0; i<3; ++i)
+        key_at_depth[i] = computeKeyAtDepth(key[i], depth, tree_depth, tree_max_val);
+    }
+
+    const OcTreeFrozenNode* curNode = &nodes[0];
+    int diff = tree_depth - depth;
+
+    // follow nodes down to requested level (for diff = 0 it's the last level)
+    for (int i=(tree_depth-1); i>=diff; --i) {
+      unsigned int pos = computeChildIdx(key_at_depth, i);
+      if (curNode->childExists(pos)) {
+        curNode = getNodeChild(curNode, pos);
+      } else {
+        // a missing child is only valid (pruned) when the node is a leaf
+        if (!curNode->hasChildren())
+          return curNode;
+        else
+          return NULL;
+      }
+    }
+    return curNode;
+  }
+
+  bool OcTreeFrozen::castRay(const point3d& origin, const point3d& directionP, point3d& end,
+                             bool ignoreUnknown, double maxRange) const {
+    // same 3D-DDA as OccupancyOcTreeBase::castRay()
+    return castRayDDA(*this, OccupancyRayLookup<OcTreeFrozen>(*this), origin, directionP, end,
+                      ignoreUnknown, maxRange);
+  }
+
+} // end namespace
@@ -0,0 +1,253 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <new>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <octomap/OcTreeMemoryPool.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace octomap {
+
+  OcTreeMemoryPool::OcTreeMemoryPool(size_t in_slot_size, size_t in_min_chunk_slots, size_t in_max_chunk_slots)
+    : min_chunk_slots(in_min_chunk_slots), max_chunk_slots(in_max_chunk_slots),
+      chunk_pos(NULL), chunk_end(NULL), free_list(NULL),
+      num_used(0), num_free(0), memory_reserved(0)
+  {
+    // every slot needs to hold the free list pointer and keep the
+    // following slots aligned
+    const size_t align = sizeof(void*);
+    slot_size = std::max(in_slot_size, sizeof(FreeSlot));
+    slot_size = ((slot_size + align - 1) / align) * align;
+
+    if (min_chunk_slots == 0)
+      min_chunk_slots = 1;
+    if (max_chunk_slots < min_chunk_slots)
+      max_chunk_slots = min_chunk_slots;
+  }
+
+  OcTreeMemoryPool::~OcTreeMemoryPool() {
+    release();
+  }
+
+  void OcTreeMemoryPool::release() {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      ::operator delete(chunks[i]);
+    }
+    chunks.clear();
+    chunk_pos = chunk_end = NULL;
+    free_list = NULL;
+    num_used = num_free = 0;
+    memory_reserved = 0;
+  }
+
+  void OcTreeMemoryPool::swap(OcTreeMemoryPool& other) {
+    std::swap(slot_size, other.slot_size);
+    std::swap(min_chunk_slots, other.min_chunk_slots);
+    std::swap(max_chunk_slots, other.max_chunk_slots);
+    chunks.swap(other.chunks);
+    std::swap(chunk_pos, other.chunk_pos);
+    std::swap(chunk_end, other.chunk_end);
+    std::swap(free_list, other.free_list);
+    std::swap(num_used, other.num_used);
+    std::swap(num_free, other.num_free);
+    std::swap(memory_reserved, other.memory_reserved);
+  }
+
+  void OcTreeMemoryPool::addChunk() {
+    // grow geometrically so that small trees stay small
+    size_t num_slots = min_chunk_slots;
+    for (size_t i = 0; i < chunks.size() && num_slots < max_chunk_slots; ++i)
+      num_slots *= 2;
+    num_slots = std::min(num_slots, max_chunk_slots);
+
+    size_t chunk_bytes = num_slots * slot_size;
+    char* chunk = static_cast<char*>(::operator new(chunk_bytes));
+    chunks.push_back(chunk);
+    chunk_pos = chunk;
+    chunk_end = chunk + chunk_bytes;
+    memory_reserved += chunk_bytes;
+  }
+
+
+  // ============================================================
+  // =  OcTreeBlockPool  ========================================
+  // ============================================================
+
+  namespace {
+    char* allocateAligned(size_t alignment, size_t size) {
+#ifdef _WIN32
+      return static_cast<char*>(_aligned_malloc(size, alignment));
+#else
+      void* p = NULL;
+      if (posix_memalign(&p, alignment, size) != 0)
+        return NULL;
+      return static_cast<char*>(p);
+#endif
+    }
+
+    void freeAligned(char* p) {
+#ifdef _WIN32
+      _aligned_free(p);
+#else
+      free(p);
+#endif
+    }
+  }
+
+  OcTreeBlockPool::OcTreeBlockPool(size_t in_slot_size, size_t in_min_chunk_blocks)
+    : slot_size(in_slot_size), block_size(8 * in_slot_size),
+      min_chunk_blocks(in_min_chunk_blocks), chunk_shift(0),
+      chunks(NULL), num_chunks(0), chunks_capacity(0),
+      next_block(0), end_block(0), free_list(0),
+      num_used(0), num_free(0), memory_reserved(0)
+  {
+    assert(sizeof(ChunkHeader) <= HEADER_SIZE);
+    assert(HEADER_SIZE + block_size <= CHUNK_SIZE);
+
+    // the chunks are found by shifting the index, a chunk may use fewer blocks than
+    // its index range holds (leaving gaps in the indices, but not in memory)
+    max_chunk_blocks = (CHUNK_SIZE - HEADER_SIZE) / block_size;
+    while ((size_t(1) << chunk_shift) < max_chunk_blocks)
+      ++chunk_shift;
+    chunk_mask = (1u << chunk_shift) - 1;
+    if (min_chunk_blocks == 0)
+      min_chunk_blocks = 1;
+    if (min_chunk_blocks > max_chunk_blocks)
+      min_chunk_blocks = max_chunk_blocks;
+  }
+
+  OcTreeBlockPool::~OcTreeBlockPool() {
+    release();
+  }
+
+  void OcTreeBlockPool::release() {
+    for (size_t i = 0; i < num_chunks; ++i) {
+      freeAligned(chunks[i]);
+    }
+    delete[] chunks;
+    for (size_t i = 0; i < retired_tables.size(); ++i) {
+      delete[] retired_tables[i];
+    }
+    retired_tables.clear();
+    chunks = NULL;
+    num_chunks = chunks_capacity = 0;
+    next_block = end_block = free_list = 0;
+    num_used = num_free = 0;
+    memory_reserved = 0;
+  }
+
+  void OcTreeBlockPool::swap(OcTreeBlockPool& other) {
+    std::swap(slot_size, other.slot_size);
+    std::swap(block_size, other.block_size);
+    std::swap(min_chunk_blocks, other.min_chunk_blocks);
+    std::swap(max_chunk_blocks, other.max_chunk_blocks);
+    std::swap(chunk_shift, other.chunk_shift);
+    std::swap(chunk_mask, other.chunk_mask);
+    std::swap(chunks, other.chunks);
+    std::swap(num_chunks, other.num_chunks);
+    std::swap(chunks_capacity, other.chunks_capacity);
+    retired_tables.swap(other.retired_tables);
+    std::swap(next_block, other.next_block);
+    std::swap(end_block, other.end_block);
+    std::swap(free_list, other.free_list);
+    std::swap(num_used, other.num_used);
+    std::swap(num_free, other.num_free);
+    std::swap(memory_reserved, other.memory_reserved);
+
+    // the chunks moved to the other pool object
+    updateHeaders();
+    other.updateHeaders();
+  }
+
+  void OcTreeBlockPool::addChunk() {
+    // block indices are 32 bit, the end of the last chunk needs to be representable
+    if ((uint64_t(num_chunks) + 2) << chunk_shift > (uint64_t(1) << 32))
+      throw std::bad_alloc();
+
+    // chunks double in size up to CHUNK_SIZE, they are aligned to CHUNK_SIZE in any case
+    size_t num_blocks = max_chunk_blocks;
+    if (num_chunks < 32 && (min_chunk_blocks << num_chunks) < max_chunk_blocks)
+      num_blocks = min_chunk_blocks << num_chunks;
+    size_t chunk_bytes = HEADER_SIZE + num_blocks * block_size;
+    char* chunk = allocateAligned(CHUNK_SIZE, chunk_bytes);
+    if (chunk == NULL)
+      throw std::bad_alloc();
+
+    // the old table stays valid for lookups running concurrently
+    bool table_changed = false;
+    if (num_chunks == chunks_capacity) {
+      size_t capacity = std::max(size_t(16), 2 * chunks_capacity);
+      char** table = new char*[capacity];
+      std::copy(chunks, chunks + num_chunks, table);
+      if (chunks != NULL)
+        retired_tables.push_back(chunks);
+      chunks = table;
+      memory_reserved += (capacity - chunks_capacity) * sizeof(char*);
+      chunks_capacity = capacity;
+      table_changed = true;
+    }
+
+    uint32_t first_block = uint32_t(num_chunks << chunk_shift);
+    ChunkHeader* header = reinterpret_cast<ChunkHeader*>(chunk);
+    header->pool = this;
+    header->chunks = chunks;
+    header->block_size = block_size;
+    header->slot_size = slot_size;
+    header->chunk_shift = chunk_shift;
+    header->chunk_mask = chunk_mask;
+    header->first_block = first_block;
+    chunks[num_chunks++] = chunk;
+    memory_reserved += chunk_bytes;
+
+    if (table_changed)
+      updateHeaders();
+
+    // index 0 denotes "no block"
+    next_block = (first_block == 0) ? 1 : first_block;
+    end_block = first_block + uint32_t(num_blocks);
+  }
+
+  void OcTreeBlockPool::updateHeaders() {
+    for (size_t i = 0; i < num_chunks; ++i) {
+      ChunkHeader* header = reinterpret_cast<ChunkHeader*>(chunks[i]);
+      header->pool = this;
+      header->chunks = chunks;
+    }
+  }
+
+} // end namespace
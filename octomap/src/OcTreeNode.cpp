@@ -44,6 +44,9 @@ namespace octomap {
 
   OcTreeNode::OcTreeNode()
     : OcTreeDataNode<float>(0.0)
+#ifndef OCTOMAP_NO_NODE_FLAGS
+    , flags(0)
+#endif
   {
   }
 
@@ -58,12 +61,11 @@ namespace octomap {
   double OcTreeNode::getMeanChildLogOdds() const{
     double mean = 0;
     uint8_t c = 0;
-    if (children !=NULL){
-      for (unsigned int i=0; i<8; i++) {
-        if (children[i] != NULL) {
-          mean += static_cast<OcTreeNode*>(children[i])->getOccupancy(); // TODO check if works generally
-          ++c;
-        }
+    for (unsigned int i=0; i<8; i++) {
+      AbstractOcTreeNode* child = getChildPtr(i);
+      if (child != NULL) {
+        mean += static_cast<OcTreeNode*>(child)->getOccupancy(); // TODO check if works generally
+        ++c;
       }
     }
     
@@ -76,13 +78,12 @@ namespace octomap {
   float OcTreeNode::getMaxChildLogOdds() const{
     float max = -std::numeric_limits<float>::max();
     
-    if (children !=NULL){
-      for (unsigned int i=0; i<8; i++) {
-        if (children[i] != NULL) {
-          float l = static_cast<OcTreeNode*>(children[i])->getLogOdds(); // TODO check if works generally
-          if (l > max)
-            max = l;
-        }
+    for (unsigned int i=0; i<8; i++) {
+      AbstractOcTreeNode* child = getChildPtr(i);
+      if (child != NULL) {
+        float l = static_cast<OcTreeNode*>(child)->getLogOdds(); // TODO check if works generally
+        if (l > max)
+          max = l;
       }
     }
     return max;
@@ -0,0 +1,317 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <octomap/OcTreeRayPacket.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+  // vectorized versions are compiled for their target only, selected at runtime
+  // (not on 32 bit x86, where scalar double arithmetic may use extended precision)
+  #define OCTOMAP_RAY_SIMD_X86
+  #include <immintrin.h>
+#endif
+
+namespace octomap {
+
+  namespace {
+
+    /// @return false if the ray is full, the key is not added then
+    inline bool addRayKey(KeyRay& ray, int k0, int k1, int k2) {
+      if (ray.size() >= ray.sizeMax())
+        return false;
+      ray.addKey(OcTreeKey((key_type) k0, (key_type) k1, (key_type) k2));
+      return true;
+    }
+
+    /// incremental phase of OcTreeBaseImpl::computeRayKeys() for ray r of the packet
+    void traverseRayScalar(RayPacket& p, unsigned int r) {
+      KeyRay& ray = *p.rays[r];
+      int key[3] = {p.key[0][r], p.key[1][r], p.key[2][r]};
+      double t_max[3] = {p.t_max[0][r], p.t_max[1][r], p.t_max[2][r]};
+
+      while (true) {
+        unsigned int dim;
+        if (t_max[0] < t_max[1])
+          dim = (t_max[0] < t_max[2]) ? 0 : 2;
+        else
+          dim = (t_max[1] < t_max[2]) ? 1 : 2;
+
+        key[dim] += p.step[dim][r];
+        t_max[dim] += p.t_delta[dim][r];
+
+        if (key[0] == p.key_end[0][r] && key[1] == p.key_end[1][r] && key[2] == p.key_end[2][r])
+          break;
+        if (std::min(std::min(t_max[0], t_max[1]), t_max[2]) > p.length[r])
+          break;
+        if (!addRayKey(ray, key[0], key[1], key[2])) {
+          *p.valid[r] = false;
+          break;
+        }
+      }
+    }
+
+#ifdef OCTOMAP_RAY_SIMD_X86
+
+    /// State of four lanes in memory, lanes are (re)filled with the next ray of the packet
+    struct LaneState {
+      int ray[4];
+      int key[3][4];
+      int key_end[3][4];
+      int step[3][4];
+      double t_max[3][4];
+      double t_delta[3][4];
+      double length[4];
+
+      /// @return bit mask of the lanes which got a ray
+      unsigned int init(const RayPacket& p, unsigned int& next) {
+        unsigned int active = 0;
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+          if (load(p, lane, next))
+            active |= 1u << lane;
+        }
+        return active;
+      }
+
+      /// loads ray "next" into the lane, or an idle ray if all rays were started
+      bool load(const RayPacket& p, unsigned int lane, unsigned int& next) {
+        bool has_ray = next < p.num_rays;
+        unsigned int r = has_ray ? next++ : 0;
+        ray[lane] = (int) r;
+        for (unsigned int i = 0; i < 3; ++i) {
+          key[i][lane] = p.key[i][r];
+          key_end[i][lane] = p.key_end[i][r];
+          step[i][lane] = has_ray ? p.step[i][r] : 0;
+          t_max[i][lane] = p.t_max[i][r];
+          t_delta[i][lane] = has_ray ? p.t_delta[i][r] : 0.0;
+        }
+        length[lane] = p.length[r];
+        return has_ray;
+      }
+    };
+
+    __attribute__((target("avx2")))
+    void traverseRaysAVX2(RayPacket& p) {
+      LaneState s;
+      unsigned int next = 0;
+      unsigned int active = s.init(p, next);
+      const __m256i pack_lo = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+      const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+
+      while (active) {
+        __m128i k0 = _mm_loadu_si128((const __m128i*) s.key[0]);
+        __m128i k1 = _mm_loadu_si128((const __m128i*) s.key[1]);
+        __m128i k2 = _mm_loadu_si128((const __m128i*) s.key[2]);
+        const __m128i e0 = _mm_loadu_si128((const __m128i*) s.key_end[0]);
+        const __m128i e1 = _mm_loadu_si128((const __m128i*) s.key_end[1]);
+        const __m128i e2 = _mm_loadu_si128((const __m128i*) s.key_end[2]);
+        const __m128i s0 = _mm_loadu_si128((const __m128i*) s.step[0]);
+        const __m128i s1 = _mm_loadu_si128((const __m128i*) s.step[1]);
+        const __m128i s2 = _mm_loadu_si128((const __m128i*) s.step[2]);
+        __m256d t0 = _mm256_loadu_pd(s.t_max[0]);
+        __m256d t1 = _mm256_loadu_pd(s.t_max[1]);
+        __m256d t2 = _mm256_loadu_pd(s.t_max[2]);
+        const __m256d d0 = _mm256_loadu_pd(s.t_delta[0]);
+        const __m256d d1 = _mm256_loadu_pd(s.t_delta[1]);
+        const __m256d d2 = _mm256_loadu_pd(s.t_delta[2]);
+        const __m256d length = _mm256_loadu_pd(s.length);
+
+        // step all lanes until one of them finishes
+        unsigned int finished = 0;
+        while (!finished) {
+          // same choice of the dimension as in computeRayKeys()
+          __m256d lt01 = _mm256_cmp_pd(t0, t1, _CMP_LT_OQ);
+          __m256d sel0 = _mm256_and_pd(lt01, _mm256_cmp_pd(t0, t2, _CMP_LT_OQ));
+          __m256d sel1 = _mm256_andnot_pd(lt01, _mm256_cmp_pd(t1, t2, _CMP_LT_OQ));
+          __m256d sel2 = _mm256_andnot_pd(_mm256_or_pd(sel0, sel1), all);
+
+          t0 = _mm256_blendv_pd(t0, _mm256_add_pd(t0, d0), sel0);
+          t1 = _mm256_blendv_pd(t1, _mm256_add_pd(t1, d1), sel1);
+          t2 = _mm256_blendv_pd(t2, _mm256_add_pd(t2, d2), sel2);
+          k0 = _mm_add_epi32(k0, _mm_and_si128(s0, _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(sel0), pack_lo))));
+          k1 = _mm_add_epi32(k1, _mm_and_si128(s1, _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(sel1), pack_lo))));
+          k2 = _mm_add_epi32(k2, _mm_and_si128(s2, _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(sel2), pack_lo))));
+
+          __m128i at_end = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi32(k0, e0), _mm_cmpeq_epi32(k1, e1)), _mm_cmpeq_epi32(k2, e2));
+          __m256d dist = _mm256_min_pd(_mm256_min_pd(t0, t1), t2);
+          unsigned int done = (unsigned int) (_mm_movemask_ps(_mm_castsi128_ps(at_end))
+                                              | _mm256_movemask_pd(_mm256_cmp_pd(dist, length, _CMP_GT_OQ)));
+          finished = done & active;
+
+          unsigned int add = active & ~finished;
+          if (add) {
+            int k[3][4];
+            _mm_storeu_si128((__m128i*) k[0], k0);
+            _mm_storeu_si128((__m128i*) k[1], k1);
+            _mm_storeu_si128((__m128i*) k[2], k2);
+            for (unsigned int lane = 0; lane < 4; ++lane) {
+              if ((add & (1u << lane)) && !addRayKey(*p.rays[s.ray[lane]], k[0][lane], k[1][lane], k[2][lane])) {
+                // full ray: fail it and refill the lane
+                *p.valid[s.ray[lane]] = false;
+                finished |= 1u << lane;
+              }
+            }
+          }
+        }
+
+        // refill the finished lanes
+        _mm_storeu_si128((__m128i*) s.key[0], k0);
+        _mm_storeu_si128((__m128i*) s.key[1], k1);
+        _mm_storeu_si128((__m128i*) s.key[2], k2);
+        _mm256_storeu_pd(s.t_max[0], t0);
+        _mm256_storeu_pd(s.t_max[1], t1);
+        _mm256_storeu_pd(s.t_max[2], t2);
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+          if ((finished & (1u << lane)) && !s.load(p, lane, next))
+            active &= ~(1u << lane);
+        }
+      }
+    }
+
+    __attribute__((target("sse4.1")))
+    void traverseRaysSSE41(RayPacket& p) {
+      LaneState s;
+      unsigned int next = 0;
+      unsigned int active = s.init(p, next);
+      const __m128d all = _mm_castsi128_pd(_mm_set1_epi32(-1));
+
+      while (active) {
+        // double lanes in two halves (lanes 0, 1 and 2, 3)
+        __m128i k0 = _mm_loadu_si128((const __m128i*) s.key[0]);
+        __m128i k1 = _mm_loadu_si128((const __m128i*) s.key[1]);
+        __m128i k2 = _mm_loadu_si128((const __m128i*) s.key[2]);
+        const __m128i e0 = _mm_loadu_si128((const __m128i*) s.key_end[0]);
+        const __m128i e1 = _mm_loadu_si128((const __m128i*) s.key_end[1]);
+        const __m128i e2 = _mm_loadu_si128((const __m128i*) s.key_end[2]);
+        const __m128i s0 = _mm_loadu_si128((const __m128i*) s.step[0]);
+        const __m128i s1 = _mm_loadu_si128((const __m128i*) s.step[1]);
+        const __m128i s2 = _mm_loadu_si128((const __m128i*) s.step[2]);
+        __m128d t[3][2];
+        __m128d d[3][2];
+        for (unsigned int i = 0; i < 3; ++i) {
+          for (unsigned int h = 0; h < 2; ++h) {
+            t[i][h] = _mm_loadu_pd(s.t_max[i] + 2*h);
+            d[i][h] = _mm_loadu_pd(s.t_delta[i] + 2*h);
+          }
+        }
+        const __m128d length[2] = {_mm_loadu_pd(s.length), _mm_loadu_pd(s.length + 2)};
+
+        unsigned int finished = 0;
+        while (!finished) {
+          __m128d sel[3][2];
+          unsigned int beyond = 0;
+          for (unsigned int h = 0; h < 2; ++h) {
+            __m128d lt01 = _mm_cmplt_pd(t[0][h], t[1][h]);
+            sel[0][h] = _mm_and_pd(lt01, _mm_cmplt_pd(t[0][h], t[2][h]));
+            sel[1][h] = _mm_andnot_pd(lt01, _mm_cmplt_pd(t[1][h], t[2][h]));
+            sel[2][h] = _mm_andnot_pd(_mm_or_pd(sel[0][h], sel[1][h]), all);
+            for (unsigned int i = 0; i < 3; ++i)
+              t[i][h] = _mm_blendv_pd(t[i][h], _mm_add_pd(t[i][h], d[i][h]), sel[i][h]);
+            __m128d dist = _mm_min_pd(_mm_min_pd(t[0][h], t[1][h]), t[2][h]);
+            beyond |= (unsigned int) _mm_movemask_pd(_mm_cmpgt_pd(dist, length[h])) << (2*h);
+          }
+          // 64 bit masks of both halves to four 32 bit masks
+          k0 = _mm_add_epi32(k0, _mm_and_si128(s0, _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(sel[0][0]), _mm_castpd_ps(sel[0][1]), _MM_SHUFFLE(2, 0, 2, 0)))));
+          k1 = _mm_add_epi32(k1, _mm_and_si128(s1, _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(sel[1][0]), _mm_castpd_ps(sel[1][1]), _MM_SHUFFLE(2, 0, 2, 0)))));
+          k2 = _mm_add_epi32(k2, _mm_and_si128(s2, _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(sel[2][0]), _mm_castpd_ps(sel[2][1]), _MM_SHUFFLE(2, 0, 2, 0)))));
+
+          __m128i at_end = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi32(k0, e0), _mm_cmpeq_epi32(k1, e1)), _mm_cmpeq_epi32(k2, e2));
+          unsigned int done = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(at_end)) | beyond;
+          finished = done & active;
+
+          unsigned int add = active & ~finished;
+          if (add) {
+            int k[3][4];
+            _mm_storeu_si128((__m128i*) k[0], k0);
+            _mm_storeu_si128((__m128i*) k[1], k1);
+            _mm_storeu_si128((__m128i*) k[2], k2);
+            for (unsigned int lane = 0; lane < 4; ++lane) {
+              if ((add & (1u << lane)) && !addRayKey(*p.rays[s.ray[lane]], k[0][lane], k[1][lane], k[2][lane])) {
+                // full ray: fail it and refill the lane
+                *p.valid[s.ray[lane]] = false;
+                finished |= 1u << lane;
+              }
+            }
+          }
+        }
+
+        _mm_storeu_si128((__m128i*) s.key[0], k0);
+        _mm_storeu_si128((__m128i*) s.key[1], k1);
+        _mm_storeu_si128((__m128i*) s.key[2], k2);
+        for (unsigned int i = 0; i < 3; ++i) {
+          _mm_storeu_pd(s.t_max[i], t[i][0]);
+          _mm_storeu_pd(s.t_max[i] + 2, t[i][1]);
+        }
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+          if ((finished & (1u << lane)) && !s.load(p, lane, next))
+            active &= ~(1u << lane);
+        }
+      }
+    }
+
+#endif // OCTOMAP_RAY_SIMD_X86
+
+  } // namespace
+
+  RaySIMD detectRaySIMD() {
+#ifdef OCTOMAP_RAY_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return RAY_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+      return RAY_SIMD_SSE41;
+#endif
+    return RAY_SIMD_NONE;
+  }
+
+  void traverseRayPacket(RayPacket& packet, RaySIMD simd) {
+    assert(packet.num_rays <= RayPacket::MAX_RAYS);
+    if (packet.num_rays == 0)
+      return;
+    static const RaySIMD detected = detectRaySIMD();
+    switch (std::min(detected, simd)) {
+#ifdef OCTOMAP_RAY_SIMD_X86
+      case RAY_SIMD_AVX2:
+        traverseRaysAVX2(packet);
+        return;
+      case RAY_SIMD_SSE41:
+        traverseRaysSSE41(packet);
+        return;
+#endif
+      default:
+        for (unsigned int r = 0; r < packet.num_rays; ++r)
+          traverseRayScalar(packet, r);
+    }
+  }
+
+} // namespace
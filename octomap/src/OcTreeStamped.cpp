@@ -49,13 +49,26 @@ namespace octomap {
   void OcTreeStamped::degradeOutdatedNodes(unsigned int time_thres) {
     unsigned int query_time = (unsigned int) time(NULL);
 
+    // nodes shared with snapshots need to be copied before they are modified,
+    // which invalidates the iterator: collect them first
+    std::vector<std::pair<OcTreeKey, unsigned int> > outdated;
+
+    // the leaf iterator stops at paged-out subtrees
+    pageInAll();
+
     for(leaf_iterator it = this->begin_leafs(), end=this->end_leafs();
         it!= end; ++it) {
       if ( this->isNodeOccupied(*it)
            && ((query_time - it->getTimestamp()) > time_thres) ) {
-        integrateMissNoTime(&*it);
+        if (copy_on_write)
+          outdated.push_back(std::make_pair(it.getKey(), it.getDepth()));
+        else
+          integrateMissNoTime(&*it);
       }
     }
+
+    for (size_t i = 0; i < outdated.size(); ++i)
+      integrateMissNoTime(searchForWrite(outdated[i].first, outdated[i].second));
   }
 
   void OcTreeStamped::updateNodeLogOdds(OcTreeNodeStamped* node, const float& update) const {
@@ -0,0 +1,575 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <octomap/OccupancyBlockMap.h>
+#include <octomap/OcTree.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace octomap {
+
+  OccupancyBlockMap::OccupancyBlockMap(double in_resolution)
+    : num_voxels(0)
+  {
+    init(in_resolution, OCTOMAP_TREE_DEPTH);
+
+    // same defaults as AbstractOccupancyOcTree
+    setOccupancyThres(0.5);
+    setProbHit(0.7);
+    setProbMiss(0.4);
+    setClampingThresMin(0.1192);
+    setClampingThresMax(0.971);
+  }
+
+  void OccupancyBlockMap::init(double in_resolution, unsigned int in_tree_depth){
+    tree_depth = in_tree_depth;
+    tree_max_val = 1 << (tree_depth - 1);
+    resolution = in_resolution;
+    resolution_factor = 1. / resolution;
+  }
+
+  size_t OccupancyBlockMap::memoryUsage() const{
+    // hash table slots: entry plus state byte, padded
+    return sizeof(OccupancyBlockMap) + blocks.size() * sizeof(Block)
+        + block_index.capacity() * (sizeof(std::pair<OcTreeKey, size_t>) + sizeof(size_t));
+  }
+
+  void OccupancyBlockMap::clear(){
+    blocks.clear();
+    block_index.clear();
+    num_voxels = 0;
+  }
+
+  bool OccupancyBlockMap::coordToKeyChecked(double coordinate, key_type& keyval) const {
+    // scale to resolution and shift center for tree_max_val
+    int scaled_coord =  ((int) floor(resolution_factor * coordinate)) + tree_max_val;
+
+    // keyval within range of tree?
+    if (( scaled_coord >= 0) && (((unsigned int) scaled_coord) < (2*tree_max_val))) {
+      keyval = scaled_coord;
+      return true;
+    }
+    return false;
+  }
+
+  bool OccupancyBlockMap::coordToKeyChecked(const point3d& point, OcTreeKey& key) const{
+    for (unsigned int i=0;i<3;i++) {
+      if (!coordToKeyChecked( point(i), key[i])) return false;
+    }
+    return true;
+  }
+
+  bool OccupancyBlockMap::coordToKeyChecked(double x, double y, double z, OcTreeKey& key) const{
+    return coordToKeyChecked(x, key[0]) && coordToKeyChecked(y, key[1]) && coordToKeyChecked(z, key[2]);
+  }
+
+  // -- blocks  -----------------
+
+  const OccupancyBlockMap::Block* OccupancyBlockMap::findBlock(const OcTreeKey& block_key) const {
+    KeyFlatMap<size_t>::const_iterator it = block_index.find(block_key);
+    if (it == block_index.end())
+      return NULL;
+    return &blocks[it->second];
+  }
+
+  OccupancyBlockMap::Block* OccupancyBlockMap::getOrCreateBlock(const OcTreeKey& block_key) {
+    std::pair<KeyFlatMap<size_t>::iterator, bool> ret =
+        block_index.insert(std::make_pair(block_key, blocks.size()));
+    if (ret.second){
+      // value-initialized in place: no voxel known, all log-odds 0
+      blocks.resize(blocks.size() + 1);
+      blocks.back().key = block_key;
+    }
+    return &blocks[ret.first->second];
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::touchVoxel(Block* block, unsigned int idx) {
+    uint64_t& known = block->known[idx >> 6];
+    const uint64_t bit = uint64_t(1) << (idx & 63);
+    if (!(known & bit)){
+      known |= bit;
+      block->voxels[idx].setLogOdds(0.0f);
+      ++block->num_known;
+      ++num_voxels;
+    }
+    return &block->voxels[idx];
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::touchVoxel(const OcTreeKey& key) {
+    return touchVoxel(getOrCreateBlock(blockKey(key)), voxelIndex(key));
+  }
+
+  // -- search and update  -----------------
+
+  const OccupancyBlockMapVoxel* OccupancyBlockMap::search(const OcTreeKey& key) const {
+    const Block* block = findBlock(blockKey(key));
+    if (block == NULL)
+      return NULL;
+    const unsigned int idx = voxelIndex(key);
+    return block->isKnown(idx) ? &block->voxels[idx] : NULL;
+  }
+
+  const OccupancyBlockMapVoxel* OccupancyBlockMap::search(const point3d& value) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(value, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< value <<"] is out of OcTree bounds!");
+      return NULL;
+    }
+    return search(key);
+  }
+
+  const OccupancyBlockMapVoxel* OccupancyBlockMap::search(double x, double y, double z) const {
+    OcTreeKey key;
+    if (!coordToKeyChecked(x, y, z, key)){
+      OCTOMAP_ERROR_STR("Error in search: ["<< x <<" "<< y << " " << z << "] is out of OcTree bounds!");
+      return NULL;
+    }
+    return search(key);
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::updateNode(const OcTreeKey& key, float log_odds_update) {
+    OccupancyBlockMapVoxel* voxel = touchVoxel(key);
+    float l = voxel->getLogOdds() + log_odds_update;
+    voxel->setLogOdds(std::min(std::max(l, clamping_thres_min), clamping_thres_max));
+    return voxel;
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::updateNode(const point3d& value, float log_odds_update) {
+    OcTreeKey key;
+    if (!coordToKeyChecked(value, key))
+      return NULL;
+    return updateNode(key, log_odds_update);
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::updateNode(double x, double y, double z, float log_odds_update) {
+    OcTreeKey key;
+    if (!coordToKeyChecked(x, y, z, key))
+      return NULL;
+    return updateNode(key, log_odds_update);
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::updateNode(const OcTreeKey& key, bool occupied) {
+    return updateNode(key, occupied ? prob_hit_log : prob_miss_log);
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::updateNode(const point3d& value, bool occupied) {
+    return updateNode(value, occupied ? prob_hit_log : prob_miss_log);
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::updateNode(double x, double y, double z, bool occupied) {
+    return updateNode(x, y, z, occupied ? prob_hit_log : prob_miss_log);
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::setNodeValue(const OcTreeKey& key, float log_odds_value) {
+    OccupancyBlockMapVoxel* voxel = touchVoxel(key);
+    voxel->setLogOdds(std::min(std::max(log_odds_value, clamping_thres_min), clamping_thres_max));
+    return voxel;
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::setNodeValue(const point3d& value, float log_odds_value) {
+    OcTreeKey key;
+    if (!coordToKeyChecked(value, key))
+      return NULL;
+    return setNodeValue(key, log_odds_value);
+  }
+
+  OccupancyBlockMapVoxel* OccupancyBlockMap::setNodeValue(double x, double y, double z, float log_odds_value) {
+    OcTreeKey key;
+    if (!coordToKeyChecked(x, y, z, key))
+      return NULL;
+    return setNodeValue(key, log_odds_value);
+  }
+
+  void OccupancyBlockMap::toMaxLikelihood() {
+    const float thres = occ_prob_thres_log;
+    const float lmin = clamping_thres_min;
+    const float lmax = clamping_thres_max;
+    // unknown voxels are set as well, which keeps the loop branch-free
+    for (std::deque<Block>::iterator block = blocks.begin(); block != blocks.end(); ++block){
+      OccupancyBlockMapVoxel* voxels = block->voxels;
+      for (unsigned int i = 0; i < BLOCK_VOXELS; ++i)
+        voxels[i].log_odds = (voxels[i].log_odds >= thres) ? lmax : lmin;
+    }
+  }
+
+  // -- scan insertion  -----------------
+
+  void OccupancyBlockMap::insertPointCloud(const Pointcloud& scan, const point3d& sensor_origin,
+                                           double maxrange, bool discretize) {
+    KeyFlatSet& free_cells = scan_free_cells;
+    KeyFlatSet& occupied_cells = scan_occupied_cells;
+    free_cells.clear();
+    occupied_cells.clear();
+
+    if (discretize){
+      // see OccupancyOcTreeBase::computeDiscreteUpdate()
+      Pointcloud discrete_scan;
+      discrete_scan.reserve(scan.size());
+      for (size_t i = 0; i < scan.size(); ++i) {
+        OcTreeKey k = coordToKey(scan[i]);
+        if (occupied_cells.insert(k).second)
+          discrete_scan.push_back(keyToCoord(k));
+      }
+      occupied_cells.clear();
+      computeUpdate(discrete_scan, sensor_origin, free_cells, occupied_cells, maxrange);
+    } else {
+      computeUpdate(scan, sensor_origin, free_cells, occupied_cells, maxrange);
+    }
+
+    // consecutive keys mostly fall into the same block, remember the last one
+    Block* block = NULL;
+    for (int pass = 0; pass < 2; ++pass){
+      const KeyFlatSet& cells = (pass == 0) ? free_cells : occupied_cells;
+      const float update = (pass == 0) ? prob_miss_log : prob_hit_log;
+      for (KeyFlatSet::const_iterator it = cells.begin(); it != cells.end(); ++it) {
+        const OcTreeKey block_key = blockKey(*it);
+        if (block == NULL || !(block->key == block_key))
+          block = getOrCreateBlock(block_key);
+
+        OccupancyBlockMapVoxel* voxel = touchVoxel(block, voxelIndex(*it));
+        float l = voxel->getLogOdds() + update;
+        voxel->setLogOdds(std::min(std::max(l, clamping_thres_min), clamping_thres_max));
+      }
+    }
+
+    // keep the memory for the next scan
+    free_cells.clear();
+    occupied_cells.clear();
+  }
+
+  void OccupancyBlockMap::insertPointCloud(const Pointcloud& pc, const point3d& sensor_origin, const pose6d& frame_origin,
+                                           double maxrange, bool discretize) {
+    // performs transformation to data and sensor origin first
+    Pointcloud transformed_scan (pc);
+    transformed_scan.transform(frame_origin);
+    point3d transformed_sensor_origin = frame_origin.transform(sensor_origin);
+    insertPointCloud(transformed_scan, transformed_sensor_origin, maxrange, discretize);
+  }
+
+  void OccupancyBlockMap::computeUpdate(const Pointcloud& scan, const point3d& origin,
+                                        KeyFlatSet& free_cells, KeyFlatSet& occupied_cells, double maxrange) {
+    occupied_cells.reserve(occupied_cells.size() + scan.size());
+
+    for (size_t i = 0; i < scan.size(); ++i) {
+      const point3d& p = scan[i];
+      if ((maxrange < 0.0) || ((p - origin).norm() <= maxrange) ) { // is not maxrange meas.
+        // free cells
+        if (computeRayKeys(origin, p, keyray))
+          free_cells.insert(keyray.begin(), keyray.end());
+        // occupied endpoint
+        OcTreeKey key;
+        if (coordToKeyChecked(p, key))
+          occupied_cells.insert(key);
+      } else { // user set a maxrange and length is above
+        point3d direction = (p - origin).normalized ();
+        point3d new_end = origin + direction * (float) maxrange;
+        if (computeRayKeys(origin, new_end, keyray))
+          free_cells.insert(keyray.begin(), keyray.end());
+      }
+    }
+
+    // prefer occupied cells over free ones (and make sets disjunct)
+    for(KeyFlatSet::iterator it = free_cells.begin(), end=free_cells.end(); it!= end; ){
+      if (occupied_cells.find(*it) != occupied_cells.end()){
+        it = free_cells.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  bool OccupancyBlockMap::computeRayKeys(const point3d& origin, const point3d& end, KeyRay& ray) const {
+
+    /// ----------  see OcTreeBaseImpl::computeRayKeys  -----------
+
+    ray.reset();
+
+    OcTreeKey key_origin, key_end;
+    if ( !coordToKeyChecked(origin, key_origin) || !coordToKeyChecked(end, key_end) ) {
+      OCTOMAP_WARNING_STR("coordinates ( "
+                << origin << " -> " << end << ") out of bounds in computeRayKeys");
+      return false;
+    }
+
+    if (key_origin == key_end)
+      return true; // same tree cell, we're done.
+
+    ray.addKey(key_origin);
+
+    // Initialization phase -------------------------------------------------------
+
+    point3d direction = (end - origin);
+    float length = (float) direction.norm();
+    direction /= length; // normalize vector
+
+    int    step[3];
+    double tMax[3];
+    double tDelta[3];
+
+    OcTreeKey current_key = key_origin;
+
+    for(unsigned int i=0; i < 3; ++i) {
+      // compute step direction
+      if (direction(i) > 0.0) step[i] =  1;
+      else if (direction(i) < 0.0)   step[i] = -1;
+      else step[i] = 0;
+
+      // compute tMax, tDelta
+      if (step[i] != 0) {
+        // corner point of voxel (in direction of ray)
+        double voxelBorder = this->keyToCoord(current_key[i]);
+        voxelBorder += (float) (step[i] * this->resolution * 0.5);
+
+        tMax[i] = ( voxelBorder - origin(i) ) / direction(i);
+        tDelta[i] = this->resolution / fabs( direction(i) );
+      }
+      else {
+        tMax[i] =  std::numeric_limits<double>::max( );
+        tDelta[i] = std::numeric_limits<double>::max( );
+      }
+    }
+
+    // Incremental phase  ---------------------------------------------------------
+
+    while (true) {
+      unsigned int dim;
+
+      // find minimum tMax:
+      if (tMax[0] < tMax[1]){
+        if (tMax[0] < tMax[2]) dim = 0;
+        else                   dim = 2;
+      }
+      else {
+        if (tMax[1] < tMax[2]) dim = 1;
+        else                   dim = 2;
+      }
+
+      // advance in direction "dim"
+      current_key[dim] += step[dim];
+      tMax[dim] += tDelta[dim];
+
+      assert (current_key[dim] < 2*this->tree_max_val);
+
+      // reached endpoint, key equv?
+      if (current_key == key_end)
+        break;
+
+      // reached endpoint world coords? (missed key_end due to discretization errors)
+      double dist_from_origin = std::min(std::min(tMax[0], tMax[1]), tMax[2]);
+      if (dist_from_origin > length)
+        break;
+
+      // continue to add freespace cells
+      ray.addKey(current_key);
+
+      assert ( ray.size() < ray.sizeMax() - 1);
+    } // end while
+
+    return true;
+  }
+
+  bool OccupancyBlockMap::castRay(const point3d& origin, const point3d& directionP, point3d& end,
+                                  bool ignoreUnknown, double maxRange) const {
+
+    /// ----------  see OccupancyOcTreeBase::castRay  -----------
+
+    // Initialization phase -------------------------------------------------------
+    OcTreeKey current_key;
+    if ( !coordToKeyChecked(origin, current_key) ) {
+      OCTOMAP_WARNING_STR("Coordinates out of bounds during ray casting");
+      return false;
+    }
+
+    const OccupancyBlockMapVoxel* startingVoxel = this->search(current_key);
+    if (startingVoxel){
+      if (this->isNodeOccupied(startingVoxel)){
+        // Occupied voxel found at origin
+        // (need to convert from key, since origin does not need to be a voxel center)
+        end = this->keyToCoord(current_key);
+        return true;
+      }
+    } else if(!ignoreUnknown){
+      end = this->keyToCoord(current_key);
+      return false;
+    }
+
+    point3d direction = directionP.normalized();
+    bool max_range_set = (maxRange > 0.0);
+
+    int step[3];
+    double tMax[3];
+    double tDelta[3];
+
+    for(unsigned int i=0; i < 3; ++i) {
+      // compute step direction
+      if (direction(i) > 0.0) step[i] =  1;
+      else if (direction(i) < 0.0)   step[i] = -1;
+      else step[i] = 0;
+
+      // compute tMax, tDelta
+      if (step[i] != 0) {
+        // corner point of voxel (in direction of ray)
+        double voxelBorder = this->keyToCoord(current_key[i]);
+        voxelBorder += double(step[i] * this->resolution * 0.5);
+
+        tMax[i] = ( voxelBorder - origin(i) ) / direction(i);
+        tDelta[i] = this->resolution / fabs( direction(i) );
+      }
+      else {
+        tMax[i] =  std::numeric_limits<double>::max();
+        tDelta[i] = std::numeric_limits<double>::max();
+      }
+    }
+
+    if (step[0] == 0 && step[1] == 0 && step[2] == 0){
+      OCTOMAP_ERROR("Raycasting in direction (0,0,0) is not possible!");
+      return false;
+    }
+
+    // for speedup:
+    double maxrange_sq = maxRange *maxRange;
+
+    // the ray stays within one block for several steps, remember the last one
+    OcTreeKey block_key = blockKey(current_key);
+    const Block* block = findBlock(block_key);
+
+    // Incremental phase  ---------------------------------------------------------
+
+    while (true) {
+      unsigned int dim;
+
+      // find minimum tMax:
+      if (tMax[0] < tMax[1]){
+        if (tMax[0] < tMax[2]) dim = 0;
+        else                   dim = 2;
+      }
+      else {
+        if (tMax[1] < tMax[2]) dim = 1;
+        else                   dim = 2;
+      }
+
+      // check for overflow:
+      if ((step[dim] < 0 && current_key[dim] == 0)
+          || (step[dim] > 0 && current_key[dim] == 2* this->tree_max_val-1))
+      {
+        OCTOMAP_WARNING("Coordinate hit bounds in dim %d, aborting raycast\n", dim);
+        // return border point nevertheless:
+        end = this->keyToCoord(current_key);
+        return false;
+      }
+
+      // advance in direction "dim"
+      current_key[dim] += step[dim];
+      tMax[dim] += tDelta[dim];
+
+      // generate world coords from key
+      end = this->keyToCoord(current_key);
+
+      // check for maxrange:
+      if (max_range_set){
+        double dist_from_origin_sq(0.0);
+        for (unsigned int j = 0; j < 3; j++) {
+          dist_from_origin_sq += ((end(j) - origin(j)) * (end(j) - origin(j)));
+        }
+        if (dist_from_origin_sq > maxrange_sq)
+          return false;
+      }
+
+      const key_type current_block_key = key_type(current_key[dim] >> BLOCK_SHIFT);
+      if (current_block_key != block_key[dim]){
+        block_key[dim] = current_block_key;
+        block = findBlock(block_key);
+      }
+
+      const unsigned int idx = voxelIndex(current_key);
+      if (block && block->isKnown(idx)){
+        if (this->isNodeOccupied(block->voxels[idx]))
+          return true;
+        // otherwise: voxel is free and valid, raycasting continues
+      } else if (!ignoreUnknown){ // no voxel found, this usually means we are in "unknown" areas
+        return false;
+      }
+    }
+  }
+
+  // -- export  -----------------
+
+  bool OccupancyBlockMap::writeBinary(const std::string& filename) const {
+    OcTree tree(resolution);
+    exportTo(tree);
+    return tree.writeBinary(filename);
+  }
+
+  bool OccupancyBlockMap::writeBinary(std::ostream &s) const {
+    OcTree tree(resolution);
+    exportTo(tree);
+    return tree.writeBinary(s);
+  }
+
+  // -- iterator  -----------------
+
+  OccupancyBlockMap::leaf_iterator::leaf_iterator(const OccupancyBlockMap* pmap)
+    : map(pmap), block(0), idx(0)
+  {
+    skipUnknown();
+  }
+
+  void OccupancyBlockMap::leaf_iterator::skipUnknown(){
+    if (map == NULL)
+      return;
+
+    for (; block < map->blocks.size(); ++block, idx = 0){
+      const Block& b = map->blocks[block];
+      for (; idx < BLOCK_VOXELS; ++idx){
+        // skip words without known voxels
+        uint64_t word = b.known[idx >> 6] >> (idx & 63);
+        if (word == 0){
+          idx = (idx | 63);
+          continue;
+        }
+        while (!(word & 1)){
+          word >>= 1;
+          ++idx;
+        }
+        return;
+      }
+    }
+
+    // past the last voxel: end-iterator
+    map = NULL;
+    block = 0;
+    idx = 0;
+  }
+
+} // end namespace
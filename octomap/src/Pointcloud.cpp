@@ -71,10 +71,8 @@ namespace octomap {
   }
 
 
-  Pointcloud::Pointcloud(const Pointcloud& other) {
-    for (Pointcloud::const_iterator it = other.begin(); it != other.end(); it++) {
-      points.push_back(point3d(*it));
-    }
+  Pointcloud::Pointcloud(const Pointcloud& other)
+    : points(other.points) {
   }
 
   Pointcloud::Pointcloud(Pointcloud* other) {
@@ -85,9 +83,7 @@ namespace octomap {
 
 
   void Pointcloud::push_back(const Pointcloud& other)   {
-    for (Pointcloud::const_iterator it = other.begin(); it != other.end(); it++) {
-      points.push_back(point3d(*it));
-    }
+    points.insert(points.end(), other.points.begin(), other.points.end());
   }
 
   point3d Pointcloud::getPoint(unsigned int i) const{
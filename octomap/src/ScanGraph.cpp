@@ -35,6 +35,7 @@
 #include <fstream>
 #include <sstream>
 #include <stdlib.h>
+#include <map>
 
 #include <octomap/math/Pose6D.h>
 #include <octomap/ScanGraph.h>
@@ -49,6 +50,18 @@ namespace octomap {
     }
   }
 
+  ScanNode::ScanNode(const ScanNode& other)
+    : scan(NULL), pose(other.pose), id(other.id) {
+    if (other.scan != NULL)
+      scan = new Pointcloud(*other.scan);
+  }
+
+  ScanNode& ScanNode::operator=(const ScanNode& other) {
+    ScanNode tmp(other);
+    swap(tmp);
+    return *this;
+  }
+
   std::ostream& ScanNode::writeBinary(std::ostream &s) const {
 
     // file structure:    pointcloud | pose | id
@@ -160,6 +173,31 @@ namespace octomap {
   }
 
 
+  ScanGraph::ScanGraph(const ScanGraph& other) {
+    nodes.reserve(other.nodes.size());
+    edges.reserve(other.edges.size());
+    std::map<const ScanNode*, ScanNode*> node_map;
+    for (unsigned int i=0; i<other.nodes.size(); i++) {
+      nodes.push_back(new ScanNode(*other.nodes[i]));
+      node_map[other.nodes[i]] = nodes.back();
+    }
+    // edges refer to the copied nodes
+    for (unsigned int i=0; i<other.edges.size(); i++) {
+      const ScanEdge* e = other.edges[i];
+      ScanEdge* copy = new ScanEdge(node_map[e->first], node_map[e->second], e->constraint);
+      copy->weight = e->weight;
+      edges.push_back(copy);
+    }
+  }
+
+  ScanGraph& ScanGraph::operator=(const ScanGraph& other) {
+    if (this != &other) {
+      ScanGraph tmp(other);
+      swap(tmp);
+    }
+    return *this;
+  }
+
   ScanGraph::~ScanGraph() {
     this->clear();
   }
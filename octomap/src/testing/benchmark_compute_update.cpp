@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+using namespace std;
+using namespace octomap;
+
+// Timing of computeUpdate for the instruction sets of the ray traversal and for 1 up to
+// the given number of threads (default: all cores), results are checked by test_compute_update.
+// Every thread count is also timed with the former computeUpdate as baseline, which inserts
+// the keys of each ray into the shared sets in OpenMP critical sections.
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+// computeUpdate into flat sets (as in insertPointCloud) with the given number of threads,
+// @return fastest of some repetitions in s
+double computeUpdateTimed(unsigned int num_threads, const Pointcloud& cloud, const point3d& origin,
+                          double maxrange, bool use_bbx, KeyFlatSet& free_cells, KeyFlatSet& occupied_cells,
+                          RaySIMD simd = RAY_SIMD_AVX2){
+#ifdef _OPENMP
+  omp_set_num_threads(num_threads);
+#else
+  (void) num_threads;
+#endif
+  OcTree tree (0.05); // one keyray per thread
+  tree.setRaySIMD(simd);
+  if (use_bbx){
+    point3d bbx_min (-1.0f, -2.0f, -0.5f);
+    point3d bbx_max (3.0f, 2.0f, 1.0f);
+    tree.setBBXMin(bbx_min);
+    tree.setBBXMax(bbx_max);
+    tree.useBBXLimit(true);
+  }
+
+  double best = -1.0;
+  for (unsigned int r = 0; r < 3; ++r) {
+    free_cells.clear();
+    occupied_cells.clear();
+    timeval start;
+    timeval stop;
+    gettimeofday(&start, NULL);
+    tree.computeUpdate(cloud, origin, free_cells, occupied_cells, maxrange);
+    gettimeofday(&stop, NULL);
+    double time = timediff(start, stop);
+    if (best < 0.0 || time < best)
+      best = time;
+  }
+  return best;
+}
+
+// baseline: computeUpdate as it was before the per-thread key sets, one scalar ray at a time
+// and every insertion serialized on a critical section
+void computeUpdateCritical(const OcTree& tree, const Pointcloud& scan, const point3d& origin,
+                           KeySet& free_cells, KeySet& occupied_cells, double maxrange,
+                           std::vector<KeyRay>& keyrays){
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(guided)
+#endif
+  for (int i = 0; i < (int)scan.size(); ++i) {
+    const point3d& p = scan[i];
+    unsigned threadIdx = 0;
+#ifdef _OPENMP
+    threadIdx = omp_get_thread_num();
+#endif
+    KeyRay* keyray = &(keyrays.at(threadIdx));
+
+    if (!tree.bbxSet()) { // no BBX specified
+      if ((maxrange < 0.0) || ((p - origin).norm() <= maxrange) ) { // is not maxrange meas.
+        // free cells
+        if (tree.computeRayKeys(origin, p, *keyray)){
+#ifdef _OPENMP
+          #pragma omp critical (free_insert)
+#endif
+          {
+            free_cells.insert(keyray->begin(), keyray->end());
+          }
+        }
+        // occupied endpoint
+        OcTreeKey key;
+        if (tree.coordToKeyChecked(p, key)){
+#ifdef _OPENMP
+          #pragma omp critical (occupied_insert)
+#endif
+          {
+            occupied_cells.insert(key);
+          }
+        }
+      } else { // user set a maxrange and length is above
+        point3d direction = (p - origin).normalized ();
+        point3d new_end = origin + direction * (float) maxrange;
+        if (tree.computeRayKeys(origin, new_end, *keyray)){
+#ifdef _OPENMP
+          #pragma omp critical (free_insert)
+#endif
+          {
+            free_cells.insert(keyray->begin(), keyray->end());
+          }
+        }
+      } // end if maxrange
+    } else { // BBX was set
+      // endpoint in bbx and not maxrange?
+      if ( tree.inBBX(p) && ((maxrange < 0.0) || ((p - origin).norm () <= maxrange) ) )  {
+        // occupied endpoint
+        OcTreeKey key;
+        if (tree.coordToKeyChecked(p, key)){
+#ifdef _OPENMP
+          #pragma omp critical (occupied_insert)
+#endif
+          {
+            occupied_cells.insert(key);
+          }
+        }
+
+        // update freespace, break as soon as bbx limit is reached
+        if (tree.computeRayKeys(origin, p, *keyray)){
+          for(KeyRay::reverse_iterator rit=keyray->rbegin(); rit != keyray->rend(); rit++) {
+            if (tree.inBBX(*rit)) {
+#ifdef _OPENMP
+              #pragma omp critical (free_insert)
+#endif
+              {
+                free_cells.insert(*rit);
+              }
+            }
+            else break;
+          }
+        } // end if compute ray
+      } // end if in BBX and not maxrange
+    } // end bbx case
+  } // end for all points, end of parallel OMP loop
+
+  // prefer occupied cells over free ones (and make sets disjunct)
+  for(KeySet::iterator it = free_cells.begin(), end=free_cells.end(); it!= end; ){
+    if (occupied_cells.find(*it) != occupied_cells.end()){
+      it = free_cells.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// computeUpdateCritical with the given number of threads, @return fastest of some repetitions in s
+double computeUpdateCriticalTimed(unsigned int num_threads, const Pointcloud& cloud, const point3d& origin,
+                                  double maxrange, bool use_bbx, KeySet& free_cells, KeySet& occupied_cells){
+#ifdef _OPENMP
+  omp_set_num_threads(num_threads);
+#endif
+  OcTree tree (0.05);
+  if (use_bbx){
+    point3d bbx_min (-1.0f, -2.0f, -0.5f);
+    point3d bbx_max (3.0f, 2.0f, 1.0f);
+    tree.setBBXMin(bbx_min);
+    tree.setBBXMax(bbx_max);
+    tree.useBBXLimit(true);
+  }
+  std::vector<KeyRay> keyrays (num_threads);
+
+  double best = -1.0;
+  for (unsigned int r = 0; r < 3; ++r) {
+    free_cells.clear();
+    occupied_cells.clear();
+    timeval start;
+    timeval stop;
+    gettimeofday(&start, NULL);
+    computeUpdateCritical(tree, cloud, origin, free_cells, occupied_cells, maxrange, keyrays);
+    gettimeofday(&stop, NULL);
+    double time = timediff(start, stop);
+    if (best < 0.0 || time < best)
+      best = time;
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+
+  // simulated scan of a sphere with varying ranges, rays overlap close to the origin
+  Pointcloud cloud;
+  for (float azimuth = -3.14f; azimuth < 3.14f; azimuth += 0.01f)
+    for (float elevation = -0.8f; elevation < 0.8f; elevation += 0.01f) {
+      float range = 4.0f + 2.0f * sin(3.0f * azimuth) * cos(5.0f * elevation);
+      cloud.push_back(range * cos(elevation) * cos(azimuth), range * cos(elevation) * sin(azimuth), range * sin(elevation));
+    }
+  point3d origin (0.01f, 0.01f, 0.02f);
+
+  unsigned int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_num_procs();
+  if (argc > 1)
+    max_threads = (unsigned int) atoi(argv[1]);
+  printf("%d cores, up to %u threads\n", omp_get_num_procs(), max_threads);
+#else
+  printf("built without OpenMP (OCTOMAP_OMP), 1 thread only\n");
+#endif
+
+  const char* names[] = {"unlimited", "maxrange", "bbx"};
+  const char* simd_names[] = {"scalar", "SSE4.1", "AVX2"};
+  for (unsigned int config = 0; config < 3; ++config) {
+    double maxrange = (config == 1) ? 3.0 : -1.0;
+    bool use_bbx = (config == 2);
+
+    KeyFlatSet free_cells, occupied_cells;
+    double ref_time = computeUpdateTimed(1, cloud, origin, maxrange, use_bbx, free_cells, occupied_cells);
+    printf("computeUpdate (%s, %lu rays, %lu free, %lu occupied)\n", names[config],
+           (unsigned long) cloud.size(), (unsigned long) free_cells.size(), (unsigned long) occupied_cells.size());
+
+    for (int simd = RAY_SIMD_NONE; simd <= (int) detectRaySIMD(); ++simd) {
+      double time = computeUpdateTimed(1, cloud, origin, maxrange, use_bbx, free_cells, occupied_cells, (RaySIMD) simd);
+      printf("  1 thread, %s rays: %f s\n", simd_names[simd], time);
+    }
+
+    for (unsigned int num_threads = 2; num_threads <= max_threads; num_threads *= 2) {
+      double time = computeUpdateTimed(num_threads, cloud, origin, maxrange, use_bbx, free_cells, occupied_cells);
+      printf("  %u threads: %f s, speedup %.2f\n", num_threads, time, ref_time / time);
+    }
+
+    // baseline with critical sections, speedup of the current computeUpdate at the same thread count
+    KeySet base_free_cells, base_occupied_cells;
+    for (unsigned int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+      double base_time = computeUpdateCriticalTimed(num_threads, cloud, origin, maxrange, use_bbx,
+                                                    base_free_cells, base_occupied_cells);
+      double time = computeUpdateTimed(num_threads, cloud, origin, maxrange, use_bbx, free_cells, occupied_cells);
+      printf("  %u thread(s), critical sections: %f s (%lu free, %lu occupied), speedup over it %.2f\n",
+             num_threads, base_time, (unsigned long) base_free_cells.size(),
+             (unsigned long) base_occupied_cells.size(), base_time / time);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <octomap/octomap_timing.h>
+#include <octomap/octomap.h>
+#include <octomap/OcTreeFixed.h>
+
+using namespace std;
+using namespace octomap;
+
+// Compares the timing of OcTreeFixed with compile-time configuration to OcTree,
+// results are checked by test_fixed_tree.
+
+typedef OcTreeFixed<OcTree, OCTOMAP_TREE_DEPTH, 5, 100> OcTreeFixed5cm;
+
+double timediff(const timeval& start, const timeval& stop){
+  return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
+}
+
+int main(int argc, char** argv) {
+
+  // simulated scan of a half sphere
+  Pointcloud cloud;
+  for (float azimuth = -1.5f; azimuth < 1.5f; azimuth += 0.02f)
+    for (float elevation = -0.5f; elevation < 0.8f; elevation += 0.02f) {
+      float range = 2.0f + 0.5f * sin(3.0f * azimuth);
+      cloud.push_back(range * cos(elevation) * cos(azimuth), range * cos(elevation) * sin(azimuth), range * sin(elevation));
+    }
+  point3d origin (0.01f, 0.01f, 0.02f);
+
+  OcTree tree (0.05);
+  OcTreeFixed5cm fixed;
+  tree.insertPointCloud(cloud, origin);
+  fixed.insertPointCloud(cloud, origin);
+
+  // timing: compile-time vs runtime configuration
+  timeval start;
+  timeval stop;
+  const unsigned int repetitions = 20;
+  std::vector<point3d> queries;
+  for (float x = -3.0f; x < 3.0f; x += 0.031f)
+    for (float y = -3.0f; y < 3.0f; y += 0.031f)
+      for (float z = -1.5f; z < 2.0f; z += 0.1f)
+        queries.push_back(point3d(x, y, z));
+
+  unsigned int checksum_tree = 0, checksum_fixed = 0;
+  gettimeofday(&start, NULL);
+  for (unsigned int r = 0; r < repetitions; ++r)
+    for (size_t i = 0; i < queries.size(); ++i)
+      checksum_tree += tree.coordToKey(queries[i])[0];
+  gettimeofday(&stop, NULL);
+  double time_tree = timediff(start, stop);
+  gettimeofday(&start, NULL);
+  for (unsigned int r = 0; r < repetitions; ++r)
+    for (size_t i = 0; i < queries.size(); ++i)
+      checksum_fixed += fixed.coordToKey(queries[i])[0];
+  gettimeofday(&stop, NULL);
+  double time_fixed = timediff(start, stop);
+  if (checksum_tree != checksum_fixed)
+    fprintf(stderr, "coordToKey results differ\n");
+  printf("coordToKey: %f s (runtime), %f s (fixed)\n", time_tree, time_fixed);
+
+  std::vector<OcTreeKey> keys;
+  for (size_t i = 0; i < queries.size(); ++i)
+    keys.push_back(tree.coordToKey(queries[i]));
+
+  size_t found_tree = 0, found_fixed = 0;
+  gettimeofday(&start, NULL);
+  for (unsigned int r = 0; r < repetitions; ++r)
+    for (size_t i = 0; i < keys.size(); ++i)
+      found_tree += (tree.search(keys[i]) != NULL);
+  gettimeofday(&stop, NULL);
+  time_tree = timediff(start, stop);
+  gettimeofday(&start, NULL);
+  for (unsigned int r = 0; r < repetitions; ++r)
+    for (size_t i = 0; i < keys.size(); ++i)
+      found_fixed += (fixed.search(keys[i]) != NULL);
+  gettimeofday(&stop, NULL);
+  time_fixed = timediff(start, stop);
+  if (found_tree != found_fixed)
+    fprintf(stderr, "search results differ\n");
+  printf("search: %f s (runtime), %f s (fixed)\n", time_tree, time_fixed);
+
+  gettimeofday(&start, NULL);
+  for (size_t i = 0; i < keys.size(); ++i)
+    tree.updateNode(keys[i], (i % 3) ? -0.4f : 0.85f, true);
+  gettimeofday(&stop, NULL);
+  time_tree = timediff(start, stop);
+  gettimeofday(&start, NULL);
+  for (size_t i = 0; i < keys.size(); ++i)
+    fixed.updateNode(keys[i], (i % 3) ? -0.4f : 0.85f, true);
+  gettimeofday(&stop, NULL);
+  time_fixed = timediff(start, stop);
+  tree.updateInnerOccupancy();
+  fixed.updateInnerOccupancy();
+  if (!(fixed == tree))
+    fprintf(stderr, "updateNode results differ\n");
+  printf("updateNode: %f s (runtime), %f s (fixed)\n", time_tree, time_fixed);
+
+  return 0;
+}
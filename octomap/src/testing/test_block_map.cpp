@@ -0,0 +1,148 @@
+
+#include <sstream>
+#include <octomap/octomap.h>
+#include <octomap/OccupancyBlockMap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+// all leaves of a and b cover the same volumes with the same occupancy
+bool sameLeafs(const OcTree& a, const OcTree& b) {
+  if (a.size() != b.size())
+    return false;
+  for (OcTree::leaf_iterator it = a.begin_leafs(); it != a.end_leafs(); ++it) {
+    OcTreeNode* node = b.search(it.getKey(), it.getDepth());
+    if (!node || b.nodeHasChildren(node) || node->getLogOdds() != it->getLogOdds())
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+
+  // empty map
+  OccupancyBlockMap map (0.05);
+  EXPECT_EQ (map.size(), 0);
+  EXPECT_EQ (map.getNumBlocks(), 0);
+  EXPECT_FALSE (map.search(point3d(0.0f, 0.0f, 0.0f)));
+  EXPECT_TRUE (map.begin_leafs() == map.end_leafs());
+
+  // simulated scan of a half sphere
+  Pointcloud cloud;
+  for (float azimuth = -1.5f; azimuth < 1.5f; azimuth += 0.02f)
+    for (float elevation = -0.5f; elevation < 0.8f; elevation += 0.02f) {
+      float range = 2.0f + 0.5f * sin(3.0f * azimuth);
+      cloud.push_back(range * cos(elevation) * cos(azimuth), range * cos(elevation) * sin(azimuth), range * sin(elevation));
+    }
+  point3d origin (0.01f, 0.01f, 0.02f);
+
+  OcTree tree (0.05);
+  for (int i = 0; i < 2; ++i) {
+    tree.insertPointCloud(cloud, origin, 2.2);
+    map.insertPointCloud(cloud, origin, 2.2);
+  }
+  tree.updateNode(point3d(-1.0f, 0.0f, 0.0f), true); // single isolated voxel
+  map.updateNode(point3d(-1.0f, 0.0f, 0.0f), true);
+  tree.setNodeValue(point3d(-1.0f, 0.2f, 0.0f), 10.0f);
+  map.setNodeValue(point3d(-1.0f, 0.2f, 0.0f), 10.0f);
+  EXPECT_EQ (map.search(point3d(-1.0f, 0.2f, 0.0f))->getLogOdds(), map.getClampingThresMaxLog());
+  EXPECT_TRUE (map.size() > 0);
+  EXPECT_TRUE (map.getNumBlocks() * OccupancyBlockMap::BLOCK_VOXELS >= map.size());
+
+  // every voxel of the map is a leaf with the same occupancy in the tree
+  size_t num_voxels = 0;
+  for (OccupancyBlockMap::leaf_iterator it = map.begin_leafs(); it != map.end_leafs(); ++it, ++num_voxels) {
+    OcTreeNode* node = tree.search(it.getKey());
+    EXPECT_TRUE (node);
+    EXPECT_EQ (node->getLogOdds(), it->getLogOdds());
+    EXPECT_TRUE (map.search(it.getKey()) == &(*it));
+    EXPECT_TRUE (map.search(it.getCoordinate()) == &(*it));
+    EXPECT_EQ (it.getDepth(), tree.getTreeDepth());
+    EXPECT_FLOAT_EQ (it.getSize(), map.getResolution());
+  }
+  EXPECT_EQ (num_voxels, map.size());
+
+  // ... and vice versa
+  for (float x = -3.0f; x < 3.0f; x += 0.07f)
+    for (float y = -3.0f; y < 3.0f; y += 0.07f)
+      for (float z = -1.5f; z < 2.0f; z += 0.11f) {
+        point3d p (x, y, z);
+        OcTreeNode* node = tree.search(p);
+        const OccupancyBlockMapVoxel* voxel = map.search(p);
+        EXPECT_EQ ((node == NULL), (voxel == NULL));
+        if (node && voxel)
+          EXPECT_EQ (tree.isNodeOccupied(node), map.isNodeOccupied(voxel));
+      }
+
+  // export into an octree equals the directly built tree
+  tree.updateInnerOccupancy();
+  tree.prune();
+  OcTree exported (0.05);
+  map.exportTo(exported);
+  EXPECT_TRUE (sameLeafs(tree, exported));
+
+  // ray casting
+  for (float azimuth = -3.1f; azimuth < 3.1f; azimuth += 0.05f)
+    for (float elevation = -1.0f; elevation < 1.0f; elevation += 0.1f) {
+      point3d direction (cos(elevation) * cos(azimuth), cos(elevation) * sin(azimuth), sin(elevation));
+      for (int ignore_unknown = 0; ignore_unknown < 2; ++ignore_unknown) {
+        point3d end, map_end;
+        bool hit = tree.castRay(origin, direction, end, ignore_unknown != 0, 5.0);
+        bool map_hit = map.castRay(origin, direction, map_end, ignore_unknown != 0, 5.0);
+        EXPECT_EQ (hit, map_hit);
+        EXPECT_TRUE (end == map_end);
+      }
+    }
+
+  // .bt export
+  std::stringstream map_stream, tree_stream;
+  EXPECT_TRUE (map.writeBinary(map_stream));
+  OcTree tree_ml (tree);
+  EXPECT_TRUE (tree_ml.writeBinary(tree_stream));
+  OcTree read_tree (0.1);
+  EXPECT_TRUE (read_tree.readBinary(map_stream));
+  EXPECT_TRUE (sameLeafs(tree_ml, read_tree));
+  EXPECT_TRUE (map_stream.str() == tree_stream.str());
+
+  // conversion from a (pruned) octree expands all leaves
+  OccupancyBlockMap converted (tree);
+  size_t expected_voxels = 0;
+  for (OcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+    size_t width = size_t(1) << (tree.getTreeDepth() - it.getDepth());
+    expected_voxels += width * width * width;
+  }
+  EXPECT_EQ (converted.size(), expected_voxels);
+  EXPECT_EQ (converted.getOccupancyThresLog(), tree.getOccupancyThresLog());
+  OcTree reexported (0.05);
+  converted.exportTo(reexported);
+  EXPECT_TRUE (sameLeafs(tree, reexported));
+
+  // maximum likelihood
+  map.toMaxLikelihood();
+  tree.toMaxLikelihood();
+  tree.prune();
+  OcTree exported_ml (0.05);
+  map.exportTo(exported_ml);
+  EXPECT_TRUE (sameLeafs(tree, exported_ml));
+  EXPECT_EQ (num_voxels, map.size());
+
+  // discretized insertion
+  OcTree tree_discrete (0.1);
+  OccupancyBlockMap map_discrete (0.1);
+  tree_discrete.insertPointCloud(cloud, origin, -1.0, false, true);
+  map_discrete.insertPointCloud(cloud, origin, -1.0, true);
+  tree_discrete.prune();
+  OcTree exported_discrete (0.1);
+  map_discrete.exportTo(exported_discrete);
+  EXPECT_TRUE (sameLeafs(tree_discrete, exported_discrete));
+
+  // clear
+  map.clear();
+  EXPECT_EQ (map.size(), 0);
+  EXPECT_TRUE (map.begin_leafs() == map.end_leafs());
+  EXPECT_FALSE (map.search(point3d(-1.0f, 0.0f, 0.0f)));
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,94 @@
+
+#include <stdio.h>
+#include <octomap/octomap.h>
+#include "testing.h"
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+using namespace std;
+using namespace octomap;
+
+bool equalKeySets(const KeySet& a, const KeySet& b){
+  if (a.size() != b.size())
+    return false;
+  for (KeySet::const_iterator it = a.begin(); it != a.end(); ++it) {
+    if (b.find(*it) == b.end())
+      return false;
+  }
+  return true;
+}
+
+// computeUpdate with the given number of threads (only 1 without OpenMP)
+void computeUpdateThreads(unsigned int num_threads, const Pointcloud& cloud, const point3d& origin,
+                          double maxrange, bool use_bbx, KeySet& free_cells, KeySet& occupied_cells,
+                          RaySIMD simd = RAY_SIMD_AVX2){
+#ifdef _OPENMP
+  omp_set_num_threads(num_threads);
+#else
+  (void) num_threads;
+#endif
+  OcTree tree (0.05); // one keyray per thread
+  tree.setRaySIMD(simd);
+  if (use_bbx){
+    point3d bbx_min (-1.0f, -2.0f, -0.5f);
+    point3d bbx_max (3.0f, 2.0f, 1.0f);
+    tree.setBBXMin(bbx_min);
+    tree.setBBXMax(bbx_max);
+    tree.useBBXLimit(true);
+  }
+  tree.computeUpdate(cloud, origin, free_cells, occupied_cells, maxrange);
+}
+
+// Checks that computeUpdate gives the same sets for any number of threads and instruction set,
+// the timing is measured by benchmark_compute_update.
+int main(int argc, char** argv) {
+
+  // simulated scan of a sphere with varying ranges, rays overlap close to the origin
+  Pointcloud cloud;
+  for (float azimuth = -3.14f; azimuth < 3.14f; azimuth += 0.05f)
+    for (float elevation = -0.8f; elevation < 0.8f; elevation += 0.05f) {
+      float range = 4.0f + 2.0f * sin(3.0f * azimuth) * cos(5.0f * elevation);
+      cloud.push_back(range * cos(elevation) * cos(azimuth), range * cos(elevation) * sin(azimuth), range * sin(elevation));
+    }
+  point3d origin (0.01f, 0.01f, 0.02f);
+
+  unsigned int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = 4; // also more threads than cores
+#endif
+
+  for (unsigned int config = 0; config < 3; ++config) {
+    double maxrange = (config == 1) ? 3.0 : -1.0;
+    bool use_bbx = (config == 2);
+
+    // single thread: serial reference
+    KeySet ref_free, ref_occupied;
+    computeUpdateThreads(1, cloud, origin, maxrange, use_bbx, ref_free, ref_occupied);
+    EXPECT_FALSE (ref_free.empty());
+    for (KeySet::const_iterator it = ref_occupied.begin(); it != ref_occupied.end(); ++it)
+      EXPECT_TRUE (ref_free.find(*it) == ref_free.end()); // occupied has precedence
+    if (config == 1)
+      EXPECT_TRUE (ref_occupied.size() < cloud.size() / 2); // most endpoints beyond maxrange
+
+    // same sets with the other instruction sets for ray traversal
+    for (int simd = RAY_SIMD_NONE; simd <= (int) detectRaySIMD(); ++simd) {
+      KeySet free_cells, occupied_cells;
+      computeUpdateThreads(1, cloud, origin, maxrange, use_bbx, free_cells, occupied_cells, (RaySIMD) simd);
+      EXPECT_TRUE (equalKeySets(free_cells, ref_free));
+      EXPECT_TRUE (equalKeySets(occupied_cells, ref_occupied));
+    }
+
+    // same sets with any number of threads
+    for (unsigned int num_threads = 2; num_threads <= max_threads; ++num_threads) {
+      KeySet free_cells, occupied_cells;
+      computeUpdateThreads(num_threads, cloud, origin, maxrange, use_bbx, free_cells, occupied_cells);
+      EXPECT_TRUE (equalKeySets(free_cells, ref_free));
+      EXPECT_TRUE (equalKeySets(occupied_cells, ref_occupied));
+    }
+  }
+
+  fprintf(stderr, "Test successful.\n");
+  return 0;
+}
@@ -0,0 +1,124 @@
+
+#include <stdio.h>
+#include <sstream>
+#include <octomap/octomap.h>
+#include <octomap/ColorOcTree.h>
+#include <octomap/OcTreeFixed.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+typedef OcTreeFixed<OcTree, OCTOMAP_TREE_DEPTH, 5, 100> OcTreeFixed5cm;
+
+// same updates on both trees
+template <class TREE>
+void insertScan(TREE& tree, const Pointcloud& cloud, const point3d& origin){
+  tree.insertPointCloud(cloud, origin);
+  tree.updateNode(point3d(-1.0f, 0.0f, 0.0f), true); // single isolated voxel
+  tree.updateNode(point3d(-1.2f, 0.3f, 0.1f), 2.0f, true);
+  tree.insertRay(origin, point3d(0.5f, -2.5f, 0.3f));
+  tree.updateInnerOccupancy();
+}
+
+template <class TREE>
+void compareTrees(const OcTree& tree, const TREE& fixed){
+  EXPECT_EQ (fixed.size(), tree.size());
+  EXPECT_EQ (fixed.getNumLeafNodes(), tree.getNumLeafNodes());
+  EXPECT_TRUE (fixed == tree);
+
+  // search at all depths: same nodes found
+  for (float x = -3.0f; x < 3.0f; x += 0.07f)
+    for (float y = -3.0f; y < 3.0f; y += 0.07f)
+      for (float z = -1.5f; z < 2.0f; z += 0.11f) {
+        point3d p (x, y, z);
+        OcTreeKey key = tree.coordToKey(p);
+        EXPECT_TRUE (key == fixed.coordToKey(p));
+        EXPECT_TRUE (tree.keyToCoord(key) == fixed.keyToCoord(key));
+        for (unsigned int depth = 0; depth <= tree.getTreeDepth(); depth += 4) {
+          OcTreeNode* node = tree.search(key, depth);
+          OcTreeNode* fixed_node = fixed.search(key, depth);
+          EXPECT_EQ ((node == NULL), (fixed_node == NULL));
+          EXPECT_TRUE (fixed_node == fixed.search(p, depth));
+          if (node && fixed_node) {
+            EXPECT_EQ (node->getLogOdds(), fixed_node->getLogOdds());
+            EXPECT_EQ (tree.nodeHasChildren(node), fixed.nodeHasChildren(fixed_node));
+          }
+        }
+      }
+}
+
+int main(int argc, char** argv) {
+
+  // simulated scan of a half sphere
+  Pointcloud cloud;
+  for (float azimuth = -1.5f; azimuth < 1.5f; azimuth += 0.02f)
+    for (float elevation = -0.5f; elevation < 0.8f; elevation += 0.02f) {
+      float range = 2.0f + 0.5f * sin(3.0f * azimuth);
+      cloud.push_back(range * cos(elevation) * cos(azimuth), range * cos(elevation) * sin(azimuth), range * sin(elevation));
+    }
+  point3d origin (0.01f, 0.01f, 0.02f);
+
+  // compile-time resolution and depth
+  OcTreeFixed5cm fixed;
+  EXPECT_TRUE (fixed.hasFixedResolution());
+  EXPECT_EQ (fixed.getResolution(), 0.05);
+  EXPECT_EQ (fixed.getTreeDepth(), (unsigned int) OCTOMAP_TREE_DEPTH);
+  EXPECT_FALSE (fixed.search(point3d(0.0f, 0.0f, 0.0f)));
+
+  OcTree tree (0.05);
+  const OcTree& fixed_ref = fixed; // usable as an OcTree
+  EXPECT_EQ (fixed_ref.getResolution(), tree.getResolution());
+  for (unsigned int depth = 0; depth <= tree.getTreeDepth(); ++depth)
+    EXPECT_EQ (fixed.getNodeSize(depth), tree.getNodeSize(depth));
+
+  insertScan(tree, cloud, origin);
+  insertScan(fixed, cloud, origin);
+  compareTrees(tree, fixed);
+
+  // out of bounds
+  OcTreeKey key;
+  EXPECT_FALSE (fixed.coordToKeyChecked(point3d(1e6f, 0.0f, 0.0f), key));
+  EXPECT_FALSE (fixed.search(1e6, 0.0, 0.0));
+
+  // the resolution cannot be changed
+  fixed.setResolution(0.1);
+  EXPECT_EQ (fixed.getResolution(), 0.05);
+  EXPECT_EQ (fixed_ref.getResolution(), 0.05);
+
+  // fixed depth, resolution at runtime; other tree types
+  OcTreeFixed<OcTree> fixed_depth (0.05);
+  EXPECT_FALSE (fixed_depth.hasFixedResolution());
+  insertScan(fixed_depth, cloud, origin);
+  compareTrees(tree, fixed_depth);
+  fixed_depth.setResolution(0.1);
+  EXPECT_EQ (fixed_depth.getResolution(), 0.1);
+  EXPECT_TRUE (fixed_depth.coordToKey(point3d(1.0f, 2.0f, 3.0f)) == fixed_depth.OcTree::coordToKey(point3d(1.0f, 2.0f, 3.0f)));
+
+  OcTreeFixed<ColorOcTree, OCTOMAP_TREE_DEPTH, 1, 10> color_fixed;
+  ColorOcTreeNode* color_node = color_fixed.updateNode(point3d(0.3f, 0.2f, 0.1f), true);
+  color_node->setColor(255, 0, 0);
+  EXPECT_TRUE (color_fixed.search(point3d(0.3f, 0.2f, 0.1f))->getColor() == ColorOcTreeNode::Color(255, 0, 0));
+
+  // a fixed resolution cannot be changed, neither by the constructor nor by reading a file
+  OcTreeFixed5cm forced (0.1);
+  EXPECT_EQ (forced.getResolution(), 0.05);
+  EXPECT_EQ (forced.OcTree::getResolution(), 0.05);
+  OcTree coarse_tree (0.1);
+  coarse_tree.updateNode(point3d(1.0f, 1.0f, 1.0f), true);
+  std::stringstream coarse_file;
+  EXPECT_TRUE (coarse_tree.writeBinaryConst(coarse_file));
+  EXPECT_FALSE (fixed.readBinary(coarse_file));
+  EXPECT_EQ (fixed.getResolution(), 0.05);
+  std::stringstream fixed_file;
+  EXPECT_TRUE (tree.writeBinaryConst(fixed_file));
+  EXPECT_TRUE (fixed.readBinary(fixed_file));
+  OcTree binary_tree (0.05);
+  fixed_file.clear();
+  fixed_file.seekg(0);
+  EXPECT_TRUE (binary_tree.readBinary(fixed_file));
+  EXPECT_TRUE (fixed == binary_tree);
+
+  fprintf(stderr, "Test successful.\n");
+  return 0;
+}
@@ -0,0 +1,128 @@
+
+#include <octomap/octomap.h>
+#include <octomap/ColorOcTree.h>
+#include <octomap/OcTreeFrozen.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+int main(int argc, char** argv) {
+
+  // empty trees
+  OcTree tree (0.05);
+  OcTreeFrozen empty_frozen (tree);
+  EXPECT_EQ (empty_frozen.size(), 0);
+  EXPECT_FALSE (empty_frozen.search(point3d(0.0f, 0.0f, 0.0f)));
+  EXPECT_TRUE (empty_frozen.begin_leafs() == empty_frozen.end_leafs());
+
+  // simulated scan of a half sphere
+  Pointcloud cloud;
+  for (float azimuth = -1.5f; azimuth < 1.5f; azimuth += 0.02f)
+    for (float elevation = -0.5f; elevation < 0.8f; elevation += 0.02f) {
+      float range = 2.0f + 0.5f * sin(3.0f * azimuth);
+      cloud.push_back(range * cos(elevation) * cos(azimuth), range * cos(elevation) * sin(azimuth), range * sin(elevation));
+    }
+  point3d origin (0.01f, 0.01f, 0.02f);
+  tree.insertPointCloud(cloud, origin);
+  tree.updateNode(point3d(-1.0f, 0.0f, 0.0f), true); // single isolated voxel
+  tree.prune();
+
+  OcTreeFrozen frozen (tree);
+  EXPECT_EQ (frozen.size(), tree.size());
+  EXPECT_FLOAT_EQ (frozen.getResolution(), tree.getResolution());
+  EXPECT_EQ (frozen.getTreeDepth(), tree.getTreeDepth());
+  EXPECT_TRUE (frozen.memoryUsage() < tree.memoryUsage() / 2);
+
+  // search at all depths: same nodes found, same occupancy
+  for (float x = -3.0f; x < 3.0f; x += 0.07f)
+    for (float y = -3.0f; y < 3.0f; y += 0.07f)
+      for (float z = -1.5f; z < 2.0f; z += 0.11f) {
+        point3d p (x, y, z);
+        for (unsigned int depth = 0; depth <= 16; depth += 4) {
+          OcTreeNode* node = tree.search(p, depth);
+          const OcTreeFrozenNode* frozen_node = frozen.search(p, depth);
+          EXPECT_EQ ((node == NULL), (frozen_node == NULL));
+          if (node && frozen_node) {
+            EXPECT_EQ (node->getLogOdds(), frozen_node->getLogOdds());
+            EXPECT_EQ (tree.isNodeOccupied(node), frozen.isNodeOccupied(frozen_node));
+            EXPECT_EQ (tree.nodeHasChildren(node), frozen.nodeHasChildren(frozen_node));
+          }
+        }
+      }
+
+  // leaf iterators
+  size_t num_leafs = 0;
+  OcTree::leaf_iterator it = tree.begin_leafs();
+  OcTreeFrozen::leaf_iterator frozen_it = frozen.begin_leafs();
+  for (; it != tree.end_leafs(); ++it, ++frozen_it, ++num_leafs) {
+    EXPECT_TRUE (frozen_it != frozen.end_leafs());
+    EXPECT_TRUE (it.getKey() == frozen_it.getKey());
+    EXPECT_EQ (it.getDepth(), frozen_it.getDepth());
+    EXPECT_FLOAT_EQ (it.getSize(), frozen_it.getSize());
+    EXPECT_EQ (it->getLogOdds(), frozen_it->getLogOdds());
+  }
+  EXPECT_TRUE (frozen_it == frozen.end_leafs());
+  EXPECT_EQ (num_leafs, tree.getNumLeafNodes());
+
+  // depth-limited leaf iterator
+  size_t num_tree = 0, num_frozen = 0;
+  for (OcTree::leaf_iterator it = tree.begin_leafs(12); it != tree.end_leafs(); ++it)
+    ++num_tree;
+  for (OcTreeFrozen::leaf_iterator it = frozen.begin_leafs(12); it != frozen.end_leafs(); ++it)
+    ++num_frozen;
+  EXPECT_EQ (num_tree, num_frozen);
+
+  // tree iterator: inner nodes and leafs in the same order
+  num_tree = 0;
+  OcTree::tree_iterator tree_it = tree.begin_tree();
+  OcTreeFrozen::tree_iterator frozen_tree_it = frozen.begin_tree();
+  for (; tree_it != tree.end_tree(); ++tree_it, ++frozen_tree_it, ++num_tree) {
+    EXPECT_TRUE (frozen_tree_it != frozen.end_tree());
+    EXPECT_TRUE (tree_it.getKey() == frozen_tree_it.getKey());
+    EXPECT_EQ (tree_it.isLeaf(), frozen_tree_it.isLeaf());
+    EXPECT_EQ (tree_it->getLogOdds(), frozen_tree_it->getLogOdds());
+  }
+  EXPECT_TRUE (frozen_tree_it == frozen.end_tree());
+  EXPECT_EQ (num_tree, frozen.size());
+
+  // bounding box iterator, invalid corners give the end iterator
+  EXPECT_TRUE (frozen.begin_leafs_bbx(point3d(-1e6f, 0.0f, 0.0f), point3d(1.0f, 1.0f, 1.0f)) == frozen.end_leafs_bbx());
+  EXPECT_TRUE (tree.begin_leafs_bbx(point3d(-1e6f, 0.0f, 0.0f), point3d(1.0f, 1.0f, 1.0f)) == tree.end_leafs_bbx());
+  point3d bbx_min (-0.5f, -0.8f, -0.2f);
+  point3d bbx_max (1.9f, 0.4f, 0.6f);
+  num_leafs = 0;
+  OcTree::leaf_bbx_iterator bbx_it = tree.begin_leafs_bbx(bbx_min, bbx_max);
+  OcTreeFrozen::leaf_bbx_iterator frozen_bbx_it = frozen.begin_leafs_bbx(bbx_min, bbx_max);
+  for (; bbx_it != tree.end_leafs_bbx(); ++bbx_it, ++frozen_bbx_it, ++num_leafs) {
+    EXPECT_TRUE (frozen_bbx_it != frozen.end_leafs_bbx());
+    EXPECT_TRUE (bbx_it.getKey() == frozen_bbx_it.getKey());
+    EXPECT_TRUE (bbx_it.getCoordinate() == frozen_bbx_it.getCoordinate());
+    EXPECT_EQ (bbx_it->getLogOdds(), frozen_bbx_it->getLogOdds());
+  }
+  EXPECT_TRUE (frozen_bbx_it == frozen.end_leafs_bbx());
+  EXPECT_TRUE (num_leafs > 0);
+
+  // ray casting
+  for (float azimuth = -3.1f; azimuth < 3.1f; azimuth += 0.05f)
+    for (float elevation = -1.0f; elevation < 1.0f; elevation += 0.1f) {
+      point3d direction (cos(elevation) * cos(azimuth), cos(elevation) * sin(azimuth), sin(elevation));
+      for (int ignore_unknown = 0; ignore_unknown < 2; ++ignore_unknown) {
+        point3d end, frozen_end;
+        bool hit = tree.castRay(origin, direction, end, ignore_unknown != 0, 5.0);
+        bool frozen_hit = frozen.castRay(origin, direction, frozen_end, ignore_unknown != 0, 5.0);
+        EXPECT_EQ (hit, frozen_hit);
+        EXPECT_TRUE (end == frozen_end);
+      }
+    }
+
+  // any occupancy tree can be frozen
+  ColorOcTree color_tree (0.1);
+  color_tree.insertPointCloud(cloud, origin);
+  OcTreeFrozen frozen_color (color_tree);
+  EXPECT_EQ (frozen_color.size(), color_tree.size());
+  EXPECT_EQ (frozen_color.getOccupancyThresLog(), color_tree.getOccupancyThresLog());
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,142 @@
+
+#include <map>
+#include <sstream>
+#include <octomap/octomap.h>
+#include <octomap/OcTreeQuantized.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+int main(int argc, char** argv) {
+
+  // fixed-point conversion
+  EXPECT_NEAR (OcTreeNodeQ16::dequantize(OcTreeNodeQ16::quantize(0.85)), 0.85, 0.5 / 1024.0);
+  EXPECT_EQ (OcTreeNodeQ16::quantize(-2.0), -2048);
+  EXPECT_EQ (OcTreeNodeQ16::quantize(40.0), 32767);
+  EXPECT_EQ (OcTreeNodeQ16::quantize(-40.0), -32768);
+
+#ifdef OCTOMAP_INDEXED_CHILDREN
+  // child index, value, child mask and flags
+  EXPECT_EQ (sizeof(OcTreeNodeQ16), 8);
+#endif
+
+  // sensor model is quantized once
+  OcTreeQ16 tree (0.05);
+  OcTree float_tree (0.05);
+  EXPECT_NEAR (tree.getProbHitLog(), float_tree.getProbHitLog(), 0.5 / 1024.0);
+  EXPECT_NEAR (tree.getProbMissLog(), float_tree.getProbMissLog(), 0.5 / 1024.0);
+  EXPECT_NEAR (tree.getClampingThresMinLog(), float_tree.getClampingThresMinLog(), 0.5 / 1024.0);
+  EXPECT_NEAR (tree.getClampingThresMaxLog(), float_tree.getClampingThresMaxLog(), 0.5 / 1024.0);
+
+  // random updates, checked against an integer model of every voxel
+  const int hit = OcTreeNodeQ16::quantize(tree.getProbHitLog());
+  const int miss = OcTreeNodeQ16::quantize(tree.getProbMissLog());
+  const int clamp_min = OcTreeNodeQ16::quantize(tree.getClampingThresMinLog());
+  const int clamp_max = OcTreeNodeQ16::quantize(tree.getClampingThresMaxLog());
+  std::map<morton_type, int> model;
+  srand(42);
+  for (unsigned int i = 0; i < 20000; ++i) {
+    OcTreeKey key ((key_type) (32768 + rand() % 20), (key_type) (32768 + rand() % 20), (key_type) (32768 + rand() % 4));
+    bool occupied = (rand() % 3 != 0);
+    bool lazy_eval = (i % 2 == 0);
+    tree.updateNode(key, occupied, lazy_eval);
+    float_tree.updateNode(key, occupied, lazy_eval);
+
+    int& v = model[computeMortonCode(key)];
+    v = std::min(std::max(v + (occupied ? hit : miss), clamp_min), clamp_max);
+  }
+  tree.updateInnerOccupancy();
+  float_tree.updateInnerOccupancy();
+  for (std::map<morton_type, int>::iterator it = model.begin(); it != model.end(); ++it) {
+    OcTreeNodeQ16* node = tree.search(mortonCodeToKey(it->first));
+    EXPECT_TRUE (node);
+    EXPECT_EQ (node->getValue(), it->second);
+
+    OcTreeNode* float_node = float_tree.search(mortonCodeToKey(it->first));
+    EXPECT_NEAR (node->getLogOdds(), float_node->getLogOdds(), 0.05);
+  }
+
+  // inner nodes hold the maximum of their children
+  EXPECT_EQ (tree.getRoot()->getValue(), tree.getRoot()->getMaxChildValue());
+  tree.prune();
+  for (OcTreeQ16::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it)
+    EXPECT_EQ (it->getValue(), model[computeMortonCode(it.getKey())]);
+
+  // set values, clamped and rounded
+  OcTreeKey set_key (32700, 32700, 32700);
+  EXPECT_EQ (tree.setNodeValue(set_key, 100.0f)->getValue(), clamp_max);
+  EXPECT_EQ (tree.setNodeValue(set_key, 0.25f)->getValue(), 256);
+  EXPECT_EQ (tree.updateNode(set_key, -0.5f)->getValue(), -256);
+
+  // point cloud insertion matches OcTree
+  Pointcloud cloud;
+  for (float azimuth = -1.5f; azimuth < 1.5f; azimuth += 0.03f)
+    for (float elevation = -0.5f; elevation < 0.8f; elevation += 0.03f) {
+      float range = 2.0f + 0.5f * sin(3.0f * azimuth);
+      cloud.push_back(range * cos(elevation) * cos(azimuth), range * cos(elevation) * sin(azimuth), range * sin(elevation));
+    }
+  point3d origin (0.01f, 0.01f, 0.02f);
+  OcTreeQ16 scan_tree (0.05);
+  OcTree float_scan_tree (0.05);
+  for (unsigned int i = 0; i < 2; ++i) {
+    scan_tree.insertPointCloud(cloud, origin, 2.2);
+    float_scan_tree.insertPointCloud(cloud, origin, 2.2);
+  }
+  size_t num_leafs = 0;
+  for (OcTree::leaf_iterator it = float_scan_tree.begin_leafs(); it != float_scan_tree.end_leafs(); ++it, ++num_leafs) {
+    OcTreeNodeQ16* node = scan_tree.search(it.getKey());
+    EXPECT_TRUE (node);
+    EXPECT_EQ (scan_tree.isNodeOccupied(node), float_scan_tree.isNodeOccupied(*it));
+  }
+  EXPECT_TRUE (num_leafs > 1000);
+#ifndef OCTOMAP_NO_NODE_FLAGS
+  // the nodes store their depth
+  size_t num_nodes = 0;
+  for (unsigned int depth = 0; depth <= scan_tree.getTreeDepth(); ++depth)
+    num_nodes += scan_tree.getNumNodesAtDepth(depth);
+  EXPECT_EQ (num_nodes, scan_tree.size());
+  EXPECT_EQ (scan_tree.getNumNodesAtDepth(0), 1);
+#endif
+
+  // binary (.bt) files are exchangeable with OcTree
+  std::stringstream bt_stream;
+  EXPECT_TRUE (scan_tree.writeBinary(bt_stream));
+  OcTree bt_tree (0.1);
+  EXPECT_TRUE (bt_tree.readBinary(bt_stream));
+  EXPECT_EQ (bt_tree.size(), scan_tree.size());
+  EXPECT_FLOAT_EQ (bt_tree.getResolution(), scan_tree.getResolution());
+  for (OcTree::leaf_iterator it = bt_tree.begin_leafs(); it != bt_tree.end_leafs(); ++it) {
+    OcTreeNodeQ16* node = scan_tree.search(it.getKey());
+    EXPECT_TRUE (node);
+    EXPECT_EQ (scan_tree.isNodeOccupied(node), bt_tree.isNodeOccupied(*it));
+  }
+
+  std::stringstream bt_float_stream;
+  EXPECT_TRUE (float_scan_tree.writeBinary(bt_float_stream));
+  OcTreeQ16 bt_tree_q16 (0.1);
+  EXPECT_TRUE (bt_tree_q16.readBinary(bt_float_stream));
+  EXPECT_EQ (bt_tree_q16.size(), float_scan_tree.size());
+  for (OcTreeQ16::leaf_iterator it = bt_tree_q16.begin_leafs(); it != bt_tree_q16.end_leafs(); ++it) {
+    OcTreeNode* node = float_scan_tree.search(it.getKey());
+    EXPECT_TRUE (node);
+    EXPECT_EQ (bt_tree_q16.isNodeOccupied(*it), float_scan_tree.isNodeOccupied(node));
+  }
+  // inner nodes, including the root, hold the maximum of their children
+  EXPECT_EQ (bt_tree_q16.getRoot()->getValue(), bt_tree_q16.getRoot()->getMaxChildValue());
+  EXPECT_EQ (bt_tree_q16.isNodeOccupied(bt_tree_q16.getRoot()), float_scan_tree.isNodeOccupied(float_scan_tree.getRoot()));
+
+  // full (.ot) files keep the fixed-point values
+  std::stringstream ot_stream;
+  EXPECT_TRUE (tree.write(ot_stream));
+  AbstractOcTree* read_tree = AbstractOcTree::read(ot_stream);
+  EXPECT_TRUE (read_tree);
+  EXPECT_EQ (read_tree->getTreeType(), "OcTreeQ16");
+  OcTreeQ16* read_tree_q16 = dynamic_cast<OcTreeQ16*>(read_tree);
+  EXPECT_TRUE (read_tree_q16);
+  EXPECT_TRUE (*read_tree_q16 == tree);
+  delete read_tree;
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -1,6 +1,7 @@
 
 #include <stdio.h>
 #include <octomap/octomap.h>
+#include <octomap/octomap_timing.h>
 #include <octomap/math/Utils.h>
 #include "testing.h"
 
@@ -190,6 +191,109 @@ int main(int argc, char** argv) {
   EXPECT_NEAR(0.9, dist, res);
 
 
+  // -----------------------------------------------
+  // exact integer DDA
+
+  cout << "Exact ray keys ..." << endl;
+  OcTree exact_tree (0.05);
+  std::vector<std::pair<point3d, point3d> > rays;
+  srand(23);
+  for (unsigned int i = 0; i < 20000; ++i) {
+    point3d from ((float) (rand() % 10001 - 5000) * 0.001f, (float) (rand() % 10001 - 5000) * 0.001f, (float) (rand() % 4001 - 2000) * 0.001f);
+    point3d to ((float) (rand() % 10001 - 5000) * 0.001f, (float) (rand() % 10001 - 5000) * 0.001f, (float) (rand() % 4001 - 2000) * 0.001f);
+    rays.push_back(std::make_pair(from, to));
+  }
+  // axis-parallel, on node borders, through node corners
+  rays.push_back(std::make_pair(point3d(0.01f, 0.01f, 0.01f), point3d(3.01f, 0.01f, 0.01f)));
+  rays.push_back(std::make_pair(point3d(0.01f, 0.01f, 0.01f), point3d(0.01f, -3.01f, 0.01f)));
+  rays.push_back(std::make_pair(point3d(0.0f, 0.0f, 0.0f), point3d(0.0f, 0.0f, 2.0f)));
+  rays.push_back(std::make_pair(point3d(0.0f, 0.0f, 0.0f), point3d(1.0f, 1.0f, 1.0f)));
+  rays.push_back(std::make_pair(point3d(-1.0f, -1.0f, -1.0f), point3d(1.0f, 1.0f, 1.0f)));
+  rays.push_back(std::make_pair(point3d(0.5f, 0.0f, 0.0f), point3d(-0.5f, 0.0f, 0.0f)));
+  rays.push_back(std::make_pair(point3d(0.02f, 0.02f, 0.02f), point3d(0.03f, 0.03f, 0.03f)));
+
+  KeyRay exact_ray;
+  KeyRay float_ray;
+  unsigned int num_equal = 0;
+  for (size_t i = 0; i < rays.size(); ++i) {
+    const point3d& from = rays[i].first;
+    const point3d& to = rays[i].second;
+    EXPECT_TRUE (exact_tree.computeRayKeysExact(from, to, exact_ray));
+    OcTreeKey key_from = exact_tree.coordToKey(from);
+    OcTreeKey key_to = exact_tree.coordToKey(to);
+    if (key_from == key_to) {
+      EXPECT_EQ (exact_ray.size(), (size_t) 0);
+      continue;
+    }
+
+    // every node between both keys exactly once, consecutive nodes share a face
+    size_t num_steps = 0;
+    for (unsigned int d = 0; d < 3; ++d)
+      num_steps += abs((int) key_to[d] - (int) key_from[d]);
+    EXPECT_EQ (exact_ray.size(), num_steps);
+    EXPECT_TRUE (*exact_ray.begin() == key_from);
+    for (KeyRay::iterator it = exact_ray.begin(); it != exact_ray.end(); ++it) {
+      OcTreeKey next = (it + 1 == exact_ray.end()) ? key_to : *(it + 1);
+      unsigned int diff = 0;
+      for (unsigned int d = 0; d < 3; ++d) {
+        diff += abs((int) next[d] - (int) (*it)[d]);
+        EXPECT_TRUE ((next[d] - (*it)[d]) * (key_to[d] - key_from[d]) >= 0); // monotonic
+      }
+      EXPECT_EQ (diff, 1u);
+
+      // node intersected by the segment (slab test, small tolerance for the float coordinates)
+      double t_min = 0.0;
+      double t_max = 1.0;
+      for (unsigned int d = 0; d < 3; ++d) {
+        double lo = exact_tree.keyToCoord((*it)[d]) - 0.5 * exact_tree.getResolution() - 1e-5;
+        double hi = lo + exact_tree.getResolution() + 2e-5;
+        double dir = to(d) - from(d);
+        if (dir == 0.0) {
+          EXPECT_TRUE (from(d) >= lo && from(d) <= hi);
+        } else {
+          double t0 = (lo - from(d)) / dir;
+          double t1 = (hi - from(d)) / dir;
+          t_min = std::max(t_min, std::min(t0, t1));
+          t_max = std::min(t_max, std::max(t0, t1));
+        }
+      }
+      EXPECT_TRUE (t_min <= t_max);
+    }
+
+    // mostly the same as the floating point DDA
+    EXPECT_TRUE (exact_tree.computeRayKeys(from, to, float_ray));
+    if (float_ray.size() == exact_ray.size() && std::equal(exact_ray.begin(), exact_ray.end(), float_ray.begin()))
+      num_equal++;
+  }
+  cout << " " << num_equal << " of " << rays.size() << " rays equal to computeRayKeys" << endl;
+  EXPECT_TRUE (num_equal > rays.size() * 9 / 10);
+
+  // out of bounds
+  EXPECT_FALSE (exact_tree.computeRayKeysExact(point3d(0.0f, 0.0f, 0.0f), point3d(1e6f, 0.0f, 0.0f), exact_ray));
+
+  // timing
+  timeval start;
+  timeval stop;
+  size_t num_keys[2] = {0, 0};
+  double time[2];
+  for (unsigned int exact = 0; exact < 2; ++exact) {
+    gettimeofday(&start, NULL);
+    for (unsigned int r = 0; r < 5; ++r) {
+      for (size_t i = 0; i < rays.size(); ++i) {
+        if (exact)
+          exact_tree.computeRayKeysExact(rays[i].first, rays[i].second, exact_ray);
+        else
+          exact_tree.computeRayKeys(rays[i].first, rays[i].second, exact_ray);
+        num_keys[exact] += exact_ray.size();
+      }
+    }
+    gettimeofday(&stop, NULL);
+    time[exact] = (stop.tv_sec - start.tv_sec) + 1.0e-6 * (stop.tv_usec - start.tv_usec);
+  }
+  cout << " computeRayKeys: " << time[0] << " s, computeRayKeysExact: " << time[1] << " s ("
+       << num_keys[0] << " / " << num_keys[1] << " keys)" << endl;
+
+
   std::cout << "Test successful\n";
   return 0;
 }
@@ -1,5 +1,9 @@
 #include <stdio.h>
 #include <string>
+#include <sstream>
+#include <fstream>
+#include <set>
+#include <limits>
 #ifdef _WIN32
   #include <Windows.h>  // to define Sleep()
 #else
@@ -9,13 +13,74 @@
 
 #include <octomap/octomap.h>
 #include <octomap/OcTreeStamped.h>
+#include <octomap/ColorOcTree.h>
+#include <octomap/CountingOcTree.h>
 #include <octomap/math/Utils.h>
+#include <octomap/octomap_timing.h>
 #include "testing.h"
  
 using namespace std;
 using namespace octomap;
 using namespace octomath;
 
+// compares the incrementally maintained statistics with a traversal of the tree
+template <class TREE>
+void checkNodeStatistics(const TREE& tree) {
+  std::vector<size_t> num_nodes_depth (tree.getTreeDepth()+1, 0);
+  size_t num_inner_nodes = 0;
+  for (typename TREE::tree_iterator it = tree.begin_tree(); it != tree.end_tree(); ++it) {
+    num_nodes_depth[it.getDepth()]++;
+    if (tree.nodeHasChildren(&(*it)))
+      num_inner_nodes++;
+  }
+  size_t num_nodes = 0;
+  for (unsigned int depth = 0; depth <= tree.getTreeDepth(); ++depth) {
+    EXPECT_EQ (tree.getNumNodesAtDepth(depth), num_nodes_depth[depth]);
+    num_nodes += num_nodes_depth[depth];
+  }
+  EXPECT_EQ (tree.size(), num_nodes);
+  EXPECT_EQ (tree.getNumInnerNodes(), num_inner_nodes);
+  EXPECT_EQ (tree.size() - tree.getNumInnerNodes(), tree.getNumLeafNodes());
+  EXPECT_TRUE (tree.memoryUsagePeak() >= tree.memoryUsage());
+}
+
+// compares the incrementally maintained bounds with the bounds of all leafs
+template <class TREE>
+void checkMetricBounds(TREE& tree) {
+  double min_val[3], max_val[3];
+  tree.getMetricMin(min_val[0], min_val[1], min_val[2]);
+  tree.getMetricMax(max_val[0], max_val[1], max_val[2]);
+  const TREE& const_tree = tree;
+  double const_min[3], const_max[3];
+  const_tree.getMetricMin(const_min[0], const_min[1], const_min[2]);
+  const_tree.getMetricMax(const_max[0], const_max[1], const_max[2]);
+
+  TREE copy (tree);  // recomputes from scratch
+  double copy_min[3], copy_max[3];
+  copy.getMetricMin(copy_min[0], copy_min[1], copy_min[2]);
+  copy.getMetricMax(copy_max[0], copy_max[1], copy_max[2]);
+
+  double leaf_min[3] = {1e10, 1e10, 1e10};
+  double leaf_max[3] = {-1e10, -1e10, -1e10};
+  for (typename TREE::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+    point3d center = it.getCoordinate();
+    for (unsigned int i = 0; i < 3; ++i) {
+      leaf_min[i] = std::min(leaf_min[i], center(i) - it.getSize()/2.0);
+      leaf_max[i] = std::max(leaf_max[i], center(i) + it.getSize()/2.0);
+    }
+  }
+  for (unsigned int i = 0; i < 3; ++i) {
+    EXPECT_EQ (min_val[i], copy_min[i]);
+    EXPECT_EQ (max_val[i], copy_max[i]);
+    EXPECT_EQ (const_min[i], min_val[i]);
+    EXPECT_EQ (const_max[i], max_val[i]);
+    if (tree.size() > 0) {
+      EXPECT_NEAR (min_val[i], leaf_min[i], 1e-4);
+      EXPECT_NEAR (max_val[i], leaf_max[i], 1e-4);
+    }
+  }
+}
+
 int main(int argc, char** argv) {
 
   if (argc != 2){
@@ -200,6 +265,1540 @@ int main(int argc, char** argv) {
     EXPECT_FLOAT_EQ (0.025, p_inv.y());
     EXPECT_FLOAT_EQ (0.025, p_inv.z());
 
+  // ------------------------------------------------------------
+  } else if (test_name == "MortonCode") {
+    OcTreeKey key (0xFFFF, 0, 0x8001);
+    EXPECT_EQ (computeMortonCode(OcTreeKey(1, 0, 0)), 1);
+    EXPECT_EQ (computeMortonCode(OcTreeKey(0, 1, 0)), 2);
+    EXPECT_EQ (computeMortonCode(OcTreeKey(0, 0, 1)), 4);
+    EXPECT_EQ (computeMortonCode(OcTreeKey(0xFFFF, 0xFFFF, 0xFFFF)), 0xFFFFFFFFFFFFULL);
+    EXPECT_TRUE (mortonCodeToKey(computeMortonCode(key)) == key);
+
+    srand(42);
+    for (unsigned int i = 0; i < 1000; ++i) {
+      const int key_mask = (1 << OCTOMAP_TREE_DEPTH) - 1;
+      OcTreeKey k ((key_type) (rand() & key_mask), (key_type) (rand() & key_mask), (key_type) (rand() & key_mask));
+      morton_type code = computeMortonCode(k);
+      EXPECT_TRUE (mortonCodeToKey(code) == k);
+      for (unsigned int level = 0; level < OCTOMAP_TREE_DEPTH; ++level) {
+        EXPECT_EQ (computeMortonChildIdx(code, level), computeChildIdx(k, level));
+        morton_type index_code = computeMortonIndexCode(level, code);
+        EXPECT_TRUE (mortonCodeToKey(index_code) == computeIndexKey(level, k));
+        if (level > 0) {
+          morton_type parent_code = computeMortonIndexCode(level, code);
+          EXPECT_EQ (computeMortonChildCode(computeMortonChildIdx(code, level-1), level, parent_code),
+                     computeMortonIndexCode(level-1, code));
+        }
+      }
+    }
+
+    // no hash collisions within a dense block
+    KeySet keys;
+    std::set<size_t> hashes;
+    OcTreeKey::KeyHash hash;
+    for (key_type x = 32700; x < 32740; ++x)
+      for (key_type y = 32700; y < 32740; ++y)
+        for (key_type z = 32760; z < 32780; ++z) {
+          keys.insert(OcTreeKey(x, y, z));
+          hashes.insert(hash(OcTreeKey(x, y, z)));
+        }
+    EXPECT_EQ (hashes.size(), keys.size());
+
+    // Morton order corresponds to the depth-first order of the tree iterators
+    std::vector<OcTreeKey> sorted;
+    sortMortonOrder(keys, sorted);
+    EXPECT_EQ (sorted.size(), keys.size());
+    OcTree tree (0.05);
+    for (KeySet::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      tree.updateNode(*it, (((*it)[0] + (*it)[1]) % 3) == 0);
+    std::vector<OcTreeKey>::const_iterator sorted_it = sorted.begin();
+    for (OcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+      // pruned leafs cover several sorted keys
+      OcTreeKey index_key = it.getIndexKey();
+      unsigned int level = tree.getTreeDepth() - it.getDepth();
+      EXPECT_TRUE (sorted_it != sorted.end());
+      EXPECT_TRUE (computeIndexKey(level, *sorted_it) == index_key);
+      while (sorted_it != sorted.end() && computeIndexKey(level, *sorted_it) == index_key)
+        ++sorted_it;
+    }
+    EXPECT_TRUE (sorted_it == sorted.end());
+
+    KeyRay ray;
+    for (std::vector<OcTreeKey>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it)
+      ray.addKey(*it);
+    ray.sortMortonOrder();
+    EXPECT_TRUE (std::equal(ray.begin(), ray.end(), sorted.begin()));
+    EXPECT_TRUE (KeyMortonLess()(sorted.front(), sorted.back()));
+
+  // ------------------------------------------------------------
+  } else if (test_name == "KeyFlatHash") {
+    KeyFlatSet keys;
+    std::set<morton_type> reference;
+    EXPECT_TRUE (keys.empty());
+    EXPECT_TRUE (keys.begin() == keys.end());
+    EXPECT_TRUE (keys.find(OcTreeKey(1, 2, 3)) == keys.end());
+
+    srand(7);
+    for (unsigned int i = 0; i < 20000; ++i) {
+      OcTreeKey k ((key_type) (32768 + rand() % 64), (key_type) (32768 + rand() % 64), (key_type) (32768 + rand() % 16));
+      bool inserted = reference.insert(computeMortonCode(k)).second;
+      std::pair<KeyFlatSet::iterator, bool> ret = keys.insert(k);
+      EXPECT_EQ (ret.second, inserted);
+      EXPECT_TRUE (*(ret.first) == k);
+    }
+    EXPECT_EQ (keys.size(), reference.size());
+    size_t num_iterated = 0;
+    for (KeyFlatSet::const_iterator it = keys.begin(); it != keys.end(); ++it, ++num_iterated)
+      EXPECT_EQ (reference.count(computeMortonCode(*it)), 1);
+    EXPECT_EQ (num_iterated, reference.size());
+
+    // erase every second key while iterating
+    bool erase = false;
+    for (KeyFlatSet::iterator it = keys.begin(); it != keys.end(); erase = !erase) {
+      if (erase) {
+        reference.erase(computeMortonCode(*it));
+        it = keys.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    EXPECT_EQ (keys.size(), reference.size());
+    for (std::set<morton_type>::const_iterator it = reference.begin(); it != reference.end(); ++it)
+      EXPECT_TRUE (keys.find(mortonCodeToKey(*it)) != keys.end());
+    EXPECT_EQ (keys.erase(mortonCodeToKey(*reference.begin())), 1);
+    EXPECT_EQ (keys.count(mortonCodeToKey(*reference.begin())), 0);
+
+    // clear keeps the memory for reuse
+    size_t capacity = keys.capacity();
+    keys.clear();
+    EXPECT_TRUE (keys.empty());
+    EXPECT_EQ (keys.capacity(), capacity);
+    EXPECT_TRUE (keys.begin() == keys.end());
+    keys.reserve(capacity / 2);
+    EXPECT_EQ (keys.capacity(), capacity);
+
+    KeyFlatMap<bool> changes;
+    changes.insert(std::pair<OcTreeKey,bool>(OcTreeKey(1, 2, 3), true));
+    EXPECT_FALSE (changes.insert(std::pair<OcTreeKey,bool>(OcTreeKey(1, 2, 3), false)).second);
+    changes[OcTreeKey(4, 5, 6)] = false;
+    EXPECT_EQ (changes.size(), 2);
+    KeyFlatMap<bool>::iterator it = changes.find(OcTreeKey(1, 2, 3));
+    EXPECT_TRUE (it != changes.end());
+    EXPECT_TRUE (it->second);
+    changes.erase(it);
+    EXPECT_EQ (changes.size(), 1);
+    EXPECT_FALSE (changes.begin()->second);
+    KeyFlatMap<bool> changes_copy (changes);
+    EXPECT_EQ (changes_copy.size(), 1);
+    EXPECT_TRUE (changes_copy.begin()->first == OcTreeKey(4, 5, 6));
+
+  // ------------------------------------------------------------
+  } else if (test_name == "UpdateNodes") {
+    OcTree batch_tree (0.05);
+    OcTree single_tree (0.05);
+    batch_tree.enableChangeDetection(true);
+    single_tree.enableChangeDetection(true);
+
+    srand(3);
+    for (unsigned int round = 0; round < 20; ++round) {
+      // random updates with duplicates in a small volume, so that nodes get pruned,
+      // expanded and clamped
+      std::vector<std::pair<OcTreeKey, float> > updates;
+      for (unsigned int i = 0; i < 3000; ++i) {
+        OcTreeKey key ((key_type) (32768 + rand() % 24), (key_type) (32768 + rand() % 24), (key_type) (32768 + rand() % 8));
+        float log_odds = (rand() % 3 == 0) ? single_tree.getProbMissLog() : single_tree.getProbHitLog();
+        updates.push_back(std::make_pair(key, log_odds));
+      }
+      bool lazy_eval = (round % 4 == 3);
+      batch_tree.updateNodes(updates, lazy_eval);
+      for (size_t i = 0; i < updates.size(); ++i)
+        single_tree.updateNode(updates[i].first, updates[i].second, lazy_eval);
+      if (lazy_eval) {
+        batch_tree.updateInnerOccupancy();
+        single_tree.updateInnerOccupancy();
+      }
+      EXPECT_EQ (batch_tree.size(), single_tree.size());
+      EXPECT_TRUE (batch_tree == single_tree);
+      EXPECT_EQ (batch_tree.numChangesDetected(), single_tree.numChangesDetected());
+      batch_tree.resetChangeDetection();
+      single_tree.resetChangeDetection();
+    }
+
+    // insertPointCloud uses updateNodes, compare with per-key updates
+    Pointcloud cloud;
+    for (int x=-20; x<20; x++)
+      for (int y=-20; y<20; y++)
+        cloud.push_back((float) x*0.05f, (float) y*0.05f, 1.0f + (float) (x*y)*0.001f);
+    point3d origin (0.01f, 0.01f, 0.02f);
+    OcTree scan_tree (0.05);
+    OcTree reference_tree (0.05);
+    for (unsigned int i = 0; i < 3; ++i) {
+      scan_tree.insertPointCloud(cloud, origin);
+      KeySet free_cells, occupied_cells;
+      reference_tree.computeUpdate(cloud, origin, free_cells, occupied_cells, -1.0);
+      for (KeySet::iterator it = free_cells.begin(); it != free_cells.end(); ++it)
+        reference_tree.updateNode(*it, false);
+      for (KeySet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it)
+        reference_tree.updateNode(*it, true);
+      EXPECT_TRUE (scan_tree == reference_tree);
+    }
+
+  // ------------------------------------------------------------
+  } else if (test_name == "DirtyTracking") {
+    // dirty bits share the depth byte, which fits into the padding of the node.
+    // OcTreeNodeStamped fills that padding with its timestamp and needs another
+    // pointer-aligned unit for the flags, its size is kept by building without them.
+    EXPECT_EQ (sizeof(OcTreeNode), sizeof(OcTreeDataNode<float>));
+#if defined(OCTOMAP_INDEXED_CHILDREN)
+    // index of the children, value, child mask and flags; color and timestamp take 4 more bytes
+    EXPECT_EQ (sizeof(OcTreeNode), 12);
+    EXPECT_EQ (sizeof(ColorOcTreeNode), 16);
+    EXPECT_EQ (sizeof(OcTreeNodeStamped), 16);
+#else
+    EXPECT_EQ (sizeof(ColorOcTreeNode), sizeof(OcTreeNode));
+#ifdef OCTOMAP_NO_NODE_FLAGS
+    EXPECT_EQ (sizeof(OcTreeNodeStamped), sizeof(OcTreeDataNode<float>));
+#else
+    EXPECT_EQ (sizeof(OcTreeNodeStamped), sizeof(OcTreeNode) + sizeof(AbstractOcTreeNode*));
+#endif
+#endif
+
+    OcTree dirty_tree (0.05);
+    OcTree full_tree (0.05);
+    EXPECT_FALSE (dirty_tree.isDirtyTrackingEnabled());
+    dirty_tree.enableDirtyTracking(true);
+    EXPECT_TRUE (dirty_tree.isDirtyTrackingEnabled());
+
+    // a large, fully pruned map which the lazy updates below only touch locally
+    for (int x=-40; x<40; x++)
+      for (int y=-40; y<40; y++) {
+        point3d p ((float) x*0.05f+0.01f, (float) y*0.05f+0.01f, -1.0f);
+        dirty_tree.updateNode(p, true);
+        full_tree.updateNode(p, true);
+      }
+    dirty_tree.prune();
+    full_tree.prune();
+    EXPECT_TRUE (dirty_tree == full_tree);
+
+    srand(7);
+    for (unsigned int round = 0; round < 40; ++round) {
+      std::vector<std::pair<OcTreeKey, float> > updates;
+      for (unsigned int i = 0; i < 500; ++i) {
+        OcTreeKey key ((key_type) (32768 + rand() % 16), (key_type) (32768 + rand() % 16), (key_type) (32768 - 20 + rand() % 4));
+        float log_odds = (rand() % 3 == 0) ? full_tree.getProbMissLog() : full_tree.getProbHitLog();
+        updates.push_back(std::make_pair(key, log_odds));
+      }
+      switch (round % 3) {
+        case 0:
+          dirty_tree.updateNodes(updates, true);
+          full_tree.updateNodes(updates, true);
+          break;
+        case 1:
+          for (size_t i = 0; i < updates.size(); ++i) {
+            dirty_tree.updateNode(updates[i].first, updates[i].second, true);
+            full_tree.updateNode(updates[i].first, updates[i].second, true);
+          }
+          break;
+        default:
+          for (size_t i = 0; i < updates.size(); ++i) {
+            float value = (updates[i].second > 0) ? full_tree.getClampingThresMaxLog() : full_tree.getClampingThresMinLog();
+            dirty_tree.setNodeValue(updates[i].first, value, true);
+            full_tree.setNodeValue(updates[i].first, value, true);
+          }
+      }
+
+      // both operations have their own dirty state, run them in varying order
+      if (round % 4 == 0) {
+        dirty_tree.updateInnerOccupancy();
+        full_tree.updateInnerOccupancy();
+        dirty_tree.prune();
+        full_tree.prune();
+      } else if (round % 4 == 1) {
+        dirty_tree.prune();
+        full_tree.prune();
+        dirty_tree.updateInnerOccupancy();
+        full_tree.updateInnerOccupancy();
+      } else if (round % 4 == 2) {
+        dirty_tree.updateInnerOccupancy();
+        full_tree.updateInnerOccupancy();
+      } else {
+        continue;  // accumulate over two rounds
+      }
+      EXPECT_EQ (dirty_tree.size(), full_tree.size());
+      EXPECT_TRUE (dirty_tree == full_tree);
+    }
+
+    // full traversal needed after operations touching the whole tree
+    dirty_tree.expand();
+    full_tree.expand();
+    dirty_tree.prune();
+    full_tree.prune();
+    EXPECT_EQ (dirty_tree.size(), full_tree.size());
+    EXPECT_TRUE (dirty_tree == full_tree);
+
+    // direct modifications are only seen after markTreeDirty()
+    OcTreeNode* node = dirty_tree.search(OcTreeKey(32768, 32768, 32748));
+    EXPECT_TRUE (node);
+    node->setLogOdds(full_tree.getClampingThresMinLog());
+    full_tree.search(OcTreeKey(32768, 32768, 32748))->setLogOdds(full_tree.getClampingThresMinLog());
+    dirty_tree.markTreeDirty();
+    dirty_tree.updateInnerOccupancy();
+    full_tree.updateInnerOccupancy();
+    EXPECT_TRUE (dirty_tree == full_tree);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "Snapshots") {
+#if !defined(OCTOMAP_NO_NODE_FLAGS) && !defined(OCTOMAP_INDEXED_CHILDREN)
+    OcTree tree (0.05);
+    for (int x=-20; x<20; x++)
+      for (int y=-20; y<20; y++)
+        tree.updateNode(point3d((float) x*0.05f+0.01f, (float) y*0.05f+0.01f, -1.0f), true);
+    tree.prune();
+
+    // snapshots must stay equal to a deep copy taken at the same time
+    std::vector<const OccupancyOcTreeBase<OcTreeNode>*> snapshots;
+    std::vector<OcTree*> copies;
+    srand(11);
+    for (unsigned int round = 0; round < 12; ++round) {
+      const OccupancyOcTreeBase<OcTreeNode>* snap = tree.snapshot();
+      EXPECT_TRUE (snap);
+      EXPECT_TRUE (snap->isSnapshot());
+      EXPECT_EQ (snap->getTreeType(), tree.getTreeType());
+      snapshots.push_back(snap);
+      copies.push_back(new OcTree(tree));
+
+      for (unsigned int i = 0; i < 300; ++i) {
+        OcTreeKey key ((key_type) (32768 - 10 + rand() % 20), (key_type) (32768 - 10 + rand() % 20), (key_type) (32768 - 20 + rand() % 4));
+        switch (round % 4) {
+          case 0: tree.updateNode(key, rand() % 3 != 0); break;
+          case 1: tree.updateNode(key, rand() % 3 != 0, true); break;
+          case 2: tree.setNodeValue(key, tree.getClampingThresMaxLog()); break;
+          default: tree.deleteNode(key);
+        }
+      }
+      if (round % 4 == 1)
+        tree.updateInnerOccupancy();
+      if (round == 6) {
+        tree.expand();
+        tree.prune();
+      }
+      if (round == 9)
+        tree.enableDirtyTracking(true);
+
+      // delete some snapshots early
+      if (round % 3 == 2) {
+        delete snapshots[round-1];
+        snapshots[round-1] = NULL;
+      }
+      for (size_t i = 0; i < snapshots.size(); ++i) {
+        if (snapshots[i])
+          EXPECT_TRUE (*copies[i] == *snapshots[i]);
+      }
+    }
+    EXPECT_EQ (tree.numSnapshots(), (size_t) 8);
+
+    // the live tree is unaffected by sharing
+    OcTree reference (tree);
+    tree.prune();
+    reference.prune();
+    EXPECT_TRUE (tree == reference);
+
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+      if (snapshots[i])
+        EXPECT_TRUE (*copies[i] == *snapshots[i]);
+      delete snapshots[i];
+      delete copies[i];
+    }
+    EXPECT_EQ (tree.numSnapshots(), (size_t) 0);
+    tree.releaseSnapshotMemory();
+
+    // without snapshots, nodes are modified in place again
+    OcTreeKey probe_key ((key_type) 32768, (key_type) 32768, (key_type) (32768 - 20));
+    tree.updateNode(probe_key, true);
+    const OcTreeNode* probe = tree.search(probe_key);
+    tree.updateNode(probe_key, true);
+    EXPECT_TRUE (tree.search(probe_key) == probe);
+    tree.clear();
+    EXPECT_EQ (tree.size(), (size_t) 0);
+
+    // updateInnerOccupancy() only copies the shared nodes which change
+    OcTree inner_tree (0.05);
+    OcTreeKey other_key ((key_type) 32700, (key_type) 32800, (key_type) 32768);
+    inner_tree.updateNode(probe_key, true);
+    inner_tree.updateNode(other_key, true);
+    const OccupancyOcTreeBase<OcTreeNode>* inner_snap = inner_tree.snapshot();
+    inner_tree.updateInnerOccupancy();
+    EXPECT_TRUE (inner_tree.search(probe_key) == inner_snap->search(probe_key));
+    inner_tree.updateNode(probe_key, false, true);
+    inner_tree.updateInnerOccupancy();
+    EXPECT_FALSE (inner_tree.search(probe_key) == inner_snap->search(probe_key));
+    EXPECT_TRUE (inner_tree.search(other_key) == inner_snap->search(other_key));
+    OcTree inner_reference (inner_tree);
+    inner_reference.updateInnerOccupancy();
+    EXPECT_TRUE (inner_tree == inner_reference);
+    delete inner_snap;
+
+    // color changes of derived trees
+    ColorOcTree color_tree (0.1);
+    point3d p (1.0f, 1.0f, 1.0f);
+    color_tree.updateNode(p, true);
+    color_tree.setNodeColor(p.x(), p.y(), p.z(), 255, 0, 0);
+    const OccupancyOcTreeBase<ColorOcTreeNode>* color_snap = color_tree.snapshot();
+    color_tree.setNodeColor(p.x(), p.y(), p.z(), 0, 255, 0);
+    EXPECT_EQ (color_tree.search(p)->getColor(), ColorOcTreeNode::Color(0, 255, 0));
+    EXPECT_EQ (color_snap->search(p)->getColor(), ColorOcTreeNode::Color(255, 0, 0));
+    delete color_snap;
+#else
+    // snapshots need the node flags and child pointers
+    OcTree tree (0.05);
+    tree.updateNode(point3d(0.01f, 0.01f, -1.0f), true);
+    EXPECT_FALSE (tree.snapshot());
+#endif
+
+  // ------------------------------------------------------------
+  } else if (test_name == "ParallelTraversal") {
+    OcTree serial_tree (0.05);
+    OcTree parallel_tree (0.05);
+    EXPECT_EQ (parallel_tree.getNumThreads(), 1u);
+    parallel_tree.setNumThreads(4);
+    EXPECT_EQ (parallel_tree.getNumThreads(), 4u);
+
+    // lazy updates spread over all subtrees of the root
+    srand(5);
+    for (unsigned int i = 0; i < 20000; ++i) {
+      point3d p ((float) (rand() % 200 - 100) * 0.05f, (float) (rand() % 200 - 100) * 0.05f, (float) (rand() % 40 - 20) * 0.05f);
+      bool occupied = (rand() % 4 != 0);
+      serial_tree.updateNode(p, occupied, true);
+      parallel_tree.updateNode(p, occupied, true);
+    }
+    serial_tree.updateInnerOccupancy();
+    parallel_tree.updateInnerOccupancy();
+    EXPECT_TRUE (serial_tree == parallel_tree);
+    EXPECT_EQ (serial_tree.calcNumNodes(), parallel_tree.calcNumNodes());
+    EXPECT_EQ (serial_tree.getNumLeafNodes(), parallel_tree.getNumLeafNodes());
+
+    double serial_min[3], serial_max[3], parallel_min[3], parallel_max[3];
+    serial_tree.getMetricMin(serial_min[0], serial_min[1], serial_min[2]);
+    serial_tree.getMetricMax(serial_max[0], serial_max[1], serial_max[2]);
+    parallel_tree.getMetricMin(parallel_min[0], parallel_min[1], parallel_min[2]);
+    parallel_tree.getMetricMax(parallel_max[0], parallel_max[1], parallel_max[2]);
+    for (unsigned int i = 0; i < 3; ++i) {
+      EXPECT_EQ (serial_min[i], parallel_min[i]);
+      EXPECT_EQ (serial_max[i], parallel_max[i]);
+    }
+
+    serial_tree.toMaxLikelihood();
+    parallel_tree.toMaxLikelihood();
+    EXPECT_TRUE (serial_tree == parallel_tree);
+    serial_tree.prune();
+    parallel_tree.prune();
+    EXPECT_EQ (serial_tree.size(), parallel_tree.size());
+    EXPECT_TRUE (serial_tree == parallel_tree);
+    serial_tree.expand();
+    parallel_tree.expand();
+    EXPECT_EQ (serial_tree.size(), parallel_tree.size());
+    EXPECT_TRUE (serial_tree == parallel_tree);
+    EXPECT_EQ (parallel_tree.size(), parallel_tree.calcNumNodes());
+    serial_tree.prune();
+    parallel_tree.prune();
+    EXPECT_TRUE (serial_tree == parallel_tree);
+
+    // with dirty tracking
+    serial_tree.enableDirtyTracking(true);
+    parallel_tree.enableDirtyTracking(true);
+    for (unsigned int i = 0; i < 2000; ++i) {
+      point3d p ((float) (rand() % 200 - 100) * 0.05f, (float) (rand() % 200 - 100) * 0.05f, (float) (rand() % 40 - 20) * 0.05f);
+      serial_tree.updateNode(p, false, true);
+      parallel_tree.updateNode(p, false, true);
+    }
+    serial_tree.updateInnerOccupancy();
+    parallel_tree.updateInnerOccupancy();
+    serial_tree.prune();
+    parallel_tree.prune();
+    EXPECT_TRUE (serial_tree == parallel_tree);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "ParallelUpdateNodes") {
+    OcTree serial_tree (0.05);
+    OcTree parallel_tree (0.05);
+    parallel_tree.setNumThreads(4);
+    serial_tree.enableChangeDetection(true);
+    parallel_tree.enableChangeDetection(true);
+
+    srand(7);
+    for (unsigned int round = 0; round < 16; ++round) {
+      // dense updates around the center (all subtrees of the root, pruned and clamped nodes)
+      // and sparse ones further out
+      std::vector<std::pair<OcTreeKey, float> > updates;
+      for (unsigned int i = 0; i < 4000; ++i) {
+        OcTreeKey key;
+        if (i % 4 != 0)
+          key = OcTreeKey((key_type) (32756 + rand() % 24), (key_type) (32756 + rand() % 24), (key_type) (32764 + rand() % 8));
+        else
+          key = OcTreeKey((key_type) (12768 + rand() % 40000), (key_type) (12768 + rand() % 40000), (key_type) (32000 + rand() % 1536));
+        float log_odds = (rand() % 3 == 0) ? serial_tree.getProbMissLog() : serial_tree.getProbHitLog();
+        updates.push_back(std::make_pair(key, log_odds));
+      }
+      if (round == 8) {
+        serial_tree.enableDirtyTracking(true);
+        parallel_tree.enableDirtyTracking(true);
+      }
+      bool lazy_eval = (round % 4 == 3);
+      serial_tree.updateNodes(updates, lazy_eval);
+      parallel_tree.updateNodes(updates, lazy_eval);
+      if (lazy_eval) {
+        serial_tree.updateInnerOccupancy();
+        parallel_tree.updateInnerOccupancy();
+      }
+      EXPECT_EQ (parallel_tree.size(), serial_tree.size());
+      EXPECT_EQ (parallel_tree.size(), parallel_tree.calcNumNodes());
+      EXPECT_TRUE (parallel_tree == serial_tree);
+
+      // same changes detected
+      EXPECT_EQ (parallel_tree.numChangesDetected(), serial_tree.numChangesDetected());
+      KeyBoolMap parallel_changes;
+      for (KeyBoolMap::const_iterator it = parallel_tree.changedKeysBegin(); it != parallel_tree.changedKeysEnd(); ++it)
+        parallel_changes.insert(*it);
+      for (KeyBoolMap::const_iterator it = serial_tree.changedKeysBegin(); it != serial_tree.changedKeysEnd(); ++it) {
+        KeyBoolMap::const_iterator found = parallel_changes.find(it->first);
+        EXPECT_TRUE (found != parallel_changes.end() && found->second == it->second);
+      }
+      serial_tree.resetChangeDetection();
+      parallel_tree.resetChangeDetection();
+    }
+
+    // scans through insertPointCloud
+    Pointcloud cloud;
+    for (float azimuth = -3.1f; azimuth < 3.1f; azimuth += 0.05f)
+      for (float elevation = -0.5f; elevation < 0.5f; elevation += 0.05f)
+        cloud.push_back(3.0f * cos(elevation) * cos(azimuth), 3.0f * cos(elevation) * sin(azimuth), 3.0f * sin(elevation));
+    serial_tree.insertPointCloud(cloud, point3d(0.01f, 0.01f, 0.02f));
+    parallel_tree.insertPointCloud(cloud, point3d(0.01f, 0.01f, 0.02f));
+    EXPECT_TRUE (parallel_tree == serial_tree);
+    EXPECT_EQ (parallel_tree.numChangesDetected(), serial_tree.numChangesDetected());
+    serial_tree.prune();
+    parallel_tree.prune();
+    EXPECT_EQ (parallel_tree.size(), serial_tree.size());
+    EXPECT_TRUE (parallel_tree == serial_tree);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "RayPacket") {
+    OcTree tree (0.05);
+    point3d origins[] = {point3d(0.01f, 0.01f, 0.02f), point3d(0.0f, 0.0f, 0.0f), point3d(-3.3f, 1.275f, 0.5f)};
+
+    // random directions and lengths, axis-parallel rays, rays within a node, out of bounds
+    std::vector<point3d> ends;
+    srand(11);
+    for (unsigned int i = 0; i < 2000; ++i) {
+      float length = (float) (rand() % 10000) * 0.001f;
+      point3d dir ((float) (rand() % 2001 - 1000), (float) (rand() % 2001 - 1000), (float) (rand() % 2001 - 1000));
+      if (dir.norm() > 0.0)
+        ends.push_back(dir.normalized() * length);
+    }
+    ends.push_back(point3d(5.0f, 0.0f, 0.0f));
+    ends.push_back(point3d(0.0f, -5.0f, 0.0f));
+    ends.push_back(point3d(0.0f, 0.0f, 0.0f));
+    ends.push_back(point3d(0.01f, 0.02f, 0.01f));
+    ends.push_back(point3d(1e6f, 0.0f, 0.0f));
+    ends.push_back(point3d(2.5f, 2.5f, 2.5f));
+
+    KeyRay reference;
+    for (int simd = RAY_SIMD_NONE; simd <= RAY_SIMD_AVX2; ++simd) {
+      tree.setRaySIMD((RaySIMD) simd);
+      EXPECT_TRUE (tree.getRaySIMD() <= detectRaySIMD());
+      for (unsigned int o = 0; o < 3; ++o) {
+        for (size_t begin = 0; begin < ends.size(); begin += 13) {
+          // batches of various sizes, several packets per batch, rays without room are grown
+          size_t num_rays = std::min((size_t) 13, ends.size() - begin);
+          std::vector<KeyRay> rays (num_rays, (o == 1) ? KeyRay(0) : KeyRay());
+          bool valid[13];
+          tree.computeRaysKeys(origins[o], &ends[begin], num_rays, &rays[0], valid);
+          for (size_t r = 0; r < num_rays; ++r) {
+            point3d end = ends[begin + r];
+            bool reference_valid = tree.computeRayKeys(origins[o], end, reference);
+            EXPECT_EQ (valid[r], reference_valid);
+            EXPECT_EQ (rays[r].size(), reference.size());
+            if (rays[r].size() == reference.size())
+              EXPECT_TRUE (std::equal(reference.begin(), reference.end(), rays[r].begin()));
+          }
+        }
+      }
+    }
+    // the limit belongs to the tree
+    EXPECT_EQ (OcTree(0.05).getRaySIMD(), detectRaySIMD());
+    tree.setRaySIMD(RAY_SIMD_AVX2);
+    EXPECT_EQ (tree.getRaySIMD(), detectRaySIMD());
+
+    // rays only take the room they need
+    KeyRay small_ray (0);
+    EXPECT_EQ (small_ray.sizeMax(), 0);
+    small_ray.reserveMax(100);
+    EXPECT_EQ (small_ray.sizeMax(), 100);
+    small_ray.reserveMax(10);
+    EXPECT_EQ (small_ray.sizeMax(), 100);
+    EXPECT_EQ (small_ray.size(), 0);
+
+    // a ray which does not fit into its KeyRay is stopped and marked invalid
+    for (int simd = RAY_SIMD_NONE; simd <= RAY_SIMD_AVX2; ++simd) {
+      KeyRay short_rays[2] = {KeyRay(4), KeyRay(20)};
+      bool short_valid[2] = {true, true};
+      RayPacket packet;
+      packet.num_rays = 2;
+      for (unsigned int r = 0; r < 2; ++r) {
+        // along x through 10 nodes
+        short_rays[r].addKey(OcTreeKey(100, 100, 100));
+        packet.rays[r] = &short_rays[r];
+        packet.valid[r] = &short_valid[r];
+        for (unsigned int d = 0; d < 3; ++d) {
+          packet.key[d][r] = 100;
+          packet.key_end[d][r] = (d == 0) ? 110 : 100;
+          packet.step[d][r] = (d == 0) ? 1 : 0;
+          packet.t_max[d][r] = (d == 0) ? 0.5 : std::numeric_limits<double>::max();
+          packet.t_delta[d][r] = (d == 0) ? 1.0 : std::numeric_limits<double>::max();
+        }
+        packet.length[r] = 10.2;
+      }
+      traverseRayPacket(packet, (RaySIMD) simd);
+      EXPECT_FALSE (short_valid[0]);
+      EXPECT_EQ (short_rays[0].size(), 4);
+      EXPECT_TRUE (short_valid[1]);
+      EXPECT_EQ (short_rays[1].size(), 10);
+    }
+    Pointcloud scan;
+    for (size_t i = 0; i < ends.size(); ++i)
+      scan.push_back(ends[i]);
+    KeySet free_cells, occupied_cells;
+    tree.computeUpdate(scan, origins[0], free_cells, occupied_cells, -1.0);
+    EXPECT_FALSE (free_cells.empty());
+
+  // ------------------------------------------------------------
+  } else if (test_name == "MoveSemantics") {
+    Pointcloud cloud;
+    for (int i = 0; i < 100; ++i)
+      cloud.push_back((float) i * 0.1f, 1.0f, 0.5f);
+    Pointcloud other_cloud;
+    other_cloud.swap(cloud);
+    EXPECT_EQ (cloud.size(), (size_t) 0);
+    EXPECT_EQ (other_cloud.size(), (size_t) 100);
+
+    OcTree tree (0.1);
+    tree.setProbHit(0.8);
+    tree.insertPointCloud(other_cloud, point3d(0,0,0));
+    OcTree reference (tree);
+    size_t tree_size = tree.size();
+
+    OcTree other_tree (0.05);
+    other_tree.swap(tree);
+    EXPECT_EQ (tree.size(), (size_t) 0);
+    EXPECT_EQ (tree.getResolution(), 0.05);
+    EXPECT_EQ (other_tree.size(), tree_size);
+    EXPECT_EQ (other_tree.getResolution(), 0.1);
+    EXPECT_FLOAT_EQ (other_tree.getProbHit(), 0.8);
+    EXPECT_TRUE (other_tree == reference);
+
+    ScanGraph graph;
+    graph.addNode(new Pointcloud(other_cloud), pose6d());
+    ScanGraph other_graph;
+    other_graph.swap(graph);
+    EXPECT_EQ (graph.size(), (size_t) 0);
+    EXPECT_EQ (other_graph.size(), (size_t) 1);
+
+    // copies are deep: own scans, edges point to the copied nodes
+    other_graph.addNode(new Pointcloud(other_cloud), pose6d(1,0,0,0,0,0));
+    other_graph.connectPrevious();
+    ScanGraph copied_graph (other_graph);
+    EXPECT_EQ (copied_graph.size(), (size_t) 2);
+    EXPECT_TRUE (copied_graph.edges_begin() != copied_graph.edges_end());
+    EXPECT_TRUE ((*copied_graph.begin())->scan != (*other_graph.begin())->scan);
+    EXPECT_EQ ((*copied_graph.begin())->scan->size(), (size_t) 100);
+    EXPECT_TRUE ((*copied_graph.edges_begin())->first == copied_graph.getNodeByID(0));
+    EXPECT_TRUE ((*copied_graph.edges_begin())->second == copied_graph.getNodeByID(1));
+    ScanGraph assigned_graph;
+    assigned_graph = copied_graph;
+    EXPECT_EQ (assigned_graph.size(), (size_t) 2);
+    ScanNode node_copy (*copied_graph.getNodeByID(1));
+    EXPECT_TRUE (node_copy.scan != copied_graph.getNodeByID(1)->scan);
+    EXPECT_EQ (node_copy.id, (unsigned int) 1);
+
+#ifdef OCTOMAP_HAS_MOVE_SEMANTICS
+    Pointcloud moved_cloud (std::move(other_cloud));
+    EXPECT_EQ (moved_cloud.size(), (size_t) 100);
+    EXPECT_EQ (other_cloud.size(), (size_t) 0);
+
+    OcTree moved_tree (std::move(other_tree));
+    EXPECT_EQ (other_tree.size(), (size_t) 0);
+    EXPECT_TRUE (moved_tree == reference);
+    EXPECT_FLOAT_EQ (moved_tree.getProbHit(), 0.8);
+    tree = std::move(moved_tree);
+    EXPECT_TRUE (tree == reference);
+
+    // consuming insert gives the same result as the copying one
+    OcTree copy_insert_tree (0.1);
+    OcTree move_insert_tree (0.1);
+    pose6d frame_origin (1.0, 0.5, 0.0, 0.0, 0.0, 0.3);
+    copy_insert_tree.insertPointCloud(moved_cloud, point3d(0,0,0), frame_origin);
+    move_insert_tree.insertPointCloud(std::move(moved_cloud), point3d(0,0,0), frame_origin);
+    EXPECT_TRUE (copy_insert_tree == move_insert_tree);
+
+    ScanGraph moved_graph (std::move(other_graph));
+    EXPECT_EQ (moved_graph.size(), (size_t) 2);
+    EXPECT_EQ (other_graph.size(), (size_t) 0);
+#endif
+
+  // ------------------------------------------------------------
+  } else if (test_name == "MemoryPool") {
+    OcTree tree (0.05);
+    EXPECT_TRUE (tree.isMemoryPoolEnabled());
+    for (int x=-20; x<20; x++)
+      for (int y=-20; y<20; y++)
+        for (int z=-20; z<20; z++) {
+          point3d p ((float) x*0.05f+0.01f, (float) y*0.05f+0.01f, (float) z*0.05f+0.01f);
+          tree.updateNode(p, (x+y+z) % 2 == 0);
+        }
+    size_t num_nodes = tree.size();
+    size_t mem_usage = tree.memoryUsage();
+    EXPECT_TRUE (mem_usage > num_nodes * tree.memoryUsageNode());
+
+    // deep copy lives in its own pool
+    OcTree copy (tree);
+    EXPECT_TRUE (tree == copy);
+
+    // can't switch allocation while nodes exist
+    EXPECT_FALSE (tree.setMemoryPoolEnabled(false));
+
+    // cleared memory is reused by the next insertion
+    tree.clear();
+    EXPECT_EQ (tree.size(), 0);
+    EXPECT_EQ (tree.memoryUsage(), mem_usage);
+    for (int x=-20; x<20; x++)
+      for (int y=-20; y<20; y++)
+        for (int z=-20; z<20; z++) {
+          point3d p ((float) x*0.05f+0.01f, (float) y*0.05f+0.01f, (float) z*0.05f+0.01f);
+          tree.updateNode(p, (x+y+z) % 2 == 0);
+        }
+    EXPECT_EQ (tree.size(), num_nodes);
+    EXPECT_EQ (tree.memoryUsage(), mem_usage);
+    EXPECT_TRUE (tree == copy);
+
+    // pruning and swapping keep the pools consistent
+    tree.prune();
+    copy.prune();
+    EXPECT_TRUE (tree == copy);
+    OcTree swapped (0.05);
+    swapped.swapContent(tree);
+    EXPECT_EQ (tree.size(), 0);
+    EXPECT_TRUE (swapped == copy);
+
+    tree.releaseMemoryPool();
+    EXPECT_TRUE (tree.memoryUsage() < mem_usage);
+
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // indexed children only exist in the pool
+    OcTree heap_tree (0.05);
+    EXPECT_FALSE (heap_tree.setMemoryPoolEnabled(false));
+    EXPECT_TRUE (heap_tree.isMemoryPoolEnabled());
+#else
+    // same results with plain heap allocation
+    OcTree heap_tree (0.05);
+    EXPECT_TRUE (heap_tree.setMemoryPoolEnabled(false));
+    EXPECT_FALSE (heap_tree.isMemoryPoolEnabled());
+    for (int x=-20; x<20; x++)
+      for (int y=-20; y<20; y++)
+        for (int z=-20; z<20; z++) {
+          point3d p ((float) x*0.05f+0.01f, (float) y*0.05f+0.01f, (float) z*0.05f+0.01f);
+          heap_tree.updateNode(p, (x+y+z) % 2 == 0);
+        }
+    heap_tree.prune();
+    EXPECT_TRUE (heap_tree == copy);
+    OcTree heap_copy (heap_tree);
+    EXPECT_TRUE (heap_copy == copy);
+#endif
+
+  // ------------------------------------------------------------
+  } else if (test_name == "BlockPool") {
+    OcTreeBlockPool pool (12);
+    EXPECT_EQ (pool.getBlockSize(), 96);
+    EXPECT_EQ (pool.getMemoryReserved(), 0);
+
+    // enough blocks for several chunks, all slots can be found from any node
+    std::vector<uint32_t> blocks;
+    for (unsigned int i=0; i<50000; i++) {
+      uint32_t block = pool.allocate();
+      EXPECT_TRUE (block != 0);
+      *static_cast<uint32_t*>(pool.getSlot(block, 7)) = i;
+      blocks.push_back(block);
+    }
+    EXPECT_EQ (pool.getNumBlocksInUse(), blocks.size());
+    EXPECT_TRUE (pool.getMemoryReserved() >= blocks.size() * pool.getBlockSize());
+    for (size_t i=0; i<blocks.size(); i++) {
+      void* node = pool.getSlot(blocks[i], 3);
+      EXPECT_EQ (OcTreeBlockPool::getPool(node), &pool);
+      EXPECT_EQ (OcTreeBlockPool::getBlock(node), blocks[i]);
+      EXPECT_EQ (OcTreeBlockPool::getSlot(node, blocks[i], 7), pool.getSlot(blocks[i], 7));
+      EXPECT_EQ (OcTreeBlockPool::getSlot(node, blocks[(i*7919) % blocks.size()], 0),
+                 pool.getSlot(blocks[(i*7919) % blocks.size()], 0));
+      EXPECT_EQ (*static_cast<uint32_t*>(pool.getSlot(blocks[i], 7)), i);
+    }
+
+    // released blocks are reused
+    size_t mem_usage = pool.getMemoryReserved();
+    for (size_t i=0; i<blocks.size(); i+=2)
+      pool.deallocate(blocks[i]);
+    for (size_t i=0; i<blocks.size(); i+=2)
+      blocks[i] = pool.allocate();
+    EXPECT_EQ (pool.getMemoryReserved(), mem_usage);
+    for (size_t i=1; i<blocks.size(); i+=2)
+      EXPECT_EQ (*static_cast<uint32_t*>(pool.getSlot(blocks[i], 7)), i);
+
+    // the chunks know their pool after swapping
+    OcTreeBlockPool other (12);
+    other.swap(pool);
+    EXPECT_EQ (pool.getNumBlocksInUse(), 0);
+    EXPECT_EQ (other.getNumBlocksInUse(), blocks.size());
+    EXPECT_EQ (OcTreeBlockPool::getPool(other.getSlot(blocks[1], 0)), &other);
+    other.release();
+    EXPECT_EQ (other.getMemoryReserved(), 0);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "MemoryStatistics") {
+    Pointcloud cloud;
+    for (int x=-20; x<20; x++)
+      for (int y=-20; y<20; y++)
+        cloud.push_back((float) x*0.05f, (float) y*0.05f, 1.0f + (float) (x*x+y*y)*0.001f);
+    point3d origin (0.01f, 0.01f, 0.02f);
+
+    OcTree tree (0.05);
+    EXPECT_EQ (tree.getNumNodesAtDepth(0), 0);
+    EXPECT_EQ (tree.getNumInnerNodes(), 0);
+    tree.insertPointCloud(cloud, origin);
+    checkNodeStatistics(tree);
+    EXPECT_EQ (tree.getNumNodesAtDepth(0), 1);
+#ifdef OCTOMAP_INDEXED_CHILDREN
+    // all nodes live in blocks of eight, the root in one of its own
+    EXPECT_EQ (tree.memoryUsageChildArrays() + tree.size() * tree.memoryUsageNode(),
+               (tree.getNumInnerNodes() + 1) * 8 * tree.memoryUsageNode());
+#else
+    EXPECT_EQ (tree.memoryUsageChildArrays(), tree.getNumInnerNodes() * sizeof(AbstractOcTreeNode*[8]));
+#endif
+    EXPECT_EQ (tree.memoryUsage(), sizeof(OcTreeBaseImpl<OcTreeNode,AbstractOccupancyOcTree>)
+               + tree.size() * tree.memoryUsageNode() + tree.memoryUsageChildArrays() + tree.memoryUsageSlack());
+
+    // structural changes
+    tree.expand();
+    checkNodeStatistics(tree);
+    tree.prune();
+    checkNodeStatistics(tree);
+    for (int x=-5; x<5; x++)
+      tree.deleteNode(point3d((float) x*0.05f, 0.0f, 1.0f));
+    checkNodeStatistics(tree);
+    OcTree copy (tree);
+    checkNodeStatistics(copy);
+    std::stringstream buffer;
+    tree.writeBinary(buffer);
+    OcTree read_tree (0.05);
+    EXPECT_TRUE (read_tree.readBinary(buffer));
+    checkNodeStatistics(read_tree);
+
+    // the peak survives clearing the tree and releasing the memory
+    size_t mem_usage = tree.memoryUsage();
+    tree.clear();
+    checkNodeStatistics(tree);
+    EXPECT_EQ (tree.memoryUsageSlack(), mem_usage - sizeof(OcTreeBaseImpl<OcTreeNode,AbstractOccupancyOcTree>));
+    tree.releaseMemoryPool();
+    EXPECT_TRUE (tree.memoryUsage() < mem_usage);
+    EXPECT_EQ (tree.memoryUsagePeak(), mem_usage);
+    tree.resetMemoryUsagePeak();
+    EXPECT_EQ (tree.memoryUsagePeak(), tree.memoryUsage());
+
+#ifndef OCTOMAP_INDEXED_CHILDREN
+    // heap allocation: no slack, but a peak
+    OcTree heap_tree (0.05);
+    EXPECT_TRUE (heap_tree.setMemoryPoolEnabled(false));
+    heap_tree.insertPointCloud(cloud, origin);
+    checkNodeStatistics(heap_tree);
+    EXPECT_EQ (heap_tree.memoryUsageSlack(), 0);
+    mem_usage = heap_tree.memoryUsage();
+    heap_tree.deleteNode(point3d(0.0f, 0.0f, 1.0f), 12);
+    checkNodeStatistics(heap_tree);
+    EXPECT_TRUE (heap_tree.memoryUsage() < mem_usage);
+    EXPECT_EQ (heap_tree.memoryUsagePeak(), mem_usage);
+#endif
+
+    // deleteNodeChild() deletes a leaf child, deleteNodeChildSubtree() a child with its descendants
+    OcTree delete_tree (0.05);
+    delete_tree.insertPointCloud(cloud, origin);
+    OcTreeNode* parent = delete_tree.getRoot();
+    unsigned int child_idx = 0;
+    while (true) {
+      for (child_idx = 0; !delete_tree.nodeChildExists(parent, child_idx); ++child_idx) {}
+      if (!delete_tree.nodeHasChildren(delete_tree.getNodeChild(parent, child_idx)))
+        break;
+      parent = delete_tree.getNodeChild(parent, child_idx);
+    }
+    size_t num_nodes = delete_tree.size();
+    delete_tree.deleteNodeChild(parent, child_idx);
+    EXPECT_EQ (delete_tree.size(), num_nodes - 1);
+    checkNodeStatistics(delete_tree);
+    for (child_idx = 0; !delete_tree.nodeChildExists(delete_tree.getRoot(), child_idx); ++child_idx) {}
+    delete_tree.deleteNodeChildSubtree(delete_tree.getRoot(), child_idx);
+    checkNodeStatistics(delete_tree);
+
+#if !defined(OCTOMAP_NO_NODE_FLAGS) && !defined(OCTOMAP_INDEXED_CHILDREN)
+    // nodes replaced for snapshots are not part of the tree
+    OcTree snapshot_tree (0.05);
+    snapshot_tree.insertPointCloud(cloud, origin);
+    const OccupancyOcTreeBase<OcTreeNode>* snapshot = snapshot_tree.snapshot();
+    checkNodeStatistics(*snapshot);
+    for (int x=-5; x<5; x++)
+      snapshot_tree.updateNode(point3d((float) x*0.05f, 0.5f, 1.5f), true);
+    snapshot_tree.deleteNode(point3d(0.0f, 0.0f, 1.0f), 12);
+    checkNodeStatistics(snapshot_tree);
+    checkNodeStatistics(*snapshot);
+    delete snapshot;
+    snapshot_tree.releaseSnapshotMemory();
+    checkNodeStatistics(snapshot_tree);
+    snapshot = snapshot_tree.snapshot();
+    snapshot_tree.clear();
+    checkNodeStatistics(snapshot_tree);
+    delete snapshot;
+    snapshot_tree.releaseSnapshotMemory();
+    EXPECT_EQ (snapshot_tree.memoryUsageChildArrays(), 0);
+#endif
+
+    // other node types
+    ColorOcTree color_tree (0.05);
+    color_tree.insertPointCloud(cloud, origin);
+    checkNodeStatistics(color_tree);
+    OcTreeStamped stamped_tree (0.05);
+    stamped_tree.insertPointCloud(cloud, origin);
+    checkNodeStatistics(stamped_tree);
+    CountingOcTree counting_tree (0.05);
+    for (size_t i=0; i<cloud.size(); i++)
+      counting_tree.updateNode(cloud[i]);
+    checkNodeStatistics(counting_tree);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "MetricBounds") {
+    OcTree tree (0.05);
+    double x, y, z;
+    tree.getMetricMin(x, y, z);
+    EXPECT_EQ (x, 0.0);
+    tree.updateNode(point3d(0.51f, 0.52f, 0.53f), true);
+    checkMetricBounds(tree);
+
+    // grows with every update, without a recomputation in between
+    srand(7);
+    for (int i = 0; i < 200; ++i) {
+      point3d p ((float) (rand() % 400 - 200) * 0.01f, (float) (rand() % 400 - 200) * 0.01f,
+                 (float) (rand() % 100) * 0.01f);
+      tree.updateNode(p, (rand() % 4 != 0));
+      if (i % 20 == 0)
+        checkMetricBounds(tree);
+    }
+    checkMetricBounds(tree);
+
+    Pointcloud cloud;
+    for (int i=-20; i<20; i++)
+      cloud.push_back((float) i*0.05f, 3.0f, 0.5f);
+    tree.insertPointCloud(cloud, point3d(0.0f, 0.0f, 0.5f));
+    checkMetricBounds(tree);
+    tree.setNodeValue(point3d(-4.0f, 0.0f, 0.0f), tree.getClampingThresMaxLog());
+    checkMetricBounds(tree);
+    std::vector<std::pair<OcTreeKey, float> > updates;
+    updates.push_back(std::make_pair(tree.coordToKey(point3d(0.0f, -5.0f, 0.0f)), 0.85f));
+    updates.push_back(std::make_pair(tree.coordToKey(point3d(0.0f, 0.0f, -2.0f)), -0.4f));
+    tree.updateNodes(updates);
+    checkMetricBounds(tree);
+
+    // shrinks with deletions
+    tree.deleteNode(point3d(0.0f, -5.0f, 0.0f));
+    checkMetricBounds(tree);
+    tree.deleteNode(point3d(-4.0f, 0.0f, 0.0f), 10);
+    checkMetricBounds(tree);
+
+    tree.expand();
+    checkMetricBounds(tree);
+    tree.prune();
+    checkMetricBounds(tree);
+    tree.enableDirtyTracking(true);
+    tree.updateNode(point3d(6.0f, 0.0f, 0.0f), true, true);
+    tree.prune();
+    checkMetricBounds(tree);
+
+    OcTree swapped (0.05);
+    swapped.swapContent(tree);
+    checkMetricBounds(swapped);
+    checkMetricBounds(tree);
+    swapped.clear();
+    checkMetricBounds(swapped);
+
+    CountingOcTree counting_tree (0.05);
+    counting_tree.updateNode(point3d(1.0f, 1.0f, 1.0f));
+    counting_tree.getMetricMin(x, y, z);
+    for (int i=0; i<20; i++)
+      counting_tree.updateNode(point3d((float) i*0.3f, -1.0f, 0.0f));
+    checkMetricBounds(counting_tree);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "TreeDepth") {
+    OcTree tree (0.05);
+    EXPECT_EQ (tree.getTreeDepth(), OCTOMAP_TREE_DEPTH);
+    EXPECT_TRUE (sizeof(key_type) * 8 >= tree.getTreeDepth());
+    const key_type max_key = (key_type) ((1u << OCTOMAP_TREE_DEPTH) - 1);
+    OcTreeKey corner_key (max_key, 0, max_key);
+    EXPECT_TRUE (mortonCodeToKey(computeMortonCode(corner_key)) == corner_key);
+    EXPECT_TRUE (computeIndexKey(OCTOMAP_TREE_DEPTH - 1, corner_key) == OcTreeKey(max_key & ~(max_key >> 1), 0, max_key & ~(max_key >> 1)));
+
+    // voxels at the bounds of the tree
+    const float half_size = (float) (tree.getNodeSize(0) / 2.0);
+    const float center = half_size - 0.025f;
+    point3d max_point (center, center, center);
+    point3d min_point (-center, -center, -center);
+    OcTreeKey key;
+    EXPECT_TRUE (tree.coordToKeyChecked(max_point, key));
+    EXPECT_TRUE (key == OcTreeKey(max_key, max_key, max_key));
+    EXPECT_TRUE (tree.coordToKeyChecked(min_point, key));
+    EXPECT_TRUE (key == OcTreeKey(0, 0, 0));
+    EXPECT_FALSE (tree.coordToKeyChecked(point3d(half_size + 0.05f, 0.0f, 0.0f), key));
+
+    tree.updateNode(max_point, true);
+    tree.updateNode(min_point, true);
+    EXPECT_EQ (tree.getNumLeafNodes(), 2);
+    EXPECT_EQ (tree.size(), 2 * tree.getTreeDepth() + 1);
+    for (unsigned int depth = 1; depth <= tree.getTreeDepth(); ++depth) {
+      EXPECT_TRUE (tree.search(max_point, depth));
+      EXPECT_TRUE (tree.search(min_point, depth));
+      EXPECT_FALSE (tree.search(point3d(center, -center, center), depth));
+    }
+    double x, y, z;
+    tree.getMetricMax(x, y, z);
+    EXPECT_FLOAT_EQ (x, tree.getNodeSize(0) / 2.0);
+    tree.getMetricMin(x, y, z);
+    EXPECT_FLOAT_EQ (x, -tree.getNodeSize(0) / 2.0);
+
+    // ray through the tree center: all keys from the origin up to the end (excluded)
+    KeyRay ray;
+    point3d ray_origin (-0.99f, 0.01f, 0.01f), ray_end (0.99f, 0.01f, 0.01f);
+    EXPECT_TRUE (tree.computeRayKeys(ray_origin, ray_end, ray));
+    EXPECT_EQ (ray.size(), (size_t) (tree.coordToKey(ray_end)[0] - tree.coordToKey(ray_origin)[0]));
+
+    // binary round trip, files of other depths are rejected
+    std::stringstream ss;
+    EXPECT_TRUE (tree.writeBinary(ss));
+    OcTree read_tree (0.1);
+    EXPECT_TRUE (read_tree.readBinary(ss));
+    EXPECT_EQ (read_tree.size(), tree.size());
+    EXPECT_TRUE (read_tree.search(max_point));
+    EXPECT_TRUE (read_tree.search(min_point));
+
+    std::stringstream other_depth;
+    other_depth << "# Octomap OcTree binary file\nid OcTree\nsize 0\nres 0.05\ndepth "
+                << (OCTOMAP_TREE_DEPTH - 1) << "\ndata\n";
+    EXPECT_FALSE (read_tree.readBinary(other_depth));
+
+  // ------------------------------------------------------------
+  } else if (test_name == "ScrollingWindow") {
+    OcTree tree (0.05);
+    srand(11);
+    for (int i = 0; i < 2000; ++i) {
+      point3d p ((float) (rand() % 1000 - 500) * 0.01f, (float) (rand() % 1000 - 500) * 0.01f,
+                 (float) (rand() % 200 - 100) * 0.01f);
+      tree.updateNode(p, (rand() % 4 != 0));
+    }
+    // pruned block of 16^3 voxels across the window boundary
+    for (int x = 0; x < 16; ++x)
+      for (int y = 0; y < 16; ++y)
+        for (int z = 0; z < 16; ++z)
+          tree.setNodeValue(OcTreeKey(tree.coordToKey(1.6) + x, tree.coordToKey(-0.8) + y, tree.coordToKey(-0.4) + z), 2.0f);
+    OcTree reference (tree);
+
+    // only the window around the center remains, unchanged
+    tree.enableScrollingWindow(4.0);
+    tree.moveScrollingWindow(point3d(0.0f, 0.0f, 0.0f));
+    EXPECT_TRUE (tree.getNumLeafNodes() > 0);
+    EXPECT_TRUE (tree.getNumLeafNodes() < reference.getNumLeafNodes());
+    for (OcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+      point3d p = it.getCoordinate();
+      EXPECT_TRUE (fabs(p.x()) < 2.05 && fabs(p.y()) < 2.05 && fabs(p.z()) < 2.05);
+      EXPECT_EQ (it->getLogOdds(), reference.search(it.getKey())->getLogOdds());
+    }
+    size_t num_inside = 0;
+    for (OcTree::leaf_iterator it = reference.begin_leafs(); it != reference.end_leafs(); ++it) {
+      if (tree.inBBX(it.getKey()))
+        EXPECT_TRUE (tree.search(it.getKey()));
+      point3d p = it.getCoordinate();
+      if (fabs(p.x()) < 1.9 && fabs(p.y()) < 1.9 && fabs(p.z()) < 1.9)
+        num_inside++;
+    }
+    EXPECT_TRUE (num_inside > 0);
+    checkNodeStatistics(tree);
+    checkMetricBounds(tree);
+
+    // moving on deletes what leaves the window, updates outside are ignored
+    tree.moveScrollingWindow(point3d(1.0f, 0.0f, 0.0f));
+    Pointcloud cloud;
+    cloud.push_back(2.5f, 0.0f, 0.0f);
+    cloud.push_back(-3.0f, 0.0f, 0.0f);
+    tree.insertPointCloud(cloud, point3d(1.0f, 0.0f, 0.0f));
+    EXPECT_TRUE (tree.search(point3d(2.5f, 0.0f, 0.0f)));
+    EXPECT_TRUE (tree.isNodeOccupied(tree.search(point3d(2.5f, 0.0f, 0.0f))));
+    EXPECT_FALSE (tree.search(point3d(-1.5f, 0.0f, 0.0f)));
+    checkNodeStatistics(tree);
+    checkMetricBounds(tree);
+
+    // translation of the tree by whole subtrees, snapshots keep their nodes
+    OcTree shifted (tree);
+#if !defined(OCTOMAP_NO_NODE_FLAGS) && !defined(OCTOMAP_INDEXED_CHILDREN)
+    const OccupancyOcTreeBase<OcTreeNode>* snapshot = shifted.snapshot();
+    shifted.shiftKeys(128, 0, -256);
+    EXPECT_TRUE (*snapshot == tree);
+    delete snapshot;
+#else
+    shifted.shiftKeys(128, 0, -256);
+#endif
+    EXPECT_EQ (shifted.getNumLeafNodes(), tree.getNumLeafNodes());
+    for (OcTree::leaf_iterator it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+      OcTreeKey key (it.getKey()[0] + 128, it.getKey()[1], it.getKey()[2] - 256);
+      OcTreeNode* node = shifted.search(key, it.getDepth());
+      EXPECT_TRUE (node);
+      EXPECT_FALSE (shifted.nodeHasChildren(node));
+      EXPECT_EQ (node->getLogOdds(), it->getLogOdds());
+    }
+    checkNodeStatistics(shifted);
+    checkMetricBounds(shifted);
+    shifted.shiftKeys(3, 0, 0); // single voxels
+    EXPECT_TRUE (shifted.search(OcTreeKey(tree.coordToKey(2.5) + 131, tree.coordToKey(0.0), tree.coordToKey(0.0) - 256)));
+    checkNodeStatistics(shifted);
+    shifted.shiftKeys(2*32768, 0, 0); // out of range
+    EXPECT_EQ (shifted.size(), 0);
+
+    // the replaced root goes back to the pool
+    OcTree pool_tree (0.1);
+    pool_tree.updateNode(point3d(1.0f, 1.0f, 1.0f), true);
+    pool_tree.shiftKeys(256, 0, 0);
+    pool_tree.shiftKeys(-256, 0, 0);
+    size_t pool_memory = pool_tree.memoryUsage();
+    for (unsigned int i = 0; i < 500; ++i) {
+      pool_tree.shiftKeys(256, 0, 0);
+      pool_tree.shiftKeys(-256, 0, 0);
+    }
+    EXPECT_EQ (pool_tree.memoryUsage(), pool_memory);
+    checkNodeStatistics(pool_tree);
+
+    // inner nodes above the moved subtrees are updated by the tree type
+    ColorOcTree color_tree (0.1);
+    color_tree.updateNode(point3d(1.0f, 1.0f, 1.0f), true);
+    color_tree.setNodeColor(1.0f, 1.0f, 1.0f, 255, 0, 0);
+    color_tree.updateInnerOccupancy();
+    color_tree.shiftKeys(256, 0, 0);
+    EXPECT_EQ (color_tree.getRoot()->getColor(), ColorOcTreeNode::Color(255, 0, 0));
+
+    // key space is re-centered before the window reaches its boundary
+    OcTree fine_tree (0.01);
+    fine_tree.updateNode(point3d(0.0f, 0.0f, 0.0f), true);
+    fine_tree.enableScrollingWindow(2.0, true);
+    fine_tree.moveScrollingWindow(point3d(100.0f, 0.0f, 0.0f));
+    EXPECT_EQ (fine_tree.getScrollingWindowOffset().x(), 0.0f);
+    EXPECT_EQ (fine_tree.size(), 0);
+    fine_tree.updateNode(point3d(100.5f, 0.5f, 0.5f), true);
+    fine_tree.updateNode(point3d(326.0f, 0.5f, 0.5f), true); // ahead of the window
+    float log_odds = fine_tree.search(point3d(326.0f, 0.5f, 0.5f))->getLogOdds();
+    fine_tree.moveScrollingWindow(point3d(326.0f, 0.0f, 0.0f));
+    point3d offset = fine_tree.getScrollingWindowOffset();
+    EXPECT_TRUE (offset.x() > 325.0f && offset.x() < 327.0f);
+    EXPECT_EQ (offset.y(), 0.0f);
+    EXPECT_EQ (fine_tree.getNumLeafNodes(), 1);
+    OcTreeNode* node = fine_tree.search(point3d(326.0f, 0.5f, 0.5f) - offset);
+    EXPECT_TRUE (node);
+    EXPECT_EQ (node->getLogOdds(), log_odds);
+    EXPECT_TRUE (fine_tree.inBBX(point3d(326.9f, 0.0f, 0.0f) - offset));
+    checkNodeStatistics(fine_tree);
+    checkMetricBounds(fine_tree);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "Paging") {
+    // clusters of voxels in different subtrees at depth 8 (12.8 m)
+    OcTree tree (0.05);
+    for (int c = 0; c < 6; ++c)
+      for (float x = 0.0f; x < 1.0f; x += 0.05f)
+        for (float y = 0.0f; y < 1.0f; y += 0.05f)
+          tree.updateNode(point3d(20.0f * c + x, y - 10.0f * c, 0.3f * x), (x + y) < 1.0f);
+    OcTree reference (tree);
+    double ref_min[3], ref_max[3];
+    reference.getMetricMin(ref_min[0], ref_min[1], ref_min[2]);
+    reference.getMetricMax(ref_max[0], ref_max[1], ref_max[2]);
+
+    EXPECT_FALSE (tree.enablePaging("paging_test.bin", 0, 0));
+    EXPECT_FALSE (tree.enablePaging("paging_test.bin", 0, tree.getTreeDepth()));
+    size_t budget = tree.memoryUsageResident() / 3;
+    EXPECT_TRUE (tree.enablePaging("paging_test.bin", budget, 8));
+    EXPECT_TRUE (tree.enforceMemoryBudget() >= 4);
+    EXPECT_TRUE (tree.getNumPagedSubtrees() >= 4);
+    EXPECT_TRUE (tree.memoryUsageResident() <= budget);
+    EXPECT_TRUE (tree.calcNumNodes() < reference.size());
+    EXPECT_EQ (tree.size(), reference.size());
+    EXPECT_EQ (tree.getNumInnerNodes(), reference.getNumInnerNodes());
+    EXPECT_EQ (tree.getNumLeafNodes(), reference.getNumLeafNodes());
+    EXPECT_FALSE (tree.snapshot());
+
+    // bounds of the paged-out subtrees, no pruning of their roots
+    double min_val[3], max_val[3];
+    tree.getMetricMin(min_val[0], min_val[1], min_val[2]);
+    tree.getMetricMax(max_val[0], max_val[1], max_val[2]);
+    for (unsigned int i = 0; i < 3; ++i) {
+      EXPECT_EQ (min_val[i], ref_min[i]);
+      EXPECT_EQ (max_val[i], ref_max[i]);
+    }
+    tree.prune();
+    EXPECT_TRUE (tree.getNumPagedSubtrees() >= 4);
+
+    // const queries leave the tree unchanged, they stop at the paged-out subtrees
+    size_t num_paged = tree.getNumPagedSubtrees();
+    const OcTree& const_tree = tree;
+    size_t num_coarse = 0;
+    for (OcTree::leaf_iterator it = reference.begin_leafs(); it != reference.end_leafs(); ++it) {
+      OcTreeNode* node = const_tree.search(it.getKey(), it.getDepth());
+      EXPECT_TRUE (node);
+      EXPECT_TRUE (node->getLogOdds() >= it->getLogOdds());
+      if (it.getDepth() > 8 && node == const_tree.search(it.getKey(), 8))
+        num_coarse++;
+    }
+    EXPECT_TRUE (num_coarse > 0);
+    size_t num_leafs = 0;
+    for (OcTree::leaf_iterator it = const_tree.begin_leafs(); it != const_tree.end_leafs(); ++it)
+      num_leafs++;
+    EXPECT_TRUE (num_leafs >= num_paged);
+    EXPECT_TRUE (num_leafs < reference.getNumLeafNodes());
+    EXPECT_EQ (tree.getNumPagedSubtrees(), num_paged);
+
+    // pageIn() reads them back
+    EXPECT_FALSE (tree.pageIn(tree.coordToKey(point3d(-50.0f, 50.0f, 0.0f))));
+    for (OcTree::leaf_iterator it = reference.begin_leafs(); it != reference.end_leafs(); ++it) {
+      tree.pageIn(it.getKey());
+      OcTreeNode* node = tree.search(it.getKey(), it.getDepth());
+      EXPECT_TRUE (node);
+      EXPECT_EQ (node->getLogOdds(), it->getLogOdds());
+    }
+    EXPECT_EQ (tree.getNumPagedSubtrees(), 0);
+    EXPECT_EQ (tree.size(), reference.size());
+    checkNodeStatistics(tree);
+
+    // updates page in and out within the budget, also with lazy evaluation
+    for (int c = 5; c >= 0; --c)
+      for (float x = 0.0f; x < 1.0f; x += 0.1f) {
+        point3d p (20.0f * c + x, 0.5f - 10.0f * c, 0.3f * x + 0.05f);
+        tree.updateNode(p, (c % 2) == 0, c < 3);
+        reference.updateNode(p, (c % 2) == 0, c < 3);
+        EXPECT_TRUE (tree.memoryUsageResident() <= budget);
+      }
+    EXPECT_TRUE (tree.getNumPagedSubtrees() > 0);
+    tree.updateInnerOccupancy();
+    reference.updateInnerOccupancy();
+    std::vector<std::pair<OcTreeKey, float> > updates;
+    for (int c = 0; c < 6; ++c)
+      updates.push_back(std::make_pair(tree.coordToKey(point3d(20.0f * c + 0.55f, 0.25f - 10.0f * c, 0.1f)), -0.4f));
+    tree.updateNodes(updates);
+    reference.updateNodes(updates);
+    EXPECT_TRUE (tree.deleteNode(point3d(0.5f, 0.5f, 0.15f)) == reference.deleteNode(point3d(0.5f, 0.5f, 0.15f)));
+    EXPECT_TRUE (tree.memoryUsageResident() <= budget);
+
+    // writing, copying and comparing see all nodes, without reading them back
+    tree.enforceMemoryBudget();
+    num_paged = tree.getNumPagedSubtrees();
+    EXPECT_TRUE (num_paged > 0);
+    std::stringstream buffer;
+    EXPECT_TRUE (tree.write(buffer));
+    OcTree* read_tree = dynamic_cast<OcTree*>(AbstractOcTree::read(buffer));
+    EXPECT_TRUE (read_tree);
+    EXPECT_TRUE (*read_tree == reference);
+    EXPECT_TRUE (tree == *read_tree);
+    delete read_tree;
+    OcTree paged_copy (tree);
+    EXPECT_EQ (paged_copy.getNumPagedSubtrees(), 0);
+    EXPECT_EQ (paged_copy.size(), reference.size());
+    EXPECT_TRUE (paged_copy == reference);
+    checkNodeStatistics(paged_copy);
+    EXPECT_EQ (tree.getNumPagedSubtrees(), num_paged);
+    paged_copy.updateNode(point3d(0.5f, 0.5f, 0.15f), true);
+    EXPECT_FALSE (tree == paged_copy);
+
+    // the headers count the paged-out nodes as well
+    tree.enforceMemoryBudget();
+    EXPECT_TRUE (tree.getNumPagedSubtrees() > 0);
+    EXPECT_TRUE (tree.write("paging_test.ot"));
+    read_tree = dynamic_cast<OcTree*>(AbstractOcTree::read("paging_test.ot"));
+    EXPECT_TRUE (read_tree);
+    EXPECT_EQ (read_tree->size(), reference.size());
+    EXPECT_TRUE (*read_tree == reference);
+    delete read_tree;
+    std::ifstream ot_file ("paging_test.ot");
+    std::string token;
+    while (ot_file >> token && token != "size") {}
+    size_t header_size = 0;
+    ot_file >> header_size;
+    EXPECT_EQ (header_size, reference.size());
+    ot_file.close();
+    std::remove("paging_test.ot");
+    tree.enforceMemoryBudget();
+    EXPECT_TRUE (tree.getNumPagedSubtrees() > 0);
+    EXPECT_TRUE (tree.writeBinaryConst("paging_test.bt"));
+    EXPECT_TRUE (reference.writeBinaryConst("paging_reference.bt"));
+    OcTree read_binary (0.05);
+    OcTree reference_binary (0.05);
+    EXPECT_TRUE (read_binary.readBinary("paging_test.bt"));
+    EXPECT_TRUE (reference_binary.readBinary("paging_reference.bt"));
+    EXPECT_TRUE (read_binary == reference_binary);
+    std::remove("paging_test.bt");
+    std::remove("paging_reference.bt");
+
+    tree.enforceMemoryBudget();
+    EXPECT_TRUE (tree.getNumPagedSubtrees() > 0);
+    EXPECT_TRUE (tree == reference);
+    tree.pageInAll(); // the traversals of the checks stop at paged-out subtrees
+    checkNodeStatistics(tree);
+    checkMetricBounds(tree);
+
+    tree.enforceMemoryBudget();
+    tree.disablePaging();
+    EXPECT_EQ (tree.getNumPagedSubtrees(), 0);
+    EXPECT_TRUE (tree == reference);
+    EXPECT_FALSE (std::ifstream("paging_test.bin").good());
+
+    // derived node data is paged as well
+    {
+      ColorOcTree color_tree (0.05);
+      EXPECT_TRUE (color_tree.enablePaging("paging_color_test.bin", 1, 8));
+      for (int c = 0; c < 4; ++c) {
+        color_tree.updateNode(point3d(20.0f * c, 0.0f, 0.0f), true);
+        color_tree.setNodeColor(color_tree.coordToKey(point3d(20.0f * c, 0.0f, 0.0f)), 50 * c, 10, 20);
+      }
+      EXPECT_EQ (color_tree.getNumPagedSubtrees(), 3);
+      for (int c = 0; c < 4; ++c) {
+        color_tree.pageIn(color_tree.coordToKey(point3d(20.0f * c, 0.0f, 0.0f)));
+        ColorOcTreeNode* node = color_tree.search(point3d(20.0f * c, 0.0f, 0.0f));
+        EXPECT_TRUE (node);
+        EXPECT_TRUE (node->getColor() == ColorOcTreeNode::Color(50 * c, 10, 20));
+      }
+    }
+    EXPECT_FALSE (std::ifstream("paging_color_test.bin").good());
+
+  // ------------------------------------------------------------
+  } else if (test_name == "MultiResolutionFreeSpace") {
+    // long rays to walls 30 m around the sensor
+    Pointcloud cloud;
+    for (float azimuth = -3.14f; azimuth < 3.14f; azimuth += 0.02f) {
+      for (float elevation = -0.3f; elevation < 0.3f; elevation += 0.02f) {
+        point3d dir (cos(elevation) * cos(azimuth), cos(elevation) * sin(azimuth), sin(elevation));
+        cloud.push_back(dir * (30.0f / std::max(fabs(dir.x()), fabs(dir.y()))));
+      }
+    }
+    point3d origin (0.01f, 0.02f, 0.03f);
+
+    OcTree reference (0.1);
+    KeyFlatSet ref_free, ref_occupied;
+    reference.computeUpdate(cloud, origin, ref_free, ref_occupied, -1.0);
+
+    OcTree tree (0.1);
+    EXPECT_FALSE (tree.isMultiResolutionFreeSpaceEnabled());
+    tree.enableMultiResolutionFreeSpace(3.0, 4);
+    EXPECT_TRUE (tree.isMultiResolutionFreeSpaceEnabled());
+    std::vector<KeyFlatSet> free_cells;
+    KeyFlatSet occupied_cells;
+    tree.computeMultiResolutionUpdate(cloud, origin, free_cells, occupied_cells, -1.0);
+    EXPECT_EQ (free_cells.size(), (size_t) 5);
+    EXPECT_EQ (occupied_cells.size(), ref_occupied.size());
+    size_t num_free = 0;
+    for (size_t level = 0; level < free_cells.size(); ++level) {
+      EXPECT_FALSE (free_cells[level].empty());
+      num_free += free_cells[level].size();
+    }
+    std::cout << "Free nodes: " << ref_free.size() << " leaves, " << num_free << " multi-resolution" << std::endl;
+    EXPECT_TRUE (num_free * 10 < ref_free.size());
+
+    // free nodes do not overlap each other or the endpoints
+    for (key_type level = 0; level < free_cells.size(); ++level) {
+      for (KeyFlatSet::iterator it = free_cells[level].begin(); it != free_cells[level].end(); ++it) {
+        EXPECT_TRUE (computeIndexKey(level, *it) == *it);
+        for (key_type coarse = level + 1; coarse < free_cells.size(); ++coarse)
+          EXPECT_TRUE (free_cells[coarse].find(computeIndexKey(coarse, *it)) == free_cells[coarse].end());
+      }
+    }
+    for (KeyFlatSet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it) {
+      EXPECT_TRUE (ref_occupied.find(*it) != ref_occupied.end());
+      for (key_type level = 0; level < free_cells.size(); ++level)
+        EXPECT_TRUE (free_cells[level].find(computeIndexKey(level, *it)) == free_cells[level].end());
+    }
+    // the free leaves of computeUpdate() are covered (up to differences of the ray traversal)
+    size_t num_uncovered = 0;
+    for (KeyFlatSet::iterator it = ref_free.begin(); it != ref_free.end(); ++it) {
+      bool covered = false;
+      for (key_type level = 0; level < free_cells.size() && !covered; ++level)
+        covered = (free_cells[level].find(computeIndexKey(level, *it)) != free_cells[level].end());
+      if (!covered)
+        ++num_uncovered;
+    }
+    EXPECT_TRUE (num_uncovered * 100 < ref_free.size());
+
+    // within range, all free space at the lowest level
+    OcTree fine (0.1);
+    fine.enableMultiResolutionFreeSpace(100.0, 4);
+    std::vector<KeyFlatSet> fine_cells;
+    KeyFlatSet fine_occupied;
+    fine.computeMultiResolutionUpdate(cloud, origin, fine_cells, fine_occupied, -1.0);
+    for (size_t level = 1; level < fine_cells.size(); ++level)
+      EXPECT_TRUE (fine_cells[level].empty());
+    EXPECT_TRUE (fine_cells[0].size() * 100 > ref_free.size() * 99);
+    EXPECT_TRUE (fine_cells[0].size() * 99 < ref_free.size() * 100);
+
+    // inserted scan: endpoints occupied, free space free, far fewer nodes
+    tree.enableChangeDetection(true);
+    tree.insertPointCloud(cloud, origin);
+    reference.insertPointCloud(cloud, origin);
+    for (size_t i = 0; i < cloud.size(); ++i) {
+      OcTreeNode* node = tree.search(cloud[i]);
+      EXPECT_TRUE (node && tree.isNodeOccupied(node));
+    }
+    size_t num_free_leaves = 0;
+    for (KeyFlatSet::iterator it = ref_free.begin(); it != ref_free.end(); ++it) {
+      OcTreeNode* node = tree.search(*it);
+      if (node && !tree.isNodeOccupied(node))
+        ++num_free_leaves;
+    }
+    EXPECT_TRUE (num_free_leaves * 100 > ref_free.size() * 99);
+    std::cout << "Leaf nodes: " << reference.getNumLeafNodes() << " leaves, "
+              << tree.getNumLeafNodes() << " multi-resolution" << std::endl;
+    EXPECT_TRUE (tree.getNumLeafNodes() < reference.getNumLeafNodes());
+    EXPECT_TRUE (tree.numChangesDetected() > 0);
+
+    // changes of coarse free nodes are recorded with the key and depth of the node
+    size_t num_coarse_changes = 0;
+    for (KeyBoolMap::const_iterator it = tree.changedKeysBegin(); it != tree.changedKeysEnd(); ++it) {
+      unsigned int depth = tree.changedKeyDepth(it->first);
+      EXPECT_TRUE (depth <= tree.getTreeDepth() && depth + 4 >= tree.getTreeDepth());
+      if (depth < tree.getTreeDepth()) {
+        ++num_coarse_changes;
+        EXPECT_TRUE (tree.adjustKeyAtDepth(it->first, depth) == it->first);
+        OcTreeNode* node = tree.search(it->first, depth);
+        EXPECT_TRUE (node && !tree.isNodeOccupied(node));
+      }
+    }
+    EXPECT_TRUE (num_coarse_changes > 0);
+
+    // same tree and changes with the coarse levels updated in parallel
+    OcTree parallel_tree (0.1);
+    parallel_tree.setNumThreads(4);
+    parallel_tree.enableMultiResolutionFreeSpace(3.0, 4);
+    parallel_tree.enableChangeDetection(true);
+    parallel_tree.insertPointCloud(cloud, origin);
+    EXPECT_TRUE (parallel_tree == tree);
+    EXPECT_EQ (parallel_tree.numChangesDetected(), tree.numChangesDetected());
+    for (KeyBoolMap::const_iterator it = tree.changedKeysBegin(); it != tree.changedKeysEnd(); ++it)
+      EXPECT_EQ (parallel_tree.changedKeyDepth(it->first), tree.changedKeyDepth(it->first));
+
+    // the same scan again changes no occupancy and creates no nodes
+    tree.resetChangeDetection();
+    size_t tree_size = tree.size();
+    tree.insertPointCloud(cloud, origin);
+    EXPECT_EQ (tree.numChangesDetected(), (size_t) 0);
+    EXPECT_TRUE (tree.size() <= tree_size);
+
+    tree.disableMultiResolutionFreeSpace();
+    EXPECT_FALSE (tree.isMultiResolutionFreeSpaceEnabled());
+
+  // ------------------------------------------------------------
+  } else if (test_name == "DepthImage") {
+    // tilted wall with a hole of invalid pixels and a far part beyond maxrange,
+    // stored with padding after each row
+    const unsigned int width = 160;
+    const unsigned int height = 120;
+    const unsigned int pitch = width + 7;
+    const double maxrange = 5.0;
+    CameraIntrinsics intrinsics (120.0, 120.0, 79.5, 59.5);
+    std::vector<float> image (pitch * height, -1.0f);
+    for (unsigned int v = 0; v < height; ++v) {
+      for (unsigned int u = 0; u < width; ++u) {
+        float d = 2.0f + 0.01f * (float) u + 0.005f * (float) v;
+        if (u >= 60 && u < 80 && v >= 40 && v < 60)
+          d = 0.0f;
+        else if (u >= 140)
+          d = 8.0f;
+        image[v * pitch + u] = d;
+      }
+    }
+    image[10 * pitch + 10] = std::numeric_limits<float>::quiet_NaN();
+    pose6d pose (1.0f, -0.5f, 0.3f, -1.5, 0.1, -1.4);
+
+    // reference: the same points with insertPointCloud()
+    Pointcloud cloud;
+    for (unsigned int v = 0; v < height; ++v) {
+      for (unsigned int u = 0; u < width; ++u) {
+        float d = image[v * pitch + u];
+        if (d > 0.0f && d <= maxrange)
+          cloud.push_back(pose.transform(point3d((float) (((double) u - intrinsics.cx) * d / intrinsics.fx),
+                                                 (float) (((double) v - intrinsics.cy) * d / intrinsics.fy), d)));
+      }
+    }
+    OcTree reference (0.05);
+    KeyFlatSet ref_free, ref_occupied;
+    reference.computeUpdate(cloud, pose.trans(), ref_free, ref_occupied, -1.0);
+
+    OcTree tree (0.05);
+    std::vector<KeyFlatSet> free_cells;
+    KeyFlatSet occupied_cells;
+    tree.computeDepthImageUpdate(&image[0], width, height, intrinsics, pose, maxrange, pitch * sizeof(float),
+                                 free_cells, occupied_cells);
+    EXPECT_TRUE (occupied_cells.size() == ref_occupied.size());
+    size_t num_free = 0;
+    for (size_t level = 0; level < free_cells.size(); ++level)
+      num_free += free_cells[level].size();
+    std::cout << "Free nodes: " << ref_free.size() << " by ray casting, " << num_free << " projected" << std::endl;
+    EXPECT_TRUE (num_free * 3 < ref_free.size() * 2);
+
+    timeval start, stop;
+    gettimeofday(&start, NULL);
+    tree.insertDepthImage(&image[0], width, height, intrinsics, pose, maxrange, pitch * sizeof(float));
+    gettimeofday(&stop, NULL);
+    double time_depth = (stop.tv_sec - start.tv_sec) + 1.0e-6 * (stop.tv_usec - start.tv_usec);
+    gettimeofday(&start, NULL);
+    reference.insertPointCloud(cloud, pose.trans());
+    gettimeofday(&stop, NULL);
+    double time_cloud = (stop.tv_sec - start.tv_sec) + 1.0e-6 * (stop.tv_usec - start.tv_usec);
+    std::cout << "insertDepthImage: " << time_depth << " s, insertPointCloud: " << time_cloud << " s" << std::endl;
+
+    // endpoints occupied, free space of the rays (almost all) free
+    for (KeyFlatSet::iterator it = ref_occupied.begin(); it != ref_occupied.end(); ++it) {
+      OcTreeNode* node = tree.search(*it);
+      EXPECT_TRUE (node && tree.isNodeOccupied(node));
+    }
+    size_t num_free_leaves = 0;
+    for (KeyFlatSet::iterator it = ref_free.begin(); it != ref_free.end(); ++it) {
+      OcTreeNode* node = tree.search(*it);
+      if (node && !tree.isNodeOccupied(node))
+        ++num_free_leaves;
+    }
+    EXPECT_TRUE (num_free_leaves * 100 > ref_free.size() * 95);
+
+    // nothing behind the wall, in front of invalid pixels or beyond maxrange
+    point3d behind = pose.transform(point3d(0.0f, 0.0f, 4.0f));
+    EXPECT_FALSE (tree.search(behind));
+    point3d hole = pose.transform(point3d((float) ((70.0 - intrinsics.cx) / intrinsics.fx),
+                                          (float) ((50.0 - intrinsics.cy) / intrinsics.fy), 1.0f));
+    EXPECT_FALSE (tree.search(hole));
+    point3d far_free = pose.transform(point3d((float) (4.0 * (150.0 - intrinsics.cx) / intrinsics.fx),
+                                              (float) (4.0 * (60.0 - intrinsics.cy) / intrinsics.fy), 4.0f));
+    EXPECT_TRUE (tree.search(far_free) && !tree.isNodeOccupied(tree.search(far_free)));
+    point3d far_unknown = pose.transform(point3d((float) (6.0 * (150.0 - intrinsics.cx) / intrinsics.fx),
+                                                 (float) (6.0 * (60.0 - intrinsics.cy) / intrinsics.fy), 6.0f));
+    EXPECT_FALSE (tree.search(far_unknown));
+
+    // same result from a buffer without padding
+    std::vector<float> packed (width * height);
+    for (unsigned int v = 0; v < height; ++v)
+      std::copy(&image[v * pitch], &image[v * pitch] + width, &packed[v * width]);
+    OcTree packed_tree (0.05);
+    packed_tree.insertDepthImage(&packed[0], width, height, intrinsics, pose, maxrange);
+    EXPECT_TRUE (packed_tree == tree);
+
   // ------------------------------------------------------------
   } else {
     std::cerr << "Invalid test name specified: " << test_name << std::endl;